@@ -1,15 +1,18 @@
 all: ctf $(DEFAULT_COMPONENTS)
 
 ALL_COMPONENTS = libs bins bench_ao_ccsd bench_ao_ccsd_lambda bench_ao_ccsdt \
-                 bench_cholesky_ccsd bench_cholesky_ccsd_lambda bench_cholesky_ccsdt
+                 bench_cholesky_ccsd bench_cholesky_ccsd_lambda bench_cholesky_ccsdt \
+                 bench_boys bench_contract bench_permute bench_product bench_rys
 
 libs: phase1
 
 bins bench_ao_ccsd bench_ao_ccsd_lambda bench_ao_ccsdt bench_cholesky_ccsd \
-     bench_cholesky_ccsd_lambda bench_cholesky_ccsdt: libs phase2
+     bench_cholesky_ccsd_lambda bench_cholesky_ccsdt bench_boys bench_contract bench_permute \
+     bench_product bench_rys: libs phase2
 
 bins: bench_ao_ccsd bench_ao_ccsd_lambda bench_ao_ccsdt bench_cholesky_ccsd \
-      bench_cholesky_ccsd_lambda bench_cholesky_ccsdt
+      bench_cholesky_ccsd_lambda bench_cholesky_ccsdt bench_boys bench_contract bench_permute \
+      bench_product bench_rys
 
 LOWER_NO_UNDERSCORE = 1
 LOWER_UNDERSCORE = 2
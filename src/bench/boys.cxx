@@ -0,0 +1,137 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "omp.h"
+
+#include "integrals/internal.h"
+#include "time/time.hpp"
+
+using namespace std;
+using namespace aquarius;
+
+/*
+ * Reference value from the series in extended precision
+ */
+static double fmreference(double T, int m)
+{
+    long double ap = m + 0.5L;
+    long double sum = 1.0L / (2 * ap * expl(T));
+    long double delt = sum;
+    ap += 1.0L;
+
+    while (delt > sum*1e-25L)
+    {
+        delt *= T / ap;
+        ap += 1.0L;
+        sum += delt;
+    }
+
+    return (double)sum;
+}
+
+/*
+ * Compare the tabulated, batched Boys function (fmvec) against the series (fm)
+ * for accuracy and speed:
+ *
+ *  bench-boys [number of T values] [maximum T]
+ */
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+
+    {
+        int n = argc > 1 ? atoi(argv[1]) : 100000;
+        double Tmax = argc > 2 ? atof(argv[2]) : 50.0;
+        const int nrep = 5;
+
+        time::tic();
+
+        vector<double> T(n);
+        srand(1);
+        for (int i = 0;i < n;i++) T[i] = Tmax*rand()/RAND_MAX;
+
+        /*
+         * Make sure that the grid points, interval ends, and the switch to the
+         * asymptotic form are hit
+         */
+        for (int i = 0;i < min(n,64);i++) T[i] = i*0.025;
+        for (int i = 64;i < min(n,128);i++) T[i] = 30+(i-64)*1.5;
+
+        printf("%4s %14s %14s %14s %10s\n", "mmax", "max rel. err.", "series (ns/T)", "fmvec (ns/T)", "speedup");
+
+        const int orders[] = {0, 2, 4, 8, 12, 16, 24, 32};
+
+        for (int o = 0;o < sizeof(orders)/sizeof(orders[0]);o++)
+        {
+            int mmax = orders[o];
+
+            vector<double> F((mmax+1)*n);
+            vector<double> G((mmax+1)*n);
+
+            double t0 = omp_get_wtime();
+            for (int r = 0;r < nrep;r++)
+            {
+                for (int i = 0;i < n;i++)
+                {
+                    for (int m = 0;m <= mmax;m++)
+                    {
+                        G[m*n+i] = fm(T[i], m);
+                    }
+                }
+            }
+            double tseries = (omp_get_wtime()-t0)/nrep;
+
+            t0 = omp_get_wtime();
+            for (int r = 0;r < nrep;r++)
+            {
+                fmvec(n, &T[0], mmax, &F[0], n);
+            }
+            double tvec = (omp_get_wtime()-t0)/nrep;
+
+            double maxerr = 0;
+            for (int i = 0;i < n;i += max(1,n/5000))
+            {
+                for (int m = 0;m <= mmax;m++)
+                {
+                    double ref = fmreference(T[i], m);
+                    maxerr = max(maxerr, fabs(F[m*n+i]-ref)/ref);
+                }
+            }
+
+            printf("%4d %14.3e %14.2f %14.2f %10.2f\n", mmax, maxerr,
+                   tseries*1e9/n, tvec*1e9/n, tseries/tvec);
+        }
+
+        time::toc();
+    }
+
+    MPI_Finalize();
+}
@@ -0,0 +1,159 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "omp.h"
+
+#include "tensor/tensor.h"
+#include "time/time.hpp"
+
+using namespace std;
+using namespace aquarius;
+
+static vector<int> shuffled(vector<int> idx)
+{
+    for (int i = (int)idx.size()-1;i > 0;i--) swap(idx[i], idx[rand()%(i+1)]);
+    return idx;
+}
+
+static string labels(const vector<int>& idx)
+{
+    return string(idx.begin(), idx.end());
+}
+
+/*
+ * Compare matrix-multiplication based contraction (tensor_contract_dense_) against the
+ * general loop kernel (tensor_mult_dense_) for contractions with tensors of rank 2-6,
+ * with the indices of each tensor in a random order:
+ *
+ *  bench-contract [number of flops per contraction]
+ */
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+
+    {
+        double flops = argc > 1 ? atof(argv[1]) : 2e8;
+        const int nrep = 3;
+
+        time::tic();
+
+        srand(1);
+
+        printf("%4s %-8s %-8s %-8s %5s %12s %12s %12s %10s %10s\n", "rank", "A", "B", "C", "len",
+               "loops (s)", "gemm (s)", "gemm GF/s", "speedup", "max err.");
+
+        for (int rank = 2;rank <= 6;rank++)
+        {
+            for (int ntrial = 0;ntrial < 3;ntrial++)
+            {
+                /*
+                 * A and B both have the given rank, and share half of their indices
+                 * (rounded down, but at least one) which are contracted
+                 */
+                int nk = max(1, rank/2);
+                int nm = rank-nk;
+                int nn = rank-nk;
+                int len = max(2, (int)lround(pow(flops/2, 1.0/(nm+nn+nk))));
+
+                vector<int> idx_M, idx_N, idx_K;
+                for (int i = 0;i < nm;i++) idx_M.push_back('a'+i);
+                for (int i = 0;i < nn;i++) idx_N.push_back('i'+i);
+                for (int i = 0;i < nk;i++) idx_K.push_back('p'+i);
+
+                vector<int> idx_A = idx_M; idx_A.insert(idx_A.end(), idx_K.begin(), idx_K.end());
+                vector<int> idx_B = idx_K; idx_B.insert(idx_B.end(), idx_N.begin(), idx_N.end());
+                vector<int> idx_C = idx_M; idx_C.insert(idx_C.end(), idx_N.begin(), idx_N.end());
+
+                /*
+                 * The first trial is in "matrix" order, the rest random
+                 */
+                if (ntrial > 0)
+                {
+                    idx_A = shuffled(idx_A);
+                    idx_B = shuffled(idx_B);
+                    idx_C = shuffled(idx_C);
+                }
+
+                int ndim_A = idx_A.size();
+                int ndim_B = idx_B.size();
+                int ndim_C = idx_C.size();
+
+                vector<int> len_A(ndim_A, len);
+                vector<int> len_B(ndim_B, len);
+                vector<int> len_C(ndim_C, len);
+
+                size_t size_A = 1, size_B = 1, size_C = 1;
+                for (int i = 0;i < ndim_A;i++) size_A *= len;
+                for (int i = 0;i < ndim_B;i++) size_B *= len;
+                for (int i = 0;i < ndim_C;i++) size_C *= len;
+
+                vector<double> A(size_A), B(size_B), C0(size_C), C1(size_C), C2(size_C);
+                for (size_t i = 0;i < size_A;i++) A[i] = (double)rand()/RAND_MAX-0.5;
+                for (size_t i = 0;i < size_B;i++) B[i] = (double)rand()/RAND_MAX-0.5;
+                for (size_t i = 0;i < size_C;i++) C0[i] = (double)rand()/RAND_MAX-0.5;
+
+                double tloops = 0, tgemm = 0;
+                for (int r = 0;r < nrep;r++)
+                {
+                    C1 = C0;
+                    C2 = C0;
+
+                    double t0 = omp_get_wtime();
+                    tensor_mult_dense_(0.5, &A[0], ndim_A, &len_A[0], NULL, &idx_A[0],
+                                            &B[0], ndim_B, &len_B[0], NULL, &idx_B[0],
+                                       2.0, &C1[0], ndim_C, &len_C[0], NULL, &idx_C[0]);
+                    tloops += omp_get_wtime()-t0;
+
+                    t0 = omp_get_wtime();
+                    tensor_contract_dense_(0.5, &A[0], ndim_A, &len_A[0], NULL, &idx_A[0],
+                                                &B[0], ndim_B, &len_B[0], NULL, &idx_B[0],
+                                           2.0, &C2[0], ndim_C, &len_C[0], NULL, &idx_C[0]);
+                    tgemm += omp_get_wtime()-t0;
+                }
+                tloops /= nrep;
+                tgemm /= nrep;
+
+                double maxerr = 0;
+                for (size_t i = 0;i < size_C;i++) maxerr = max(maxerr, fabs(C1[i]-C2[i]));
+
+                double nflops = 2.0*size_C*pow((double)len, nk);
+
+                printf("%4d %-8s %-8s %-8s %5d %12.4f %12.4f %12.2f %10.2f %10.2e\n", rank,
+                       labels(idx_A).c_str(), labels(idx_B).c_str(), labels(idx_C).c_str(), len,
+                       tloops, tgemm, nflops/tgemm/1e9, tloops/tgemm, maxerr);
+            }
+        }
+
+        time::toc();
+    }
+
+    MPI_Finalize();
+}
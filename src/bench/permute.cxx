@@ -0,0 +1,141 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "omp.h"
+
+#include "tensor/tensor.h"
+#include "time/time.hpp"
+
+using namespace std;
+using namespace aquarius;
+
+static vector<int> shuffled(vector<int> idx)
+{
+    for (int i = (int)idx.size()-1;i > 0;i--) swap(idx[i], idx[rand()%(i+1)]);
+    return idx;
+}
+
+static string labels(const vector<int>& idx)
+{
+    return string(idx.begin(), idx.end());
+}
+
+/*
+ * Compare the blocked permutation kernel (tensor_transpose_dense_) against the
+ * general loop kernel (tensor_sum_dense_) for B = 0.5*P(A) + 2.0*B with tensors of
+ * rank 2-6 and random permutations P:
+ *
+ *  bench-permute [number of elements per tensor]
+ */
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+
+    {
+        double nelem = argc > 1 ? atof(argv[1]) : 1.6e7;
+        const int nrep = 3;
+
+        time::tic();
+
+        srand(1);
+
+        printf("%4s %-8s %-8s %5s %12s %12s %12s %10s %10s\n", "rank", "A", "B", "len",
+               "loops (s)", "permute (s)", "perm. GB/s", "speedup", "max err.");
+
+        for (int rank = 2;rank <= 6;rank++)
+        {
+            for (int ntrial = 0;ntrial < 3;ntrial++)
+            {
+                int len = max(2, (int)lround(pow(nelem, 1.0/rank)));
+
+                vector<int> idx_A;
+                for (int i = 0;i < rank;i++) idx_A.push_back('a'+i);
+
+                /*
+                 * Make sure that the fastest index changes, since otherwise
+                 * this is just a (strided) copy
+                 */
+                vector<int> idx_B;
+                do
+                {
+                    idx_B = shuffled(idx_A);
+                }
+                while (idx_B[0] == idx_A[0]);
+
+                vector<int> len_A(rank, len);
+                vector<int> len_B(rank, len);
+
+                size_t size = 1;
+                for (int i = 0;i < rank;i++) size *= len;
+
+                vector<double> A(size), B0(size), B1(size), B2(size);
+                for (size_t i = 0;i < size;i++) A[i] = (double)rand()/RAND_MAX-0.5;
+                for (size_t i = 0;i < size;i++) B0[i] = (double)rand()/RAND_MAX-0.5;
+
+                double tloops = 0, tpermute = 0;
+                for (int r = 0;r < nrep;r++)
+                {
+                    B1 = B0;
+                    B2 = B0;
+
+                    double t0 = omp_get_wtime();
+                    tensor_sum_dense_(0.5, &A[0], rank, &len_A[0], NULL, &idx_A[0],
+                                      2.0, &B1[0], rank, &len_B[0], NULL, &idx_B[0]);
+                    tloops += omp_get_wtime()-t0;
+
+                    t0 = omp_get_wtime();
+                    tensor_transpose_dense_(0.5, &A[0], rank, &len_A[0], NULL, &idx_A[0],
+                                            2.0, &B2[0], rank, &len_B[0], NULL, &idx_B[0]);
+                    tpermute += omp_get_wtime()-t0;
+                }
+                tloops /= nrep;
+                tpermute /= nrep;
+
+                double maxerr = 0;
+                for (size_t i = 0;i < size;i++) maxerr = max(maxerr, fabs(B1[i]-B2[i]));
+
+                /*
+                 * A is read once and B is read and written once
+                 */
+                double nbytes = 3.0*size*sizeof(double);
+
+                printf("%4d %-8s %-8s %5d %12.4f %12.4f %12.2f %10.2f %10.2e\n", rank,
+                       labels(idx_A).c_str(), labels(idx_B).c_str(), len,
+                       tloops, tpermute, nbytes/tpermute/1e9, tloops/tpermute, maxerr);
+            }
+        }
+
+        time::toc();
+    }
+
+    MPI_Finalize();
+}
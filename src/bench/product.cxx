@@ -0,0 +1,184 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "omp.h"
+
+#include "tensor/dense_tensor.hpp"
+#include "time/time.hpp"
+
+using namespace std;
+using namespace aquarius;
+using namespace aquarius::tensor;
+
+static void randomize(DenseTensor<double>& A)
+{
+    double* data = A.getData();
+    for (uint64_t i = 0;i < A.getSize();i++) data[i] = 2.0*rand()/RAND_MAX-1.0;
+}
+
+static double maxdiff(const DenseTensor<double>& A, const DenseTensor<double>& B)
+{
+    double err = 0;
+    for (uint64_t i = 0;i < A.getSize();i++) err = max(err, fabs(A.getData()[i]-B.getData()[i]));
+    return err;
+}
+
+/*
+ * Compare lazily-evaluated products of several tensors (with the contraction order
+ * chosen automatically) and fused sums of products against the same expressions
+ * evaluated pairwise in a fixed order, for a CC-like set of occupied (o) and
+ * virtual (v) dimensions:
+ *
+ *  bench-product [o] [v]
+ */
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+
+    {
+        int o = argc > 1 ? atoi(argv[1]) : 8;
+        int v = argc > 2 ? atoi(argv[2]) : 24;
+
+        time::tic();
+
+        srand(1);
+
+        DenseTensor<double> A("A", 4, vec(v,v,v,v));
+        DenseTensor<double> B("B", 4, vec(v,v,o,o));
+        DenseTensor<double> C("C", 4, vec(o,o,o,o));
+        DenseTensor<double> T("T", 4, vec(v,v,o,o));
+        DenseTensor<double> U("U", 4, vec(v,v,o,o));
+        DenseTensor<double> W("W", 4, vec(v,o,o,o));
+        DenseTensor<double> F("F", 2, vec(v,v));
+        DenseTensor<double> t("t", 2, vec(v,o));
+        randomize(A);
+        randomize(B);
+        randomize(C);
+        randomize(T);
+        randomize(U);
+        randomize(W);
+        randomize(F);
+        randomize(t);
+
+        printf("%-40s %12s %12s %10s\n", "expression", "pairwise (s)", "lazy (s)", "max err.");
+
+        /*
+         * Z = A*B*C: either pairwise order costs about v^4o^2
+         */
+        {
+            DenseTensor<double> Z1("Z1", 4, vec(v,v,o,o));
+            DenseTensor<double> Z2("Z2", 4, vec(v,v,o,o));
+            DenseTensor<double> BC("BC", 4, vec(v,v,o,o));
+
+            double t0 = omp_get_wtime();
+            BC["efij"] = B["efmn"]*C["mnij"];
+            Z1["abij"] = 0.5*A["abef"]*BC["efij"];
+            double tpair = omp_get_wtime()-t0;
+
+            t0 = omp_get_wtime();
+            Z2["abij"] = 0.5*A["abef"]*B["efmn"]*C["mnij"];
+            double tlazy = omp_get_wtime()-t0;
+
+            printf("%-40s %12.4f %12.4f %10.2e\n", "0.5*A[abef]*B[efmn]*C[mnij]", tpair, tlazy, maxdiff(Z1, Z2));
+        }
+
+        /*
+         * Z = W*B*t: left-to-right evaluation would form the v^3o^3 intermediate
+         * W[bmij]*B[aemn], instead of contracting B with t first
+         */
+        {
+            DenseTensor<double> Z1("Z1", 4, vec(v,v,o,o));
+            DenseTensor<double> Z2("Z2", 4, vec(v,v,o,o));
+            DenseTensor<double> Bt("Bt", 2, vec(v,o));
+
+            double t0 = omp_get_wtime();
+            Bt["am"] = B["aemn"]*t["en"];
+            Z1["abij"] = Bt["am"]*W["bmij"];
+            double tpair = omp_get_wtime()-t0;
+
+            t0 = omp_get_wtime();
+            Z2["abij"] = W["bmij"]*B["aemn"]*t["en"];
+            double tlazy = omp_get_wtime()-t0;
+
+            printf("%-40s %12.4f %12.4f %10.2e\n", "W[bmij]*B[aemn]*t[en]", tpair, tlazy, maxdiff(Z1, Z2));
+        }
+
+        /*
+         * Z += F*T - F*U + A*B*C: the first two terms are fused into F*(T-U)
+         */
+        {
+            DenseTensor<double> Z1("Z1", 4, vec(v,v,o,o));
+            DenseTensor<double> Z2("Z2", 4, vec(v,v,o,o));
+            DenseTensor<double> BC("BC", 4, vec(v,v,o,o));
+            randomize(Z1);
+            Z2["abij"] = Z1["abij"];
+
+            double t0 = omp_get_wtime();
+            Z1["abij"] += F["ae"]*T["ebij"];
+            Z1["abij"] -= F["ae"]*U["ebij"];
+            BC["efij"] = B["efmn"]*C["mnij"];
+            Z1["abij"] += A["abef"]*BC["efij"];
+            double tpair = omp_get_wtime()-t0;
+
+            t0 = omp_get_wtime();
+            Z2["abij"] += F["ae"]*T["ebij"] - F["ae"]*U["ebij"] + A["abef"]*B["efmn"]*C["mnij"];
+            double tlazy = omp_get_wtime()-t0;
+
+            printf("%-40s %12.4f %12.4f %10.2e\n", "F[ae]*T[ebij]-F[ae]*U[ebij]+A*B*C", tpair, tlazy, maxdiff(Z1, Z2));
+        }
+
+        /*
+         * Z = F*T + 0.5*Z: the second term reads Z after the first has overwritten it,
+         * unless the sum is accumulated into a copy of Z
+         */
+        {
+            DenseTensor<double> Z1("Z1", 4, vec(v,v,o,o));
+            DenseTensor<double> Z2("Z2", 4, vec(v,v,o,o));
+            DenseTensor<double> Z0("Z0", 4, vec(v,v,o,o));
+            randomize(Z0);
+            Z2["abij"] = Z0["abij"];
+
+            double t0 = omp_get_wtime();
+            Z1["abij"] = 0.5*Z0["baji"];
+            Z1["abij"] += F["ae"]*T["ebij"];
+            double tpair = omp_get_wtime()-t0;
+
+            t0 = omp_get_wtime();
+            Z2["abij"] = F["ae"]*T["ebij"] + 0.5*Z2["baji"];
+            double tlazy = omp_get_wtime()-t0;
+
+            printf("%-40s %12.4f %12.4f %10.2e\n", "F[ae]*T[ebij]+0.5*Z[baji] into Z", tpair, tlazy, maxdiff(Z1, Z2));
+        }
+
+        time::toc();
+    }
+
+    MPI_Finalize();
+}
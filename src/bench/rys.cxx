@@ -0,0 +1,126 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "omp.h"
+
+#include "integrals/internal.h"
+#include "time/time.hpp"
+
+using namespace std;
+using namespace aquarius;
+
+/*
+ * Reference value from the series in extended precision
+ */
+static double fmreference(double T, int m)
+{
+    long double ap = m + 0.5L;
+    long double sum = 1.0L / (2 * ap * expl(T));
+    long double delt = sum;
+    ap += 1.0L;
+
+    while (delt > sum*1e-25L)
+    {
+        delt *= T / ap;
+        ap += 1.0L;
+        sum += delt;
+    }
+
+    return (double)sum;
+}
+
+/*
+ * Check that the n-point Rys quadrature from the fits (rysvec) integrates
+ * t^(2q) exp(-T t^2) on [0,1] exactly for q < 2n, i.e. that sum_v w_v x_v^q
+ * reproduces the Boys function F_q(T), and compare its speed to computing the
+ * roots and weights directly (rysexact):
+ *
+ *  bench-rys [number of T values] [maximum T]
+ */
+int main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+
+    {
+        int nT = argc > 1 ? atoi(argv[1]) : 20000;
+        double Tmax = argc > 2 ? atof(argv[2]) : 200.0;
+
+        time::tic();
+
+        vector<double> T(nT);
+        srand(1);
+        for (int i = 0;i < nT;i++) T[i] = Tmax*rand()/RAND_MAX;
+
+        /*
+         * Make sure that small T, the interval ends, and the switch to the
+         * asymptotic form are hit
+         */
+        for (int i = 0;i < min(nT,64);i++) T[i] = i*0.025;
+        for (int i = 64;i < min(nT,256);i++) T[i] = 2.0*((i-64)/2+1)+((i-64)%2 ? 1e-9 : -1e-9);
+
+        printf("%4s %14s %14s %14s %10s\n", "n", "max rel. err.", "exact (ns/T)", "rysvec (ns/T)", "speedup");
+
+        for (int n = 1;n <= 20;n++)
+        {
+            vector<double> rt(n*nT), wt(n*nT);
+            vector<double> rtx(n*nT), wtx(n*nT);
+
+            int nexact = min(nT, 2000);
+
+            double t0 = omp_get_wtime();
+            for (int i = 0;i < nexact;i++) rysexact(T[i], n, &rtx[i*n], &wtx[i*n]);
+            double texact = (omp_get_wtime()-t0)/nexact;
+
+            t0 = omp_get_wtime();
+            rysvec(nT, &T[0], n, &rt[0], &wt[0]);
+            double tvec = (omp_get_wtime()-t0)/nT;
+
+            double maxerr = 0;
+            for (int i = 0;i < nT;i += max(1,nT/5000))
+            {
+                for (int q = 0;q < 2*n;q++)
+                {
+                    double sum = 0;
+                    for (int v = 0;v < n;v++) sum += wt[i*n+v]*pow(rt[i*n+v], q);
+
+                    double ref = fmreference(T[i], q);
+                    maxerr = max(maxerr, fabs(sum-ref)/ref);
+                }
+            }
+
+            printf("%4d %14.3e %14.2f %14.2f %10.2f\n", n, maxerr,
+                   texact*1e9, tvec*1e9, texact/tvec);
+        }
+
+        time::toc();
+    }
+
+    MPI_Finalize();
+}
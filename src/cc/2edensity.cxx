@@ -149,8 +149,6 @@ TwoElectronDensity<U>::TwoElectronDensity(const std::string& name, const Deexcit
                                           const ExcitationOperator<U,2>& T)
 : TwoElectronOperator<U>(name, OneElectronDensity<U>(name, L, T))
 {
-    SpinorbitalTensor<U> aitmp("I", this->ai);
-
     SpinorbitalTensor<U> Tau(T(2));
     Tau["abij"] += 0.5*T(1)["ai"]*T(1)["bj"];
 
@@ -181,8 +179,7 @@ TwoElectronDensity<U>::TwoElectronDensity(const std::string& name, const Deexcit
     this->abij["abij"] -= this->ab["ae"]*T(2)["ebij"];
     this->abij["abij"] -= this->aibj["amej"]*T(2)["ebmj"];
     this->abij["abij"] += this->aijk["bmji"]*T(1)["am"];
-    aitmp["ai"] = -this->aibc["amef"]*T(2)["efim"];
-    this->abij["abij"] += aitmp["ai"]*T(1)["bj"];
+    this->abij["abij"] -= this->aibc["amef"]*T(2)["efim"]*T(1)["bj"];
 
     this->aijk["aijk"] -= L(1)["ie"]*T(2)["aejk"];
     this->aijk["aijk"] += this->ijak["miek"]*T(2)["aejm"];
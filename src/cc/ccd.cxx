@@ -154,5 +154,20 @@ void CCD<U>::iterate()
     diis.extrapolate(T, Z);
 }
 
+template <typename U>
+void CCD<U>::saveState(Checkpoint& chk)
+{
+    chk.writeTensor("T", get<ExcitationOperator<U,2> >("T"));
+    diis.save(chk);
+}
+
+template <typename U>
+void CCD<U>::loadState(Checkpoint& chk)
+{
+    ExcitationOperator<U,2>& T = get<ExcitationOperator<U,2> >("T");
+    chk.readTensor("T", T);
+    diis.load(chk, T, gettmp<ExcitationOperator<U,2> >("Z"));
+}
+
 INSTANTIATE_SPECIALIZATIONS(CCD);
 REGISTER_TASK(CCD<double>,"ccd");
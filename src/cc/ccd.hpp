@@ -54,6 +54,11 @@ class CCD : public Iterative
         void run(task::TaskDAG& dag, const Arena& arena);
 
         void iterate();
+
+    protected:
+        void saveState(Checkpoint& chk);
+
+        void loadState(Checkpoint& chk);
 };
 
 }
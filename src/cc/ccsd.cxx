@@ -118,6 +118,8 @@ void CCSD<U>::run(TaskDAG& dag, const Arena& arena)
 
     if (isUsed("Hbar"))
     {
+        if (H.isFactorized())
+            throw runtime_error("Hbar cannot be formed from factorized integrals");
         put("Hbar", new STTwoElectronOperator<U,2>("Hbar", H, T, true));
     }
 }
@@ -148,6 +150,25 @@ void CCSD<U>::iterate()
     diis.extrapolate(T, Z);
 }
 
+template <typename U>
+void CCSD<U>::saveState(Checkpoint& chk)
+{
+    chk.writeTensor("T", get<ExcitationOperator<U,2> >("T"));
+    diis.save(chk);
+}
+
+template <typename U>
+void CCSD<U>::loadState(Checkpoint& chk)
+{
+    ExcitationOperator<U,2>& T = get<ExcitationOperator<U,2> >("T");
+    chk.readTensor("T", T);
+    diis.load(chk, T, gettmp<ExcitationOperator<U,2> >("Z"));
+
+    SpinorbitalTensor<U>& Tau = gettmp<SpinorbitalTensor<U> >("Tau");
+    Tau = T(2);
+    Tau["abij"] += 0.5*T(1)["ai"]*T(1)["bj"];
+}
+
 /*
 template <typename U>
 double CCSD<U>::getProjectedS2(const MOSpace<U>& occ, const MOSpace<U>& vrt,
@@ -60,6 +60,11 @@ class CCSD : public Iterative
                                      const tensor::SpinorbitalTensor<U>& T1,
                                      const tensor::SpinorbitalTensor<U>& T2);
          */
+
+    protected:
+        void saveState(Checkpoint& chk);
+
+        void loadState(Checkpoint& chk);
 };
 
 }
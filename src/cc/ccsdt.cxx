@@ -58,10 +58,23 @@ void CCSDT<U>::run(task::TaskDAG& dag, const Arena& arena)
     put("T", new ExcitationOperator<U,3>("T", arena, occ, vrt));
     puttmp("D", new Denominator<U>(H));
     puttmp("Z", new ExcitationOperator<U,3>("Z", arena, occ, vrt));
+    puttmp("Tau", new SpinorbitalTensor<U>("Tau", H.getABIJ()));
+    puttmp("W", new TwoElectronOperator<U>("W", const_cast<TwoElectronOperator<U>&>(H),
+                                           TwoElectronOperator<U>::AB|
+                                           TwoElectronOperator<U>::IJ|
+                                           TwoElectronOperator<U>::IA|
+                                           TwoElectronOperator<U>::AIBC|
+                                           TwoElectronOperator<U>::ABCI|
+                                           TwoElectronOperator<U>::ABCD|
+                                           TwoElectronOperator<U>::IJKL|
+                                           TwoElectronOperator<U>::IJAK|
+                                           TwoElectronOperator<U>::AIJK|
+                                           TwoElectronOperator<U>::AIBJ));
 
     ExcitationOperator<U,3>& T = get<ExcitationOperator<U,3> >("T");
     Denominator<U>& D = gettmp<Denominator<U> >("D");
     ExcitationOperator<U,3>& Z = gettmp<ExcitationOperator<U,3> >("Z");
+    SpinorbitalTensor<U>& Tau = gettmp<SpinorbitalTensor<U> >("Tau");
 
     Z(0) = (U)0.0;
     T(0) = (U)0.0;
@@ -71,7 +84,7 @@ void CCSDT<U>::run(task::TaskDAG& dag, const Arena& arena)
 
     T.weight(D);
 
-    SpinorbitalTensor<U> Tau("Tau", T(2));
+    Tau["abij"]  = T(2)["abij"];
     Tau["abij"] += 0.5*T(1)["ai"]*T(1)["bj"];
 
     energy = real(scalar(H.getAI()*T(1))) + 0.25*real(scalar(H.getABIJ()*Tau));
@@ -111,17 +124,10 @@ void CCSDT<U>::iterate()
     ExcitationOperator<U,3>& T = get<ExcitationOperator<U,3> >("T");
     Denominator<U>& D = gettmp<Denominator<U> >("D");
     ExcitationOperator<U,3>& Z = gettmp<ExcitationOperator<U,3> >("Z");
+    TwoElectronOperator<U>& W = gettmp<TwoElectronOperator<U> >("W");
+    SpinorbitalTensor<U>& Tau = gettmp<SpinorbitalTensor<U> >("Tau");
 
-    TwoElectronOperator<U> W("W", H, TwoElectronOperator<U>::AB|
-                                TwoElectronOperator<U>::IJ|
-                                TwoElectronOperator<U>::IA|
-                                TwoElectronOperator<U>::AIBC|
-                                TwoElectronOperator<U>::ABCI|
-                                TwoElectronOperator<U>::ABCD|
-                                TwoElectronOperator<U>::IJKL|
-                                TwoElectronOperator<U>::IJAK|
-                                TwoElectronOperator<U>::AIJK|
-                                TwoElectronOperator<U>::AIBJ);
+    W.refresh(H);
 
     SpinorbitalTensor<U>& FAI = W.getAI();
     SpinorbitalTensor<U>& FME = W.getIA();
@@ -137,7 +143,7 @@ void CCSDT<U>::iterate()
     SpinorbitalTensor<U>& WAMIJ = W.getAIJK();
     SpinorbitalTensor<U>& WAMEI = W.getAIBJ();
 
-    SpinorbitalTensor<U> Tau("Tau", T(2));
+    Tau["abij"]  = T(2)["abij"];
     Tau["abij"] += 0.5*T(1)["ai"]*T(1)["bj"];
 
     /**************************************************************************
@@ -276,5 +282,20 @@ double CCSDT<U>::getProjectedMultiplicity() const
 }
 */
 
+template <typename U>
+void CCSDT<U>::saveState(Checkpoint& chk)
+{
+    chk.writeTensor("T", get<ExcitationOperator<U,3> >("T"));
+    diis.save(chk);
+}
+
+template <typename U>
+void CCSDT<U>::loadState(Checkpoint& chk)
+{
+    ExcitationOperator<U,3>& T = get<ExcitationOperator<U,3> >("T");
+    chk.readTensor("T", T);
+    diis.load(chk, T, gettmp<ExcitationOperator<U,3> >("Z"));
+}
+
 INSTANTIATE_SPECIALIZATIONS(CCSDT);
 REGISTER_TASK(CCSDT<double>,"ccsdt");
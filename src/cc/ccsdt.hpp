@@ -57,6 +57,11 @@ class CCSDT : public Iterative
 
         double getProjectedMultiplicity() const;
         */
+
+    protected:
+        void saveState(Checkpoint& chk);
+
+        void loadState(Checkpoint& chk);
 };
 
 }
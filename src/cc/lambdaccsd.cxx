@@ -100,5 +100,20 @@ void LambdaCCSD<U>::iterate()
     diis.extrapolate(L, Z);
 }
 
+template <typename U>
+void LambdaCCSD<U>::saveState(Checkpoint& chk)
+{
+    chk.writeTensor("L", get<DeexcitationOperator<U,2> >("L"));
+    diis.save(chk);
+}
+
+template <typename U>
+void LambdaCCSD<U>::loadState(Checkpoint& chk)
+{
+    DeexcitationOperator<U,2>& L = get<DeexcitationOperator<U,2> >("L");
+    chk.readTensor("L", L);
+    diis.load(chk, L, gettmp<DeexcitationOperator<U,2> >("Z"));
+}
+
 INSTANTIATE_SPECIALIZATIONS(LambdaCCSD);
 REGISTER_TASK(LambdaCCSD<double>,"lambdaccsd");
@@ -66,6 +66,11 @@ class LambdaCCSD : public Iterative
         void run(task::TaskDAG& dag, const Arena& arena);
 
         void iterate();
+
+    protected:
+        void saveState(Checkpoint& chk);
+
+        void loadState(Checkpoint& chk);
 };
 
 }
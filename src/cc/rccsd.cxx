@@ -0,0 +1,315 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+#include "rccsd.hpp"
+
+using namespace std;
+using namespace aquarius::op;
+using namespace aquarius::cc;
+using namespace aquarius::input;
+using namespace aquarius::tensor;
+using namespace aquarius::task;
+using namespace aquarius::time;
+
+template <typename U>
+RCCSD<U>::RCCSD(const std::string& name, const Config& config)
+: Iterative("rccsd", name, config), diis(config.get("diis"), 2, 2)
+{
+    vector<Requirement> reqs;
+    reqs.push_back(Requirement("rmoints", "H"));
+    addProduct(Product("double", "mp2", reqs));
+    addProduct(Product("double", "energy", reqs));
+    addProduct(Product("double", "convergence", reqs));
+}
+
+template <typename U>
+void RCCSD<U>::run(TaskDAG& dag, const Arena& arena)
+{
+    const RestrictedTwoElectronOperator<U>& H = get<RestrictedTwoElectronOperator<U> >("H");
+
+    const Space& occ = H.occ;
+    const Space& vrt = H.vrt;
+
+    if (occ.nalpha != occ.nbeta || vrt.nalpha != vrt.nbeta)
+    {
+        throw runtime_error("RCCSD requires a closed-shell (RHF) reference");
+    }
+
+    const vector<int>& N = occ.nalpha;
+    const vector<int>& M = vrt.nalpha;
+
+    puttmp("T1", new SymmetryBlockedTensor<U>("T(ai)", arena, occ.group, 2, vec(M,N), vec(NS,NS), false));
+    puttmp("Z1", new SymmetryBlockedTensor<U>("Z(ai)", arena, occ.group, 2, vec(M,N), vec(NS,NS), false));
+    puttmp("T2", new SymmetryBlockedTensor<U>("T(abij)", arena, occ.group, 4, vec(M,M,N,N), vec(NS,NS,NS,NS), false));
+    puttmp("Z2", new SymmetryBlockedTensor<U>("Z(abij)", arena, occ.group, 4, vec(M,M,N,N), vec(NS,NS,NS,NS), false));
+    puttmp("Tau", new SymmetryBlockedTensor<U>("Tau(abij)", arena, occ.group, 4, vec(M,M,N,N), vec(NS,NS,NS,NS), false));
+    puttmp("D", new Denominator<U>(H));
+
+    SymmetryBlockedTensor<U>& T1 = gettmp<SymmetryBlockedTensor<U> >("T1");
+    SymmetryBlockedTensor<U>& T2 = gettmp<SymmetryBlockedTensor<U> >("T2");
+    Denominator<U>& D = gettmp<Denominator<U> >("D");
+
+    T1["ai"] = H.getAI()["ai"];
+    T2["abij"] = H.getABIJ()["abij"];
+
+    T1.weight(vec(&D.getDA(), &D.getDI()));
+    T2.weight(vec(&D.getDA(), &D.getDA(), &D.getDI(), &D.getDI()));
+
+    energy = calcEnergy();
+
+    conv = max(T1.norm(00), T2.norm(00));
+
+    Logger::log(arena) << "MP2 energy = " << setprecision(15) << energy << endl;
+    put("mp2", new Scalar(arena, energy));
+
+    Iterative::run(dag, arena);
+
+    put("energy", new Scalar(arena, energy));
+    put("convergence", new Scalar(arena, conv));
+}
+
+template <typename U>
+void RCCSD<U>::iterate()
+{
+    const RestrictedTwoElectronOperator<U>& H = get<RestrictedTwoElectronOperator<U> >("H");
+
+    SymmetryBlockedTensor<U>& T1 = gettmp<SymmetryBlockedTensor<U> >("T1");
+    SymmetryBlockedTensor<U>& T2 = gettmp<SymmetryBlockedTensor<U> >("T2");
+    SymmetryBlockedTensor<U>& Z1 = gettmp<SymmetryBlockedTensor<U> >("Z1");
+    SymmetryBlockedTensor<U>& Z2 = gettmp<SymmetryBlockedTensor<U> >("Z2");
+    SymmetryBlockedTensor<U>& Tau = gettmp<SymmetryBlockedTensor<U> >("Tau");
+    Denominator<U>& D = gettmp<Denominator<U> >("D");
+
+    /*
+     * The spatial integrals are the alpha-beta blocks <Pq|Rs> of the
+     * spin-orbital integrals, see RestrictedTwoElectronOperator
+     */
+    const SymmetryBlockedTensor<U>& FAB = H.getAB();
+    const SymmetryBlockedTensor<U>& FIJ = H.getIJ();
+    const SymmetryBlockedTensor<U>& FAI = H.getAI();
+    const SymmetryBlockedTensor<U>& FIA = H.getIA();
+    const SymmetryBlockedTensor<U>& VABCD = H.getABCD();
+    const SymmetryBlockedTensor<U>& VABCI = H.getABCI();
+    const SymmetryBlockedTensor<U>& VAIBC = H.getAIBC();
+    const SymmetryBlockedTensor<U>& VABIJ = H.getABIJ();
+    const SymmetryBlockedTensor<U>& VIJAB = H.getIJAB();
+    const SymmetryBlockedTensor<U>& VAIBJ = H.getAIBJ();
+    const SymmetryBlockedTensor<U>& VIJAK = H.getIJAK();
+    const SymmetryBlockedTensor<U>& VIJKL = H.getIJKL();
+
+    const Arena& arena = T1.arena;
+    const symmetry::PointGroup& group = H.occ.group;
+    const vector<int>& N = H.occ.nalpha;
+    const vector<int>& M = H.vrt.nalpha;
+
+    vector<int> shapeNN = vec(NS,NS);
+    vector<int> shapeNNNN = vec(NS,NS,NS,NS);
+
+    SymmetryBlockedTensor<U> FOO("F(ij)", arena, group, 2, vec(N,N), shapeNN, false);
+    SymmetryBlockedTensor<U> FVV("F(ab)", arena, group, 2, vec(M,M), shapeNN, false);
+    SymmetryBlockedTensor<U> FOV("F(ia)", arena, group, 2, vec(N,M), shapeNN, false);
+    SymmetryBlockedTensor<U> LOO("L(ij)", arena, group, 2, vec(N,N), shapeNN, false);
+    SymmetryBlockedTensor<U> LVV("L(ab)", arena, group, 2, vec(M,M), shapeNN, false);
+    SymmetryBlockedTensor<U> XOO("X(ij)", arena, group, 2, vec(N,N), shapeNN, false);
+    SymmetryBlockedTensor<U> XOV("X(ia)", arena, group, 2, vec(N,M), shapeNN, false);
+
+    SymmetryBlockedTensor<U> L("L(ijab)", arena, group, 4, vec(N,N,M,M), shapeNNNN, false);
+    SymmetryBlockedTensor<U> WOOOO("W(ijkl)", arena, group, 4, vec(N,N,N,N), shapeNNNN, false);
+    SymmetryBlockedTensor<U> WVOOV("W(aijb)", arena, group, 4, vec(M,N,N,M), shapeNNNN, false);
+    SymmetryBlockedTensor<U> WVOVO("W(aibj)", arena, group, 4, vec(M,N,M,N), shapeNNNN, false);
+    SymmetryBlockedTensor<U> XVOOO("X(aijk)", arena, group, 4, vec(M,N,N,N), shapeNNNN, false);
+    SymmetryBlockedTensor<U> XVVOO("X(abij)", arena, group, 4, vec(M,M,N,N), shapeNNNN, false);
+    SymmetryBlockedTensor<U> tmp("tmp(abij)", arena, group, 4, vec(M,M,N,N), shapeNNNN, false);
+
+    /*
+     * Dressed one-particle intermediates
+     */
+    L["ijab"]  = 2.0*VIJAB["ijab"];
+    L["ijab"] -=     VIJAB["ijba"];
+
+    FOO["ki"]  =   FIJ["ki"];
+    FOO["ki"] +=     L["klcd"]*Tau["cdil"];
+
+    FVV["ac"]  =   FAB["ac"];
+    FVV["ac"] -=     L["klcd"]*Tau["adkl"];
+
+    FOV["kc"]  =   FIA["kc"];
+    FOV["kc"] +=     L["klcd"]* T1["dl"];
+
+    LOO["ki"]  =   FOO["ki"];
+    LOO["ki"] +=   FIA["kc"]* T1["ci"];
+    LOO["ki"] += 2.0*VIJAK["lkci"]*T1["cl"];
+    LOO["ki"] -=     VIJAK["klci"]*T1["cl"];
+
+    LVV["ac"]  =   FVV["ac"];
+    LVV["ac"] -=   FIA["kc"]* T1["ak"];
+    LVV["ac"] += 2.0*VAIBC["akcd"]*T1["dk"];
+    LVV["ac"] -=     VAIBC["akdc"]*T1["dk"];
+
+    /*
+     * Two-particle intermediates; the vvvv intermediate is never formed,
+     * its T1 terms are instead folded in through a vooo intermediate below
+     */
+    WOOOO["klij"]  = VIJKL["klij"];
+    WOOOO["klij"] += VIJAK["lkci"]* T1["cj"];
+    WOOOO["klij"] += VIJAK["klcj"]* T1["ci"];
+    WOOOO["klij"] += VIJAB["klcd"]*Tau["cdij"];
+
+    XVVOO["adil"]  =      T2["adil"];
+    XVVOO["adil"] -=  0.5*T2["dail"];
+    XVVOO["adil"] -=      T1["al"]*T1["di"];
+
+    WVOOV["akic"]  = VABIJ["acik"];
+    WVOOV["akic"] += VAIBC["akdc"]*   T1["di"];
+    WVOOV["akic"] -= VIJAK["klci"]*   T1["al"];
+    WVOOV["akic"] += VIJAB["lkdc"]*XVVOO["adil"];
+    WVOOV["akic"] -= 0.5*VIJAB["lkcd"]*T2["adil"];
+
+    XVVOO["dail"]  =  0.5*T2["dail"];
+    XVVOO["dail"] +=      T1["al"]*T1["di"];
+
+    WVOVO["akci"]  = VAIBJ["akci"];
+    WVOVO["akci"] += VAIBC["akcd"]*   T1["di"];
+    WVOVO["akci"] -= VIJAK["lkci"]*   T1["al"];
+    WVOVO["akci"] -= VIJAB["lkcd"]*XVVOO["dail"];
+
+    /*
+     * T1 equation
+     */
+    XOV["kc"]  = FOV["kc"];
+    XOV["kc"] -= 2.0*FIA["kc"];
+    XOO["ki"]  = XOV["kc"]*T1["ci"];
+
+    Z1["ai"]  =   FAI["ai"];
+    Z1["ai"] +=    T1["ak"]*XOO["ki"];
+    Z1["ai"] +=   FVV["ac"]* T1["ci"];
+    Z1["ai"] -=   FOO["ki"]* T1["ak"];
+    Z1["ai"] += 2.0*FOV["kc"]*T2["caki"];
+    Z1["ai"] -=     FOV["kc"]*T2["caik"];
+    Z1["ai"] += 2.0*VABIJ["acik"]*T1["ck"];
+    Z1["ai"] -=     VAIBJ["akci"]*T1["ck"];
+    Z1["ai"] += 2.0*VAIBC["akcd"]*Tau["cdik"];
+    Z1["ai"] -=     VAIBC["akdc"]*Tau["cdik"];
+    Z1["ai"] -= 2.0*VIJAK["lkci"]*Tau["ackl"];
+    Z1["ai"] +=     VIJAK["klci"]*Tau["ackl"];
+
+    /*
+     * T2 equation; all terms in tmp are symmetrized as
+     * Z(abij) += tmp(abij) + tmp(baji)
+     */
+    Z2["abij"]  = VABIJ["abij"];
+    Z2["abij"] += WOOOO["klij"]*Tau["abkl"];
+    Z2["abij"] += VABCD["abcd"]*Tau["cdij"];
+
+    tmp["abij"]    = VABCI["baci"]*T1["cj"];
+
+    tmp["abij"]   -=    T1["ak"]*VAIBJ["bkci"]*T1["cj"];
+    tmp["abij"]   -= VAIBC["akcd"]*Tau["cdij"]*T1["bk"];
+
+    XVOOO["akij"]  = VIJAK["ijak"];
+    XVOOO["akij"] += VABIJ["acik"]*T1["cj"];
+    tmp["abij"]   -= XVOOO["akij"]*T1["bk"];
+
+    tmp["abij"] +=   LVV["ac"]*T2["cbij"];
+    tmp["abij"] -=   LOO["ki"]*T2["abkj"];
+    tmp["abij"] += 2.0*WVOOV["akic"]*T2["cbkj"];
+    tmp["abij"] -=     WVOVO["akci"]*T2["cbkj"];
+    tmp["abij"] -=     WVOOV["akic"]*T2["bckj"];
+    tmp["abij"] -=     WVOVO["bkci"]*T2["ackj"];
+
+    Z2["abij"] += tmp["abij"];
+    Z2["abij"] += tmp["baji"];
+
+    /*
+     * Z contains the diagonal Fock terms, so that T + Z/D is the Jacobi update
+     */
+    Z1.weight(vec(&D.getDA(), &D.getDI()));
+    Z2.weight(vec(&D.getDA(), &D.getDA(), &D.getDI(), &D.getDI()));
+    T1["ai"] += Z1["ai"];
+    T2["abij"] += Z2["abij"];
+
+    conv = max(Z1.norm(00), Z2.norm(00));
+
+    vector<SymmetryBlockedTensor<U>*> T = vec(&T1, &T2);
+    vector<SymmetryBlockedTensor<U>*> Z = vec(&Z1, &Z2);
+    diis.extrapolate(T, Z);
+
+    /*
+     * Also leaves Tau up to date for the next iteration
+     */
+    energy = calcEnergy();
+}
+
+template <typename U>
+double RCCSD<U>::calcEnergy()
+{
+    const RestrictedTwoElectronOperator<U>& H = get<RestrictedTwoElectronOperator<U> >("H");
+
+    SymmetryBlockedTensor<U>& T1 = gettmp<SymmetryBlockedTensor<U> >("T1");
+    SymmetryBlockedTensor<U>& T2 = gettmp<SymmetryBlockedTensor<U> >("T2");
+    SymmetryBlockedTensor<U>& Tau = gettmp<SymmetryBlockedTensor<U> >("Tau");
+
+    const SymmetryBlockedTensor<U>& FIA = H.getIA();
+    const SymmetryBlockedTensor<U>& VIJAB = H.getIJAB();
+
+    Tau["abij"]  = T2["abij"];
+    Tau["abij"] += T1["ai"]*T1["bj"];
+
+    U e = 2.0*scalar(FIA["ia"]*T1["ai"]);
+    e += 2.0*scalar(VIJAB["ijab"]*Tau["abij"]);
+    e -=     scalar(VIJAB["ijba"]*Tau["abij"]);
+
+    return real(e);
+}
+
+template <typename U>
+void RCCSD<U>::saveState(Checkpoint& chk)
+{
+    SymmetryBlockedTensor<U>& T1 = gettmp<SymmetryBlockedTensor<U> >("T1");
+    SymmetryBlockedTensor<U>& T2 = gettmp<SymmetryBlockedTensor<U> >("T2");
+
+    chk.writeTensor("T1", T1);
+    chk.writeTensor("T2", T2);
+    diis.save(chk);
+}
+
+template <typename U>
+void RCCSD<U>::loadState(Checkpoint& chk)
+{
+    SymmetryBlockedTensor<U>& T1 = gettmp<SymmetryBlockedTensor<U> >("T1");
+    SymmetryBlockedTensor<U>& T2 = gettmp<SymmetryBlockedTensor<U> >("T2");
+
+    chk.readTensor("T1", T1);
+    chk.readTensor("T2", T2);
+
+    vector<SymmetryBlockedTensor<U>*> T = vec(&T1, &T2);
+    vector<SymmetryBlockedTensor<U>*> Z = vec(&gettmp<SymmetryBlockedTensor<U> >("Z1"),
+                                              &gettmp<SymmetryBlockedTensor<U> >("Z2"));
+    diis.load(chk, T, Z);
+
+    calcEnergy();
+}
+
+INSTANTIATE_SPECIALIZATIONS(RCCSD);
+REGISTER_TASK(RCCSD<double>, "rccsd");
@@ -34,6 +34,7 @@
 #include "input/config.hpp"
 #include "util/lapack.h"
 #include "task/task.hpp"
+#include "util/checkpoint.hpp"
 
 namespace aquarius
 {
@@ -86,6 +87,65 @@ class DIIS
             }
         }
 
+        /*
+         * Save the extrapolation history so that a restarted calculation
+         * continues with the same subspace
+         */
+        void save(Checkpoint& chk) const
+        {
+            int nold = 0;
+            while (nold < nextrap && old_x[nold][0] != NULL) nold++;
+
+            chk.write("diis.start", start);
+            chk.write("diis.nold", nold);
+            chk.write("diis.e", e);
+            chk.write("diis.c", c);
+
+            for (int i = 0;i < nold;i++)
+            {
+                for (int j = 0;j < nx;j++) chk.writeTensor("diis.x", *old_x[i][j]);
+                for (int j = 0;j < ndx;j++) chk.writeTensor("diis.dx", *old_dx[i][j]);
+            }
+        }
+
+        void load(Checkpoint& chk, T& x, U& dx)
+        {
+            load(chk, std::vector<T*>(1, &x), std::vector<U*>(1, &dx));
+        }
+
+        /*
+         * Restore the history written by save(); x and dx are used as templates
+         * for the saved vectors
+         */
+        void load(Checkpoint& chk, const std::vector<T*>& x, const std::vector<U*>& dx)
+        {
+            assert(x.size() == nx);
+            assert(dx.size() == ndx);
+
+            int nold;
+            chk.read("diis.start", start);
+            chk.read("diis.nold", nold);
+            chk.read("diis.e", e);
+            chk.read("diis.c", c);
+
+            if (nold > nextrap || e.size() != (nextrap+1)*(nextrap+1))
+                throw std::runtime_error("DIIS: checkpoint was written with a different order");
+
+            for (int i = 0;i < nold;i++)
+            {
+                for (int j = 0;j < nx;j++)
+                {
+                    if (old_x[i][j] == NULL) old_x[i][j] = new T(*x[j]);
+                    chk.readTensor("diis.x", *old_x[i][j]);
+                }
+                for (int j = 0;j < ndx;j++)
+                {
+                    if (old_dx[i][j] == NULL) old_dx[i][j] = new U(*dx[j]);
+                    chk.readTensor("diis.dx", *old_dx[i][j]);
+                }
+            }
+        }
+
         void extrapolate(T& x, U& dx)
         {
             extrapolate(std::vector<T*>(1, &x), std::vector<U*>(1, &dx));
@@ -0,0 +1,335 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+#ifndef _AQUARIUS_EDIIS_HPP_
+#define _AQUARIUS_EDIIS_HPP_
+
+#include <vector>
+#include <cassert>
+#include <algorithm>
+#include <limits>
+
+#include "input/config.hpp"
+#include "util/lapack.h"
+#include "util/checkpoint.hpp"
+
+namespace aquarius
+{
+namespace convergence
+{
+
+/*
+ * Energy-based interpolation of Fock matrices for SCF, which is much more robust
+ * than commutator DIIS far from convergence. Given the densities D_i, Fock matrices
+ * F_i and energies E_i of the previous iterations, the coefficients c_i >= 0,
+ * sum_i c_i = 1 minimize a model of the energy of D = sum_i c_i D_i, either
+ *
+ *  EDIIS: E(c) = sum_i c_i E_i - 1/4 sum_ij c_i c_j Tr[(D_i-D_j)(F_i-F_j)],
+ *
+ *         which is exact for Hartree-Fock, or
+ *
+ *  ADIIS: E(c) = E_0 + sum_i c_i Tr[(D_i-D_0)F_0]
+ *                    + 1/2 sum_ij c_i c_j Tr[(D_i-D_0)(F_j-F_0)],
+ *
+ *         the second-order expansion about the latest iteration 0,
+ *
+ * and the interpolated Fock matrix is sum_i c_i F_i. With several D/F pairs (e.g. alpha
+ * and beta spin) the traces are summed.
+ */
+template<typename T>
+class EDIIS
+{
+    protected:
+        typedef typename T::dtype dtype;
+        typedef typename std::real_type<dtype>::type real_type;
+
+        static const int MAX_ORDER = 12;
+
+        std::vector< std::vector<T*> > old_D;
+        std::vector< std::vector<T*> > old_F;
+        std::vector<double> E;
+        /*
+         * t[i+j*nextrap] = sum Tr[D_i F_j]
+         */
+        std::vector<real_type> t;
+        std::vector<real_type> c;
+        int nextrap, nx;
+        bool adiis;
+
+    public:
+        EDIIS(const input::Config& config, const int nx = 1)
+        : nx(nx)
+        {
+            nextrap = config.get<int>("order");
+            adiis = config.get<std::string>("method") == "adiis";
+
+            /*
+             * minimize() visits all 2^order faces of the simplex
+             */
+            if (nextrap < 1 || nextrap > MAX_ORDER)
+                throw std::runtime_error(std::strprintf("EDIIS: order must be between 1 and %d, not %d",
+                                                        MAX_ORDER, nextrap));
+
+            E.resize(nextrap);
+            t.resize(nextrap*nextrap);
+            c.resize(nextrap);
+
+            old_D.resize(nextrap, std::vector<T*>(nx, (T*)NULL));
+            old_F.resize(nextrap, std::vector<T*>(nx, (T*)NULL));
+        }
+
+        ~EDIIS()
+        {
+            for (int i = 0;i < nextrap;i++)
+            {
+                for (int j = 0;j < nx;j++)
+                {
+                    if (old_D[i][j] != NULL) delete old_D[i][j];
+                    if (old_F[i][j] != NULL) delete old_F[i][j];
+                }
+            }
+        }
+
+        int getNumVectors() const
+        {
+            int nold = 0;
+            while (nold < nextrap && old_D[nold][0] != NULL) nold++;
+            return nold;
+        }
+
+        const std::vector<real_type>& getCoefficients() const { return c; }
+
+        void save(Checkpoint& chk) const
+        {
+            int nold = getNumVectors();
+
+            chk.write("ediis.nold", nold);
+            chk.write("ediis.E", E);
+            chk.write("ediis.t", t);
+
+            for (int i = 0;i < nold;i++)
+            {
+                for (int j = 0;j < nx;j++) chk.writeTensor("ediis.D", *old_D[i][j]);
+                for (int j = 0;j < nx;j++) chk.writeTensor("ediis.F", *old_F[i][j]);
+            }
+        }
+
+        /*
+         * Restore the history written by save(); D and F are used as templates
+         * for the saved matrices
+         */
+        void load(Checkpoint& chk, const std::vector<T*>& D, const std::vector<T*>& F)
+        {
+            assert(D.size() == nx);
+            assert(F.size() == nx);
+
+            int nold;
+            chk.read("ediis.nold", nold);
+            chk.read("ediis.E", E);
+            chk.read("ediis.t", t);
+
+            if (nold > nextrap || t.size() != nextrap*nextrap)
+                throw std::runtime_error("EDIIS: checkpoint was written with a different order");
+
+            for (int i = 0;i < nold;i++)
+            {
+                for (int j = 0;j < nx;j++)
+                {
+                    if (old_D[i][j] == NULL) old_D[i][j] = new T(*D[j]);
+                    chk.readTensor("ediis.D", *old_D[i][j]);
+                }
+                for (int j = 0;j < nx;j++)
+                {
+                    if (old_F[i][j] == NULL) old_F[i][j] = new T(*F[j]);
+                    chk.readTensor("ediis.F", *old_F[i][j]);
+                }
+            }
+        }
+
+        /*
+         * Add the density D, Fock matrix F = F(D), and energy of the current iteration
+         * to the history, discarding the oldest iteration if necessary
+         */
+        void push(double energy, const std::vector<T*>& D, const std::vector<T*>& F)
+        {
+            assert(D.size() == nx);
+            assert(F.size() == nx);
+
+            if (nextrap < 1) return;
+
+            std::rotate(old_D.begin(), old_D.end()-1, old_D.end());
+            std::rotate(old_F.begin(), old_F.end()-1, old_F.end());
+
+            for (int i = 0;i < nx;i++)
+            {
+                if (old_D[0][i] == NULL)
+                {
+                    old_D[0][i] = new T(*D[i]);
+                    old_F[0][i] = new T(*F[i]);
+                }
+                else
+                {
+                    *old_D[0][i] = *D[i];
+                    *old_F[0][i] = *F[i];
+                }
+            }
+
+            for (int i = nextrap-1;i > 0;i--)
+            {
+                for (int j = nextrap-1;j > 0;j--)
+                {
+                    t[i+j*nextrap] = t[(i-1)+(j-1)*nextrap];
+                }
+
+                E[i] = E[i-1];
+            }
+
+            E[0] = energy;
+
+            int nold = getNumVectors();
+            for (int i = 0;i < nold;i++)
+            {
+                t[i] = 0;
+                t[i*nextrap] = 0;
+                for (int j = 0;j < nx;j++)
+                {
+                    t[i] += std::real(scalar(conj(*old_D[i][j])*(*old_F[0][j])));
+                    if (i > 0) t[i*nextrap] += std::real(scalar(conj(*old_D[0][j])*(*old_F[i][j])));
+                }
+            }
+        }
+
+        /*
+         * Replace F with the interpolation of the saved Fock matrices which
+         * minimizes the model energy
+         */
+        void extrapolate(const std::vector<T*>& F)
+        {
+            assert(F.size() == nx);
+
+            int n = getNumVectors();
+            if (n == 0) return;
+
+            std::vector<real_type> A(n*n), b(n);
+            for (int i = 0;i < n;i++)
+            {
+                for (int j = 0;j < n;j++)
+                {
+                    real_type tii = t[i+i*nextrap], tjj = t[j+j*nextrap];
+                    real_type tij = t[i+j*nextrap], tji = t[j+i*nextrap];
+                    real_type ti0 = t[i], tj0 = t[j], t0i = t[i*nextrap], t0j = t[j*nextrap];
+
+                    if (adiis)
+                    {
+                        A[i+j*n] = 0.5*((tij-ti0-t0j+t[0])+(tji-tj0-t0i+t[0]));
+                    }
+                    else
+                    {
+                        A[i+j*n] = -0.5*(tii-tij-tji+tjj);
+                    }
+                }
+
+                b[i] = (adiis ? t[i]-t[0] : E[i]);
+            }
+
+            minimize(n, A, b);
+
+            for (int j = 0;j < nx;j++)
+            {
+                *F[j] = (*old_F[0][j])*c[0];
+                for (int i = 1;i < n;i++) *F[j] += (*old_F[i][j])*c[i];
+            }
+        }
+
+    protected:
+        /*
+         * Minimize f(c) = b.c + 1/2 c.A.c over the simplex c_i >= 0, sum_i c_i = 1.
+         * The subspace is small (at most MAX_ORDER), so just find the stationary point on
+         * the interior of every face and keep the lowest feasible one. This gives the global
+         * minimum even when A is indefinite, as it is for EDIIS.
+         */
+        void minimize(int n, const std::vector<real_type>& A, const std::vector<real_type>& b)
+        {
+            std::fill(c.begin(), c.end(), 0.0);
+            c[0] = 1;
+
+            real_type fmin = std::numeric_limits<real_type>::max();
+            std::vector<real_type> kkt((n+1)*(n+1)), x(n+1);
+            std::vector<integer> ipiv(n+1);
+            std::vector<int> face;
+
+            for (unsigned mask = 1;mask < (1u<<n);mask++)
+            {
+                face.clear();
+                for (int i = 0;i < n;i++) if (mask&(1u<<i)) face.push_back(i);
+                int k = face.size();
+
+                if (k == 1)
+                {
+                    x[0] = 1;
+                }
+                else
+                {
+                    /*
+                     * [ A_ff -1 ] [ c ]   [ -b_f ]
+                     * [  -1   0 ] [ l ] = [  -1  ]
+                     */
+                    for (int i = 0;i < k;i++)
+                    {
+                        for (int j = 0;j < k;j++) kkt[i+j*(k+1)] = A[face[i]+face[j]*n];
+                        kkt[i+k*(k+1)] = -1;
+                        kkt[k+i*(k+1)] = -1;
+                        x[i] = -b[face[i]];
+                    }
+                    kkt[k+k*(k+1)] = 0;
+                    x[k] = -1;
+
+                    if (hesv('U', k+1, 1, kkt.data(), k+1, ipiv.data(), x.data(), k+1) != 0) continue;
+
+                    bool feasible = true;
+                    for (int i = 0;i < k;i++) if (x[i] < 0) feasible = false;
+                    if (!feasible) continue;
+                }
+
+                real_type f = 0;
+                for (int i = 0;i < k;i++)
+                {
+                    f += b[face[i]]*x[i];
+                    for (int j = 0;j < k;j++) f += 0.5*x[i]*A[face[i]+face[j]*n]*x[j];
+                }
+
+                if (f < fmin)
+                {
+                    fmin = f;
+                    std::fill(c.begin(), c.end(), 0.0);
+                    for (int i = 0;i < k;i++) c[face[i]] = x[i];
+                }
+            }
+        }
+};
+
+}
+}
+
+#endif
@@ -440,6 +440,30 @@ OneElectronIntegralsTask::OneElectronIntegralsTask(const string& name, const Con
     addProduct(Product("1ehamiltonian", "H", reqs));
 }
 
+/*
+ * Primitive Cartesian integrals over all shell pairs, for the overlap, kinetic
+ * energy, and one nuclear attraction integral per atom
+ */
+double OneElectronIntegralsTask::getCostHint() const
+{
+    const Molecule& molecule = get<Molecule>("molecule");
+
+    int natom = distance(molecule.getAtomsBegin(), molecule.getAtomsEnd());
+
+    double npair = 0;
+    for (Molecule::const_shell_iterator a = molecule.getShellsBegin();a != molecule.getShellsEnd();++a)
+    {
+        for (Molecule::const_shell_iterator b = molecule.getShellsBegin();b != a;++b)
+        {
+            npair += (double)a->getNPrim()*(a->getL()+1)*(a->getL()+2)/2*
+                             b->getNPrim()*(b->getL()+1)*(b->getL()+2)/2;
+        }
+        npair += pow((double)a->getNPrim()*(a->getL()+1)*(a->getL()+2)/2, 2)/2;
+    }
+
+    return npair*(natom+2);
+}
+
 void OneElectronIntegralsTask::run(TaskDAG& dag, const Arena& arena)
 {
     const Molecule& molecule = get<Molecule>("molecule");
@@ -546,4 +570,30 @@ void OneElectronIntegralsTask::run(TaskDAG& dag, const Arena& arena)
     put("H", oeh);
 }
 
+template <class Integral>
+void OneElectronIntegralsTask::redistribute(const string& name, const Arena& world, bool member)
+{
+    const Molecule& molecule = get<Molecule>("molecule");
+
+    Integral *ints = new Integral(world, molecule.getGroup(), molecule.getNumOrbitals());
+
+    for (int i = 0;i < molecule.getGroup().getNumIrreps();i++)
+    {
+        vector<int> irreps(2,i);
+        vector<tkv_pair<double> > pairs;
+        if (member) get<Integral>(name).getLocalData(irreps, pairs);
+        ints->writeRemoteData(irreps, pairs);
+    }
+
+    put(name, ints);
+}
+
+void OneElectronIntegralsTask::redistribute(const Arena& world, int root, bool member)
+{
+    redistribute<OVI>("S", world, member);
+    redistribute<KEI>("T", world, member);
+    redistribute<NAI>("G", world, member);
+    redistribute<OneElectronHamiltonian>("H", world, member);
+}
+
 REGISTER_TASK(OneElectronIntegralsTask,"1eints");
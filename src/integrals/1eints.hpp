@@ -159,9 +159,20 @@ class OneElectronIntegralsTask : public task::Task
                   name(name) {}
         };
 
+    protected:
+        template <class Integral>
+        void redistribute(const std::string& name, const Arena& world, bool member);
+
+    public:
         OneElectronIntegralsTask(const std::string& name, const input::Config& config);
 
         void run(task::TaskDAG& dag, const Arena& arena);
+
+        double getCostHint() const;
+
+        bool isRedistributable() const { return true; }
+
+        void redistribute(const Arena& world, int root, bool member);
 };
 
 struct OVI : public OneElectronIntegralsTask::OneElectronIntegral
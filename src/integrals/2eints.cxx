@@ -23,10 +23,12 @@
  * SUCH DAMAGE. */
 
 #include "2eints.hpp"
+#include "screening.hpp"
 #include "internal.h"
 
-#define TMP_BUFSIZE 65536
-#define INTEGRAL_CUTOFF 1e-14
+#include <cerrno>
+#include <unistd.h>
+#include <sys/mman.h>
 
 /**
  * Compute the index of a function in cartesian angular momentum.
@@ -51,6 +53,98 @@ using namespace aquarius::input;
 using namespace aquarius::symmetry;
 using namespace aquarius::task;
 
+/*
+ * Per-thread scratch space for the primitive kernels, which is only ever grown
+ */
+static double* eri_workspace = NULL;
+static size_t eri_workspace_size = 0;
+#pragma omp threadprivate(eri_workspace, eri_workspace_size)
+
+double* ERIEvaluator::workspace(size_t n)
+{
+    if (eri_workspace_size < n)
+    {
+        FREE(eri_workspace);
+        eri_workspace = NULL;
+        eri_workspace_size = 0;
+
+        eri_workspace = SAFE_MALLOC(double, n);
+        eri_workspace_size = n;
+    }
+    return eri_workspace;
+}
+
+int64_t ERIEvaluator::validate(const vector<Shell>& shells, int64_t& nchecked, double& maxdiff)
+{
+    /*
+     * One shell of each angular momentum is enough to hit every class
+     */
+    vector<int> rep;
+    for (int s = 0;s < shells.size();s++)
+    {
+        int L = shells[s].getL();
+        if (L >= rep.size()) rep.resize(L+1, -1);
+        if (rep[L] == -1) rep[L] = s;
+    }
+
+    int64_t nmismatch = 0;
+    nchecked = 0;
+    maxdiff = 0;
+
+    for (int a = 0;a < rep.size();a++)
+    for (int b = 0;b < rep.size();b++)
+    for (int c = 0;c < rep.size();c++)
+    for (int d = 0;d < rep.size();d++)
+    {
+        if (rep[a] == -1 || rep[b] == -1 || rep[c] == -1 || rep[d] == -1) continue;
+
+        const Shell& sa = shells[rep[a]];
+        const Shell& sb = shells[rep[b]];
+        const Shell& sc = shells[rep[c]];
+        const Shell& sd = shells[rep[d]];
+
+        const double* ca = sa.getCenter().getCenter(0);
+        const double* cb = sb.getCenter().getCenter(0);
+        const double* cc = sc.getCenter().getCenter(0);
+        const double* cd = sd.getCenter().getCenter(0);
+
+        int na = sa.getNPrim(), nb = sb.getNPrim(), nc = sc.getNPrim(), nd = sd.getNPrim();
+        size_t nfunc = (a+1)*(a+2)*(b+1)*(b+2)*(c+1)*(c+2)*(d+1)*(d+2)/16;
+        size_t nprim = na*nb*nc*nd;
+
+        vector<double> batch(nfunc*nprim), scalar(nfunc*nprim);
+        vector<double> work(max(osbatch_worksize(a, b, c, d), (size_t)(a+1)*(b+1)*(c+1)*(d+1)*(a+b+c+d+1)));
+
+        osbatch(a, b, c, d, ca, cb, cc, cd, na, nb, nc, nd,
+                sa.getExponents().data(), sb.getExponents().data(),
+                sc.getExponents().data(), sd.getExponents().data(),
+                batch.data(), work.data());
+
+        for (int m = 0;m < nprim;m++)
+        {
+            int h = m/(na*nb*nc);
+            int r = m%(na*nb*nc);
+            int g = r/(na*nb);
+            int s = r%(na*nb);
+            int f = s/na;
+            int e = s%na;
+            osprim(a, b, c, d, ca, cb, cc, cd,
+                   sa.getExponents()[e], sb.getExponents()[f],
+                   sc.getExponents()[g], sd.getExponents()[h],
+                   scalar.data()+nfunc*m, work.data());
+        }
+
+        for (size_t i = 0;i < nfunc*nprim;i++)
+        {
+            if (memcmp(&batch[i], &scalar[i], sizeof(double)) != 0) nmismatch++;
+            maxdiff = max(maxdiff, fabs(batch[i]-scalar[i]));
+        }
+        nchecked += nfunc*nprim;
+    }
+
+    return nmismatch;
+}
+
 void ERIEvaluator::operator()(int la, const double* ca, int na, const double *za,
                               int lb, const double* cb, int nb, const double *zb,
                               int lc, const double* cc, int nc, const double *zc,
@@ -66,27 +160,41 @@ void ERIEvaluator::operator()(int la, const double* ca, int na, const double *za
 
     ///*
     size_t nfunc = (la+1)*(la+2)*(lb+1)*(lb+2)*(lc+1)*(lc+2)*(ld+1)*(ld+2)/16;
+    size_t nwork = osbatch_worksize(la, lb, lc, ld);
+
+    /*
+     * Split over the last primitive index only when the caller is not
+     * already threaded over shell quartets
+     */
+    if (nd > 1 && !omp_in_parallel() && omp_get_max_threads() > 1)
+    {
+        /*
+         * Exceptions may not leave the parallel region
+         */
+        string error;
 
-    int nt = omp_get_max_threads();
-    vector<double*> work(nt);
-    for (int i = 0;i < nt;i++)
-        work[i] = SAFE_MALLOC(double, (la+1)*(lb+1)*(lc+1)*(ld+1)*(la+lb+lc+ld+1));
+        #pragma omp parallel for schedule(dynamic)
+        for (int h = 0;h < nd;h++)
+        {
+            try
+            {
+                osbatch(la, lb, lc, ld, ca, cb, cc, cd, na, nb, nc, 1, za, zb, zc, zd+h,
+                        ints+nfunc*na*nb*nc*h, workspace(nwork));
+            }
+            catch (runtime_error& e)
+            {
+                #pragma omp critical
+                error = e.what();
+            }
+        }
 
-    #pragma omp parallel for
-    for (int m = 0;m < na*nb*nc*nd;m++)
+        if (!error.empty()) throw runtime_error(error);
+    }
+    else
     {
-        int tid = omp_get_thread_num();
-        int h = m/(na*nb*nc);
-        int r = m%(na*nb*nc);
-        int g = r/(na*nb);
-        int s = r%(na*nb);
-        int f = s/na;
-        int e = s%na;
-        osprim(la, lb, lc, ld, ca, cb, cc, cd, za[e], zb[f], zc[g], zd[h],
-               ints+nfunc*m, work[tid]);
+        osbatch(la, lb, lc, ld, ca, cb, cc, cd, na, nb, nc, nd, za, zb, zc, zd,
+                ints, workspace(nwork));
     }
-
-    for (int i = 0;i < nt;i++) FREE(work[i]);
     //*/
 }
 
@@ -542,79 +650,466 @@ void TwoElectronIntegrals::prim2contr4l(size_t nother, double* buf1, double* buf
     copy(m*n, buf1, 1, buf2, 1);
 }
 
+namespace
+{
+
+struct eri_entry_t
+{
+    uint32_t block;
+    uint64_t ijkl;
+    double value;
+
+    bool operator<(const eri_entry_t& other) const
+    {
+        return block < other.block || (block == other.block && ijkl < other.ijkl);
+    }
+};
+
+struct eri_block_t
+{
+    uint32_t block;
+    uint32_t count;
+    uint64_t nwords;
+};
+
+inline size_t align8(size_t n)
+{
+    return (n+7)&~(size_t)7;
+}
+
+}
+
+ERI::ERI(const Arena& arena, const PointGroup& group, const vector<int>& norb,
+         size_t chunk_size, const string& scratch)
+: Resource(arena), group(group), nirrep(norb.size()), chunk_size(chunk_size),
+  nints(0), chunk_offset(1, 0), file(NULL), map(NULL), map_size(0)
+{
+    assert(chunk_size > 0);
+
+    for (int i = 0;i < nirrep;i++) irrep += vector<int>(norb[i],i);
+
+    if (!scratch.empty())
+    {
+        string name = strprintf("%s/aquarius.eri.%d.%d", scratch.c_str(), (int)getpid(), arena.rank);
+        file = fopen(name.c_str(), "w+b");
+        if (file == NULL)
+            throw runtime_error(strprintf("Could not open ERI file %s: %s", name.c_str(), strerror(errno)));
+        /*
+         * The file goes away as soon as it is closed, even if we crash
+         */
+        unlink(name.c_str());
+    }
+
+    omp_init_lock(&lock);
+}
+
+ERI::~ERI()
+{
+    if (map != NULL) munmap(map, map_size);
+    if (file != NULL) fclose(file);
+    omp_destroy_lock(&lock);
+}
+
+void ERI::encode(const double* ints, const idx4_t* idxs, size_t n, vector<char>& buf) const
+{
+    uint64_t norb = irrep.size();
+
+    vector<eri_entry_t> entries(n);
+    for (size_t m = 0;m < n;m++)
+    {
+        idx4_t idx = idxs[m];
+        idx.canonicalize();
+
+        entries[m].block = ((irrep[idx.i]*nirrep+irrep[idx.j])*nirrep+irrep[idx.k])*nirrep+irrep[idx.l];
+        entries[m].ijkl = ((idx.i*norb+idx.j)*norb+idx.k)*norb+idx.l;
+        entries[m].value = ints[m];
+    }
+
+    sort(entries.begin(), entries.end());
+
+    buf.clear();
+    vector<uint16_t> words;
+
+    for (size_t begin = 0, end;begin < n;begin = end)
+    {
+        words.clear();
+        uint64_t last = 0;
+        for (end = begin;end < n && entries[end].block == entries[begin].block;end++)
+        {
+            uint64_t delta = entries[end].ijkl-last;
+            last = entries[end].ijkl;
+
+            while (delta >= 0x8000)
+            {
+                words.push_back((uint16_t)(0x8000|(delta&0x7fff)));
+                delta >>= 15;
+            }
+            words.push_back((uint16_t)delta);
+        }
+
+        eri_block_t header;
+        header.block = entries[begin].block;
+        header.count = end-begin;
+        header.nwords = words.size();
+
+        size_t pos = buf.size();
+        size_t nword_bytes = align8(words.size()*sizeof(uint16_t));
+        buf.resize(pos+sizeof(eri_block_t)+nword_bytes+header.count*sizeof(double), 0);
+
+        char* p = buf.data()+pos;
+        memcpy(p, &header, sizeof(eri_block_t));
+        p += sizeof(eri_block_t);
+        memcpy(p, words.data(), words.size()*sizeof(uint16_t));
+        p += nword_bytes;
+        for (size_t m = begin;m < end;m++)
+        {
+            memcpy(p, &entries[m].value, sizeof(double));
+            p += sizeof(double);
+        }
+    }
+}
+
+void ERI::addChunk(const double* ints, const idx4_t* idxs, size_t n)
+{
+    assert(n <= chunk_size);
+    assert(map == NULL);
+
+    if (n == 0) return;
+
+    vector<char> buf;
+    encode(ints, idxs, n, buf);
+
+    omp_set_lock(&lock);
+
+    if (file != NULL)
+    {
+        if (fwrite(buf.data(), 1, buf.size(), file) != buf.size())
+        {
+            omp_unset_lock(&lock);
+            throw runtime_error(strprintf("Could not write ERI file: %s", strerror(errno)));
+        }
+    }
+    else
+    {
+        mem.insert(mem.end(), buf.begin(), buf.end());
+    }
+
+    chunk_offset.push_back(chunk_offset.back()+buf.size());
+    nints += n;
+
+    omp_unset_lock(&lock);
+}
+
+void ERI::finalize()
+{
+    if (file == NULL || map != NULL || getStorageSize() == 0) return;
+
+    if (fflush(file) != 0)
+        throw runtime_error(strprintf("Could not write ERI file: %s", strerror(errno)));
+
+    map_size = getStorageSize();
+    void* addr = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fileno(file), 0);
+    if (addr == MAP_FAILED)
+        throw runtime_error(strprintf("Could not map ERI file: %s", strerror(errno)));
+    map = (char*)addr;
+}
+
+void ERI::readChunk(size_t chunk, vector<double>& ints, vector<idx4_t>& idxs) const
+{
+    assert(chunk < getNumChunks());
+    assert(file == NULL || map != NULL);
+
+    uint64_t norb = irrep.size();
+
+    const char* p = (file == NULL ? mem.data() : map)+chunk_offset[chunk];
+    const char* end = (file == NULL ? mem.data() : map)+chunk_offset[chunk+1];
+
+    ints.clear();
+    idxs.clear();
+
+    while (p < end)
+    {
+        eri_block_t header;
+        memcpy(&header, p, sizeof(eri_block_t));
+        p += sizeof(eri_block_t);
+
+        const uint16_t* words = (const uint16_t*)p;
+        p += align8(header.nwords*sizeof(uint16_t));
+
+        size_t n0 = ints.size();
+        ints.resize(n0+header.count);
+        memcpy(ints.data()+n0, p, header.count*sizeof(double));
+        p += header.count*sizeof(double);
+
+        idxs.resize(n0+header.count);
+        uint64_t ijkl = 0;
+        for (size_t m = 0, w = 0;m < header.count;m++)
+        {
+            uint64_t delta = 0;
+            int shift = 0;
+            while (words[w]&0x8000)
+            {
+                delta |= (uint64_t)(words[w++]&0x7fff) << shift;
+                shift += 15;
+            }
+            delta |= (uint64_t)words[w++] << shift;
+            ijkl += delta;
+
+            uint64_t ijk = ijkl/norb;
+            uint64_t ij = ijk/norb;
+            idxs[n0+m].l = ijkl-ijk*norb;
+            idxs[n0+m].k = ijk-ij*norb;
+            idxs[n0+m].j = ij%norb;
+            idxs[n0+m].i = ij/norb;
+        }
+    }
+}
+
 void ERI::print(Printer& p) const
 {
     //TODO
 }
 
 TwoElectronIntegralsTask::TwoElectronIntegralsTask(const string& name, const Config& config)
-: Task("2eints", name)
+: Task("2eints", name),
+  storage_cutoff(config.get<double>("storage_cutoff")),
+  calc_cutoff(config.get<double>("calc_cutoff")),
+  balance_report(config.get<bool>("balance_report")),
+  validate_kernel(config.get<bool>("validate_kernel")),
+  disk(config.get<string>("storage") == "disk"),
+  chunk_size(config.get<int>("chunk_size"))
 {
     vector<Requirement> reqs;
     reqs.push_back(Requirement("molecule", "molecule"));
     addProduct(Product("eri", "I", reqs));
+
+    if (config.exists("scratch_dir"))
+    {
+        scratch_dir = config.get<string>("scratch_dir");
+    }
+    else if (getenv("TMPDIR") != NULL)
+    {
+        scratch_dir = getenv("TMPDIR");
+    }
+    else
+    {
+        scratch_dir = ".";
+    }
 }
 
-void TwoElectronIntegralsTask::run(TaskDAG& dag, const Arena& arena)
+/*
+ * Primitive Cartesian integrals over all unique shell quartets, ignoring screening;
+ * with w_ab the work of a shell pair, this is the sum of w_ab*w_cd over ab >= cd
+ */
+double TwoElectronIntegralsTask::getCostHint() const
 {
     const Molecule& molecule = get<Molecule>("molecule");
 
-    ERI* eri = new ERI(arena, molecule.getGroup());
+    double sum = 0, sumsq = 0;
+    for (Molecule::const_shell_iterator a = molecule.getShellsBegin();a != molecule.getShellsEnd();++a)
+    {
+        for (Molecule::const_shell_iterator b = molecule.getShellsBegin();;++b)
+        {
+            double w = (double)a->getNPrim()*(a->getL()+1)*(a->getL()+2)/2*
+                               b->getNPrim()*(b->getL()+1)*(b->getL()+2)/2;
+            sum += w;
+            sumsq += w*w;
+            if (b == a) break;
+        }
+    }
 
-    Context ctx(Context::ISCF);
+    return (sum*sum+sumsq)/2;
+}
 
-    vector<double> tmpval(TMP_BUFSIZE);
-    vector<idx4_t> tmpidx(TMP_BUFSIZE);
+void TwoElectronIntegralsTask::run(TaskDAG& dag, const Arena& arena)
+{
+    const Molecule& molecule = get<Molecule>("molecule");
 
     const vector<int>& N = molecule.getNumOrbitals();
-    int nirrep = molecule.getGroup().getNumIrreps();
+
+    ERI* eri = new ERI(arena, molecule.getGroup(), N, chunk_size, disk ? scratch_dir : "");
+
+    Context ctx(Context::ISCF);
 
     vector<vector<int> > idx = Shell::setupIndices(Context(), molecule);
     vector<Shell> shells(molecule.getShellsBegin(), molecule.getShellsEnd());
 
-    int abcd = 0;
-    for (int a = 0;a < shells.size();++a)
+    /*
+     * The orderings are generated lazily, so fill them in before going parallel
+     */
+    int Lmax = 0;
+    for (int a = 0;a < shells.size();++a) Lmax = max(Lmax, shells[a].getL());
+    ctx.getCartesianOrdering(Lmax);
+    ctx.getSphericalOrdering(Lmax);
+
+    if (validate_kernel)
+    {
+        int64_t nchecked;
+        double maxdiff;
+        int64_t nmismatch = ERIEvaluator::validate(shells, nchecked, maxdiff);
+
+        log(arena) << strprintf("Primitive ERI kernel (%s): %ld of %ld integrals differ from osprim, max. difference %.3e",
+                                osbatch_isa(), (long)nmismatch, (long)nchecked, maxdiff) << endl;
+    }
+
+    SchwarzScreening screen(arena, shells, ERIEvaluator());
+
+    ShellQuartetScheduler sched(arena, shells);
+    int nthread = sched.getNumThreads();
+
+    vector<int64_t> nscreened(nthread, 0);
+
+    /*
+     * A thread which fails (e.g. runs out of memory) keeps taking blocks from the
+     * scheduler without computing them, so that the other threads and ranks are not
+     * left waiting, and the error is raised once the parallel region is done
+     */
+    string error;
+
+    #pragma omp parallel num_threads(nthread)
     {
-        for (int b = 0;b <= a;++b)
+        int tid = omp_get_thread_num();
+        bool failed = false;
+
+        vector<double> tmpval(TMP_BUFSIZE);
+        vector<idx4_t> tmpidx(TMP_BUFSIZE);
+
+        vector<double> ints;
+        vector<idx4_t> idxs;
+        ints.reserve(chunk_size);
+        idxs.reserve(chunk_size);
+
+        ShellQuartetBlock block;
+        while (sched.next(tid, block))
         {
+            if (failed) continue;
+
+            int a = block.a;
+            int b = block.b;
+
+            if (!screen.isSignificant(a, b, calc_cutoff))
+            {
+                nscreened[tid] += (int64_t)a*(a+1)/2+b+1;
+                continue;
+            }
+
             for (int c = 0;c <= a;++c)
             {
                 int dmax = c;
                 if (a == c) dmax = b;
                 for (int d = 0;d <= dmax;++d)
                 {
-                    if (abcd%arena.nproc == arena.rank)
+                    if (!screen.isSignificant(a, b, c, d, calc_cutoff))
+                    {
+                        nscreened[tid]++;
+                        continue;
+                    }
+
+                    if (failed) break;
+
+                    try
                     {
-                        TwoElectronIntegrals block(shells[a], shells[b], shells[c], shells[d], ERIEvaluator());
+                        TwoElectronIntegrals abcd(shells[a], shells[b], shells[c], shells[d], ERIEvaluator());
 
                         size_t n;
-                        while ((n = block.process(ctx, idx[a], idx[b], idx[c], idx[d],
-                                                  TMP_BUFSIZE, tmpval.data(), tmpidx.data(), INTEGRAL_CUTOFF)) != 0)
+                        while ((n = abcd.process(ctx, idx[a], idx[b], idx[c], idx[d],
+                                                 min((size_t)TMP_BUFSIZE, chunk_size-ints.size()),
+                                                 tmpval.data(), tmpidx.data(), storage_cutoff)) != 0)
                         {
-                            eri->ints.insert(eri->ints.end(), tmpval.data(), tmpval.data()+n);
-                            eri->idxs.insert(eri->idxs.end(), tmpidx.data(), tmpidx.data()+n);
+                            ints.insert(ints.end(), tmpval.data(), tmpval.data()+n);
+                            idxs.insert(idxs.end(), tmpidx.data(), tmpidx.data()+n);
+
+                            if (ints.size() == chunk_size)
+                            {
+                                eri->addChunk(ints.data(), idxs.data(), ints.size());
+                                ints.clear();
+                                idxs.clear();
+                            }
                         }
                     }
-                    abcd++;
+                    catch (runtime_error& e)
+                    {
+                        failed = true;
+                        #pragma omp critical
+                        error = e.what();
+                    }
                 }
             }
         }
+
+        if (!failed) eri->addChunk(ints.data(), idxs.data(), ints.size());
+    }
+
+    if (!error.empty()) throw runtime_error(error);
+
+    eri->finalize();
+
+    int64_t nquartet = 0, nskip = 0;
+    for (int ab = 0;ab < sched.getNumBlocks();ab++) nquartet += ab+1;
+    for (int t = 0;t < nthread;t++) nskip += nscreened[t];
+    arena.Allreduce(&nskip, 1, MPI::SUM);
+
+    log(arena) << strprintf("%ld of %ld shell quartets screened out", (long)nskip, (long)nquartet) << endl;
+
+    int64_t nstored[2] = {(int64_t)eri->getNumInts(), (int64_t)eri->getStorageSize()};
+    arena.Allreduce(nstored, 2, MPI::SUM);
+
+    log(arena) << strprintf("%ld integrals stored in %.1f MB", (long)nstored[0], nstored[1]/1048576.0) << endl;
+
+    vector<ShellQuartetScheduler::Load> loads = sched.gatherLoads();
+
+    double maxbusy = 0, sumbusy = 0, minbusy = loads[0].busy;
+    for (int p = 0;p < arena.nproc;p++)
+    {
+        maxbusy = max(maxbusy, loads[p].busy);
+        minbusy = min(minbusy, loads[p].busy);
+        sumbusy += loads[p].busy;
+    }
+    double avgbusy = sumbusy/arena.nproc;
+
+    log(arena) << strprintf("%ld shell blocks in %ld chunks, busy min/avg/max = %.3f/%.3f/%.3f s, imbalance = %.3f",
+                            (long)sched.getNumBlocks(), (long)sched.getNumChunks(),
+                            minbusy, avgbusy, maxbusy, (avgbusy > 0 ? maxbusy/avgbusy : 1.0)) << endl;
+
+    if (balance_report)
+    {
+        for (int p = 0;p < arena.nproc;p++)
+        {
+            log(arena) << strprintf("rank %4d: %8ld blocks %6ld chunks cost %10.3e busy %10.3f s idle %10.3f s wall %10.3f s",
+                                    p, (long)loads[p].nblock, (long)loads[p].nchunk, loads[p].cost,
+                                    loads[p].busy, loads[p].idle, loads[p].wall) << endl;
+        }
     }
 
-    //TODO: load balance
+    put("I", eri);
+}
+
+void TwoElectronIntegralsTask::redistribute(const Arena& world, int root, bool member)
+{
+    const Molecule& molecule = get<Molecule>("molecule");
+
+    /*
+     * Each rank only reads back its own chunks, so the ranks which ran the task
+     * keep theirs and the others start out empty
+     */
+    ERI* eri = new ERI(world, molecule.getGroup(), molecule.getNumOrbitals(),
+                       chunk_size, disk ? scratch_dir : "");
 
-    for (int i = 0;i < eri->ints.size();++i)
+    if (member)
     {
-        if (eri->idxs[i].i > eri->idxs[i].j) std::swap(eri->idxs[i].i, eri->idxs[i].j);
-        if (eri->idxs[i].k > eri->idxs[i].l) std::swap(eri->idxs[i].k, eri->idxs[i].l);
-        if (eri->idxs[i].i > eri->idxs[i].k ||
-            (eri->idxs[i].i == eri->idxs[i].k && eri->idxs[i].j > eri->idxs[i].l))
+        const ERI& old = get<ERI>("I");
+
+        vector<double> ints;
+        vector<idx4_t> idxs;
+        for (size_t chunk = 0;chunk < old.getNumChunks();chunk++)
         {
-            std::swap(eri->idxs[i].i, eri->idxs[i].k);
-            std::swap(eri->idxs[i].j, eri->idxs[i].l);
+            old.readChunk(chunk, ints, idxs);
+            eri->addChunk(ints.data(), idxs.data(), ints.size());
         }
     }
 
+    eri->finalize();
+
     put("I", eri);
 }
 
@@ -26,6 +26,7 @@
 #define _AQUARIUS_INTEGRALS_2EINTS_HPP_
 
 #include <cstddef>
+#include <cstdio>
 #include <string>
 #include <vector>
 #include <stdexcept>
@@ -42,6 +43,12 @@
 #include "input/config.hpp"
 
 #include "shell.hpp"
+#include "scheduler.hpp"
+
+/*
+ * Number of integrals to take from TwoElectronIntegrals::process at a time
+ */
+#define TMP_BUFSIZE 65536
 
 namespace aquarius
 {
@@ -56,6 +63,20 @@ struct idx4_t
     idx4_t() : i(0), j(0), k(0), l(0) {}
 
     idx4_t(uint16_t i, uint16_t j, uint16_t k, uint16_t l) : i(i), j(j), k(k), l(l) {}
+
+    /*
+     * Permute into the canonical order i <= j, k <= l, ij <= kl
+     */
+    void canonicalize()
+    {
+        if (i > j) std::swap(i, j);
+        if (k > l) std::swap(k, l);
+        if (i > k || (i == k && j > l))
+        {
+            std::swap(i, k);
+            std::swap(j, l);
+        }
+    }
 };
 
 namespace integrals
@@ -75,12 +96,22 @@ class TwoElectronIntegralEvaluator
 
 class ERIEvaluator : public TwoElectronIntegralEvaluator
 {
+    protected:
+        static double* workspace(size_t n);
+
     public:
         void operator()(int la, const double* ca, int na, const double *za,
                         int lb, const double* cb, int nb, const double *zb,
                         int lc, const double* cc, int nc, const double *zc,
                         int ld, const double* cd, int nd, const double *zd,
                         double *ints) const;
+
+        /*
+         * Check the batched primitive kernel against osprim for every class of
+         * angular momenta in shells; returns the number of integrals which are
+         * not bitwise identical
+         */
+        static int64_t validate(const std::vector<Shell>& shells, int64_t& nchecked, double& maxdiff);
 };
 
 class TwoElectronIntegrals
@@ -118,24 +149,89 @@ class TwoElectronIntegrals
         void prim2contr4l(size_t nother, double* buf1, double* buf2);
 };
 
+/*
+ * Storage for the unique integrals (ij|kl), i <= j, k <= l, ij <= kl, computed on this rank.
+ *
+ * Integrals are added in chunks of at most getChunkSize() values. Each chunk is sorted
+ * by irrep block and then by index, and the indices of each block are stored as
+ * differences of the compound index ijkl in a variable number of 16-bit words (almost
+ * always one). Chunks are kept either in memory or in an (unlinked) scratch file which
+ * is memory-mapped once writing is finished, and are read back one at a time.
+ */
 class ERI : public task::Resource
 {
     public:
         const symmetry::PointGroup& group;
-        std::vector<double> ints;
-        std::vector<idx4_t> idxs;
 
-        ERI(const Arena& arena, const symmetry::PointGroup& group) : Resource(arena), group(group) {}
+    protected:
+        std::vector<int> irrep;
+        int nirrep;
+        size_t chunk_size;
+        size_t nints;
+        std::vector<size_t> chunk_offset;
+        std::vector<char> mem;
+        FILE* file;
+        char* map;
+        size_t map_size;
+        omp_lock_t lock;
+
+        void encode(const double* ints, const idx4_t* idxs, size_t n, std::vector<char>& buf) const;
+
+    public:
+        /*
+         * If scratch is empty the integrals are kept in memory, otherwise
+         * in a file in that directory
+         */
+        ERI(const Arena& arena, const symmetry::PointGroup& group, const std::vector<int>& norb,
+            size_t chunk_size = 1048576, const std::string& scratch = "");
+
+        ~ERI();
+
+        size_t getChunkSize() const { return chunk_size; }
+
+        size_t getNumInts() const { return nints; }
+
+        size_t getNumChunks() const { return chunk_offset.size()-1; }
+
+        size_t getStorageSize() const { return chunk_offset.back(); }
+
+        /*
+         * Canonicalize, sort, compress, and store up to getChunkSize() integrals; may be
+         * called concurrently from several threads
+         */
+        void addChunk(const double* ints, const idx4_t* idxs, size_t n);
+
+        /*
+         * Finish writing; must be called before any chunk is read
+         */
+        void finalize();
+
+        void readChunk(size_t chunk, std::vector<double>& ints, std::vector<idx4_t>& idxs) const;
 
         void print(task::Printer& p) const;
 };
 
 class TwoElectronIntegralsTask : public task::Task
 {
+    protected:
+        double storage_cutoff;
+        double calc_cutoff;
+        bool balance_report;
+        bool validate_kernel;
+        bool disk;
+        size_t chunk_size;
+        std::string scratch_dir;
+
     public:
         TwoElectronIntegralsTask(const std::string& name, const input::Config& config);
 
         void run(task::TaskDAG& dag, const Arena& arena);
+
+        double getCostHint() const;
+
+        bool isRedistributable() const { return true; }
+
+        void redistribute(const Arena& world, int root, bool member);
 };
 
 }
@@ -40,7 +40,8 @@ CholeskyIntegrals<T>::CholeskyIntegrals(const Arena& arena, const Context& ctx,
   nvec(0),
   shells(molecule.getShellsBegin(),molecule.getShellsEnd()),
   delta(config.get<T>("delta")),
-  cond(config.get<T>("cond_max"))
+  cond(config.get<T>("cond_max")),
+  npivot(config.get<int>("pivot_blocks"))
 {
     nfunc = 0;
     for (int i = 0;i < shells.size();i++) nfunc += shells[i].getNFunc()*shells[i].getNContr();
@@ -57,91 +58,38 @@ CholeskyIntegrals<T>::~CholeskyIntegrals()
 }
 
 template <typename T>
-void CholeskyIntegrals<T>::test()
+T CholeskyIntegrals<T>::test()
 {
     const PointGroup& group = molecule.getGroup();
-    SymmetryBlockedTensor<T> LD("LD", this->arena, group, 3, vec(vec(nfunc),vec(nfunc),vec(rank)), vec(SY,NS,NS), false);
+    SymmetryBlockedTensor<T> LD("LD", this->arena, group, 3, vec(vec(nfunc),vec(nfunc),vec(nvec)), vec(SY,NS,NS), false);
     SymmetryBlockedTensor<T> ints("V", this->arena, group, 4, vec(vec(nfunc),vec(nfunc),vec(nfunc),vec(nfunc)), vec(NS,NS,NS,NS), false);
 
     LD["pqJ"] = (*L)["pqJ"]*(*D)["J"];
     ints["pqrs"] = (*L)["pqJ"]*LD["rsJ"];
 
-    //cout << "ints:" << endl;
-    //ints.print(stdout);
-    //cout << endl;
+    vector<vector<int> > idx = Shell::setupIndices(ctx, molecule);
 
     T err = 0;
-    for (int i = 0, m = 0;i < shells.size();i++)
+    int64_t nints = 0;
+    for (int i = 0;i < shells.size();i++)
     {
-        for (int j = 0, n = 0;j <= i;j++)
+        for (int j = 0;j <= i;j++)
         {
-            for (int k = 0, o = 0;k < shells.size();k++)
+            for (int k = 0;k < shells.size();k++)
             {
-                for (int l = 0, p = 0;l <= k;l++)
+                for (int l = 0;l <= k;l++)
                 {
-                    int ni = shells[i].getNFunc()*shells[i].getNContr();
-                    int nj = shells[j].getNFunc()*shells[j].getNContr();
-                    int nk = shells[k].getNFunc()*shells[k].getNContr();
-                    int nl = shells[l].getNFunc()*shells[l].getNContr();
-
-                    DenseTensor<T> local_ints("tmp", 4, vec(ni,nj,nk,nl));
-
-                    vector<tkv_pair<T> > pairs(ni*nj*nk*nl);
-
-                    for (int a = 0, q = 0;a < ni;a++)
-                    {
-                        for (int b = 0;b < nj;b++)
-                        {
-                            for (int c = 0;c < nk;c++)
-                            {
-                                for (int d = 0;d < nl;d++)
-                                {
-                                    pairs[q++].k = (((d+p)*nfunc+(c+o))*nfunc+(b+n))*nfunc+(a+m);
-                                }
-                            }
-                        }
-                    }
-
-                    if (rank == 0)
-                    {
-                        ints(0).getRemoteData(pairs);
-
-                        T* local_data = local_ints.getData();
-                        for (int q = 0;q < ni*nj*nk*nl;q++)
-                        {
-                            int d = pairs[q].k/(nfunc*nfunc*nfunc) - p;
-                            pairs[q].k -= (d+p)*nfunc*nfunc*nfunc;
-                            int c = pairs[q].k/(nfunc*nfunc) - o;
-                            pairs[q].k -= (c+o)*nfunc*nfunc;
-                            int b = pairs[q].k/(nfunc) - n;
-                            pairs[q].k -= (b+n)*nfunc;
-                            int a = pairs[q].k - m;
-
-                            local_data[((d*nk+c)*nj+b)*ni+a] = pairs[q].d;
-                        }
-
-                        //printf("%d %d %d %d\n", i, j, k, l);
-                        err += testBlock(local_ints, shells[i], shells[j], shells[k], shells[l]);
-                    }
-                    else
-                    {
-                        ints(0).getRemoteData();
-                    }
-
-                    p += shells[l].getNFunc()*shells[l].getNContr();
+                    err += testBlock(ints, shells[i], idx[i], shells[j], idx[j],
+                                           shells[k], idx[k], shells[l], idx[l], nints);
                 }
-                o += shells[k].getNFunc()*shells[k].getNContr();
             }
-            n += shells[j].getNFunc()*shells[j].getNContr();
         }
-        m += shells[i].getNFunc()*shells[i].getNContr();
     }
 
-    if (rank == 0)
-    {
-        err = sqrt(err / ndiag / ndiag);
-        printf("RMS error: %.15e\n\n", err);
-    }
+    if (rank == 0) err = sqrt(err/nints);
+    arena.Bcast(&err, 1, 0);
+
+    return err;
 }
 
 template <typename T>
@@ -191,81 +139,161 @@ void CholeskyIntegrals<T>::decompose()
     //    if (diag[l].elem < delta * delta / crit) diag[l].elem = 0;
     //}
 
+    /*
+     * Each step, the blocks holding the (up to) npivot largest unconverged diagonal elements
+     * are decomposed in turn, each after applying the rows of the blocks decomposed before
+     * it. Every rank offers its own npivot best blocks, so that all of the pivot blocks may
+     * come from the same rank even when there are fewer ranks than pivot blocks. While the
+     * new rows of one pivot block are being broadcast, every rank computes the integrals
+     * between that block and its own blocks, which are then applied to all of the local
+     * blocks at once at the end of the step.
+     */
     T* D = new T[ndiag];
-    T* tmp_block_data = new T[ndiag*max_block_size];
-    diag_elem_t* tmp_diag = new diag_elem_t[max_block_size];
-    for (nvec = 0;;)
+    T* tmp_block_data = new T[ndiag*max_block_size*npivot];
+    diag_elem_t* tmp_diag = new diag_elem_t[max_block_size*npivot];
+    vector<vector<T> > ints(npivot*nblock_local);
+    vector<pivot_t> local_pivots(nblock_local);
+    vector<pivot_t> pivots(npivot*nproc);
+    vector<int> seg_start(npivot+1);
+    vector<int> block_piv(nblock_local);
+    int64_t nstep = 0;
+    for (nvec = 0;;nstep++)
     {
-        int converged = 1;
-        T local_max = -2;
-        int max_block = 0;
         for (int block = 0;block < nblock_local;block++)
         {
-            T max_elem;
-            //printf("checking block: %d\n", block);
-            converged = isBlockConverged(diag+block_start[block], block_size[block], max_elem) && converged;
-            if (max_elem > local_max)
-            {
-                local_max = max_elem;
-                max_block = block;
-            }
+            isBlockConverged(diag+block_start[block], block_size[block], local_pivots[block].elem);
+            local_pivots[block].shelli = diag[block_start[block]].shelli;
+            local_pivots[block].shellj = diag[block_start[block]].shellj;
+            local_pivots[block].rank = rank;
+            local_pivots[block].block = block;
         }
 
-        //printf("max block: %d\n", max_block);
-        //printf("max elem: %e\n", local_max);
+        int nlocal = min(npivot, nblock_local);
+        partial_sort(local_pivots.begin(), local_pivots.begin()+nlocal, local_pivots.end());
+
+        vector<pivot_t> my_pivots(local_pivots.begin(), local_pivots.begin()+nlocal);
+        pivot_t none;
+        none.elem = -2;
+        none.shelli = 0;
+        none.shellj = 0;
+        none.rank = rank;
+        none.block = -1;
+        my_pivots.resize(npivot, none);
+
+        /*
+         * Every block is converged when no rank has an unconverged element left
+         */
+        arena.Allgather(my_pivots.data(), pivots.data(), npivot*sizeof(pivot_t), MPI::BYTE);
+        sort(pivots.begin(), pivots.end());
+        if (pivots[0].elem < 0) break;
+
+        int npiv = 0;
+        while (npiv < npivot && pivots[npiv].elem > 0 &&
+               pivots[npiv].elem >= pivots[0].elem/cond) npiv++;
+
+        /*
+         * Position of each local block among the pivot blocks of this step, or -1
+         */
+        fill(block_piv.begin(), block_piv.end(), -1);
+        for (int piv = 0;piv < npiv;piv++)
+            if (pivots[piv].rank == rank) block_piv[pivots[piv].block] = piv;
 
-        arena.Allreduce(&converged, 1, MPI::BAND);
-        if (converged) break;
-
-        T* maxes = new T[nproc];
-        arena.Allgather(&local_max, maxes, 1);
+        int old_rank = nvec;
+        seg_start[0] = 0;
 
-        int pmax = 0;
-        T global_max = 0;
-        for (int p = 0;p < nproc;p++)
+        for (int piv = 0;piv < npiv;piv++)
         {
-            if (maxes[p] > global_max)
+            int root = pivots[piv].rank;
+            int piv_block = pivots[piv].block;
+            int row = seg_start[piv];
+            int nactive;
+
+            if (root == rank)
             {
-                global_max = maxes[p];
-                pmax = p;
+                updateBlock(old_rank, block_size[piv_block], block_data[piv_block], diag+block_start[piv_block],
+                            0, piv, seg_start.data(), &ints[piv_block*npivot],
+                            tmp_block_data, tmp_diag, D);
+
+                decomposeBlock(block_size[piv_block], block_data[piv_block], D, diag+block_start[piv_block]);
+
+                nactive = collectActiveRows(block_size[piv_block], block_data[piv_block],
+                                            diag+block_start[piv_block],
+                                            tmp_block_data+row*ndiag, tmp_diag+row);
             }
-        }
 
-        delete[] maxes;
+            vector<MPI::Request> requests;
+            requests.push_back(arena.Ibcast(&nactive, 1, root));
 
-        int old_rank = nvec;
-        int nactive;
+            if (root == rank)
+            {
+                requests[0].Wait();
+                requests.push_back(arena.Ibcast(tmp_block_data+row*ndiag, nactive*ndiag, root));
+                requests.push_back(arena.Ibcast(tmp_diag+row, nactive*sizeof(diag_elem_t), root, MPI::BYTE));
+                requests.push_back(arena.Ibcast(D+nvec-nactive, nactive, root));
+            }
 
-        if (pmax == rank)
-        {
-            //cout << "Decomposing block " << rank+max_block*nproc << endl;
+            /*
+             * Overlap the broadcast with the integrals for the upcoming update
+             */
+            {
+                time::TraceScope trace("cholesky", "prefetch");
 
-            decomposeBlock(block_size[max_block], block_data[max_block], D, diag+block_start[max_block]);
+                const Shell& a = shells[pivots[piv].shelli];
+                const Shell& b = shells[pivots[piv].shellj];
 
-            nactive = collectActiveRows(block_size[max_block], block_data[max_block], diag+block_start[max_block],
-                                        tmp_block_data, tmp_diag);
-        }
+                #pragma omp parallel for schedule(dynamic)
+                for (int block = 0;block < nblock_local;block++)
+                {
+                    if (root == rank && block == piv_block)
+                    {
+                        ints[block*npivot+piv].clear();
+                        continue;
+                    }
+
+                    calcBlockIntegrals(a, b, block_size[block], diag+block_start[block], ints[block*npivot+piv]);
+                }
+            }
+
+            if (root != rank)
+            {
+                requests[0].Wait();
+                requests.push_back(arena.Ibcast(tmp_block_data+row*ndiag, nactive*ndiag, root));
+                requests.push_back(arena.Ibcast(tmp_diag+row, nactive*sizeof(diag_elem_t), root, MPI::BYTE));
+                requests.push_back(arena.Ibcast(D+nvec, nactive, root));
+                nvec += nactive;
+            }
+
+            {
+                time::TraceScope trace("mpi", "Ibcast");
+                MPI::Request::Waitall(requests.size(), requests.data());
+            }
 
-        arena.Bcast(&nvec, 1, pmax);
-        if (rank == old_rank) continue;
+            seg_start[piv+1] = row+nactive;
 
-        arena.Bcast(&nactive, 1, pmax);
-        arena.Bcast(tmp_block_data, nactive*ndiag, pmax);
-        arena.Bcast(tmp_diag, nactive*sizeof(diag_elem_t), pmax, MPI::BYTE);
-        arena.Bcast(D+old_rank, nvec-old_rank, pmax);
+            /*
+             * Only D*L is needed from here on
+             */
+            for (int r = row;r < seg_start[piv+1];r++)
+            {
+                for (int col = 0;col < old_rank+r;col++)
+                    tmp_block_data[r*ndiag+col] *= D[col];
+            }
+        }
 
-        for (int next_block = 0;next_block < nblock_local;next_block++)
+        for (int block = 0;block < nblock_local;block++)
         {
-            if (next_block == max_block && rank == pmax) continue;
+            int first_seg = block_piv[block]+1;
 
-            updateBlock(old_rank, block_size[next_block], block_data[next_block], diag+block_start[next_block],
-                                  nactive,                tmp_block_data,         tmp_diag,                     D);
+            updateBlock(old_rank, block_size[block], block_data[block], diag+block_start[block],
+                        first_seg, npiv, seg_start.data(), &ints[block*npivot],
+                        tmp_block_data, tmp_diag, D);
         }
     }
 
     assert(nvec > 0);
 
-    printf("rank: full, partial: %d %d\n\n", ndiag, nvec);
+    Logger::log(arena) << strprintf("Cholesky rank: full, partial: %d %d (%ld steps)",
+                                    ndiag, nvec, (long)nstep) << endl;
 
     for (int block = 0;block < nblock_local;block++)
         resortBlock(block_size[block], block_data[block], diag+block_start[block], tmp_block_data);
@@ -619,7 +647,7 @@ void CholeskyIntegrals<T>::decomposeBlock(int block_size, T* L_, T* D, diag_elem
 
         //printf("updating L[%d][%d] (out of %d %d, addr=0x%x)\n", rank, elem, ndiag, block_size, L_);
         L[elem][nvec] = 1.0;
-        D[rank] = diag[elem].elem;
+        D[nvec] = diag[elem].elem;
 
         #pragma omp parallel for schedule(dynamic) default(shared)
         for (int row = 0;row < block_size;row++)
@@ -641,12 +669,38 @@ void CholeskyIntegrals<T>::decomposeBlock(int block_size, T* L_, T* D, diag_elem
     }
 }
 
+template <typename T>
+void CholeskyIntegrals<T>::calcBlockIntegrals(const Shell& a, const Shell& b, int block_size, const diag_elem_t* diag,
+                                              vector<T>& ints)
+{
+    ints.clear();
+
+    bool found = false;
+    for (int elem = 0;elem < block_size;elem++)
+    {
+        if (diag[elem].status == TODO) found = true;
+    }
+
+    if (!found) return;
+
+    TwoElectronIntegrals eri(a, b, shells[diag[0].shelli], shells[diag[0].shellj], ERIEvaluator());
+    ints.assign(eri.getIntegrals(), eri.getIntegrals()+eri.getNumInts());
+}
+
 template <typename T>
 void CholeskyIntegrals<T>::updateBlock(int old_rank, int block_size_i, T* L_i_, diag_elem_t* diag_i,
-                                       int block_size_j, T* L_j_, diag_elem_t* diag_j, T* D)
+                                       int first_seg, int nseg, const int* seg_start, const vector<T>* ints,
+                                       const T* DL_j_, const diag_elem_t* diag_j, const T* D)
 {
     T (*L_i)[ndiag] = (T(*)[ndiag])L_i_;
-    T (*L_j)[ndiag] = (T(*)[ndiag])L_j_;
+    const T (*DL_j)[ndiag] = (const T(*)[ndiag])DL_j_;
+
+    int r0 = seg_start[first_seg];
+    int r1 = seg_start[nseg];
+    int nrow = r1-r0;
+    int c0 = old_rank+r0;
+
+    if (nrow == 0) return;
 
     bool found = false;
     for (int elem = 0;elem < block_size_i;elem++)
@@ -656,56 +710,87 @@ void CholeskyIntegrals<T>::updateBlock(int old_rank, int block_size_i, T* L_i_,
 
     if (!found) return;
 
-    //printf("subblock: %d %d\n", l, diag[l].nblock);
+    vector<size_t> controffii(nseg), funcoffii(nseg), controffij(nseg), funcoffij(nseg);
+    vector<size_t> controffji(nseg), funcoffji(nseg), controffjj(nseg), funcoffjj(nseg);
 
-    TwoElectronIntegrals eri(shells[diag_j[0].shelli], shells[diag_j[0].shellj],
-                             shells[diag_i[0].shelli], shells[diag_i[0].shellj], ERIEvaluator());
-    const T* intbuf = eri.getIntegrals();
+    for (int seg = first_seg;seg < nseg;seg++)
+    {
+        if (seg_start[seg] == seg_start[seg+1]) continue;
 
-    size_t controffii;
-    size_t funcoffii;
-    size_t controffij;
-    size_t funcoffij;
-    size_t controffji;
-    size_t funcoffji;
-    size_t controffjj;
-    size_t funcoffjj;
+        getShellOffsets(shells[diag_j[seg_start[seg]].shelli], shells[diag_j[seg_start[seg]].shellj],
+                        shells[diag_i[0].shelli], shells[diag_i[0].shellj],
+                        controffji[seg], funcoffji[seg], controffjj[seg], funcoffjj[seg],
+                        controffii[seg], funcoffii[seg], controffij[seg], funcoffij[seg]);
+    }
 
-    getShellOffsets(shells[diag_j[0].shelli], shells[diag_j[0].shellj],
-                    shells[diag_i[0].shelli], shells[diag_i[0].shellj],
-                    controffji, funcoffji, controffjj, funcoffjj,
-                    controffii, funcoffii, controffij, funcoffij);
+    /*
+     * The contribution of the vectors which this block already has, L_i[:][0:c0], is
+     * subtracted with one GEMM per chunk of rows, leaving only the triangular part among
+     * the new vectors
+     */
+    const int chunk = 32;
 
     #pragma omp parallel for schedule(dynamic) default(shared)
-    for (int elem_i = 0;elem_i < block_size_i;elem_i++)
+    for (int e0 = 0;e0 < block_size_i;e0 += chunk)
     {
-        if (diag_i[elem_i].status != TODO) continue;
+        int e1 = min(e0+chunk, block_size_i);
+
+        for (int elem_i = e0;elem_i < e1;elem_i++)
+        {
+            if (diag_i[elem_i].status != TODO) continue;
+
+            for (int seg = first_seg;seg < nseg;seg++)
+            {
+                const T* intbuf = ints[seg].data();
+
+                for (int elem_j = seg_start[seg];elem_j < seg_start[seg+1];elem_j++)
+                {
+                    L_i[elem_i][old_rank+elem_j] =
+                        intbuf[diag_j[elem_j].contri*controffji[seg]+diag_j[elem_j].funci*funcoffji[seg]+
+                               diag_j[elem_j].contrj*controffjj[seg]+diag_j[elem_j].funcj*funcoffjj[seg]+
+                               diag_i[elem_i].contri*controffii[seg]+diag_i[elem_i].funci*funcoffii[seg]+
+                               diag_i[elem_i].contrj*controffij[seg]+diag_i[elem_i].funcj*funcoffij[seg]];
+                }
+            }
+        }
+
+        if (c0 > 0)
+        {
+            gemm('T', 'N', nrow, e1-e0, c0, -1.0, DL_j[r0], ndiag,
+                                                  L_i[e0], ndiag,
+                                             1.0, L_i[e0]+c0, ndiag);
+        }
 
-        int cur_rank = old_rank;
-        for (int elem_j = 0;elem_j < block_size_j;elem_j++)
+        for (int elem_i = e0;elem_i < e1;elem_i++)
         {
-            //printf("updating L[%d][%d]\n", cur_rank, elem_i);
-            L_i[elem_i][cur_rank] = intbuf[diag_j[elem_j].contri*controffji+diag_j[elem_j].funci*funcoffji+
-                                           diag_j[elem_j].contrj*controffjj+diag_j[elem_j].funcj*funcoffjj+
-                                           diag_i[elem_i].contri*controffii+diag_i[elem_i].funci*funcoffii+
-                                           diag_i[elem_i].contrj*controffij+diag_i[elem_i].funcj*funcoffij];
-            for (int col = 0;col < cur_rank;col++)
-                L_i[elem_i][cur_rank] -= D[col] * L_i[elem_i][col] * L_j[cur_rank-old_rank][col];
-            L_i[elem_i][cur_rank] /= D[cur_rank];
-            diag_i[elem_i].elem -= D[cur_rank] * L_i[elem_i][cur_rank] * L_i[elem_i][cur_rank];
-
-            cur_rank++;
+            if (diag_i[elem_i].status != TODO)
+            {
+                fill(L_i[elem_i]+c0, L_i[elem_i]+c0+nrow, 0.0);
+                continue;
+            }
+
+            for (int cur_rank = c0;cur_rank < c0+nrow;cur_rank++)
+            {
+                for (int col = c0;col < cur_rank;col++)
+                    L_i[elem_i][cur_rank] -= L_i[elem_i][col] * DL_j[cur_rank-old_rank][col];
+                L_i[elem_i][cur_rank] /= D[cur_rank];
+                diag_i[elem_i].elem -= D[cur_rank] * L_i[elem_i][cur_rank] * L_i[elem_i][cur_rank];
+            }
         }
     }
 }
 
 template <typename T>
-T CholeskyIntegrals<T>::testBlock(const DenseTensor<T>& block, const Shell& a, const Shell& b, const Shell& c, const Shell& d)
+T CholeskyIntegrals<T>::testBlock(SymmetryBlockedTensor<T>& ints,
+                                  const Shell& a, const vector<int>& idxa, const Shell& b, const vector<int>& idxb,
+                                  const Shell& c, const vector<int>& idxc, const Shell& d, const vector<int>& idxd,
+                                  int64_t& nints)
 {
-    DenseTensor<T> packed("tmp", 4, block.getLengths(), false);
-    const T* ints = packed.getData();
-
-    packed = block;
+    if (rank != 0)
+    {
+        ints(0).getRemoteData();
+        return 0;
+    }
 
     TwoElectronIntegrals eri(a, b, c, d, ERIEvaluator());
     const T* intbuf = eri.getIntegrals();
@@ -723,8 +808,11 @@ T CholeskyIntegrals<T>::testBlock(const DenseTensor<T>& block, const Shell& a, c
                     controffa, funcoffa, controffb, funcoffb,
                     controffc, funcoffc, controffd, funcoffd);
 
-    double err = 0;
-    int q = 0;
+    /*
+     * The reconstructed integrals may not come back in the order they were asked
+     * for, so sort both lists by key before comparing them
+     */
+    vector<tkv_pair<T> > exact;
     for (int l = 0;l < d.getNFunc();l++)
     {
         for (int p = 0;p < d.getNContr();p++)
@@ -741,34 +829,16 @@ T CholeskyIntegrals<T>::testBlock(const DenseTensor<T>& block, const Shell& a, c
                             {
                                 for (int m = 0;m < a.getNContr();m++)
                                 {
-                                    //if ((&a == &b && (j > i || (j == i && n > m))) ||
-                                    //    (&c == &d && (l > k || (l == k && p > o))))
-                                    //{
-                                    //    q++;
-                                    //    continue;
-                                    //}
-
-                                    err += pow(ints[q] - intbuf[m*controffa+i*funcoffa+
-                                                                n*controffb+j*funcoffb+
-                                                                o*controffc+k*funcoffc+
-                                                                p*controffd+l*funcoffd], 2);
-
-                                    if (fabs(ints[q] - intbuf[m*controffa+i*funcoffa+
-                                                              n*controffb+j*funcoffb+
-                                                              o*controffc+k*funcoffc+
-                                                              p*controffd+l*funcoffd]) > 1e-10)
-                                    {
-                                    ///*
-                                    printf("%d %d %d %d %d %d %d %d: %.12f %.12f\n",
-                                           i, j, k, l, m, n, o, p, ints[q],
-                                           intbuf[m*controffa+i*funcoffa+
-                                                  n*controffb+j*funcoffb+
-                                                  o*controffc+k*funcoffc+
-                                                  p*controffd+l*funcoffd]);
-                                    //*/
-                                    }
-
-                                    q++;
+                                    key ijkl = ((key)d.getIndex(ctx, idxd, l, p, 0)*nfunc+
+                                                     c.getIndex(ctx, idxc, k, o, 0))*nfunc;
+                                    ijkl = ((ijkl+b.getIndex(ctx, idxb, j, n, 0))*nfunc+
+                                                  a.getIndex(ctx, idxa, i, m, 0));
+
+                                    exact.push_back(tkv_pair<T>(ijkl,
+                                        intbuf[m*controffa+i*funcoffa+
+                                               n*controffb+j*funcoffb+
+                                               o*controffc+k*funcoffc+
+                                               p*controffd+l*funcoffd]));
                                 }
                             }
                         }
@@ -778,7 +848,49 @@ T CholeskyIntegrals<T>::testBlock(const DenseTensor<T>& block, const Shell& a, c
         }
     }
 
+    vector<tkv_pair<T> > approx(exact);
+    ints(0).getRemoteData(approx);
+
+    sort(exact.begin(), exact.end());
+    sort(approx.begin(), approx.end());
+
+    T err = 0;
+    for (size_t q = 0;q < exact.size();q++)
+    {
+        err += (approx[q].d-exact[q].d)*(approx[q].d-exact[q].d);
+    }
+
+    nints += exact.size();
+
     return err;
 }
 
+CholeskyIntegralsTask::CholeskyIntegralsTask(const string& name, const Config& config)
+: Task("cholesky", name), config(config)
+{
+    vector<Requirement> reqs;
+    reqs.push_back(Requirement("molecule", "molecule"));
+    addProduct(Product("cholesky", "cholesky", reqs));
+    if (config.get<bool>("test")) addProduct(Product("double", "error", reqs));
+}
+
+void CholeskyIntegralsTask::run(TaskDAG& dag, const Arena& arena)
+{
+    const Molecule& molecule = get<Molecule>("molecule");
+
+    if (molecule.getGroup().getNumIrreps() != 1)
+        throw runtime_error("Cholesky decomposition requires C1 symmetry (use subgroup C1)");
+
+    CholeskyIntegrals<double>* chol = new CholeskyIntegrals<double>(arena, Context(Context::ISCF), config, molecule);
+    put("cholesky", chol);
+
+    if (config.get<bool>("test"))
+    {
+        double err = chol->test();
+        Logger::log(arena) << strprintf("Cholesky RMS error: %.15e", err) << endl;
+        put("error", new Scalar(arena, err));
+    }
+}
+
 INSTANTIATE_SPECIALIZATIONS(CholeskyIntegrals);
+REGISTER_TASK(CholeskyIntegralsTask,"cholesky");
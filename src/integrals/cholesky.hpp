@@ -65,12 +65,33 @@ class CholeskyIntegrals : public task::Resource
                 return elem < other.elem;
             }
         };
+        /*
+         * largest unconverged diagonal element of a block, the shell pair of the block,
+         * and the rank and local index of the block on that rank
+         */
+        struct pivot_t
+        {
+            T elem;
+            int shelli;
+            int shellj;
+            int rank;
+            int block;
 
-        const Context& ctx;
+            /*
+             * Sort the largest elements first
+             */
+            bool operator<(const pivot_t& other) const
+            {
+                return elem > other.elem;
+            }
+        };
+
+        Context ctx;
         int nvec;
         std::vector<Shell> shells;
         T delta;
         T cond;
+        int npivot;
         tensor::SymmetryBlockedTensor<T>* L;
         tensor::SymmetryBlockedTensor<T>* D;
         int ndiag;
@@ -82,7 +103,11 @@ class CholeskyIntegrals : public task::Resource
 
         ~CholeskyIntegrals();
 
-        void test();
+        /*
+         * RMS difference between the integrals rebuilt from L and D and the exact
+         * integrals, over all shell quartets; this is expensive (O(N^4) memory)
+         */
+        T test();
 
         int getRank() const { return nvec; }
 
@@ -123,26 +148,63 @@ class CholeskyIntegrals : public task::Resource
         void decomposeBlock(int block_size, T* L_, T* D, diag_elem_t* diag);
 
         /*
-         * update a block of Cholesky vectors
+         * compute the integrals (ab|cd) between the pivot shell pair ab and the shell pair cd of a block,
+         * if the block still has rows to update
          *
-         * rank             - first rank to update
-         * rank             - rank after update
+         * a, b             - shells of the pivot block
+         * block_size       - size of the block
+         * diag             - diagonal elements of the residual matrix for the block, dimensions diag[block_size]
+         * ints             - the integrals, empty if the block has no rows left to update
+         */
+        void calcBlockIntegrals(const Shell& a, const Shell& b, int block_size, const diag_elem_t* diag,
+                                std::vector<T>& ints);
+
+        /*
+         * update a block of Cholesky vectors with the rows of one or more pivot blocks
+         *
+         * old_rank         - rank before the first pivot block of this step
          * block_size_i     - size of the block of Cholesky vectors to update
-         * L_i              - Cholesky vectors to update, dimensions L_i[block_size_i][rank]
+         * L_i              - Cholesky vectors to update, dimensions L_i[block_size_i][>rank]
          * diag_i           - diagonal elements of the residual matrix and other accounting information
          *                    for the block to be updated, dimensions diag_i[block_size_i]
-         * block_size_j     - size of the block containing the rows leading to this update
-         * L_j              - Cholesky vectors for the rows leading to the update, dimensions L_j[rank-rank][rank]
-         *                    (only those vectors actually needed, and not the entire block)
-         * diag_j           - diagonal elements of the residual matrix for the block leading to the update,
-         *                    dimensions diag_j[block_size_j] (the full block)
+         * first_seg        - first pivot block to apply, all previous ones must already have been applied
+         * nseg             - number of pivot blocks in this step
+         * seg_start        - first row of each pivot block in L_j and diag_j, dimensions seg_start[nseg+1]
+         * ints             - integrals between each pivot block and this block (see calcBlockIntegrals),
+         *                    dimensions ints[nseg]
+         * DL_j             - Cholesky vectors for the rows leading to the update, scaled by D, dimensions
+         *                    DL_j[seg_start[nseg]][>rank] (only the rows of the pivot blocks which were
+         *                    actually used, and not the entire blocks)
+         * diag_j           - accounting information for the rows in DL_j, dimensions diag_j[seg_start[nseg]]
          * D                - the diagonal factor of the decomposition, dimensions D[rank]
          */
         void updateBlock(int old_rank, int block_size_i, T* L_i_, diag_elem_t* diag_i,
-                         int block_size_j, T* L_j_, diag_elem_t* diag_j, T* D);
+                         int first_seg, int nseg, const int* seg_start, const std::vector<T>* ints,
+                         const T* DL_j_, const diag_elem_t* diag_j, const T* D);
+
+        /*
+         * sum of the squared errors of the rebuilt integrals ints for one shell quartet; must be
+         * called on every rank, but only rank 0 does the comparison and adds to nints
+         */
+        T testBlock(tensor::SymmetryBlockedTensor<T>& ints,
+                    const Shell& a, const std::vector<int>& idxa, const Shell& b, const std::vector<int>& idxb,
+                    const Shell& c, const std::vector<int>& idxc, const Shell& d, const std::vector<int>& idxd,
+                    int64_t& nints);
+};
+
+/*
+ * The Cholesky vectors are stored with a single irrep, so the molecule must be run
+ * in C1 (subgroup C1)
+ */
+class CholeskyIntegralsTask : public task::Task
+{
+    protected:
+        input::Config config;
+
+    public:
+        CholeskyIntegralsTask(const std::string& name, const input::Config& config);
 
-        T testBlock(const tensor::DenseTensor<T>& block, const Shell& a, const Shell& b,
-                                                         const Shell& c, const Shell& d);
+        void run(task::TaskDAG& dag, const Arena& arena);
 };
 
 }
@@ -0,0 +1,396 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+#include "df.hpp"
+
+#include "input/basis.hpp"
+
+#include "screening.hpp"
+
+using namespace std;
+using namespace aquarius;
+using namespace aquarius::tensor;
+using namespace aquarius::input;
+using namespace aquarius::integrals;
+using namespace aquarius::task;
+using namespace aquarius::symmetry;
+
+template <typename T>
+DensityFittedIntegrals<T>::DensityFittedIntegrals(const Arena& arena, const Config& config, const Molecule& molecule)
+: Resource(arena),
+  molecule(molecule),
+  shells(molecule.getShellsBegin(), molecule.getShellsEnd()),
+  cutoff(config.get<double>("cutoff")),
+  metric_cutoff(config.get<double>("metric_cutoff")),
+  B(NULL)
+{
+    const PointGroup& group = molecule.getGroup();
+    int nirrep = group.getNumIrreps();
+
+    const vector<int>& norb = molecule.getNumOrbitals();
+
+    /*
+     * Use the same kind of functions (cartesian or spherical) as the orbital basis
+     */
+    bool spherical = shells.empty() || shells[0].isSpherical();
+
+    BasisSet basis(TOPDIR "/basis/" + config.get<string>("basis_set"));
+
+    for (vector<Atom>::const_iterator a = molecule.getAtomsBegin();a != molecule.getAtomsEnd();++a)
+    {
+        Atom aux(a->getCenter());
+        basis.apply(aux, spherical, false);
+        auxshells.insert(auxshells.end(), aux.getShellsBegin(), aux.getShellsEnd());
+    }
+
+    naux.resize(nirrep, 0);
+    for (vector<Shell>::const_iterator s = auxshells.begin();s != auxshells.end();++s)
+    {
+        for (int i = 0;i < nirrep;i++) naux[i] += s->getNFuncInIrrep(i)*s->getNContr();
+    }
+
+    if (sum(norb) > UINT16_MAX || sum(naux) > UINT16_MAX)
+        throw runtime_error("Too many basis functions for density fitting");
+
+    Context ctx(Context::ISCF);
+
+    /*
+     * The orderings are generated lazily, so fill them in before going parallel
+     */
+    int Lmax = 0;
+    for (int a = 0;a < shells.size();++a) Lmax = max(Lmax, shells[a].getL());
+    for (int a = 0;a < auxshells.size();++a) Lmax = max(Lmax, auxshells[a].getL());
+    ctx.getCartesianOrdering(Lmax);
+    ctx.getSphericalOrdering(Lmax);
+
+    vector<vector<T> > Jmhalf;
+    vector<double> Qaux;
+    calcMetric(ctx, Jmhalf, Qaux);
+
+    SymmetryBlockedTensor<T> ints("(pq|P)", arena, group, 3, vec(norb,norb,naux), vec(NS,NS,NS), true);
+    calcThreeCenter(ctx, Qaux, ints);
+
+    SymmetryBlockedTensor<T> J("J^-1/2", arena, group, 2, vec(naux,nfit), vec(NS,NS), true);
+
+    for (int i = 0;i < nirrep;i++)
+    {
+        if (naux[i] == 0 || nfit[i] == 0) continue;
+
+        vector<int> irreps(2,i);
+
+        if (arena.rank == 0)
+        {
+            vector< tkv_pair<T> > pairs(naux[i]*nfit[i]);
+
+            for (int j = 0;j < naux[i]*nfit[i];j++)
+            {
+                pairs[j].k = j;
+                pairs[j].d = Jmhalf[i][j];
+            }
+
+            J.writeRemoteData(irreps, pairs);
+        }
+        else
+        {
+            J.writeRemoteData(irreps);
+        }
+    }
+
+    B = new SymmetryBlockedTensor<T>("B", arena, group, 3, vec(norb,norb,nfit), vec(NS,NS,NS), false);
+    (*B)["pqQ"] = ints["pqP"]*J["PQ"];
+}
+
+template <typename T>
+DensityFittedIntegrals<T>::~DensityFittedIntegrals()
+{
+    delete B;
+}
+
+template <typename T>
+void DensityFittedIntegrals<T>::calcMetric(const Context& ctx, vector<vector<T> >& Jmhalf, vector<double>& Qaux)
+{
+    const PointGroup& group = molecule.getGroup();
+    int nirrep = group.getNumIrreps();
+
+    vector<int> irrep;
+    for (int i = 0;i < nirrep;i++) irrep += vector<int>(naux[i],i);
+
+    vector<int> start(nirrep,0);
+    for (int i = 1;i < nirrep;i++) start[i] = start[i-1]+naux[i-1];
+
+    vector<vector<int> > idx = Shell::setupIndices(ctx, auxshells);
+
+    vector<Shell> unit(1, Shell::unit(Center(group, vec3(0,0,0), Element::getElement("X"))));
+    vector<int> idxunit = Shell::setupIndices(ctx, unit)[0];
+
+    int nshell = auxshells.size();
+    Qaux.assign(nshell, 0.0);
+
+    vector<vector<tkv_pair<T> > > pairs(nirrep);
+
+    /*
+     * (P1|Q1) = (P|Q) for the unique shell pairs P >= Q assigned to this rank
+     */
+    #pragma omp parallel
+    {
+        vector<double> tmpval(TMP_BUFSIZE);
+        vector<idx4_t> tmpidx(TMP_BUFSIZE);
+        vector<vector<tkv_pair<T> > > local(nirrep);
+
+        #pragma omp for schedule(dynamic)
+        for (int P = 0;P < nshell;P++)
+        {
+            for (int Q = 0;Q <= P;Q++)
+            {
+                if ((P*(P+1)/2+Q)%arena.nproc != arena.rank) continue;
+
+                TwoElectronIntegrals PQ(auxshells[P], unit[0], auxshells[Q], unit[0], ERIEvaluator());
+
+                size_t n;
+                while ((n = PQ.process(ctx, idx[P], idxunit, idx[Q], idxunit, TMP_BUFSIZE,
+                                       tmpval.data(), tmpidx.data())) != 0)
+                {
+                    for (size_t m = 0;m < n;m++)
+                    {
+                        int irr = irrep[tmpidx[m].i];
+                        int i = tmpidx[m].i-start[irr];
+                        int k = tmpidx[m].k-start[irr];
+
+                        local[irr].push_back(tkv_pair<T>(i+k*naux[irr], tmpval[m]));
+                        if (i != k) local[irr].push_back(tkv_pair<T>(k+i*naux[irr], tmpval[m]));
+
+                        if (P == Q && i == k) Qaux[P] = max(Qaux[P], abs(tmpval[m]));
+                    }
+                }
+            }
+        }
+
+        #pragma omp critical
+        {
+            for (int i = 0;i < nirrep;i++) pairs[i].insert(pairs[i].end(), local[i].begin(), local[i].end());
+        }
+    }
+
+    arena.Allreduce(Qaux.data(), nshell, MPI::MAX);
+    for (int P = 0;P < nshell;P++) Qaux[P] = sqrt(Qaux[P]);
+
+    SymmetryBlockedTensor<T> J("J", arena, group, 2, vec(naux,naux), vec(NS,NS), true);
+
+    for (int i = 0;i < nirrep;i++)
+    {
+        if (naux[i] > 0) J.writeRemoteData(vec(i,i), pairs[i]);
+    }
+
+    /*
+     * J^-1/2 = V w^-1/2 over the eigenvectors V of J with eigenvalues w above the cutoff
+     */
+    Jmhalf.resize(nirrep);
+    nfit.assign(nirrep, 0);
+    int info = 0;
+
+    for (int i = 0;i < nirrep;i++)
+    {
+        if (naux[i] == 0) continue;
+
+        vector<int> irreps(2,i);
+
+        if (arena.rank == 0)
+        {
+            int n = naux[i];
+            vector<T> vals;
+            vector<typename real_type<T>::type> w(n);
+
+            J.getAllData(irreps, vals, 0);
+            assert(vals.size() == n*n);
+
+            /*
+             * The other ranks are still in the collectives below, so a failure
+             * is only reported once all irreps have been gone through
+             */
+            PROFILE_FLOPS(9*n*n*n);
+            int err = heev('V', 'U', n, vals.data(), n, w.data());
+            if (err != 0)
+            {
+                if (info == 0) info = err;
+                continue;
+            }
+
+            int first = 0;
+            while (first < n && w[first] <= metric_cutoff*w[n-1]) first++;
+            nfit[i] = n-first;
+
+            Jmhalf[i].resize(n*nfit[i]);
+            for (int j = first;j < n;j++)
+            {
+                for (int k = 0;k < n;k++)
+                {
+                    Jmhalf[i][k+(j-first)*n] = vals[k+j*n]/sqrt(w[j]);
+                }
+            }
+        }
+        else
+        {
+            J.getAllData(irreps, 0);
+        }
+    }
+
+    arena.Bcast(&info, 1, 0);
+    if (info != 0) throw runtime_error(strprintf("DF: Info in heev: %d", info));
+
+    arena.Bcast(nfit, 0);
+}
+
+template <typename T>
+void DensityFittedIntegrals<T>::calcThreeCenter(const Context& ctx, const vector<double>& Qaux,
+                                                SymmetryBlockedTensor<T>& ints)
+{
+    const PointGroup& group = molecule.getGroup();
+    int nirrep = group.getNumIrreps();
+
+    const vector<int>& norb = molecule.getNumOrbitals();
+
+    vector<int> irrep, irrepaux;
+    for (int i = 0;i < nirrep;i++) irrep += vector<int>(norb[i],i);
+    for (int i = 0;i < nirrep;i++) irrepaux += vector<int>(naux[i],i);
+
+    vector<int> start(nirrep,0), startaux(nirrep,0);
+    for (int i = 1;i < nirrep;i++) start[i] = start[i-1]+norb[i-1];
+    for (int i = 1;i < nirrep;i++) startaux[i] = startaux[i-1]+naux[i-1];
+
+    vector<vector<int> > idx = Shell::setupIndices(ctx, shells);
+    vector<vector<int> > idxaux = Shell::setupIndices(ctx, auxshells);
+
+    vector<Shell> unit(1, Shell::unit(Center(group, vec3(0,0,0), Element::getElement("X"))));
+    vector<int> idxunit = Shell::setupIndices(ctx, unit)[0];
+
+    SchwarzScreening screen(arena, shells, ERIEvaluator());
+
+    int nshell = shells.size();
+    int nauxshell = auxshells.size();
+    int64_t nscreened = 0;
+
+    /*
+     * Integrals for each irrep block ijk of (pq|P), keyed by i+j*nirrep+k*nirrep^2
+     */
+    vector<vector<tkv_pair<T> > > pairs(nirrep*nirrep*nirrep);
+
+    #pragma omp parallel reduction(+:nscreened)
+    {
+        vector<double> tmpval(TMP_BUFSIZE);
+        vector<idx4_t> tmpidx(TMP_BUFSIZE);
+        vector<vector<tkv_pair<T> > > local(nirrep*nirrep*nirrep);
+
+        #pragma omp for schedule(dynamic)
+        for (int a = 0;a < nshell;a++)
+        {
+            for (int b = 0;b <= a;b++)
+            {
+                if ((a*(a+1)/2+b)%arena.nproc != arena.rank) continue;
+
+                for (int P = 0;P < nauxshell;P++)
+                {
+                    if (screen.getBound(a,b)*Qaux[P] < cutoff)
+                    {
+                        nscreened++;
+                        continue;
+                    }
+
+                    TwoElectronIntegrals abP(shells[a], shells[b], auxshells[P], unit[0], ERIEvaluator());
+
+                    size_t n;
+                    while ((n = abP.process(ctx, idx[a], idx[b], idxaux[P], idxunit, TMP_BUFSIZE,
+                                            tmpval.data(), tmpidx.data())) != 0)
+                    {
+                        for (size_t m = 0;m < n;m++)
+                        {
+                            int irri = irrep[tmpidx[m].i];
+                            int irrj = irrep[tmpidx[m].j];
+                            int irrk = irrepaux[tmpidx[m].k];
+                            int i = tmpidx[m].i-start[irri];
+                            int j = tmpidx[m].j-start[irrj];
+                            int k = tmpidx[m].k-startaux[irrk];
+
+                            local[irri+(irrj+irrk*nirrep)*nirrep].push_back(
+                                tkv_pair<T>(i+(j+k*norb[irrj])*norb[irri], tmpval[m]));
+
+                            if (irri != irrj || i != j)
+                            {
+                                local[irrj+(irri+irrk*nirrep)*nirrep].push_back(
+                                    tkv_pair<T>(j+(i+k*norb[irri])*norb[irrj], tmpval[m]));
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        #pragma omp critical
+        {
+            for (int b = 0;b < nirrep*nirrep*nirrep;b++)
+            {
+                pairs[b].insert(pairs[b].end(), local[b].begin(), local[b].end());
+            }
+        }
+    }
+
+    for (int k = 0;k < nirrep;k++)
+    {
+        for (int j = 0;j < nirrep;j++)
+        {
+            for (int i = 0;i < nirrep;i++)
+            {
+                vector<int> irreps = vec(i,j,k);
+                if (ints.exists(irreps)) ints.writeRemoteData(irreps, pairs[i+(j+k*nirrep)*nirrep]);
+            }
+        }
+    }
+
+    int64_t ntriple = (int64_t)nshell*(nshell+1)/2*nauxshell;
+    arena.Allreduce(&nscreened, 1, MPI::SUM);
+
+    Logger::log(arena) << strprintf("%ld of %ld shell triples screened out", (long)nscreened, (long)ntriple) << endl;
+}
+
+DensityFittedIntegralsTask::DensityFittedIntegralsTask(const string& name, const Config& config)
+: Task("dfints", name), config(config)
+{
+    vector<Requirement> reqs;
+    reqs.push_back(Requirement("molecule", "molecule"));
+    addProduct(Product("df", "B", reqs));
+}
+
+void DensityFittedIntegralsTask::run(TaskDAG& dag, const Arena& arena)
+{
+    const Molecule& molecule = get<Molecule>("molecule");
+
+    DensityFittedIntegrals<double>* df = new DensityFittedIntegrals<double>(arena, config, molecule);
+
+    log(arena) << strprintf("%d auxiliary functions, %d fitting vectors",
+                            sum(df->getNumAuxiliary()), sum(df->getNumFitting())) << endl;
+
+    put("B", df);
+}
+
+INSTANTIATE_SPECIALIZATIONS(DensityFittedIntegrals);
+REGISTER_TASK(DensityFittedIntegralsTask,"dfints");
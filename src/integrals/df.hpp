@@ -0,0 +1,112 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+#ifndef _AQUARIUS_INTEGRALS_DF_HPP_
+#define _AQUARIUS_INTEGRALS_DF_HPP_
+
+#include "2eints.hpp"
+
+#include "tensor/symblocked_tensor.hpp"
+#include "input/molecule.hpp"
+#include "input/config.hpp"
+#include "util/util.h"
+#include "util/blas.h"
+#include "util/lapack.h"
+#include "task/task.hpp"
+
+namespace aquarius
+{
+namespace integrals
+{
+
+/*
+ * Density-fitted (resolution of the identity) two-electron integrals,
+ *
+ *   (pq|rs) ~= B[pqQ]*B[rsQ], B[pqQ] = (pq|P)*J^-1/2[PQ], J[PQ] = (P|Q),
+ *
+ * with an auxiliary basis set placed on the same atoms as the orbital basis. Eigenvectors
+ * of the metric J with eigenvalues below metric_cutoff are dropped, so the number of
+ * fitting functions in B may be less than the size of the auxiliary basis.
+ */
+template <typename T>
+class DensityFittedIntegrals : public task::Resource
+{
+    public:
+        const input::Molecule& molecule;
+
+    protected:
+        std::vector<Shell> shells;
+        std::vector<Shell> auxshells;
+        std::vector<int> naux;
+        std::vector<int> nfit;
+        double cutoff;
+        double metric_cutoff;
+        tensor::SymmetryBlockedTensor<T>* B;
+
+    public:
+        DensityFittedIntegrals(const Arena& arena, const input::Config& config, const input::Molecule& molecule);
+
+        ~DensityFittedIntegrals();
+
+        /*
+         * Number of auxiliary functions in each irrep
+         */
+        const std::vector<int>& getNumAuxiliary() const { return naux; }
+
+        /*
+         * Number of fitting vectors in each irrep (the last index of B)
+         */
+        const std::vector<int>& getNumFitting() const { return nfit; }
+
+        const tensor::SymmetryBlockedTensor<T>& getB() const { return *B; }
+
+    protected:
+        /*
+         * Form J^-1/2 (as naux x nfit matrices), and the Schwarz factors
+         * max |(P|P)|^(1/2) for each auxiliary shell
+         */
+        void calcMetric(const Context& ctx, std::vector<std::vector<T> >& Jmhalf, std::vector<double>& Qaux);
+
+        /*
+         * Compute the integrals (pq|P) for the shell pairs ab assigned to this rank
+         */
+        void calcThreeCenter(const Context& ctx, const std::vector<double>& Qaux,
+                             tensor::SymmetryBlockedTensor<T>& ints);
+};
+
+class DensityFittedIntegralsTask : public task::Task
+{
+    protected:
+        input::Config config;
+
+    public:
+        DensityFittedIntegralsTask(const std::string& name, const input::Config& config);
+
+        void run(task::TaskDAG& dag, const Arena& arena);
+};
+
+}
+}
+
+#endif
@@ -25,15 +25,24 @@
 #include "internal.h"
 
 #include <stdbool.h>
+#include <pthread.h>
 
 #define TAYLOR_N 8
+#define FM_NORDER 40
+#define FM_NGRID 2281
+#define FM_DELTA 20.0
+#define FM_BLOCK 64
 
 const static int TMAX[40] = { 33, 37, 40, 43, 46, 49, 51, 53, 56, 58,
                               60, 62, 64, 66, 68, 70, 72, 74, 76, 78,
                               80, 82, 83, 85, 87, 89, 90, 92, 94, 96,
                               97, 99, 101, 102, 104, 106, 108, 110, 112, 114 };
 
-static double FMTABLE[2281][40];
+static double FMTABLE[FM_NGRID][FM_NORDER];
+
+static pthread_once_t fmtable_once = PTHREAD_ONCE_INIT;
+
+static double fmseries(double T, int m);
 
 /**
  * Compute \f$F_m(T)\f$
@@ -43,20 +52,26 @@ static double FMTABLE[2281][40];
  */
 double fm(double T, int m)
 {
-    const double epsilon = 1e-15;
-
-    double sum, delt, ap;
-
     PROFILE_FLOPS(1);
-    ap = m + 0.5;
 
     if (T <= 0)
     {
         PROFILE_FLOPS(DIV_FLOPS);
-        return 0.5 / ap;
+        return 0.5 / (m + 0.5);
     }
 
-    if (T > TMAX[m]) return fmasymptotic(T, m);
+    if (m < FM_NORDER && T > TMAX[m]) return fmasymptotic(T, m);
+
+    return fmseries(T, m);
+}
+
+static double fmseries(double T, int m)
+{
+    const double epsilon = 1e-15;
+
+    double sum, delt, ap;
+
+    ap = m + 0.5;
 
     PROFILE_FLOPS(2+EXP_FLOPS+DIV_FLOPS);
     sum = 1.0 / (2 * ap * exp(T));
@@ -82,10 +97,12 @@ double fmtaylor(double T, int n)
     int tidx;
     double tr, trmt;
 
+    pthread_once(&fmtable_once, calcfmtable);
+
     PROFILE_FLOPS((TAYLOR_N+1)*(3+DIV_FLOPS));
 
-    tidx = (int)round(T * 20.0);
-    tr = (double)tidx / 20.0;
+    tidx = (int)round(T * FM_DELTA);
+    tr = (double)tidx / FM_DELTA;
     trmt = tr - T;
 
     ans = 0.0;
@@ -118,39 +135,95 @@ double fmasymptotic(double T, int m)
 
 void fmrecursive(double T, int n, double* array)
 {
-    int i;
-    double emt;
+    fmvec(1, &T, n, array, 1);
+}
 
-    if (T > TMAX[n])
-    {
-        array[n] = fmasymptotic(T, n);
-    }
-    else
-    {
-        array[n] = fmtaylor(T, n);
-    }
+/**
+ * Compute \f$F_m(T_i)\f$ for all \f$0 \le m \le m_{max}\f$ and \f$0 \le i < n\f$,
+ * storing \f$F_m(T_i)\f$ in F[m*ldf+i].
+ *
+ * \f$F_{m_{max}}\f$ is interpolated from the table by a Taylor expansion about
+ * the nearest grid point (\f$|\Delta T| \le 0.025\f$, \f$dF_m/dT = -F_{m+1}\f$),
+ * or from the asymptotic form for large T, and the lower orders are generated
+ * by the (stable) downward recursion
+ *
+ * \f$F_{m-1}(T) = \frac{2T F_m(T) + e^{-T}}{2m-1}\f$
+ *
+ * Each T is independent, and the recursion runs over unit-stride blocks of
+ * T so that it vectorizes. Orders beyond the table fall back to the series.
+ */
+void fmvec(int n, const double* restrict T, int mmax, double* restrict F, int ldf)
+{
+    const double PI = 3.1415926535897932384626433832795;
 
-    if (n == 0) return;
+    double emt[FM_BLOCK], twot[FM_BLOCK];
 
-    emt = exp(-T);
+    pthread_once(&fmtable_once, calcfmtable);
 
-    for (i = n;i > 0;i--)
+    for (int i0 = 0;i0 < n;i0 += FM_BLOCK)
     {
-        array[i - 1] = (2 * T * array[i] + emt) / (2 * i - 1);
-    }
+        int ni = MIN(FM_BLOCK, n-i0);
+        double* restrict Fmax = F+mmax*ldf+i0;
+
+        for (int i = 0;i < ni;i++)
+        {
+            double t = T[i0+i];
+
+            emt[i] = exp(-t);
+            twot[i] = 2*t;
+
+            if (t <= 0)
+            {
+                Fmax[i] = 0.5 / (mmax + 0.5);
+            }
+            else if (mmax < FM_NORDER && t > TMAX[mmax])
+            {
+                double f = sqrt(PI / t) / 2;
+                for (int m = 1;m <= mmax;m++) f *= (2*m-1) / twot[i];
+                Fmax[i] = f;
+            }
+            else if (mmax <= FM_NORDER-TAYLOR_N)
+            {
+                int tidx = (int)round(t * FM_DELTA);
+                double dt = (double)tidx / FM_DELTA - t;
+                const double* row = &FMTABLE[tidx][mmax];
+
+                double f = row[TAYLOR_N-1];
+                for (int k = TAYLOR_N-1;k > 0;k--) f = row[k-1] + f*dt/k;
+                Fmax[i] = f;
+            }
+            else
+            {
+                Fmax[i] = fmseries(t, mmax);
+            }
+        }
 
-    PROFILE_FLOPS((5+DIV_FLOPS)*(n-1)+EXP_FLOPS);
+        for (int m = mmax;m > 0;m--)
+        {
+            const double* restrict Fm = F+m*ldf+i0;
+            double* restrict Fm1 = F+(m-1)*ldf+i0;
+            double scale = 1.0 / (2*m-1);
+
+            #pragma omp simd
+            for (int i = 0;i < ni;i++)
+            {
+                Fm1[i] = (twot[i]*Fm[i] + emt[i])*scale;
+            }
+        }
+
+        PROFILE_FLOPS(ni*(EXP_FLOPS+2*TAYLOR_N+3*mmax));
+    }
 }
 
-void calcfmtable()
+void calcfmtable(void)
 {
     // store tabulated points for T=0,TMAX[m],0.05, m=0,39
     #pragma omp parallel for
-    for (int m = 0;m < 40;m++)
+    for (int m = 0;m < FM_NORDER;m++)
     {
         for (int Tidx = 0;Tidx < TMAX[m] * 20 + 1;Tidx++)
         {
-            FMTABLE[Tidx][m] = fm(((double)Tidx) / 20.0, m);
+            FMTABLE[Tidx][m] = fm(((double)Tidx) / FM_DELTA, m);
         }
     }
 }
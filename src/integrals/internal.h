@@ -81,16 +81,30 @@ void osprim(int la, int lb, int lc, int ld,
             double za, double zb, double zc, double zd, double* integrals,
             double* xtable);
 
+// osbatch.c
+
+size_t osbatch_worksize(int la, int lb, int lc, int ld);
+
+const char* osbatch_isa();
+
+void osbatch(int la, int lb, int lc, int ld,
+             const double* posa, const double* posb, const double* posc, const double* posd,
+             int na, int nb, int nc, int nd,
+             const double* za, const double* zb, const double* zc, const double* zd,
+             double* integrals, double* work);
+
+// osinv.c and vrr.c return 0 on success or -1 if their scratch space could not be allocated
+
 // osinv.c
 
-void osinv(int la, int lb, int lc, int ld,
+int osinv(int la, int lb, int lc, int ld,
            const double* posa, const double* posb, const double* posc, const double* posd,
            int na, int nb, int nc, int nd,
            const double* za, const double* zb, const double* zc, const double* zd, double* integrals);
 
 // vrr.c
 
-void vrr(int le0, int le1, int lf0, int lf1,
+int vrr(int le0, int le1, int lf0, int lf1,
          const double* posa, const double* posb, const double* posc, const double* posd,
          int na, int nb, int nc, int nd,
          const double* za, const double* zb, const double* zc, const double* zd, double* integrals);
@@ -111,7 +125,8 @@ double fm(double T, int m);
 double fmtaylor(double T, int m);
 double fmasymptotic(double T, int m);
 void fmrecursive(double T, int n, double* array);
-void calcfmtable();
+void fmvec(int n, const double* T, int mmax, double* F, int ldf);
+void calcfmtable(void);
 
 // keiprim.c
 
@@ -134,6 +149,8 @@ void oviprim(int la, int lb, const double* posa, const double* posb,
 // rys.c
 
 void rysquad(double T, int n, double* rt, double* wt);
+void rysvec(int nT, const double* T, int n, double* rt, double* wt);
+void rysexact(double T, int n, double* rt, double* wt);
 void quadrature(int n, double* a, double* b, double mu0, double* rt, double* wt);
 
 // blasx.c
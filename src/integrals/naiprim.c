@@ -80,9 +80,9 @@ void naiprim(int la, const int lb, const double* posa, const double* posb, const
     A0 = -charge * 2 * PI * exp(-za * zb * dist2(posa, posb) / zp) / zp;
     Z = dist2(posp, posc) * zp;
 
-    //fmrecursive(Z, vmax, (double*)gtable);
+    fmvec(1, &Z, vmax, gtable, 1);
     for (i = 0;i <= vmax;i++)
-        gtable[i] = fm(Z, i) * A0;
+        gtable[i] *= A0;
 
     target = &gtable[la * ainc + lb * binc];
 
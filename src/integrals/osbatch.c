@@ -0,0 +1,411 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+#include "internal.h"
+
+/*
+ * Number of primitive quartets evaluated together (one AVX-512 register)
+ */
+#define NB 8
+
+/*
+ * Compile the recursion for several instruction sets and pick one at load time.
+ * None of the variants enables FMA, so that every lane rounds exactly as osprim does.
+ */
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 6 && defined(__x86_64__)
+#define OSBATCH_DISPATCH __attribute__((target_clones("avx512f","avx2","default")))
+#define OSBATCH_HAVE_DISPATCH
+#else
+#define OSBATCH_DISPATCH
+#endif
+
+typedef struct
+{
+    double afac[3][NB], bfac[3][NB], cfac[3][NB], dfac[3][NB], pfac[3][NB], qfac[3][NB];
+    double s1fac[NB], t1fac[NB], s2fac[NB], t2fac[NB], gfac[NB];
+} osbatch_fac_t;
+
+static void filltable_batch(double* table, int la, int lb, int lc, int ld,
+                            const osbatch_fac_t* fac, int dir,
+                            int ainc, int binc, int cinc, int dinc);
+
+size_t osbatch_worksize(int la, int lb, int lc, int ld)
+{
+    return (size_t)(la+1)*(lb+1)*(lc+1)*(ld+1)*(la+lb+lc+ld+1)*NB;
+}
+
+const char* osbatch_isa()
+{
+    #ifdef OSBATCH_HAVE_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return "avx512f";
+    if (__builtin_cpu_supports("avx2")) return "avx2";
+    #endif
+    return "generic";
+}
+
+/**
+ * Calculate ERIs for all primitive quartets of a shell quartet with the
+ * recursion of Obara and Saika (see osprim), NB quartets at a time.
+ *
+ * The recursion tables are stored lane-innermost (xtable[...][v][NB]) so
+ * that each step of the recursion is a vector operation over quartets.
+ * integrals is laid out as [nd][nc][nb][na][nfunc], i.e. the same as
+ * calling osprim for each primitive quartet with integrals+nfunc*m, and
+ * work must hold osbatch_worksize(la,lb,lc,ld) doubles.
+ */
+void osbatch(int la, int lb, int lc, int ld,
+             const double* posa, const double* posb, const double* posc, const double* posd,
+             int na, int nb, int nc, int nd,
+             const double* za, const double* zb, const double* zc, const double* zd,
+             double* restrict integrals, double* restrict work)
+{
+    const double TWO_PI_52 = 34.98683665524972497; // 2*pi^(5/2)
+    int vmax = la+lb+lc+ld;
+    int nprim = na*nb*nc*nd;
+
+    osbatch_fac_t fac;
+
+    /*
+     * work is dimensioned as work[ld+1][lc+1][lb+1][la+1][la+lb+lc+ld+1][NB]
+     */
+    int ainc = (vmax+1)*NB;
+    int binc = ainc*(la+1);
+    int cinc = binc*(lb+1);
+    int dinc = cinc*(lc+1);
+
+    double* target = &work[la*ainc+lb*binc+lc*cinc+ld*dinc];
+
+    int iinc = 1;
+    int jinc = iinc*(la+1)*(la+2)/2;
+    int kinc = jinc*(lb+1)*(lb+2)/2;
+    int linc = kinc*(lc+1)*(lc+2)/2;
+    int nint = linc*(ld+1)*(ld+2)/2;
+
+    double Z[NB], A0[NB];
+
+    for (int m0 = 0;m0 < nprim;m0 += NB)
+    {
+        int nvalid = MIN(NB, nprim-m0);
+
+        /*
+         * Set up each lane exactly as osprim does; unused lanes repeat the last quartet
+         */
+        for (int k = 0;k < NB;k++)
+        {
+            int m = m0+MIN(k, nvalid-1);
+            int h = m/(na*nb*nc);
+            int r = m%(na*nb*nc);
+            int g = r/(na*nb);
+            int s = r%(na*nb);
+            int f = s/na;
+            int e = s%na;
+
+            double zp = za[e]+zb[f];
+            double zq = zc[g]+zd[h];
+
+            double posp[3], posq[3], posw[3];
+            for (int x = 0;x < 3;x++)
+            {
+                posp[x] = (posa[x]*za[e] + posb[x]*zb[f])/zp;
+                posq[x] = (posc[x]*zc[g] + posd[x]*zd[h])/zq;
+                posw[x] = (posp[x]*zp + posq[x]*zq)/(zp+zq);
+
+                fac.afac[x][k] = posp[x] - posa[x];
+                fac.bfac[x][k] = posp[x] - posb[x];
+                fac.cfac[x][k] = posq[x] - posc[x];
+                fac.dfac[x][k] = posq[x] - posd[x];
+                fac.pfac[x][k] = posw[x] - posp[x];
+                fac.qfac[x][k] = posw[x] - posq[x];
+            }
+
+            fac.s1fac[k] = 1.0/(2*zp);
+            fac.s2fac[k] = 1.0/(2*zq);
+            fac.gfac[k] = 1.0/(2*(zp+zq));
+            fac.t1fac[k] = -fac.gfac[k]*zq/zp;
+            fac.t2fac[k] = -fac.gfac[k]*zp/zq;
+
+            Z[k] = dist2(posp,posq)*zp*zq/(zp+zq);
+            A0[k] = TWO_PI_52*exp(-za[e]*zb[f]*dist2(posa, posb)/zp
+                                  -zc[g]*zd[h]*dist2(posc, posd)/zq)/(zp*zq*sqrt(zp+zq));
+        }
+
+        /*
+         * (00|00)[m] for all lanes at once
+         */
+        fmvec(NB, Z, vmax, work, NB);
+        for (int v = 0;v <= vmax;v++)
+        {
+            for (int k = 0;k < NB;k++)
+            {
+                work[v*NB+k] *= A0[k];
+            }
+        }
+
+        PROFILE_FLOPS(nvalid*(vmax+61+EXP_FLOPS+SQRT_FLOPS+18*DIV_FLOPS));
+
+        filltable_batch(work, la, lb, lc, ld, &fac, 0, ainc, binc, cinc, dinc);
+
+        /*
+         * Same traversal as in osprim, with pos taking the place of the integral pointer
+         */
+        double* table1 = target;
+        ptrdiff_t pos = nint-1;
+        for (int dx = ld;dx >= 0;dx--)
+        {
+            for (int cx = lc;cx >= 0;cx--)
+            {
+                for (int bx = lb;bx >= 0;bx--)
+                {
+                    for (int ax = la;ax >= 0;ax--)
+                    {
+                        filltable_batch(table1, la-ax, lb-bx, lc-cx, ld-dx, &fac, 1,
+                                        ainc, binc, cinc, dinc);
+
+                        double* table2 = target;
+                        for (int dy = ld-dx;dy >= 0;dy--)
+                        {
+                            for (int cy = lc-cx;cy >= 0;cy--)
+                            {
+                                for (int by = lb-bx;by >= 0;by--)
+                                {
+                                    for (int ay = la-ax;ay >= 0;ay--)
+                                    {
+                                        filltable_batch(table2, la-ax-ay, lb-bx-by, lc-cx-cy, ld-dx-dy, &fac, 2,
+                                                        ainc, binc, cinc, dinc);
+
+                                        for (int k = 0;k < nvalid;k++)
+                                        {
+                                            integrals[(size_t)nint*(m0+k)+pos] = target[k];
+                                        }
+
+                                        table2 -= ainc;
+                                        pos -= iinc;
+                                    }
+                                    table2 -= binc-ainc*(la-ax+1);
+                                    pos -= jinc-iinc*(la-ax+1);
+                                }
+                                table2 -= cinc-binc*(lb-bx+1);
+                                pos -= kinc-jinc*(lb-bx+1);
+                            }
+                            table2 -= dinc-cinc*(lc-cx+1);
+                            pos -= linc-kinc*(lc-cx+1);
+                        }
+                        table1 -= ainc;
+                        pos -= iinc*(la-ax+1)-linc*(ld-dx+1);
+                    }
+                    table1 -= binc-ainc*(la+1);
+                    pos -= jinc*(lb-bx+1)-iinc*(la+1)*(la+2)/2;
+                }
+                table1 -= cinc-binc*(lb+1);
+                pos -= kinc*(lc-cx+1)-jinc*(lb+1)*(lb+2)/2;
+            }
+            table1 -= dinc-cinc*(lc+1);
+            pos -= linc*(ld-dx+1)-kinc*(lc+1)*(lc+2)/2;
+        }
+    }
+}
+
+/*
+ * As filltable in osprim.c, for direction dir (0=x, 1=y, 2=z), with every
+ * element being a vector of NB lanes; the increments are in doubles
+ */
+OSBATCH_DISPATCH
+static void filltable_batch(double* restrict table, int la, int lb, int lc, int ld,
+                            const osbatch_fac_t* restrict fac, int dir,
+                            int ainc, int binc, int cinc, int dinc)
+{
+    int vmax = la+lb+lc+ld;
+
+    const double* afac = fac->afac[dir];
+    const double* bfac = fac->bfac[dir];
+    const double* cfac = fac->cfac[dir];
+    const double* dfac = fac->dfac[dir];
+    const double* pfac = fac->pfac[dir];
+    const double* qfac = fac->qfac[dir];
+    const double* s1fac = fac->s1fac;
+    const double* t1fac = fac->t1fac;
+    const double* s2fac = fac->s2fac;
+    const double* t2fac = fac->t2fac;
+    const double* gfac = fac->gfac;
+
+    int64_t flops = 0;
+
+    for (int d = 0;d <= ld;d++)
+    {
+        if (d < ld)
+        {
+            flops += (vmax-d)*3*NB;
+            if (d > 0) flops += (vmax-d)*5*NB;
+            for (int v = 0;v < vmax-d;v++)
+            {
+                double* t = table+v*NB;
+
+                #pragma omp simd
+                for (int k = 0;k < NB;k++)
+                {
+                    double x = dfac[k]*(t[k   ]) +
+                               qfac[k]*(t[k+NB]);
+
+                    if (d > 0)
+                    {
+                        x += d*(s2fac[k]*(t[k-dinc   ]) +
+                                t2fac[k]*(t[k-dinc+NB]));
+                    }
+
+                    t[k+dinc] = x;
+                }
+            }
+        }
+
+        for (int c = 0;c <= lc;c++)
+        {
+            if (c < lc)
+            {
+                flops += (vmax-c-d)*3*NB;
+                if (c > 0) flops += (vmax-c-d)*5*NB;
+                if (d > 0) flops += (vmax-c-d)*5*NB;
+                for (int v = 0;v < vmax-c-d;v++)
+                {
+                    double* t = table+v*NB;
+
+                    #pragma omp simd
+                    for (int k = 0;k < NB;k++)
+                    {
+                        double x = cfac[k]*(t[k   ]) +
+                                   qfac[k]*(t[k+NB]);
+
+                        if (c > 0)
+                        {
+                            x += c*(s2fac[k]*(t[k-cinc   ]) +
+                                    t2fac[k]*(t[k-cinc+NB]));
+                        }
+
+                        if (d > 0)
+                        {
+                            x += d*(s2fac[k]*(t[k-dinc   ]) +
+                                    t2fac[k]*(t[k-dinc+NB]));
+                        }
+
+                        t[k+cinc] = x;
+                    }
+                }
+            }
+
+            for (int b = 0;b <= lb;b++)
+            {
+                if (b < lb)
+                {
+                    flops += (vmax-b-c-d)*3*NB;
+                    if (b > 0) flops += (vmax-b-c-d)*5*NB;
+                    if (c > 0) flops += (vmax-b-c-d)*3*NB;
+                    if (d > 0) flops += (vmax-b-c-d)*3*NB;
+                    for (int v = 0;v < vmax-b-c-d;v++)
+                    {
+                        double* t = table+v*NB;
+
+                        #pragma omp simd
+                        for (int k = 0;k < NB;k++)
+                        {
+                            double x = bfac[k]*(t[k   ]) +
+                                       pfac[k]*(t[k+NB]);
+
+                            if (c > 0)
+                            {
+                                x += c*gfac[k]*(t[k-cinc+NB]);
+                            }
+
+                            if (d > 0)
+                            {
+                                x += d*gfac[k]*(t[k-dinc+NB]);
+                            }
+
+                            if (b > 0)
+                            {
+                                x += b*(s1fac[k]*(t[k-binc   ]) +
+                                        t1fac[k]*(t[k-binc+NB]));
+                            }
+
+                            t[k+binc] = x;
+                        }
+                    }
+                }
+
+                for (int a = 0;a <= la;a++)
+                {
+                    if (a < la)
+                    {
+                        flops += (vmax-a-b-c-d)*3*NB;
+                        if (a > 0) flops += (vmax-a-b-c-d)*5*NB;
+                        if (b > 0) flops += (vmax-a-b-c-d)*5*NB;
+                        if (c > 0) flops += (vmax-a-b-c-d)*3*NB;
+                        if (d > 0) flops += (vmax-a-b-c-d)*3*NB;
+                        for (int v = 0;v < vmax-a-b-c-d;v++)
+                        {
+                            double* t = table+v*NB;
+
+                            #pragma omp simd
+                            for (int k = 0;k < NB;k++)
+                            {
+                                double x = afac[k]*(t[k   ]) +
+                                           pfac[k]*(t[k+NB]);
+
+                                if (c > 0)
+                                {
+                                    x += c*gfac[k]*(t[k-cinc+NB]);
+                                }
+
+                                if (d > 0)
+                                {
+                                    x += d*gfac[k]*(t[k-dinc+NB]);
+                                }
+
+                                if (a > 0)
+                                {
+                                    x += a*(s1fac[k]*(t[k-ainc   ]) +
+                                            t1fac[k]*(t[k-ainc+NB]));
+                                }
+
+                                if (b > 0)
+                                {
+                                    x += b*(s1fac[k]*(t[k-binc   ]) +
+                                            t1fac[k]*(t[k-binc+NB]));
+                                }
+
+                                t[k+ainc] = x;
+                            }
+                        }
+                    }
+
+                    table += ainc;
+                }
+                table += binc-ainc*(la+1);
+            }
+            table += cinc-binc*(lb+1);
+        }
+        table += dinc-cinc*(lc+1);
+    }
+
+    PROFILE_FLOPS(flops);
+}
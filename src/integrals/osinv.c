@@ -32,7 +32,7 @@ static void filltable(int np, double* table, int la, int lb, int lc, int ld,
 					  const double* s2fac, const double* t2fac, const double* gfac,
 					  int vinc, int ainc, int binc, int cinc, int dinc);
 
-void osinv(int la, int lb, int lc, int ld,
+int osinv(int la, int lb, int lc, int ld,
            const double* posa, const double* posb, const double* posc, const double* posd,
            int na, int nb, int nc, int nd,
            const double* za, const double* zb, const double* zc, const double* zd, double* restrict integrals)
@@ -58,20 +58,39 @@ void osinv(int la, int lb, int lc, int ld,
     int dinc = cinc*(lc+1);
 
 	size_t worksize = dinc*(ld+1);
-	double* xtable = SAFE_MALLOC(double, worksize);
+	double* xtable = MALLOC(double, worksize);
 
     double *afac, *bfac, *cfac, *dfac, *pfac, *qfac, *s1fac, *s2fac, *t1fac, *t2fac, *gfac;
-     afac = SAFE_MALLOC(double, 3*aosize3);
-     bfac = SAFE_MALLOC(double, 3*aosize3);
-     cfac = SAFE_MALLOC(double, 3*aosize3);
-     dfac = SAFE_MALLOC(double, 3*aosize3);
-     pfac = SAFE_MALLOC(double, 3*aosize3);
-     qfac = SAFE_MALLOC(double, 3*aosize3);
-    s1fac = SAFE_MALLOC(double,   aosize3);
-    s2fac = SAFE_MALLOC(double,   aosize3);
-    t1fac = SAFE_MALLOC(double,   aosize3);
-    t2fac = SAFE_MALLOC(double,   aosize3);
-     gfac = SAFE_MALLOC(double,   aosize3);
+     afac = MALLOC(double, 3*aosize3);
+     bfac = MALLOC(double, 3*aosize3);
+     cfac = MALLOC(double, 3*aosize3);
+     dfac = MALLOC(double, 3*aosize3);
+     pfac = MALLOC(double, 3*aosize3);
+     qfac = MALLOC(double, 3*aosize3);
+    s1fac = MALLOC(double,   aosize3);
+    s2fac = MALLOC(double,   aosize3);
+    t1fac = MALLOC(double,   aosize3);
+    t2fac = MALLOC(double,   aosize3);
+     gfac = MALLOC(double,   aosize3);
+
+    if (xtable == NULL || afac == NULL || bfac == NULL || cfac == NULL ||
+        dfac == NULL || pfac == NULL || qfac == NULL || s1fac == NULL ||
+        s2fac == NULL || t1fac == NULL || t2fac == NULL || gfac == NULL)
+    {
+        FREE(xtable);
+        FREE( afac);
+        FREE( bfac);
+        FREE( cfac);
+        FREE( dfac);
+        FREE( pfac);
+        FREE( qfac);
+        FREE(s1fac);
+        FREE(s2fac);
+        FREE(t1fac);
+        FREE(t2fac);
+        FREE( gfac);
+        return -1;
+    }
 
     double* target = &xtable[la*ainc+lb*binc+lc*cinc+ld*dinc];
 
@@ -236,6 +255,8 @@ void osinv(int la, int lb, int lc, int ld,
     FREE(t1fac);
     FREE(t2fac);
     FREE( gfac);
+
+    return 0;
 }
 
 static void filltable(int np, double* restrict table, int la, int lb, int lc, int ld,
@@ -98,11 +98,10 @@ void osprim(int la, int lb, int lc, int ld,
     /*
      * Get (00|00)[m] and scale by A0
      */
-    //fmrecursive(Z, vmax, xtable);
+    fmvec(1, &Z, vmax, xtable, 1);
     for (int v = 0;v <= vmax;v++)
     {
-        //xtable[v] *= A0;
-        xtable[v] = fm(Z, v)*A0;
+        xtable[v] *= A0;
     }
 
     PROFILE_FLOPS(vmax+61+EXP_FLOPS+SQRT_FLOPS+18*DIV_FLOPS);
@@ -24,58 +24,210 @@
 
 #include "internal.h"
 
+#include <pthread.h>
+
+/*
+ * Roots and weights for n <= RYS_NMAX are fitted by Chebyshev polynomials of
+ * degree RYS_DEGREE on intervals of width RYS_WIDTH for T < rysasymptotic(n),
+ * and taken from the large-T limit beyond that
+ */
+#define RYS_NMAX 16
+#define RYS_DEGREE 12
+#define RYS_WIDTH 2.0
+
+/*
+ * Largest n computed directly (rysexact, and quadrature, which is also used
+ * for the 2n-point Gauss-Hermite limit of each fit), so that the work arrays
+ * can live on the stack
+ */
+#define RYS_NEXACT (2*RYS_NMAX)
+
+/*
+ * The weight function exp(-T t^2) on [0,1] is discretized by RYS_NPANEL
+ * panels of RYS_NGAUSS-point Gauss-Legendre quadrature
+ */
+#define RYS_NPANEL 8
+#define RYS_NGAUSS 32
+#define RYS_NDISC (RYS_NPANEL*RYS_NGAUSS)
+
+static double DISCX[RYS_NDISC], DISCW[RYS_NDISC];
+
+/*
+ * RYSFIT[n-1] is dimensioned as [ninterval][RYS_DEGREE+1][2*n], holding the
+ * Chebyshev coefficients of the n roots followed by the n weights
+ */
+static double* RYSFIT[RYS_NMAX];
+static int RYSNINT[RYS_NMAX];
+
+/*
+ * Roots (x^2) and weights of the positive half of the 2n-point Gauss-Hermite
+ * quadrature, dimensioned as [n][2] for each n
+ */
+static double RYSHERMITE[RYS_NMAX][RYS_NMAX][2];
+
+static pthread_once_t rystable_once = PTHREAD_ONCE_INIT;
+
+static void calcrystable(void);
+
+static void rysstieltjes(double T, int n, double* rt, double* wt);
+
+static double rysasymptotic(int n)
+{
+    return 32 + 6.5*n;
+}
+
 /**
  * generate the roots and weights of the Rys quadrature
  *
- * see Golub, G. H.; Welsch, J. H. Math. Comput. 23, 221-230 (1969)
- *     K. Ishida, J. Chem. Phys. 95, 5198-205 (1991)
+ * For n <= RYS_NMAX the roots and weights are interpolated from the fits; larger n,
+ * up to RYS_NEXACT, are computed directly (rysexact).
  */
 void rysquad(double T, int n, double* restrict rt, double* restrict wt)
 {
-    double a[n], b[n - 1], tmp;
-    int i, j, k;
-    double R[n + 1][n + 1];
-    double fm0;
+    rysvec(1, &T, n, rt, wt);
+}
 
-    for (i = 0;i < n + 1;i++)
+/**
+ * generate the roots and weights of the n-point Rys quadrature for each of nT values
+ * of T, with the roots and weights for T[i] stored in rt[i*n..i*n+n-1] and wt[i*n..i*n+n-1]
+ */
+void rysvec(int nT, const double* restrict T, int n, double* restrict rt, double* restrict wt)
+{
+    pthread_once(&rystable_once, calcrystable);
+
+    if (n > RYS_NMAX)
     {
-        for (j = 0;j < n + 1;j++)
-        {
-            R[i][j] = fm(T, i + j);
-        }
+        for (int i = 0;i < nT;i++) rysexact(T[i], n, rt+i*n, wt+i*n);
+        return;
     }
 
-    for (i = 0;i < n + 1;i++)
+    const double* fit = RYSFIT[n-1];
+    const int nint = RYSNINT[n-1];
+    const double Tasym = rysasymptotic(n);
+
+    for (int i = 0;i < nT;i++)
     {
-        for (j = i;j < n + 1;j++)
+        double t = MAX(T[i], 0.0);
+        double* restrict r = rt+i*n;
+        double* restrict w = wt+i*n;
+
+        if (t >= Tasym)
         {
-            for (k = 0;k <= i - 1;k++)
+            double tinv = 1.0/t;
+            double tinvsqrt = sqrt(tinv);
+
+            for (int v = 0;v < n;v++)
             {
-                R[i][j] -= R[k][i] * R[k][j] / R[k][k];
+                r[v] = RYSHERMITE[n-1][v][0]*tinv;
+                w[v] = RYSHERMITE[n-1][v][1]*tinvsqrt;
             }
+
+            PROFILE_FLOPS(2*n+SQRT_FLOPS+DIV_FLOPS);
+            continue;
         }
-    }
 
-    for (i = 0;i < n + 1;i++)
-    {
-        tmp = sqrt(fabs(1 / R[i][i]));
+        int interval = MIN((int)(t/RYS_WIDTH), nint-1);
+        double u = 2*(t-interval*RYS_WIDTH)/RYS_WIDTH-1;
+        const double* c = fit+(size_t)interval*(RYS_DEGREE+1)*2*n;
+
+        /*
+         * Clenshaw recurrence for all roots and weights at once
+         */
+        double b1[2*RYS_NMAX], b2[2*RYS_NMAX];
+
+        for (int v = 0;v < 2*n;v++)
+        {
+            b1[v] = c[RYS_DEGREE*2*n+v];
+            b2[v] = 0;
+        }
+
+        for (int j = RYS_DEGREE-1;j > 0;j--)
+        {
+            const double* cj = c+j*2*n;
+
+            #pragma omp simd
+            for (int v = 0;v < 2*n;v++)
+            {
+                double tmp = 2*u*b1[v]-b2[v]+cj[v];
+                b2[v] = b1[v];
+                b1[v] = tmp;
+            }
+        }
 
-        for (j = 0;j < n + 1;j++)
+        for (int v = 0;v < n;v++)
         {
-            R[i][j] *= tmp;
+            r[v] = u*b1[v  ]-b2[v  ]+c[v  ];
+            w[v] = u*b1[v+n]-b2[v+n]+c[v+n];
         }
+
+        PROFILE_FLOPS(2*n*(4*RYS_DEGREE+3)+4+DIV_FLOPS);
     }
+}
 
-    a[0] = R[0][1] / R[0][0];
+/**
+ * generate the roots and weights of the Rys quadrature directly
+ *
+ * The recursion coefficients of the polynomials orthogonal with respect to
+ * exp(-T t^2) dt on [0,1] (in the variable x = t^2) are found by the Stieltjes
+ * procedure on a discretization of the weight function, and the roots and weights
+ * from the eigenvalues and eigenvectors of the resulting Jacobi matrix. This is
+ * stable for any n, unlike the Cholesky factorization of the moment matrix, but
+ * n is limited to RYS_NEXACT by the size of the work arrays.
+ *
+ * see W. Gautschi, Orthogonal Polynomials: Computation and Approximation (2004)
+ *     Golub, G. H.; Welsch, J. H. Math. Comput. 23, 221-230 (1969)
+ */
+void rysexact(double T, int n, double* restrict rt, double* restrict wt)
+{
+    pthread_once(&rystable_once, calcrystable);
+    rysstieltjes(T, n, rt, wt);
+}
+
+static void rysstieltjes(double T, int n, double* restrict rt, double* restrict wt)
+{
+    double x[RYS_NDISC], l[RYS_NDISC], p0[RYS_NDISC], p1[RYS_NDISC];
+    double a[RYS_NEXACT], b[RYS_NEXACT];
+    double mu0 = 0, bj = 0;
+    int i, j;
+
+    assert(n <= RYS_NEXACT);
+
+    for (i = 0;i < RYS_NDISC;i++)
+    {
+        x[i] = DISCX[i]*DISCX[i];
+        l[i] = DISCW[i]*exp(-T*x[i]);
+        mu0 += l[i];
+        p0[i] = 0;
+        p1[i] = 1;
+    }
 
-    for (i = 0;i < n - 1;i++)
+    /*
+     * p0 holds the orthonormal polynomial j-1 and p1 the unnormalized polynomial
+     * j, whose norm is the off-diagonal element b[j-1]
+     */
+    for (j = 0;j < n;j++)
     {
-        a[i + 1] = R[i + 1][i + 2] / R[i + 1][i + 1] - R[i][i + 1] / R[i][i];
-        b[i] = R[i + 1][i + 1] / R[i][i];
+        double nrm = 0, ax = 0;
+
+        for (i = 0;i < RYS_NDISC;i++)
+        {
+            nrm += l[i]*p1[i]*p1[i];
+            ax += l[i]*x[i]*p1[i]*p1[i];
+        }
+
+        a[j] = ax/nrm;
+        if (j > 0) b[j-1] = bj = sqrt(nrm);
+
+        double scale = 1/sqrt(nrm);
+        for (i = 0;i < RYS_NDISC;i++)
+        {
+            double p = (x[i]-a[j])*p1[i]*scale - bj*p0[i];
+            p0[i] = p1[i]*scale;
+            p1[i] = p;
+        }
     }
 
-    fm0 = fm(T, 0);
-    quadrature(n, a, b, fm0, rt, wt);
+    quadrature(n, a, b, mu0, rt, wt);
 }
 
 /**
@@ -84,7 +236,9 @@ void rysquad(double T, int n, double* restrict rt, double* restrict wt)
 void quadrature(int n, double* restrict a, double* restrict b, double mu0, double* restrict rt, double* restrict wt)
 {
     int i, info;
-    double Z[n * n];
+    double Z[RYS_NEXACT*RYS_NEXACT];
+
+    assert(n <= RYS_NEXACT);
 
     info = dstev('V', n, a, b, Z, n);
     assert(info == 0);
@@ -95,3 +249,113 @@ void quadrature(int n, double* restrict a, double* restrict b, double mu0, doubl
         wt[i] = Z[i * n] * Z[i * n] * mu0;
     }
 }
+
+/**
+ * generate the n-point Gauss-Legendre quadrature on [-1,1]
+ */
+static void gausslegendre(int n, double* x, double* w)
+{
+    const double PI = 3.1415926535897932384626433832795;
+
+    for (int i = 0;i < n;i++)
+    {
+        double z = cos(PI*(i+0.75)/(n+0.5));
+        double dp = 1;
+
+        for (int iter = 0;iter < 100;iter++)
+        {
+            double p1 = 1, p2 = 0;
+
+            for (int j = 0;j < n;j++)
+            {
+                double p3 = p2;
+                p2 = p1;
+                p1 = ((2*j+1)*z*p2-j*p3)/(j+1);
+            }
+
+            dp = n*(z*p1-p2)/(z*z-1);
+            double dz = p1/dp;
+            z -= dz;
+            if (fabs(dz) < 1e-16) break;
+        }
+
+        x[i] = z;
+        w[i] = 2/((1-z*z)*dp*dp);
+    }
+}
+
+static void calcrystable(void)
+{
+    const double PI = 3.1415926535897932384626433832795;
+
+    double x[RYS_NGAUSS], w[RYS_NGAUSS];
+
+    gausslegendre(RYS_NGAUSS, x, w);
+
+    for (int p = 0;p < RYS_NPANEL;p++)
+    {
+        for (int i = 0;i < RYS_NGAUSS;i++)
+        {
+            DISCX[p*RYS_NGAUSS+i] = (p+0.5*(1+x[i]))/RYS_NPANEL;
+            DISCW[p*RYS_NGAUSS+i] = 0.5*w[i]/RYS_NPANEL;
+        }
+    }
+
+    for (int n = 1;n <= RYS_NMAX;n++)
+    {
+        /*
+         * As T -> inf, exp(-T t^2) dt on [0,1] -> T^{-1/2} exp(-y^2) dy on [0,inf),
+         * so the roots and weights follow from the positive half of the 2n-point
+         * Gauss-Hermite quadrature
+         */
+        double ha[2*RYS_NMAX], hb[2*RYS_NMAX], hr[2*RYS_NMAX], hw[2*RYS_NMAX];
+        for (int i = 0;i < 2*n;i++)
+        {
+            ha[i] = 0;
+            hb[i] = sqrt((i+1)/2.0);
+        }
+        quadrature(2*n, ha, hb, sqrt(PI), hr, hw);
+
+        for (int v = 0;v < n;v++)
+        {
+            RYSHERMITE[n-1][v][0] = hr[n+v]*hr[n+v];
+            RYSHERMITE[n-1][v][1] = hw[n+v];
+        }
+
+        /*
+         * Chebyshev interpolation of each root and weight on each interval. The
+         * tables are built once, under pthread_once, so there is no caller to
+         * return an error to; SAFE_MALLOC reports the failure and aborts
+         */
+        int nint = (int)ceil(rysasymptotic(n)/RYS_WIDTH);
+        double* fit = SAFE_MALLOC(double, (size_t)nint*(RYS_DEGREE+1)*2*n);
+        double f[RYS_DEGREE+1][2*RYS_NMAX];
+
+        for (int interval = 0;interval < nint;interval++)
+        {
+            double* c = fit+(size_t)interval*(RYS_DEGREE+1)*2*n;
+
+            for (int k = 0;k <= RYS_DEGREE;k++)
+            {
+                double u = cos(PI*(k+0.5)/(RYS_DEGREE+1));
+                rysstieltjes((interval+0.5*(1+u))*RYS_WIDTH, n, f[k], f[k]+n);
+            }
+
+            for (int j = 0;j <= RYS_DEGREE;j++)
+            {
+                for (int v = 0;v < 2*n;v++)
+                {
+                    double sum = 0;
+                    for (int k = 0;k <= RYS_DEGREE;k++)
+                    {
+                        sum += f[k][v]*cos(PI*j*(k+0.5)/(RYS_DEGREE+1));
+                    }
+                    c[j*2*n+v] = sum*(j == 0 ? 1 : 2)/(RYS_DEGREE+1);
+                }
+            }
+        }
+
+        RYSNINT[n-1] = nint;
+        RYSFIT[n-1] = fit;
+    }
+}
@@ -0,0 +1,376 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+#include "scheduler.hpp"
+
+using namespace std;
+using namespace aquarius;
+using namespace aquarius::integrals;
+
+ShellQuartetScheduler::ShellQuartetScheduler(const Arena& arena, const vector<Shell>& shells)
+: Distributed(arena), nthread(omp_get_max_threads()), queues(nthread), locks(nthread),
+  busy(nthread, 0.0), started(nthread, -1.0), cost(nthread, 0.0), count(nthread, 0),
+  nqueued(0), exhausted(0), nchunk_local(0), wall_start(-1.0), wall_end(-1.0),
+  next_chunk(0), nfinished(0), pending(false), reply(-1)
+{
+    for (int t = 0;t < nthread;t++) omp_init_lock(&locks[t]);
+
+    /*
+     * Sum w(cd) and w(cd)*L(cd) over all cd <= ab as we go, so that
+     * the cost of each block is known exactly under the quartet model
+     */
+    double sumw = 0, sumwl = 0;
+    for (int a = 0;a < shells.size();++a)
+    {
+        for (int b = 0;b <= a;++b)
+        {
+            double w = pairWeight(shells[a], shells[b]);
+            int L = shells[a].getL()+shells[b].getL();
+            sumw += w;
+            sumwl += w*L;
+            blocks.push_back(ShellQuartetBlock(a, b, w*((L+1)*sumw+sumwl)));
+        }
+    }
+
+    /*
+     * Every rank sorts identically, so that only chunk numbers need to be communicated
+     */
+    stable_sort(blocks.begin(), blocks.end());
+
+    makeChunks();
+
+    /*
+     * The first nproc chunks are assigned statically so that nobody waits at the start
+     */
+    if (rank < getNumChunks()) distribute(rank);
+    next_chunk = min(getNumChunks(), (size_t)nproc);
+}
+
+ShellQuartetScheduler::~ShellQuartetScheduler()
+{
+    for (int t = 0;t < nthread;t++) omp_destroy_lock(&locks[t]);
+}
+
+double ShellQuartetScheduler::pairWeight(const Shell& a, const Shell& b)
+{
+    int ncarta = (a.getL()+1)*(a.getL()+2)/2;
+    int ncartb = (b.getL()+1)*(b.getL()+2)/2;
+    return (double)a.getNPrim()*b.getNPrim()*ncarta*ncartb;
+}
+
+void ShellQuartetScheduler::makeChunks()
+{
+    double remaining = 0;
+    for (size_t i = 0;i < blocks.size();i++) remaining += blocks[i].cost;
+
+    /*
+     * Each chunk takes 1/(2*nproc) of the remaining cost, but at least one
+     * block per thread
+     */
+    chunk_start.push_back(0);
+    size_t i = 0;
+    while (i < blocks.size())
+    {
+        double target = remaining/(2*nproc);
+        double taken = 0;
+        size_t n = 0;
+        while (i < blocks.size() && (n < nthread || taken < target))
+        {
+            taken += blocks[i].cost;
+            n++;
+            i++;
+        }
+        remaining -= taken;
+        chunk_start.push_back(i);
+    }
+}
+
+void ShellQuartetScheduler::distribute(size_t chunk)
+{
+    /*
+     * Deal out round-robin, rotating the starting thread so that the most
+     * expensive block of each chunk does not always go to the same thread
+     */
+    for (int t = 0;t < nthread;t++)
+    {
+        size_t first = chunk_start[chunk]+(t+nchunk_local)%nthread;
+
+        omp_set_lock(&locks[t]);
+        for (size_t i = first;i < chunk_start[chunk+1];i += nthread) queues[t].push_back(i);
+        omp_unset_lock(&locks[t]);
+    }
+
+    int n = chunk_start[chunk+1]-chunk_start[chunk];
+    #pragma omp atomic
+    nqueued += n;
+
+    nchunk_local++;
+}
+
+bool ShellQuartetScheduler::pop(int tid, ShellQuartetBlock& block)
+{
+    bool found = false;
+
+    omp_set_lock(&locks[tid]);
+    if (!queues[tid].empty())
+    {
+        block = blocks[queues[tid].front()];
+        queues[tid].pop_front();
+        found = true;
+    }
+    omp_unset_lock(&locks[tid]);
+
+    if (found)
+    {
+        #pragma omp atomic
+        nqueued--;
+    }
+
+    return found;
+}
+
+bool ShellQuartetScheduler::steal(int tid, ShellQuartetBlock& block)
+{
+    for (int v = 1;v < nthread;v++)
+    {
+        int victim = (tid+v)%nthread;
+        bool found = false;
+
+        /*
+         * Take from the back, where the cheapest blocks of the victim are
+         */
+        omp_set_lock(&locks[victim]);
+        if (!queues[victim].empty())
+        {
+            block = blocks[queues[victim].back()];
+            queues[victim].pop_back();
+            found = true;
+        }
+        omp_unset_lock(&locks[victim]);
+
+        if (found)
+        {
+            #pragma omp atomic
+            nqueued--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ShellQuartetScheduler::isExhausted()
+{
+    int e;
+    #pragma omp atomic read
+    e = exhausted;
+    return e != 0;
+}
+
+void ShellQuartetScheduler::progress(bool block)
+{
+    if (isExhausted())
+    {
+        serve(false);
+        return;
+    }
+
+    int n;
+    #pragma omp atomic read
+    n = nqueued;
+
+    if (rank == 0)
+    {
+        serve(false);
+
+        if (n < nthread)
+        {
+            if (next_chunk < getNumChunks())
+            {
+                distribute(next_chunk++);
+            }
+            else
+            {
+                #pragma omp atomic write
+                exhausted = 1;
+            }
+        }
+
+        return;
+    }
+
+    while (true)
+    {
+        if (pending)
+        {
+            if (block)
+            {
+                request.Wait();
+            }
+            else if (!request.Test())
+            {
+                return;
+            }
+
+            pending = false;
+
+            if (reply < 0)
+            {
+                #pragma omp atomic write
+                exhausted = 1;
+                return;
+            }
+
+            distribute(reply);
+
+            #pragma omp atomic read
+            n = nqueued;
+        }
+
+        /*
+         * Ask for the next chunk well before running dry, since rank 0 only
+         * answers in between its own blocks
+         */
+        if (n >= 2*nthread) return;
+
+        arena.Send(&rank, 1, 0, TAG_REQUEST);
+        request = arena.Irecv(&reply, 1, 0, TAG_CHUNK);
+        pending = true;
+
+        if (!block || n > 0) return;
+    }
+}
+
+void ShellQuartetScheduler::serve(bool block)
+{
+    if (rank != 0) return;
+
+    while (nfinished < nproc-1)
+    {
+        MPI::Status status;
+        if (block)
+        {
+            arena.Probe(MPI::ANY_SOURCE, TAG_REQUEST, status);
+        }
+        else if (!arena.Iprobe(MPI::ANY_SOURCE, TAG_REQUEST, status))
+        {
+            return;
+        }
+
+        int source;
+        arena.Recv(&source, 1, status.Get_source(), TAG_REQUEST);
+
+        int chunk = -1;
+        if (next_chunk < getNumChunks())
+        {
+            chunk = next_chunk++;
+        }
+        else
+        {
+            nfinished++;
+        }
+
+        arena.Send(&chunk, 1, source, TAG_CHUNK);
+    }
+}
+
+bool ShellQuartetScheduler::next(int tid, ShellQuartetBlock& block)
+{
+    assert(tid >= 0 && tid < nthread);
+
+    double now = omp_get_wtime();
+
+    if (started[tid] < 0)
+    {
+        #pragma omp critical (aquarius_integrals_scheduler)
+        {
+            if (wall_start < 0 || now < wall_start) wall_start = now;
+        }
+    }
+    else
+    {
+        busy[tid] += now-started[tid];
+    }
+
+    while (true)
+    {
+        if (tid == 0) progress(false);
+
+        if (pop(tid, block) || steal(tid, block)) break;
+
+        if (isExhausted())
+        {
+            /*
+             * The last chunk may have been dealt out just before the flag was set
+             */
+            if (pop(tid, block) || steal(tid, block)) break;
+
+            if (tid == 0) serve(true);
+
+            now = omp_get_wtime();
+            #pragma omp critical (aquarius_integrals_scheduler)
+            {
+                if (now > wall_end) wall_end = now;
+            }
+
+            return false;
+        }
+
+        if (tid == 0)
+        {
+            progress(true);
+        }
+        else
+        {
+            sched_yield();
+        }
+    }
+
+    started[tid] = omp_get_wtime();
+    cost[tid] += block.cost;
+    count[tid]++;
+
+    return true;
+}
+
+vector<ShellQuartetScheduler::Load> ShellQuartetScheduler::gatherLoads() const
+{
+    Load local;
+
+    for (int t = 0;t < nthread;t++)
+    {
+        local.cost += cost[t];
+        local.busy += busy[t];
+        local.nblock += count[t];
+    }
+
+    if (wall_start >= 0) local.wall = wall_end-wall_start;
+    local.idle = max(0.0, local.wall*nthread-local.busy);
+    local.nchunk = nchunk_local;
+
+    vector<Load> loads(nproc);
+    arena.Allgather(&local, loads.data(), sizeof(Load), MPI::BYTE);
+
+    return loads;
+}
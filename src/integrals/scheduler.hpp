@@ -0,0 +1,176 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+#ifndef _AQUARIUS_INTEGRALS_SCHEDULER_HPP_
+#define _AQUARIUS_INTEGRALS_SCHEDULER_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+#include <deque>
+#include <stdint.h>
+#include <sched.h>
+
+#include "omp.h"
+
+#include "util/distributed.hpp"
+
+#include "shell.hpp"
+
+namespace aquarius
+{
+namespace integrals
+{
+
+/*
+ * All unique quartets (ab|cd) for a fixed bra shell pair ab, i.e. those with
+ * c <= a and d <= (c == a ? b : c)
+ */
+struct ShellQuartetBlock
+{
+    int a, b;
+    double cost;
+
+    ShellQuartetBlock() : a(0), b(0), cost(0) {}
+
+    ShellQuartetBlock(int a, int b, double cost) : a(a), b(b), cost(cost) {}
+
+    /*
+     * Sort the most expensive blocks first
+     */
+    bool operator<(const ShellQuartetBlock& other) const { return cost > other.cost; }
+};
+
+/*
+ * Hand out the unique shell quartets (ab|cd), a >= b, c >= d, ab >= cd, for
+ * evaluation in blocks of common bra pair, in order of decreasing estimated cost.
+ *
+ * The sorted list of blocks is cut into chunks of decreasing cost (guided
+ * self-scheduling). Chunk i < nproc goes to rank i, and the rest are handed out
+ * on demand by rank 0. Within each rank, the blocks of a chunk are dealt out to per-thread
+ * queues, and threads which run out of work steal from the other queues. All MPI
+ * communication is done by thread 0 of each rank, in between blocks.
+ *
+ * Usage (all threads of all ranks):
+ *
+ *  #pragma omp parallel num_threads(sched.getNumThreads())
+ *  {
+ *      ShellQuartetBlock block;
+ *      while (sched.next(omp_get_thread_num(), block)) { ... }
+ *  }
+ */
+class ShellQuartetScheduler : public Distributed
+{
+    public:
+        struct Load
+        {
+            double cost;
+            double busy;
+            double idle;
+            double wall;
+            int64_t nblock;
+            int64_t nchunk;
+
+            Load() : cost(0), busy(0), idle(0), wall(0), nblock(0), nchunk(0) {}
+        };
+
+    protected:
+        enum {TAG_REQUEST = 8801, TAG_CHUNK = 8802};
+
+        std::vector<ShellQuartetBlock> blocks;
+        std::vector<size_t> chunk_start;
+        int nthread;
+        std::vector<std::deque<size_t> > queues;
+        std::vector<omp_lock_t> locks;
+        std::vector<double> busy;
+        std::vector<double> started;
+        std::vector<double> cost;
+        std::vector<int64_t> count;
+        int nqueued;
+        int exhausted;
+        int64_t nchunk_local;
+        double wall_start, wall_end;
+        /*
+         * Rank 0 only: next unassigned chunk and the number of
+         * ranks which have been told that there is no more work
+         */
+        size_t next_chunk;
+        int nfinished;
+        /*
+         * Other ranks: outstanding chunk request
+         */
+        MPI::Request request;
+        bool pending;
+        int reply;
+
+    public:
+        ShellQuartetScheduler(const Arena& arena, const std::vector<Shell>& shells);
+
+        ~ShellQuartetScheduler();
+
+        /*
+         * The cost of (ab|cd) is estimated as w(ab)*w(cd)*(L(ab)+L(cd)+1), where w is the
+         * product of the number of primitives and cartesian functions and L the total angular
+         * momentum of the pair
+         */
+        static double pairWeight(const Shell& a, const Shell& b);
+
+        int getNumThreads() const { return nthread; }
+
+        size_t getNumBlocks() const { return blocks.size(); }
+
+        size_t getNumChunks() const { return chunk_start.size()-1; }
+
+        /*
+         * Get the next block for thread tid. Returns false when there is no more work
+         * anywhere in the arena. Must be called by every thread in [0,getNumThreads()).
+         */
+        bool next(int tid, ShellQuartetBlock& block);
+
+        /*
+         * Collect the load statistics of every rank (collective)
+         */
+        std::vector<Load> gatherLoads() const;
+
+    protected:
+        void makeChunks();
+
+        void distribute(size_t chunk);
+
+        bool pop(int tid, ShellQuartetBlock& block);
+
+        bool steal(int tid, ShellQuartetBlock& block);
+
+        bool isExhausted();
+
+        void progress(bool block);
+
+        void serve(bool block);
+};
+
+}
+}
+
+#endif
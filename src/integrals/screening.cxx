@@ -0,0 +1,87 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+#include "screening.hpp"
+
+using namespace std;
+using namespace aquarius;
+using namespace aquarius::integrals;
+
+SchwarzScreening::SchwarzScreening(const Arena& arena, const vector<Shell>& shells,
+                                   const TwoElectronIntegralEvaluator& eval)
+: Distributed(arena), nshell(shells.size()), Q(nshell*(nshell+1)/2, 0.0), Qmax(0), Dmax(0)
+{
+    int npair = Q.size();
+
+    /*
+     * The diagonal quartets are spread over ranks and threads, and
+     * then summed (each element is computed only once). Exceptions may
+     * not leave the parallel region
+     */
+    string error;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int ab = rank;ab < npair;ab += nproc)
+    {
+        int a = (int)((sqrt(8.0*ab+1)-1)/2);
+        while (a*(a+1)/2 > ab) a--;
+        while ((a+1)*(a+2)/2 <= ab) a++;
+        int b = ab-a*(a+1)/2;
+
+        try
+        {
+            TwoElectronIntegrals abab(shells[a], shells[b], shells[a], shells[b], eval);
+
+            const double* ints = abab.getIntegrals();
+            double m = 0;
+            for (size_t i = 0;i < abab.getNumInts();i++) m = max(m, fabs(ints[i]));
+
+            Q[ab] = sqrt(m);
+        }
+        catch (runtime_error& e)
+        {
+            #pragma omp critical
+            error = e.what();
+        }
+    }
+
+    if (!error.empty()) throw runtime_error(error);
+
+    arena.Allreduce(Q, MPI::SUM);
+
+    for (int ab = 0;ab < npair;ab++) Qmax = max(Qmax, Q[ab]);
+}
+
+void SchwarzScreening::setDensity(const vector<double>& Dshell)
+{
+    assert(Dshell.size() == nshell*nshell);
+
+    D = Dshell;
+    Dmax = 0;
+    for (int i = 0;i < D.size();i++)
+    {
+        D[i] = fabs(D[i]);
+        Dmax = max(Dmax, D[i]);
+    }
+}
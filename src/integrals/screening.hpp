@@ -0,0 +1,121 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+#ifndef _AQUARIUS_INTEGRALS_SCREENING_HPP_
+#define _AQUARIUS_INTEGRALS_SCREENING_HPP_
+
+#include <cassert>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "util/distributed.hpp"
+
+#include "shell.hpp"
+#include "2eints.hpp"
+
+namespace aquarius
+{
+namespace integrals
+{
+
+/*
+ * Cauchy-Schwarz bounds |(ab|cd)| <= Q(ab)*Q(cd) for shell quartets, where
+ * Q(ab) = max |(ij|ij)|^(1/2) over the functions i in a and j in b.
+ *
+ * If shell-pair maxima of the density are given, quartets can also be
+ * screened by the largest contribution they could make to a Fock matrix.
+ */
+class SchwarzScreening : public Distributed
+{
+    protected:
+        int nshell;
+        std::vector<double> Q;
+        double Qmax;
+        std::vector<double> D;
+        double Dmax;
+
+        static size_t pair(int a, int b)
+        {
+            return (a > b ? a*(a+1)/2+b : b*(b+1)/2+a);
+        }
+
+    public:
+        SchwarzScreening(const Arena& arena, const std::vector<Shell>& shells,
+                         const TwoElectronIntegralEvaluator& eval);
+
+        int getNumShells() const { return nshell; }
+
+        double getBound(int a, int b) const { return Q[pair(a,b)]; }
+
+        double getMaxBound() const { return Qmax; }
+
+        /*
+         * Upper bound on |(ab|cd)|
+         */
+        double getBound(int a, int b, int c, int d) const
+        {
+            return Q[pair(a,b)]*Q[pair(c,d)];
+        }
+
+        /*
+         * True if some quartet (ab|cd) could exceed cutoff for this bra pair
+         */
+        bool isSignificant(int a, int b, double cutoff) const
+        {
+            return getBound(a,b)*Qmax*(D.empty() ? 1.0 : 4*Dmax) >= cutoff;
+        }
+
+        bool isSignificant(int a, int b, int c, int d, double cutoff) const
+        {
+            double bound = getBound(a,b,c,d);
+            if (D.empty()) return bound >= cutoff;
+            return bound*getDensityWeight(a,b,c,d) >= cutoff;
+        }
+
+        /*
+         * Set the maximum magnitude of the density (or density change) in each block
+         * of shells a, b, given as an nshell x nshell matrix. For unrestricted
+         * calculations this should bound both the alpha and beta densities.
+         */
+        void setDensity(const std::vector<double>& Dshell);
+
+        void clearDensity() { D.clear(); Dmax = 0; }
+
+        /*
+         * Largest density element that (ab|cd) is multiplied by in a Coulomb or
+         * exchange contribution to the Fock matrix
+         */
+        double getDensityWeight(int a, int b, int c, int d) const
+        {
+            return std::max(std::max(4*std::max(D[a*nshell+b], D[c*nshell+d]),
+                                     std::max(D[a*nshell+c], D[a*nshell+d])),
+                                     std::max(D[b*nshell+c], D[b*nshell+d]));
+        }
+};
+
+}
+}
+
+#endif
@@ -51,7 +51,68 @@ Shell::Shell(const Center& pos, int L, int nprim, int ncontr, bool spherical, bo
   ndegen(pos.getCenters().size()), spherical(spherical), keep_contaminants(keep_contaminants),
   exponents(exponents), coefficients(coefficients)
 {
-    const PointGroup& group = pos.getPointGroup();
+    setupSymmetry();
+
+    /*
+     * Normalize the shell
+     */
+    const double PI2_N34 = 0.25197943553838073034791409490358;
+
+    for (int i = 0;i < ncontr;i++)
+    {
+        double norm = 0.0;
+        for (int j = 0;j < nprim;j++)
+        {
+            for (int k = 0;k < nprim;k++)
+            {
+                double zeta = sqrt(exponents[j]*exponents[k])/(exponents[j]+exponents[k]);
+                norm += coefficients[i*nprim+j]*coefficients[i*nprim+k]*pow(2*zeta,(double)L+1.5);
+            }
+        }
+
+        for (int j = 0;j < nprim;j++)
+        {
+            this->coefficients[i*nprim+j] *= PI2_N34*pow(4*exponents[j],((double)L+1.5)/2)/sqrt(norm);
+        }
+    }
+
+    /*
+     * Generate the cartesian -> spherical harmonic transformation
+     */
+    if (spherical)
+    {
+        cart2spher.resize(nfunc*(L+1)*(L+2)/2);
+        int k = 0;
+        for (int l = L;l >= (keep_contaminants ? 0 : L);l -= 2)
+        {
+            for (int m = l;m > 0;m--)
+            {
+                for (int x = 0;x <= L;x++)
+                    for (int y = 0;y <= L-x;y++)
+                        cart2spher[k++] = cartcoef(l, m, x, y, L-x-y);
+                for (int x = 0;x <= L;x++)
+                    for (int y = 0;y <= L-x;y++)
+                        cart2spher[k++] = cartcoef(l, -m, x, y, L-x-y);
+            }
+            for (int x = 0;x <= L;x++)
+                for (int y = 0;y <= L-x;y++)
+                    cart2spher[k++] = cartcoef(l, 0, x, y, L-x-y);
+        }
+        assert(k == nfunc*(L+1)*(L+2)/2);
+    }
+}
+
+Shell::Shell(const Center& pos, const Shell& other)
+: center(pos), L(other.L), nprim(other.nprim), ncontr(other.ncontr), nfunc(other.nfunc),
+  ndegen(pos.getCenters().size()), spherical(other.spherical), keep_contaminants(other.keep_contaminants),
+  exponents(other.exponents), coefficients(other.coefficients), cart2spher(other.cart2spher)
+{
+    setupSymmetry();
+}
+
+void Shell::setupSymmetry()
+{
+    const PointGroup& group = center.getPointGroup();
     int nirrep = group.getNumIrreps();
     int order = group.getOrder();
 
@@ -119,7 +180,7 @@ Shell::Shell(const Center& pos, int L, int nprim, int ncontr, bool spherical, bo
              */
             for (int op = 0;op < order;op++)
             {
-                proj[pos.getCenterAfterOp(op)] += (group.character(irrep, op)*parity[func][op] < 0 ? -1 : 1);
+                proj[center.getCenterAfterOp(op)] += (group.character(irrep, op)*parity[func][op] < 0 ? -1 : 1);
             }
 
             for (int j = 0;j < ndegen;j++)
@@ -145,64 +206,31 @@ Shell::Shell(const Center& pos, int L, int nprim, int ncontr, bool spherical, bo
             }
         }
     }
+}
 
-    /*
-     * Normalize the shell
-     */
-    const double PI2_N34 = 0.25197943553838073034791409490358;
-
-    for (int i = 0;i < ncontr;i++)
-    {
-        double norm = 0.0;
-        for (int j = 0;j < nprim;j++)
-        {
-            for (int k = 0;k < nprim;k++)
-            {
-                double zeta = sqrt(exponents[j]*exponents[k])/(exponents[j]+exponents[k]);
-                norm += coefficients[i*nprim+j]*coefficients[i*nprim+k]*pow(2*zeta,(double)L+1.5);
-            }
-        }
-
-        for (int j = 0;j < nprim;j++)
-        {
-            this->coefficients[i*nprim+j] *= PI2_N34*pow(4*exponents[j],((double)L+1.5)/2)/sqrt(norm);
-        }
-    }
-
-    /*
-     * Generate the cartesian -> spherical harmonic transformation
-     */
-    if (spherical)
-    {
-        cart2spher.resize(nfunc*(L+1)*(L+2)/2);
-        int k = 0;
-        for (int l = L;l >= (keep_contaminants ? 0 : L);l -= 2)
-        {
-            for (int m = l;m > 0;m--)
-            {
-                for (int x = 0;x <= L;x++)
-                    for (int y = 0;y <= L-x;y++)
-                        cart2spher[k++] = cartcoef(l, m, x, y, L-x-y);
-                for (int x = 0;x <= L;x++)
-                    for (int y = 0;y <= L-x;y++)
-                        cart2spher[k++] = cartcoef(l, -m, x, y, L-x-y);
-            }
-            for (int x = 0;x <= L;x++)
-                for (int y = 0;y <= L-x;y++)
-                    cart2spher[k++] = cartcoef(l, 0, x, y, L-x-y);
-        }
-        assert(k == nfunc*(L+1)*(L+2)/2);
-    }
+Shell Shell::unit(const Center& pos)
+{
+    Shell s(pos, 0, 1, 1, false, false, vector<double>(1, 1.0), vector<double>(1, 1.0));
+    s.exponents[0] = 0.0;
+    s.coefficients[0] = 1.0;
+    return s;
 }
 
 vector<vector<int> > Shell::setupIndices(const Context& ctx, const Molecule& m)
 {
-    int nirrep = m.getGroup().getNumIrreps();
+    return setupIndices(ctx, vector<Shell>(m.getShellsBegin(), m.getShellsEnd()));
+}
+
+vector<vector<int> > Shell::setupIndices(const Context& ctx, const vector<Shell>& shells)
+{
+    if (shells.empty()) return vector<vector<int> >();
+
+    int nirrep = shells[0].getCenter().getPointGroup().getNumIrreps();
 
     vector<vector<int> > idx;
     vector<int> nfunc(nirrep, (int)0);
 
-    for (Molecule::const_shell_iterator s = m.getShellsBegin();s != m.getShellsEnd();++s)
+    for (vector<Shell>::const_iterator s = shells.begin();s != shells.end();++s)
     {
         idx.push_back(vector<int>(nirrep));
         vector<int>& index = idx.back();
@@ -76,8 +76,23 @@ class Shell
         Shell(const Center& pos, int L, int nprim, int ncontr, bool spherical, bool keep_contaminants,
               const std::vector<double>& exponents, const std::vector<double>& coefficients);
 
+        /*
+         * The same (already normalized) shell on another center, possibly with a
+         * different point group
+         */
+        Shell(const Center& pos, const Shell& other);
+
+        /*
+         * The constant function 1, as an s shell with zero exponent, so that (ab|c1)
+         * gives the three-center integrals (ab|c) and (a1|b1) the two-center ones.
+         * The position only determines the symmetry, so use the origin.
+         */
+        static Shell unit(const Center& pos);
+
         static std::vector<std::vector<int> > setupIndices(const Context& ctx, const input::Molecule& m);
 
+        static std::vector<std::vector<int> > setupIndices(const Context& ctx, const std::vector<Shell>& shells);
+
         int getIndex(const Context& ctx, std::vector<int> idx, int func, int contr, int degen) const;
 
         //void aoToSo(Context::Ordering primitive_ordering, double* aoso, int ld) const;
@@ -115,6 +130,8 @@ class Shell
         const std::vector<double>& getCart2Spher() const { return cart2spher; }
 
     protected:
+        void setupSymmetry();
+
         static double cartcoef(int l, int m, int lx, int ly, int lz);
 };
 
@@ -31,7 +31,7 @@ static void filltable(int np, double* table, int le, int lf,
                       const double* s2fac, const double* t2fac, const double* gfac,
                       int vinc, int einc, int finc);
 
-void vrr(int le0, int le1, int lf0, int lf1,
+int vrr(int le0, int le1, int lf0, int lf1,
          const double* posa, const double* posb, const double* posc, const double* posd,
          int na, int nb, int nc, int nd,
          const double* za, const double* zb, const double* zc, const double* zd, double* restrict integrals)
@@ -55,18 +55,35 @@ void vrr(int le0, int le1, int lf0, int lf1,
     int finc = einc*(le1+1);
 
 	size_t worksize = finc*(lf1+1);
-	double* xtable = SAFE_MALLOC(double, worksize);
+	double* xtable = MALLOC(double, worksize);
 
     double *efac, *ffac, *pfac, *qfac, *s1fac, *s2fac, *t1fac, *t2fac, *gfac;
-     efac = SAFE_MALLOC(double, 3*aosize3);
-     ffac = SAFE_MALLOC(double, 3*aosize3);
-     pfac = SAFE_MALLOC(double, 3*aosize3);
-     qfac = SAFE_MALLOC(double, 3*aosize3);
-    s1fac = SAFE_MALLOC(double,   aosize3);
-    s2fac = SAFE_MALLOC(double,   aosize3);
-    t1fac = SAFE_MALLOC(double,   aosize3);
-    t2fac = SAFE_MALLOC(double,   aosize3);
-     gfac = SAFE_MALLOC(double,   aosize3);
+     efac = MALLOC(double, 3*aosize3);
+     ffac = MALLOC(double, 3*aosize3);
+     pfac = MALLOC(double, 3*aosize3);
+     qfac = MALLOC(double, 3*aosize3);
+    s1fac = MALLOC(double,   aosize3);
+    s2fac = MALLOC(double,   aosize3);
+    t1fac = MALLOC(double,   aosize3);
+    t2fac = MALLOC(double,   aosize3);
+     gfac = MALLOC(double,   aosize3);
+
+    if (xtable == NULL || efac == NULL || ffac == NULL || pfac == NULL ||
+        qfac == NULL || s1fac == NULL || s2fac == NULL || t1fac == NULL ||
+        t2fac == NULL || gfac == NULL)
+    {
+        FREE(xtable);
+        FREE( efac);
+        FREE( ffac);
+        FREE( pfac);
+        FREE( qfac);
+        FREE(s1fac);
+        FREE(s2fac);
+        FREE(t1fac);
+        FREE(t2fac);
+        FREE( gfac);
+        return -1;
+    }
 
     int i = 0;
     for (int h = 0;h < nd;h++)
@@ -252,6 +269,8 @@ void vrr(int le0, int le1, int lf0, int lf1,
     FREE(t1fac);
     FREE(t2fac);
     FREE( gfac);
+
+    return 0;
 }
 
 static void filltable(int np, double* restrict table, int le, int lf,
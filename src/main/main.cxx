@@ -26,6 +26,7 @@
 #include "tensor/symblocked_tensor.hpp"
 
 #include "time/time.hpp"
+#include "time/trace.hpp"
 #include "task/task.hpp"
 
 #include <exception>
@@ -39,7 +40,11 @@ using namespace aquarius::task;
 
 int main(int argc, char **argv)
 {
-    MPI::Init(argc, argv);
+    /*
+     * Threaded sections (e.g. the 2eints scheduler) make MPI calls from the
+     * master thread while the other threads compute
+     */
+    int thread_level = MPI::Init_thread(argc, argv, MPI_THREAD_FUNNELED);
 #ifdef ELEMENTAL
     elem::Initialize(argc, argv);
 #endif
@@ -49,6 +54,17 @@ int main(int argc, char **argv)
         omp_set_num_threads(1);
     }
 
+    if (thread_level < MPI_THREAD_FUNNELED && omp_get_max_threads() > 1)
+    {
+        if (MPI::COMM_WORLD.Get_rank() == 0)
+        {
+            fprintf(stderr, "The MPI library does not support MPI_THREAD_FUNNELED, "
+                            "running with 1 thread\n\n");
+        }
+
+        omp_set_num_threads(1);
+    }
+
     if (MPI::COMM_WORLD.Get_rank() == 0)
     {
         printf("================================================================================\n");
@@ -81,6 +97,8 @@ int main(int argc, char **argv)
     {
         Arena world;
 
+        if (getenv("AQUARIUS_TRACE") != NULL) Trace::start(world);
+
         if (argc < 2)
         {
             Logger::error(world) << "No input file specified." << endl << endl;
@@ -100,6 +118,12 @@ int main(int argc, char **argv)
         }
 
         Timer::printTimers(world);
+
+        if (getenv("AQUARIUS_PROFILE_JSON") != NULL)
+            Timer::writeTimers(world, getenv("AQUARIUS_PROFILE_JSON"));
+
+        if (getenv("AQUARIUS_TRACE") != NULL)
+            Trace::write(world, getenv("AQUARIUS_TRACE"));
     }
     while (false);
 
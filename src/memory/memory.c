@@ -22,11 +22,68 @@
  * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE. */
 
+
 #include "memory.h"
 
 #include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+
+/*
+ * Every block starts with a header of one cache line, so that the memory handed out is
+ * cache-line aligned. Blocks of up to 2^MAX_CLASS bytes (including the header) are
+ * rounded up to a power of two and recycled, first through a small cache private to
+ * each thread and then through a cache shared by all threads. Larger blocks go straight
+ * to the system.
+ */
+#define MIN_CLASS 6
+#define MAX_CLASS 20
+#define NUM_CLASSES (MAX_CLASS-MIN_CLASS+1)
+
+/*
+ * Limits on the number of blocks of each class kept in a thread cache (in blocks)
+ * and in the shared cache (in bytes)
+ */
+#define THREAD_CACHE_BLOCKS 16
+#define THREAD_CACHE_BYTES (1<<20)
+#define SHARED_CACHE_BYTES (1<<24)
+
+typedef struct block_header
+{
+    size_t size;
+    int cls;
+    struct block_header* next;
+} block_header;
+
+#define HEADER(ptr) ((block_header*)((intptr_t)(ptr)-CACHE_LINE))
+#define DATA(block) ((void*)((intptr_t)(block)+CACHE_LINE))
 
 size_t mem_limit = 0, mem_used = 0;
+static size_t mem_cached = 0, mem_peak = 0;
+
+/*
+ * The thread caches are registered in a list so that any thread can empty all of them
+ * before refusing an allocation; each has its own lock, which only the owning thread
+ * takes otherwise
+ */
+typedef struct thread_cache_t
+{
+    pthread_mutex_t lock;
+    block_header* blocks[NUM_CLASSES];
+    int count[NUM_CLASSES];
+    struct thread_cache_t* next;
+    struct thread_cache_t* prev;
+} thread_cache_t;
+
+static __thread thread_cache_t* thread_cache = NULL;
+static thread_cache_t* all_thread_caches = NULL;
+static pthread_mutex_t thread_caches_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t thread_cache_key;
+static pthread_once_t thread_cache_once = PTHREAD_ONCE_INIT;
+
+static block_header* shared_cache[NUM_CLASSES];
+static size_t shared_cache_count[NUM_CLASSES];
+static pthread_mutex_t shared_cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
 void set_memory_limit(const size_t bytes)
 {
@@ -43,76 +100,334 @@ size_t get_memory_used()
     return mem_used;
 }
 
-void* aq_malloc(const size_t size_, const char *file, const int line, const int bailout)
+size_t get_memory_high_water()
+{
+    return mem_peak;
+}
+
+void reset_memory_high_water()
+{
+    mem_peak = mem_used;
+}
+
+static void update_high_water(size_t used)
+{
+    size_t peak = mem_peak;
+    while (used > peak && !__sync_bool_compare_and_swap(&mem_peak, peak, used)) peak = mem_peak;
+}
+
+static int size_class(size_t bytes)
+{
+    int cls = MIN_CLASS;
+    while (cls <= MAX_CLASS && ((size_t)1 << cls) < bytes) cls++;
+    return (cls > MAX_CLASS ? -1 : cls-MIN_CLASS);
+}
+
+static size_t class_size(int cls)
+{
+    return (size_t)1 << (cls+MIN_CLASS);
+}
+
+static int thread_cache_limit(int cls)
+{
+    return MIN(THREAD_CACHE_BLOCKS, MAX(1, THREAD_CACHE_BYTES/class_size(cls)));
+}
+
+static size_t shared_cache_limit(int cls)
+{
+    return MAX(1, SHARED_CACHE_BYTES/class_size(cls));
+}
+
+/*
+ * Return all blocks in a thread cache to the system
+ */
+static void flush_thread_cache(thread_cache_t* cache)
+{
+    pthread_mutex_lock(&cache->lock);
+    for (int cls = 0;cls < NUM_CLASSES;cls++)
+    {
+        while (cache->blocks[cls] != NULL)
+        {
+            block_header* block = cache->blocks[cls];
+            cache->blocks[cls] = block->next;
+            free(block);
+            __sync_sub_and_fetch(&mem_cached, class_size(cls));
+        }
+        cache->count[cls] = 0;
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/*
+ * Empty and unregister the cache of a thread which is exiting
+ */
+static void release_thread_cache(void* ptr)
+{
+    thread_cache_t* cache = (thread_cache_t*)ptr;
+
+    flush_thread_cache(cache);
+
+    pthread_mutex_lock(&thread_caches_lock);
+    if (cache->prev != NULL) cache->prev->next = cache->next;
+    else all_thread_caches = cache->next;
+    if (cache->next != NULL) cache->next->prev = cache->prev;
+    pthread_mutex_unlock(&thread_caches_lock);
+
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+static void create_thread_cache_key()
+{
+    pthread_key_create(&thread_cache_key, release_thread_cache);
+}
+
+static thread_cache_t* get_thread_cache()
+{
+    if (thread_cache != NULL) return thread_cache;
+
+    pthread_once(&thread_cache_once, create_thread_cache_key);
+
+    thread_cache_t* cache = (thread_cache_t*)calloc(1, sizeof(thread_cache_t));
+    if (cache == NULL) return NULL;
+    pthread_mutex_init(&cache->lock, NULL);
+
+    pthread_mutex_lock(&thread_caches_lock);
+    cache->next = all_thread_caches;
+    if (all_thread_caches != NULL) all_thread_caches->prev = cache;
+    all_thread_caches = cache;
+    pthread_mutex_unlock(&thread_caches_lock);
+
+    pthread_setspecific(thread_cache_key, cache);
+    thread_cache = cache;
+
+    return cache;
+}
+
+/*
+ * Return all blocks in the shared cache to the system
+ */
+static void flush_shared_cache()
+{
+    pthread_mutex_lock(&shared_cache_lock);
+    for (int cls = 0;cls < NUM_CLASSES;cls++)
+    {
+        while (shared_cache[cls] != NULL)
+        {
+            block_header* block = shared_cache[cls];
+            shared_cache[cls] = block->next;
+            free(block);
+            __sync_sub_and_fetch(&mem_cached, class_size(cls));
+        }
+        shared_cache_count[cls] = 0;
+    }
+    pthread_mutex_unlock(&shared_cache_lock);
+}
+
+/*
+ * Account for bytes of new memory from the system, failing if this would go over the limit
+ */
+static int reserve(size_t bytes)
+{
+    size_t used = __sync_add_and_fetch(&mem_used, bytes);
+
+    if (mem_limit > 0 && used+mem_cached > mem_limit)
+    {
+        __sync_sub_and_fetch(&mem_used, bytes);
+        return 0;
+    }
+
+    update_high_water(used);
+    return 1;
+}
+
+/*
+ * Return the blocks held in every cache to the system
+ */
+static void flush_caches()
 {
-	assert(ALIGNMENT >= sizeof(size_t));
+    flush_shared_cache();
 
-	size_t size = MAX(size_,1);
+    pthread_mutex_lock(&thread_caches_lock);
+    for (thread_cache_t* cache = all_thread_caches;cache != NULL;cache = cache->next)
+    {
+        flush_thread_cache(cache);
+    }
+    pthread_mutex_unlock(&thread_caches_lock);
+}
 
-	if (mem_limit > 0 && mem_used+size+ALIGNMENT > mem_limit)
+static block_header* system_alloc(size_t bytes)
+{
+    if (!reserve(bytes))
     {
-        if (bailout) abort();
-	    return NULL;
+        flush_caches();
+        if (!reserve(bytes)) return NULL;
     }
 
     void* mem;
-    if (posix_memalign(&mem, ALIGNMENT, size+ALIGNMENT) != 0)
+    if (posix_memalign(&mem, CACHE_LINE, bytes) != 0)
     {
-        if (bailout) abort();
+        __sync_sub_and_fetch(&mem_used, bytes);
         return NULL;
     }
 
-    mem_used += size+ALIGNMENT;
-    *(size_t*)mem = size;
+    return (block_header*)mem;
+}
+
+static block_header* cache_alloc(int cls)
+{
+    thread_cache_t* cache = get_thread_cache();
+    block_header* block = NULL;
+
+    if (cache != NULL)
+    {
+        pthread_mutex_lock(&cache->lock);
+        block = cache->blocks[cls];
+        if (block != NULL)
+        {
+            cache->blocks[cls] = block->next;
+            cache->count[cls]--;
+        }
+        pthread_mutex_unlock(&cache->lock);
+    }
+
+    if (block == NULL && shared_cache[cls] != NULL)
+    {
+        pthread_mutex_lock(&shared_cache_lock);
+        block = shared_cache[cls];
+        if (block != NULL)
+        {
+            shared_cache[cls] = block->next;
+            shared_cache_count[cls]--;
+        }
+        pthread_mutex_unlock(&shared_cache_lock);
+    }
+
+    if (block != NULL)
+    {
+        __sync_sub_and_fetch(&mem_cached, class_size(cls));
+        update_high_water(__sync_add_and_fetch(&mem_used, class_size(cls)));
+    }
 
-    return (void*)((intptr_t)mem+ALIGNMENT);
+    return block;
 }
 
-void* aq_realloc(void* ptr, const size_t size_, const char *file, const int line, const int bailout)
+static void cache_free(block_header* block)
 {
-    size_t size = MAX(size_,1);
+    int cls = block->cls;
 
-	if (ptr == NULL) return aq_malloc(size, file, line, bailout);
-	if (size == 0)
-	{
-		aq_free(ptr, file, line);
-		return NULL;
-	}
+    __sync_sub_and_fetch(&mem_used, class_size(cls));
+    __sync_add_and_fetch(&mem_cached, class_size(cls));
 
-	ptr = (void*)((intptr_t)ptr-ALIGNMENT);
-	size_t old_size = *(size_t*)ptr;
+    thread_cache_t* cache = get_thread_cache();
 
-	if (mem_limit > 0 && mem_used+size-old_size > mem_limit)
+    if (cache != NULL)
     {
-        if (bailout) abort();
-	    return NULL;
+        pthread_mutex_lock(&cache->lock);
+        if (cache->count[cls] < thread_cache_limit(cls))
+        {
+            block->next = cache->blocks[cls];
+            cache->blocks[cls] = block;
+            cache->count[cls]++;
+            block = NULL;
+        }
+        pthread_mutex_unlock(&cache->lock);
+
+        if (block == NULL) return;
     }
 
-    void* mem = aq_malloc(size, file, line, bailout);
-    if (mem == NULL)
+    pthread_mutex_lock(&shared_cache_lock);
+    if (shared_cache_count[cls] < shared_cache_limit(cls))
     {
-        if (bailout) abort();
-        return NULL;
+        block->next = shared_cache[cls];
+        shared_cache[cls] = block;
+        shared_cache_count[cls]++;
+        block = NULL;
     }
+    pthread_mutex_unlock(&shared_cache_lock);
 
-    memcpy((void*)((intptr_t)mem+ALIGNMENT), (void*)((intptr_t)ptr+ALIGNMENT), MIN(size,old_size));
+    if (block != NULL)
+    {
+        free(block);
+        __sync_sub_and_fetch(&mem_cached, class_size(cls));
+    }
+}
 
-    aq_free(ptr, file, line);
+static void* out_of_memory(const size_t size, const char *file, const int line, const int bailout)
+{
+    if (bailout)
+    {
+        fprintf(stderr, "%s:%d: out of memory allocating %zu bytes (%zu bytes in use, limit %zu)\n",
+                file, line, size, mem_used, mem_limit);
+        abort();
+    }
 
-    mem_used += size-old_size;
-    *(size_t*)mem = size;
+    return NULL;
+}
 
-    return (void*)((intptr_t)mem+ALIGNMENT);
+void* aq_malloc(const size_t size_, const char *file, const int line, const int bailout)
+{
+    size_t size = MAX(size_,1);
+    int cls = size_class(size+CACHE_LINE);
+
+    block_header* block = NULL;
+    if (cls >= 0)
+    {
+        block = cache_alloc(cls);
+        if (block == NULL) block = system_alloc(class_size(cls));
+    }
+    else
+    {
+        block = system_alloc(size+CACHE_LINE);
+    }
+
+    if (block == NULL) return out_of_memory(size, file, line, bailout);
+
+    block->size = size;
+    block->cls = cls;
+
+    return DATA(block);
 }
 
-void aq_free(void* ptr, const char *file, const int line)
+void* aq_realloc(void* ptr, const size_t size_, const char *file, const int line, const int bailout)
 {
-	if (ptr == NULL) return;
+    size_t size = MAX(size_,1);
 
-    ptr = (void*)((intptr_t)ptr-ALIGNMENT);
-	size_t old_size = *(size_t*)ptr;
+    if (ptr == NULL) return aq_malloc(size, file, line, bailout);
 
-    free(ptr);
+    block_header* block = HEADER(ptr);
 
-    mem_used -= old_size+ALIGNMENT;
+    /*
+     * Grow or shrink in place within the size class
+     */
+    if (block->cls >= 0 && size_class(size+CACHE_LINE) == block->cls)
+    {
+        block->size = size;
+        return ptr;
+    }
+
+    void* mem = aq_malloc(size, file, line, bailout);
+    if (mem == NULL) return NULL;
+
+    memcpy(mem, ptr, MIN(size,block->size));
+    aq_free(ptr, file, line);
+
+    return mem;
+}
+
+void aq_free(void* ptr, const char *file, const int line)
+{
+    if (ptr == NULL) return;
+
+    block_header* block = HEADER(ptr);
+
+    if (block->cls >= 0)
+    {
+        cache_free(block);
+    }
+    else
+    {
+        __sync_sub_and_fetch(&mem_used, block->size+CACHE_LINE);
+        free(block);
+    }
 }
@@ -32,7 +32,14 @@
 
 #include "util/util.h"
 
-#define ALIGNMENT 16
+/*
+ * aq_malloc returns memory aligned to CACHE_LINE bytes; ALIGN rounds a number
+ * of doubles up to a whole number of cache lines, so that arrays laid out at
+ * multiples of it within such a block stay aligned
+ */
+#define CACHE_LINE 64
+
+#define ALIGNMENT (CACHE_LINE/sizeof(double))
 
 #define ALIGN(x) ((x)+((ALIGNMENT-((x)&(ALIGNMENT-1)))&(ALIGNMENT-1)))
 
@@ -54,10 +61,25 @@ for (x)
 
 #define REALLOC(type, ptr, size) (type*)aq_realloc(ptr, sizeof(type)*(size), __FILE__, __LINE__, 0)
 
+/*
+ * The SAFE_ variants do not return on failure: from C++ they throw std::runtime_error
+ * (so that the task fails cleanly), and from C they print a diagnostic and abort. C
+ * kernels should therefore use MALLOC and return an error code to their C++ caller.
+ */
+#ifdef __cplusplus
+
+#define SAFE_MALLOC(type, size) (type*)aq_safe_malloc(sizeof(type)*(size), __FILE__, __LINE__)
+
+#define SAFE_REALLOC(type, ptr, size) (type*)aq_safe_realloc(ptr, sizeof(type)*(size), __FILE__, __LINE__)
+
+#else
+
 #define SAFE_MALLOC(type, size) (type*)aq_malloc(sizeof(type)*(size), __FILE__, __LINE__, 1)
 
 #define SAFE_REALLOC(type, ptr, size) (type*)aq_realloc(ptr, sizeof(type)*(size), __FILE__, __LINE__, 1)
 
+#endif
+
 #define FREE(ptr) aq_free(ptr, __FILE__, __LINE__)
 
 #ifdef __cplusplus
@@ -73,6 +95,13 @@ size_t get_memory_limit();
 
 size_t get_memory_used();
 
+/*
+ * Largest amount of memory in use since the last reset
+ */
+size_t get_memory_high_water();
+
+void reset_memory_high_water();
+
 void* aq_malloc(const size_t size, const char* who, const int where, const int bailout);
 
 void* aq_realloc(void* ptr, const size_t size, const char* who, const int where, const int bailout);
@@ -81,6 +110,44 @@ void aq_free(void* ptr, const char* who, const int where);
 
 #ifdef __cplusplus
 }
+
+#include <cstdio>
+#include <stdexcept>
+
+inline void aq_throw_out_of_memory(const size_t size, const char* who, const int where)
+{
+    char msg[256];
+    snprintf(msg, sizeof(msg), "%s:%d: out of memory allocating %lu bytes (%lu bytes in use, limit %lu)",
+             who, where, (unsigned long)size, (unsigned long)get_memory_used(),
+             (unsigned long)get_memory_limit());
+    throw std::runtime_error(msg);
+}
+
+/*
+ * For C kernels which reported that they ran out of memory
+ */
+inline void aq_throw_out_of_memory(const char* who, const int where)
+{
+    char msg[256];
+    snprintf(msg, sizeof(msg), "%s:%d: out of memory (%lu bytes in use, limit %lu)",
+             who, where, (unsigned long)get_memory_used(), (unsigned long)get_memory_limit());
+    throw std::runtime_error(msg);
+}
+
+inline void* aq_safe_malloc(const size_t size, const char* who, const int where)
+{
+    void* ptr = aq_malloc(size, who, where, 0);
+    if (ptr == NULL) aq_throw_out_of_memory(size, who, where);
+    return ptr;
+}
+
+inline void* aq_safe_realloc(void* ptr, const size_t size, const char* who, const int where)
+{
+    void* mem = aq_realloc(ptr, size, who, where, 0);
+    if (mem == NULL) aq_throw_out_of_memory(size, who, where);
+    return mem;
+}
+
 #endif
 
 #endif
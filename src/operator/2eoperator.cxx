@@ -81,6 +81,24 @@ TwoElectronOperator<T>::TwoElectronOperator(const string& name, const OneElectro
   abci(this->addTensor(new SpinorbitalTensor<T>(name, other.arena, other.occ.group, std::vec(other.vrt, other.occ), std::vec(2,0), std::vec(1,1)))),
   abcd(this->addTensor(new SpinorbitalTensor<T>(name, other.arena, other.occ.group, std::vec(other.vrt, other.occ), std::vec(2,0), std::vec(2,0)))) {}
 
+template <typename T>
+TwoElectronOperator<T>::TwoElectronOperator(const string& name, const OneElectronOperator<T>& other, CholeskyFactors<T>* factors)
+: OneElectronOperatorBase<T,TwoElectronOperator<T> >(name, other),
+  ijkl(this->addTensor(new SpinorbitalTensor<T>(name, other.arena, other.occ.group, std::vec(other.vrt, other.occ), std::vec(0,2), std::vec(0,2)))),
+  aijk(this->addTensor(new SpinorbitalTensor<T>(name, other.arena, other.occ.group, std::vec(other.vrt, other.occ), std::vec(1,1), std::vec(0,2)))),
+  ijak(this->addTensor(new SpinorbitalTensor<T>(name, other.arena, other.occ.group, std::vec(other.vrt, other.occ), std::vec(0,2), std::vec(1,1)))),
+  abij(this->addTensor(new SpinorbitalTensor<T>(name, other.arena, other.occ.group, std::vec(other.vrt, other.occ), std::vec(2,0), std::vec(0,2)))),
+  ijab(this->addTensor(new SpinorbitalTensor<T>(name, other.arena, other.occ.group, std::vec(other.vrt, other.occ), std::vec(0,2), std::vec(2,0)))),
+  aibj(this->addTensor(new SpinorbitalTensor<T>(name, other.arena, other.occ.group, std::vec(other.vrt, other.occ), std::vec(1,1), std::vec(1,1)))),
+  /*
+   * Placeholders with an empty virtual space, so that generic code (copies, dot, etc.)
+   * still sees every block
+   */
+  aibc(this->addTensor(new SpinorbitalTensor<T>(name, other.arena, other.occ.group, std::vec(Space(other.occ.group), other.occ), std::vec(1,1), std::vec(2,0)))),
+  abci(this->addTensor(new SpinorbitalTensor<T>(name, other.arena, other.occ.group, std::vec(Space(other.occ.group), other.occ), std::vec(2,0), std::vec(1,1)))),
+  abcd(this->addTensor(new SpinorbitalTensor<T>(name, other.arena, other.occ.group, std::vec(Space(other.occ.group), other.occ), std::vec(2,0), std::vec(2,0)))),
+  factors(factors) {}
+
 template <typename T>
 TwoElectronOperator<T>::TwoElectronOperator(const string& name, TwoElectronOperator<T>& other, int copy)
 : OneElectronOperatorBase<T,TwoElectronOperator<T> >(name, other, copy),
@@ -90,9 +108,10 @@ TwoElectronOperator<T>::TwoElectronOperator(const string& name, TwoElectronOpera
   abij(copy&ABIJ ? this->addTensor(new SpinorbitalTensor<T>(name, other.getABIJ())) : this->addTensor(other.getABIJ())),
   ijab(copy&IJAB ? this->addTensor(new SpinorbitalTensor<T>(name, other.getIJAB())) : this->addTensor(other.getIJAB())),
   aibj(copy&AIBJ ? this->addTensor(new SpinorbitalTensor<T>(name, other.getAIBJ())) : this->addTensor(other.getAIBJ())),
-  aibc(copy&AIBC ? this->addTensor(new SpinorbitalTensor<T>(name, other.getAIBC())) : this->addTensor(other.getAIBC())),
-  abci(copy&ABCI ? this->addTensor(new SpinorbitalTensor<T>(name, other.getABCI())) : this->addTensor(other.getABCI())),
-  abcd(copy&ABCD ? this->addTensor(new SpinorbitalTensor<T>(name, other.getABCD())) : this->addTensor(other.getABCD())) {}
+  aibc(copy&AIBC ? this->addTensor(new SpinorbitalTensor<T>(name, other.aibc)) : this->addTensor(other.aibc)),
+  abci(copy&ABCI ? this->addTensor(new SpinorbitalTensor<T>(name, other.abci)) : this->addTensor(other.abci)),
+  abcd(copy&ABCD ? this->addTensor(new SpinorbitalTensor<T>(name, other.abcd)) : this->addTensor(other.abcd)),
+  factors(other.factors) {}
 
 template <typename T>
 TwoElectronOperator<T>::TwoElectronOperator(const TwoElectronOperator<T>& other)
@@ -103,9 +122,10 @@ TwoElectronOperator<T>::TwoElectronOperator(const TwoElectronOperator<T>& other)
   abij(this->addTensor(new SpinorbitalTensor<T>(other.getABIJ()))),
   ijab(this->addTensor(new SpinorbitalTensor<T>(other.getIJAB()))),
   aibj(this->addTensor(new SpinorbitalTensor<T>(other.getAIBJ()))),
-  aibc(this->addTensor(new SpinorbitalTensor<T>(other.getAIBC()))),
-  abci(this->addTensor(new SpinorbitalTensor<T>(other.getABCI()))),
-  abcd(this->addTensor(new SpinorbitalTensor<T>(other.getABCD()))) {}
+  aibc(this->addTensor(new SpinorbitalTensor<T>(other.aibc))),
+  abci(this->addTensor(new SpinorbitalTensor<T>(other.abci))),
+  abcd(this->addTensor(new SpinorbitalTensor<T>(other.abcd))),
+  factors(other.factors) {}
 
 template <typename T>
 TwoElectronOperator<T>::TwoElectronOperator(const string& name, const TwoElectronOperator<T>& other)
@@ -116,9 +136,10 @@ TwoElectronOperator<T>::TwoElectronOperator(const string& name, const TwoElectro
   abij(this->addTensor(new SpinorbitalTensor<T>(name, other.getABIJ()))),
   ijab(this->addTensor(new SpinorbitalTensor<T>(name, other.getIJAB()))),
   aibj(this->addTensor(new SpinorbitalTensor<T>(name, other.getAIBJ()))),
-  aibc(this->addTensor(new SpinorbitalTensor<T>(name, other.getAIBC()))),
-  abci(this->addTensor(new SpinorbitalTensor<T>(name, other.getABCI()))),
-  abcd(this->addTensor(new SpinorbitalTensor<T>(name, other.getABCD()))) {}
+  aibc(this->addTensor(new SpinorbitalTensor<T>(name, other.aibc))),
+  abci(this->addTensor(new SpinorbitalTensor<T>(name, other.abci))),
+  abcd(this->addTensor(new SpinorbitalTensor<T>(name, other.abcd))),
+  factors(other.factors) {}
 
 template <typename T>
 T TwoElectronOperator<T>::dot(bool conja, const TwoElectronOperator<T>& A, bool conjb) const
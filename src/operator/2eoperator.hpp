@@ -25,7 +25,12 @@
 #ifndef _AQUARIUS_OPERATOR_2EOPERATOR_HPP_
 #define _AQUARIUS_OPERATOR_2EOPERATOR_HPP_
 
+#include <stdexcept>
+
+#include "util/stl_ext.hpp"
+
 #include "1eoperator.hpp"
+#include "choleskyfactors.hpp"
 
 namespace aquarius
 {
@@ -45,6 +50,13 @@ class TwoElectronOperator : public OneElectronOperatorBase<T,TwoElectronOperator
         tensor::SpinorbitalTensor<T>& aibc;
         tensor::SpinorbitalTensor<T>& abci;
         tensor::SpinorbitalTensor<T>& abcd;
+        std::shared_ptr<CholeskyFactors<T> > factors;
+
+        void checkNotFactorized() const
+        {
+            if (factors.get() != NULL)
+                throw std::runtime_error("the AIBC, ABCI, and ABCD blocks of a factorized operator are not available");
+        }
 
     public:
         enum
@@ -68,6 +80,12 @@ class TwoElectronOperator : public OneElectronOperatorBase<T,TwoElectronOperator
 
         TwoElectronOperator(const std::string& name, const OneElectronOperator<T>& other);
 
+        /*
+         * Create an operator whose AIBC, ABCI, and ABCD blocks are represented only by
+         * the given factors, which are then owned by this operator and any copies of it
+         */
+        TwoElectronOperator(const std::string& name, const OneElectronOperator<T>& other, CholeskyFactors<T>* factors);
+
         TwoElectronOperator(const std::string& name, TwoElectronOperator<T>& other, int copy);
 
         TwoElectronOperator(const TwoElectronOperator<T>& other);
@@ -82,9 +100,9 @@ class TwoElectronOperator : public OneElectronOperatorBase<T,TwoElectronOperator
         tensor::SpinorbitalTensor<T>& getABIJ() { return abij; }
         tensor::SpinorbitalTensor<T>& getIJAB() { return ijab; }
         tensor::SpinorbitalTensor<T>& getAIBJ() { return aibj; }
-        tensor::SpinorbitalTensor<T>& getAIBC() { return aibc; }
-        tensor::SpinorbitalTensor<T>& getABCI() { return abci; }
-        tensor::SpinorbitalTensor<T>& getABCD() { return abcd; }
+        tensor::SpinorbitalTensor<T>& getAIBC() { checkNotFactorized(); return aibc; }
+        tensor::SpinorbitalTensor<T>& getABCI() { checkNotFactorized(); return abci; }
+        tensor::SpinorbitalTensor<T>& getABCD() { checkNotFactorized(); return abcd; }
 
         const tensor::SpinorbitalTensor<T>& getIJKL() const { return ijkl; }
         const tensor::SpinorbitalTensor<T>& getAIJK() const { return aijk; }
@@ -92,9 +110,13 @@ class TwoElectronOperator : public OneElectronOperatorBase<T,TwoElectronOperator
         const tensor::SpinorbitalTensor<T>& getABIJ() const { return abij; }
         const tensor::SpinorbitalTensor<T>& getIJAB() const { return ijab; }
         const tensor::SpinorbitalTensor<T>& getAIBJ() const { return aibj; }
-        const tensor::SpinorbitalTensor<T>& getAIBC() const { return aibc; }
-        const tensor::SpinorbitalTensor<T>& getABCI() const { return abci; }
-        const tensor::SpinorbitalTensor<T>& getABCD() const { return abcd; }
+        const tensor::SpinorbitalTensor<T>& getAIBC() const { checkNotFactorized(); return aibc; }
+        const tensor::SpinorbitalTensor<T>& getABCI() const { checkNotFactorized(); return abci; }
+        const tensor::SpinorbitalTensor<T>& getABCD() const { checkNotFactorized(); return abcd; }
+
+        bool isFactorized() const { return factors.get() != NULL; }
+
+        const CholeskyFactors<T>& getFactors() const { return *factors; }
 };
 
 }
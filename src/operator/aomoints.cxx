@@ -24,6 +24,7 @@
 
 #include <algorithm>
 #include <numeric>
+#include <cmath>
 #include <limits.h>
 
 #include "aomoints.hpp"
@@ -49,19 +50,32 @@ AOMOIntegrals<T>::AOMOIntegrals(const string& name, const Config& config)
 }
 
 template <typename T>
-AOMOIntegrals<T>::pqrs_integrals::pqrs_integrals(const vector<int>& norb, const ERI& aoints)
+AOMOIntegrals<T>::AOMOIntegrals(const string& type, const string& name, const Config& config,
+                                const string& product)
+: MOIntegrals<T>(type, name, config, product)
+{
+    this->getProduct("H").addRequirement(Requirement("eri","I"));
+}
+
+template <typename T>
+AOMOIntegrals<T>::pqrs_integrals::pqrs_integrals(const vector<int>& norb, const ERI& aoints, size_t chunk)
 : Distributed(aoints.arena), group(aoints.group)
 {
     PROFILE_FUNCTION
 
     ns = nr = nq = np = norb;
 
-    const vector<T>& oldints = aoints.ints;
-    const vector<idx4_t>& oldidxs = aoints.idxs;
-    size_t noldints = oldints.size();
-    size_t nints = noldints;
+    if (chunk >= aoints.getNumChunks())
+    {
+        PROFILE_RETURN;
+    }
 
-    for (size_t i = 0;i < noldints;i++)
+    vector<double> oldints;
+    vector<idx4_t> oldidxs;
+    aoints.readChunk(chunk, oldints, oldidxs);
+
+    size_t nints = oldints.size();
+    for (size_t i = 0;i < oldints.size();i++)
     {
         idx4_t idx = oldidxs[i];
 
@@ -76,7 +90,7 @@ AOMOIntegrals<T>::pqrs_integrals::pqrs_integrals(const vector<int>& norb, const
     idxs.resize(nints);
 
     size_t j = 0;
-    for (size_t i = 0;i < noldints;i++)
+    for (size_t i = 0;i < oldints.size();i++)
     {
         T val = oldints[i];
         idx4_t idx = oldidxs[i];
@@ -371,6 +385,124 @@ AOMOIntegrals<T>::abrs_integrals::abrs_integrals(pqrs_integrals& pqrs, const boo
     PROFILE_STOP
 }
 
+template <typename T>
+AOMOIntegrals<T>::abrs_integrals::abrs_integrals(const Arena& arena, const PointGroup& group,
+                                                 const vector<int>& na, const vector<int>& nb,
+                                                 const vector<int>& nrs)
+: Distributed(arena), group(group), na(na), nb(nb), nr(nrs), ns(nrs)
+{
+    size_t nrstot = sum(nrs);
+    size_t nrs_ = nrstot*(nrstot+1)/2;
+    size_t rsbegin = (nrs_*rank)/nproc;
+    size_t rsend = (nrs_*(rank+1))/nproc;
+
+    rs.resize(rsend-rsbegin);
+
+    size_t nints = 0;
+    for (size_t irs = rsbegin;irs < rsend;irs++)
+    {
+        /*
+         * Invert irs = r+s*(s+1)/2
+         */
+        size_t s = (size_t)((sqrt(8.0*irs+1.0)-1.0)/2.0);
+        while (s*(s+1)/2 > irs) s--;
+        while ((s+1)*(s+2)/2 <= irs) s++;
+        size_t r = irs-s*(s+1)/2;
+
+        rs[irs-rsbegin] = idx2_t(r, s);
+        nints += getNumAB(rs[irs-rsbegin]);
+    }
+
+    ints.assign(nints, (T)0);
+}
+
+template <typename T>
+void AOMOIntegrals<T>::abrs_integrals::accumulate(const pqrs_integrals& pqrs, const bool pleq,
+                                                  const vector<int>& nc, const vector<vector<T> >& C)
+{
+    PROFILE_FUNCTION
+
+    assert(na == pqrs.np);
+    assert(nb == nc);
+    assert(nr == pqrs.nr);
+    assert(ns == pqrs.ns);
+
+    int n = group.getNumIrreps();
+    const vector<int>& np = pqrs.np;
+    const vector<int>& nq = pqrs.nq;
+
+    vector<int> irrepp;
+    for (int i = 0;i < n;i++) irrepp += vector<int>(np[i],i);
+    vector<int> irrepq;
+    for (int i = 0;i < n;i++) irrepq += vector<int>(nq[i],i);
+
+    vector<int> startp(n,0);
+    for (int i = 1;i < n;i++) startp[i] = startp[i-1]+np[i-1];
+    vector<int> startq(n,0);
+    for (int i = 1;i < n;i++) startq[i] = startq[i-1]+nq[i-1];
+
+    /*
+     * Offset of each of our rs pairs, and the ranges of pqrs with the same rs
+     */
+    size_t nrtot = sum(nr);
+    vector<size_t> offrs(nrtot*sum(ns), SIZE_MAX);
+    for (size_t irs = 0, off = 0;irs < rs.size();irs++)
+    {
+        offrs[rs[irs].i+rs[irs].j*nrtot] = off;
+        off += getNumAB(rs[irs]);
+    }
+
+    vector<size_t> groups;
+    for (size_t ipqrs = 0;ipqrs < pqrs.ints.size();ipqrs++)
+    {
+        if (ipqrs == 0 ||
+            pqrs.idxs[ipqrs].k != pqrs.idxs[ipqrs-1].k ||
+            pqrs.idxs[ipqrs].l != pqrs.idxs[ipqrs-1].l) groups.push_back(ipqrs);
+    }
+    groups.push_back(pqrs.ints.size());
+
+    long_int flops = 0;
+    #pragma omp parallel
+    {
+        vector<size_t> offpc(n*n);
+
+        #pragma omp for schedule(dynamic), reduction(+:flops)
+        for (size_t g = 0;g < groups.size()-1;g++)
+        {
+            idx2_t rspair(pqrs.idxs[groups[g]].k, pqrs.idxs[groups[g]].l);
+            size_t off = offrs[rspair.i+rspair.j*nrtot];
+            assert(off != SIZE_MAX);
+
+            fill(offpc.begin(), offpc.end(), SIZE_MAX);
+            getNumAB(rspair, offpc);
+
+            for (size_t ipqrs = groups[g];ipqrs < groups[g+1];ipqrs++)
+            {
+                T val = pqrs.ints[ipqrs];
+                int p = pqrs.idxs[ipqrs].i;
+                int q = pqrs.idxs[ipqrs].j;
+
+                for (int swapped = 0;swapped < (pleq && p != q ? 2 : 1);swapped++)
+                {
+                    if (swapped) std::swap(p, q);
+
+                    int irrp = irrepp[p];
+                    int irrq = irrepq[q];
+                    if (nc[irrq] == 0) continue;
+
+                    assert(offpc[irrp+irrq*n] != SIZE_MAX);
+                    axpy(nc[irrq], val, C[irrq].data()+(q-startq[irrq]), nq[irrq],
+                         ints.data()+off+offpc[irrp+irrq*n]+(p-startp[irrp]), np[irrp]);
+                    flops += 2*nc[irrq];
+                }
+            }
+        }
+    }
+    PROFILE_FLOPS(flops);
+
+    PROFILE_STOP
+}
+
 template <typename T>
 typename AOMOIntegrals<T>::abrs_integrals
 AOMOIntegrals<T>::abrs_integrals::transform(Index index, const vector<int>& nc, const vector<vector<T> >& C)
@@ -827,26 +959,38 @@ void AOMOIntegrals<T>::run(TaskDAG& dag, const Arena& arena)
     #define SHOWIT(name) cout << #name ": " << absmax(name.ints) << endl;
 
     /*
-     * Resort integrals so that each node has (pq|r_k s_l) where pq
-     * are dense blocks for each sparse rs pair
+     * Stream the stored integrals one chunk at a time: each chunk is resorted so
+     * that each node has (pq|r_k s_l) for its own rs pairs and immediately added
+     * into the first quarter-transformation, so that the untransformed integrals
+     * never take more than about one chunk
      */
-    pqrs_integrals pqrs(N, ints);
-    pqrs.collect(true);
-    abrs_integrals PQrs(pqrs, true);
+    abrs_integrals PArs(arena, ints.group, N, nA, N);
+    abrs_integrals Pars(arena, ints.group, N, na, N);
+    abrs_integrals PIrs(arena, ints.group, N, nI, N);
+    abrs_integrals Pirs(arena, ints.group, N, ni, N);
 
-    /*
-     * First quarter-transformation
-     */
-    //SHOWIT(PQrs);
-    abrs_integrals PArs = PQrs.transform(B, nA, cA);
+    long_int nchunk = ints.getNumChunks();
+    arena.Allreduce(&nchunk, 1, MPI::MAX);
+
+    for (long_int chunk = 0;chunk < nchunk;chunk++)
+    {
+        pqrs_integrals pqrs(N, ints, chunk);
+        pqrs.collect(true);
+
+        /*
+         * First quarter-transformation
+         */
+        PArs.accumulate(pqrs, true, nA, cA);
+        Pars.accumulate(pqrs, true, na, ca);
+        PIrs.accumulate(pqrs, true, nI, cI);
+        Pirs.accumulate(pqrs, true, ni, ci);
+
+        pqrs.free();
+    }
     //SHOWIT(PArs);
-    abrs_integrals Pars = PQrs.transform(B, na, ca);
     //SHOWIT(Pars);
-    abrs_integrals PIrs = PQrs.transform(B, nI, cI);
     //SHOWIT(PIrs);
-    abrs_integrals Pirs = PQrs.transform(B, ni, ci);
     //SHOWIT(Pirs);
-    PQrs.free();
 
     /*
      * Second quarter-transformation
@@ -43,7 +43,10 @@ class AOMOIntegrals : public MOIntegrals<T>
     public:
         AOMOIntegrals(const std::string& name, const input::Config& config);
 
-    private:
+    protected:
+        AOMOIntegrals(const std::string& type, const std::string& name, const input::Config& config,
+                      const std::string& product);
+
         enum Side {NONE, PQ, RS};
         enum Index {A, B};
 
@@ -57,9 +60,10 @@ class AOMOIntegrals : public MOIntegrals<T>
             std::vararray<idx4_t> idxs;
 
             /*
-             * Read integrals in and break (pq|rs)=(rs|pq) symmetry
+             * Read one chunk of integrals in and break (pq|rs)=(rs|pq) symmetry; chunks
+             * past the last one stored on this node give no integrals
              */
-            pqrs_integrals(const std::vector<int>& norb, const integrals::ERI& aoints);
+            pqrs_integrals(const std::vector<int>& norb, const integrals::ERI& aoints, size_t chunk);
 
             pqrs_integrals(abrs_integrals& abrs);
 
@@ -89,6 +93,21 @@ class AOMOIntegrals : public MOIntegrals<T>
              */
             abrs_integrals(pqrs_integrals& pqrs, const bool pleq);
 
+            /*
+             * Zero (ab|rs) for every r <= s pair assigned to this node by
+             * pqrs_integrals::collect(true)
+             */
+            abrs_integrals(const Arena& arena, const symmetry::PointGroup& group,
+                           const std::vector<int>& na, const std::vector<int>& nb,
+                           const std::vector<int>& nrs);
+
+            /*
+             * Add the transformation (pq|rs) -> (pc|rs) of the collected integrals in pqrs,
+             * where pleq has the same meaning as above
+             */
+            void accumulate(const pqrs_integrals& pqrs, const bool pleq,
+                            const std::vector<int>& nc, const std::vector<std::vector<T> >& C);
+
             /*
              * Transform (ab|rs) -> (cb|rs) (index = A) or (ab|rs) -> (ac|rs) (index = B)
              *
@@ -105,7 +124,6 @@ class AOMOIntegrals : public MOIntegrals<T>
             size_t getNumAB(idx2_t rs, std::vector<size_t>& offab);
         };
 
-    protected:
         void run(task::TaskDAG& dag, const Arena& arena);
 };
 
@@ -0,0 +1,204 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+
+#include "aormoints.hpp"
+
+#include "time/time.hpp"
+#include "util/util.h"
+
+using namespace std;
+using namespace aquarius;
+using namespace aquarius::op;
+using namespace aquarius::tensor;
+using namespace aquarius::input;
+using namespace aquarius::integrals;
+using namespace aquarius::task;
+using namespace aquarius::symmetry;
+
+template <typename T>
+AORMOIntegrals<T>::AORMOIntegrals(const string& name, const Config& config)
+: AOMOIntegrals<T>("aormoints", name, config, "rmoints") {}
+
+template <typename T>
+void AORMOIntegrals<T>::run(TaskDAG& dag, const Arena& arena)
+{
+    typedef typename AOMOIntegrals<T>::pqrs_integrals pqrs_integrals;
+    typedef typename AOMOIntegrals<T>::abrs_integrals abrs_integrals;
+
+    const MOSpace<T>& occ = this->template get<MOSpace<T> >("occ");
+    const MOSpace<T>& vrt = this->template get<MOSpace<T> >("vrt");
+
+    if (occ.nalpha != occ.nbeta || vrt.nalpha != vrt.nbeta)
+    {
+        throw runtime_error("Restricted MO integrals require a closed-shell (RHF) reference");
+    }
+
+    const SymmetryBlockedTensor<T>& Fa = this->template get<SymmetryBlockedTensor<T> >("Fa");
+
+    this->put("H", new RestrictedTwoElectronOperator<T>("V", arena, occ, vrt));
+    RestrictedTwoElectronOperator<T>& H = this->template get<RestrictedTwoElectronOperator<T> >("H");
+
+    const ERI& ints = this->template get<ERI>("I");
+
+    int n = ints.group.getNumIrreps();
+    const vector<int>& N = occ.nao;
+    const vector<int>& nI = occ.nalpha;
+    const vector<int>& nA = vrt.nalpha;
+
+    /*
+     * Fock matrix blocks
+     */
+    {
+        OneElectronOperator<T> f("f", occ, vrt, Fa, Fa);
+        H.getAB()["ab"] = f.getAB()(vec(1,0),vec(1,0))["ab"];
+        H.getIJ()["ij"] = f.getIJ()(vec(0,1),vec(0,1))["ij"];
+        H.getAI()["ai"] = f.getAI()(vec(1,0),vec(0,1))["ai"];
+        H.getIA()["ia"] = f.getIA()(vec(0,1),vec(1,0))["ia"];
+    }
+
+    vector<vector<T> > cA(n), cI(n);
+
+    /*
+     * Read transformation coefficients
+     */
+    for (int i = 0;i < n;i++)
+    {
+        vector<int> irreps = vec(i,i);
+        vrt.Calpha.getAllData(irreps, cA[i]);
+        assert(cA[i].size() == N[i]*nA[i]);
+        occ.Calpha.getAllData(irreps, cI[i]);
+        assert(cI[i].size() == N[i]*nI[i]);
+    }
+
+    /*
+     * First quarter-transformation, streamed one chunk at a time as in AOMOIntegrals
+     */
+    abrs_integrals PArs(arena, ints.group, N, nA, N);
+    abrs_integrals PIrs(arena, ints.group, N, nI, N);
+
+    long_int nchunk = ints.getNumChunks();
+    arena.Allreduce(&nchunk, 1, MPI::MAX);
+
+    for (long_int chunk = 0;chunk < nchunk;chunk++)
+    {
+        pqrs_integrals pqrs(N, ints, chunk);
+        pqrs.collect(true);
+
+        PArs.accumulate(pqrs, true, nA, cA);
+        PIrs.accumulate(pqrs, true, nI, cI);
+
+        pqrs.free();
+    }
+
+    /*
+     * Second quarter-transformation
+     */
+    abrs_integrals ABrs = PArs.transform(AOMOIntegrals<T>::A, nA, cA);
+    PArs.free();
+    abrs_integrals AIrs = PIrs.transform(AOMOIntegrals<T>::A, nA, cA);
+    abrs_integrals IJrs = PIrs.transform(AOMOIntegrals<T>::A, nI, cI);
+    PIrs.free();
+
+    /*
+     * Make <Ab|Cd>
+     */
+    {
+        pqrs_integrals rsAB(ABrs);
+        rsAB.collect(false);
+
+        abrs_integrals RSAB(rsAB, true);
+        abrs_integrals RDAB = RSAB.transform(AOMOIntegrals<T>::B, nA, cA);
+        RSAB.free();
+
+        abrs_integrals CDAB = RDAB.transform(AOMOIntegrals<T>::A, nA, cA);
+        RDAB.free();
+        CDAB.transcribe(H.getABCD(), false, false, AOMOIntegrals<T>::NONE);
+        CDAB.free();
+    }
+
+    /*
+     * Make <Ab||cI>, <Ai|Bc>, and <Ab|Ij>; with the same alpha and beta orbitals,
+     * <Ab||cI> and <Ab|Ci> come from the same (BC|AI)
+     */
+    {
+        pqrs_integrals rsAI(AIrs);
+        rsAI.collect(false);
+
+        abrs_integrals RSAI(rsAI, true);
+        abrs_integrals RCAI = RSAI.transform(AOMOIntegrals<T>::B, nA, cA);
+        abrs_integrals RJAI = RSAI.transform(AOMOIntegrals<T>::B, nI, cI);
+        RSAI.free();
+
+        abrs_integrals BCAI = RCAI.transform(AOMOIntegrals<T>::A, nA, cA);
+        RCAI.free();
+
+        SymmetryBlockedTensor<T> AbCi("<Ab|Ci>", arena, ints.group, 4, vec(nA,nA,nA,nI), vec(NS,NS,NS,NS));
+        BCAI.transcribe(AbCi, false, false, AOMOIntegrals<T>::NONE);
+        BCAI.transcribe(H.getABCI(), false, false, AOMOIntegrals<T>::PQ);
+        BCAI.free();
+
+        H.getAIBC()["AiBc"] = AbCi["BcAi"];
+
+        abrs_integrals BJAI = RJAI.transform(AOMOIntegrals<T>::A, nA, cA);
+        RJAI.free();
+        BJAI.transcribe(H.getABIJ(), false, false, AOMOIntegrals<T>::NONE);
+        BJAI.free();
+    }
+
+    /*
+     * Make <Ai|Bj>, <Ai|Jk>, and <Ij|Kl>
+     */
+    {
+        pqrs_integrals rsIJ(IJrs);
+        rsIJ.collect(false);
+
+        abrs_integrals RSIJ(rsIJ, true);
+        abrs_integrals RBIJ = RSIJ.transform(AOMOIntegrals<T>::B, nA, cA);
+        abrs_integrals RLIJ = RSIJ.transform(AOMOIntegrals<T>::B, nI, cI);
+        RSIJ.free();
+
+        abrs_integrals ABIJ = RBIJ.transform(AOMOIntegrals<T>::A, nA, cA);
+        RBIJ.free();
+        ABIJ.transcribe(H.getAIBJ(), false, false, AOMOIntegrals<T>::NONE);
+        ABIJ.free();
+
+        abrs_integrals AKIJ = RLIJ.transform(AOMOIntegrals<T>::A, nA, cA);
+        abrs_integrals KLIJ = RLIJ.transform(AOMOIntegrals<T>::A, nI, cI);
+        RLIJ.free();
+        AKIJ.transcribe(H.getAIJK(), false, false, AOMOIntegrals<T>::NONE);
+        AKIJ.free();
+        KLIJ.transcribe(H.getIJKL(), false, false, AOMOIntegrals<T>::NONE);
+        KLIJ.free();
+    }
+
+    /*
+     * Fill in pieces which are equal by Hermicity
+     */
+    H.getIJAK()["JkAi"] = H.getAIJK()["AiJk"];
+    H.getIJAB()["IjAb"] = H.getABIJ()["AbIj"];
+}
+
+INSTANTIATE_SPECIALIZATIONS(AORMOIntegrals);
+REGISTER_TASK(AORMOIntegrals<double>,"aormoints");
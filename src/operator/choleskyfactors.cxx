@@ -0,0 +1,310 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+
+#include "choleskyfactors.hpp"
+
+using namespace std;
+using namespace aquarius;
+using namespace aquarius::op;
+using namespace aquarius::tensor;
+using namespace aquarius::symmetry;
+
+template <typename T>
+CholeskyFactors<T>::CholeskyFactors(const SymmetryBlockedTensor<T>& LAB, const SymmetryBlockedTensor<T>& Lab,
+                                    const SymmetryBlockedTensor<T>& LAI, const SymmetryBlockedTensor<T>& Lai,
+                                    const SymmetryBlockedTensor<T>& D, int batch_size)
+: arena(LAB.arena), group(LAB.getGroup()), batch_size(batch_size),
+  LAB("LAB", LAB), Lab("Lab", Lab), LAI("LAI", LAI), Lai("Lai", Lai), D("D", D)
+{
+    if (batch_size < 1) throw runtime_error("batch_size must be positive");
+}
+
+template <typename T>
+void CholeskyFactors<T>::contractBatched(const SymmetryBlockedTensor<T>& L1, const string& idx_L1,
+                                         const SymmetryBlockedTensor<T>& L2, const string& idx_L2,
+                                         const string& idx_V,
+                                         const SymmetryBlockedTensor<T>& B, const string& idx_B,
+                                         SymmetryBlockedTensor<T>& Y, const string& idx_Y) const
+{
+    assert(idx_V[0] == idx_L1[0] && idx_Y[0] == idx_L1[0]);
+    assert(idx_L1[2] == idx_L2[2]);
+
+    int n = group.getNumIrreps();
+    int ndim = Y.getDimension();
+    string idx_D(1, idx_L1[2]);
+
+    for (int h = 0;h < n;h++)
+    {
+        for (int start = 0;start < L1.getLengths()[0][h];start += batch_size)
+        {
+            int len = min(batch_size, L1.getLengths()[0][h]-start);
+
+            vector<vector<int> > start_L1(3, vector<int>(n, 0));
+            vector<vector<int> > len_L1(L1.getLengths());
+            start_L1[0][h] = start;
+            len_L1[0].assign(n, 0);
+            len_L1[0][h] = len;
+
+            SymmetryBlockedTensor<T> L1_batch("L1", L1, start_L1, len_L1);
+            SymmetryBlockedTensor<T> LD_batch("LD", arena, group, 3, len_L1, vec(NS,NS,NS), false);
+            LD_batch[idx_L1] = D[idx_D]*L1_batch[idx_L1];
+
+            vector<vector<int> > len_V(4);
+            for (int i = 0;i < 4;i++)
+            {
+                size_t pos = idx_L1.find(idx_V[i]);
+                if (pos != string::npos)
+                {
+                    len_V[i] = len_L1[pos];
+                }
+                else
+                {
+                    pos = idx_L2.find(idx_V[i]);
+                    assert(pos != string::npos);
+                    len_V[i] = L2.getLengths()[pos];
+                }
+            }
+
+            SymmetryBlockedTensor<T> V("V", arena, group, 4, len_V, vec(NS,NS,NS,NS), false);
+            V[idx_V] = LD_batch[idx_L1]*L2[idx_L2];
+
+            vector<vector<int> > len_Y(Y.getLengths());
+            len_Y[0] = len_L1[0];
+
+            SymmetryBlockedTensor<T> Y_batch("Y", arena, group, ndim, len_Y, vector<int>(ndim, NS), false);
+            Y_batch[idx_Y] = V[idx_V]*B[idx_B];
+
+            vector<vector<int> > start_Y(ndim, vector<int>(n, 0));
+            start_Y[0][h] = start;
+
+            Y.slice((T)1, false, Y_batch, (T)0, start_Y);
+        }
+    }
+}
+
+template <typename T>
+void CholeskyFactors<T>::calcQ(const SpinorbitalTensor<T>& T1,
+                               SymmetryBlockedTensor<T>& QA, SymmetryBlockedTensor<T>& Qa) const
+{
+    vector<int> shapeNNN = vec(NS,NS,NS);
+
+    {
+        SymmetryBlockedTensor<T> LT("LT", arena, group, 3, QA.getLengths(), shapeNNN, false);
+        LT["AIR"] = LAB["AER"]*T1(vec(1,0),vec(0,1))["EI"];
+        QA["AIR"] = D["R"]*LT["AIR"];
+    }
+
+    {
+        SymmetryBlockedTensor<T> LT("LT", arena, group, 3, Qa.getLengths(), shapeNNN, false);
+        LT["aiR"] = Lab["aeR"]*T1(vec(0,0),vec(0,0))["ei"];
+        Qa["aiR"] = D["R"]*LT["aiR"];
+    }
+}
+
+/*
+ * For like spins, sum_ef <ab||ef> Tau(ef,ij) = 2 sum_ef (ae|bf) Tau(ef,ij), which is already
+ * antisymmetric and so is picked up four times when added to an antisymmetric block
+ */
+template <typename T>
+void CholeskyFactors<T>::contractABCD(T alpha, const SpinorbitalTensor<T>& Tau, SpinorbitalTensor<T>& Z) const
+{
+    const vector<vector<int> >& lenA = LAB.getLengths();
+    const vector<vector<int> >& lena = Lab.getLengths();
+    const vector<int>& nA = lenA[0];
+    const vector<int>& na = lena[0];
+    const vector<int>& nI = LAI.getLengths()[1];
+    const vector<int>& ni = Lai.getLengths()[1];
+    vector<int> shapeNNNN = vec(NS,NS,NS,NS);
+
+    {
+        SymmetryBlockedTensor<T> Y("Y", arena, group, 4, vec(nA,nA,nI,nI), shapeNNNN, false);
+        contractBatched(LAB, "AER", LAB, "BFR", "AEBF", Tau(vec(2,0),vec(0,2)), "EFIJ", Y, "ABIJ");
+        Z(vec(2,0),vec(0,2))["ABIJ"] += 0.5*alpha*Y["ABIJ"];
+    }
+
+    {
+        SymmetryBlockedTensor<T> Y("Y", arena, group, 4, vec(nA,na,nI,ni), shapeNNNN, false);
+        contractBatched(LAB, "AER", Lab, "bfR", "AEbf", Tau(vec(1,0),vec(0,1)), "EfIj", Y, "AbIj");
+        Z(vec(1,0),vec(0,1))["AbIj"] += 2.0*alpha*Y["AbIj"];
+    }
+
+    {
+        SymmetryBlockedTensor<T> Y("Y", arena, group, 4, vec(na,na,ni,ni), shapeNNNN, false);
+        contractBatched(Lab, "aeR", Lab, "bfR", "aebf", Tau(vec(0,0),vec(0,0)), "efij", Y, "abij");
+        Z(vec(0,0),vec(0,0))["abij"] += 0.5*alpha*Y["abij"];
+    }
+}
+
+/*
+ * With Q(ai,R) = sum_e (ae|R) T1(e,i), P(ij) sum_e <ab||ej> T1(e,i) is the full antisymmetrization
+ * of sum_R Q(ai,R) L(bj,R)
+ */
+template <typename T>
+void CholeskyFactors<T>::contractABCI(T alpha, const SpinorbitalTensor<T>& T1, SpinorbitalTensor<T>& Z) const
+{
+    vector<int> shapeNNN = vec(NS,NS,NS);
+
+    SymmetryBlockedTensor<T> QA("QA", arena, group, 3, LAI.getLengths(), shapeNNN, false);
+    SymmetryBlockedTensor<T> Qa("Qa", arena, group, 3, Lai.getLengths(), shapeNNN, false);
+    calcQ(T1, QA, Qa);
+
+    Z(vec(2,0),vec(0,2))["ABIJ"] += alpha*QA["AIR"]*LAI["BJR"];
+    Z(vec(1,0),vec(0,1))["AbIj"] += alpha*QA["AIR"]*Lai["bjR"];
+    Z(vec(1,0),vec(0,1))["AbIj"] += alpha*LAI["AIR"]*Qa["bjR"];
+    Z(vec(0,0),vec(0,0))["abij"] += alpha*Qa["aiR"]*Lai["bjR"];
+}
+
+/*
+ * sum_mef <am||ef> Tau(ef,im) = 2 sum_e sum_R (ae|R) X(ei,R) with X(ei,R) = sum_mf (R|fm) Tau(ef,im)
+ */
+template <typename T>
+void CholeskyFactors<T>::contractAIBCToAI(T alpha, const SpinorbitalTensor<T>& Tau, SpinorbitalTensor<T>& Z) const
+{
+    vector<int> shapeNNN = vec(NS,NS,NS);
+
+    const SymmetryBlockedTensor<T>& TauAA = Tau(vec(2,0),vec(0,2));
+    const SymmetryBlockedTensor<T>& TauAb = Tau(vec(1,0),vec(0,1));
+    const SymmetryBlockedTensor<T>& Tauab = Tau(vec(0,0),vec(0,0));
+
+    SymmetryBlockedTensor<T> XA("XA", arena, group, 3, LAI.getLengths(), shapeNNN, false);
+    SymmetryBlockedTensor<T> Xa("Xa", arena, group, 3, Lai.getLengths(), shapeNNN, false);
+
+    XA["EIR"]  = LAI["FMR"]*TauAA["EFIM"];
+    XA["EIR"] += Lai["fmR"]*TauAb["EfIm"];
+    Xa["eiR"]  = Lai["fmR"]*Tauab["efim"];
+    Xa["eiR"] += LAI["FMR"]*TauAb["FeMi"];
+
+    SymmetryBlockedTensor<T> XDA("XDA", arena, group, 3, LAI.getLengths(), shapeNNN, false);
+    SymmetryBlockedTensor<T> XDa("XDa", arena, group, 3, Lai.getLengths(), shapeNNN, false);
+
+    XDA["EIR"] = D["R"]*XA["EIR"];
+    XDa["eiR"] = D["R"]*Xa["eiR"];
+
+    Z(vec(1,0),vec(0,1))["AI"] += 2.0*alpha*LAB["AER"]*XDA["EIR"];
+    Z(vec(0,0),vec(0,0))["ai"] += 2.0*alpha*Lab["aeR"]*XDa["eiR"];
+}
+
+template <typename T>
+void CholeskyFactors<T>::contractAIBCToAB(T alpha, const SpinorbitalTensor<T>& T1, SpinorbitalTensor<T>& F) const
+{
+    vector<int> shapeNNN = vec(NS,NS,NS);
+
+    /*
+     * Coulomb part, sum_R (ae|R) t(R) with t(R) = sum_mf (R|fm) T1(f,m)
+     */
+    SymmetryBlockedTensor<T> t("t", arena, group, 1, vec(LAB.getLengths()[2]), vec(NS), false);
+    SymmetryBlockedTensor<T> td("td", arena, group, 1, vec(LAB.getLengths()[2]), vec(NS), false);
+    t["R"]  = LAI["FMR"]*T1(vec(1,0),vec(0,1))["FM"];
+    t["R"] += Lai["fmR"]*T1(vec(0,0),vec(0,0))["fm"];
+    td["R"] = D["R"]*t["R"];
+
+    F(vec(1,0),vec(1,0))["AE"] += alpha*LAB["AER"]*td["R"];
+    F(vec(0,0),vec(0,0))["ae"] += alpha*Lab["aeR"]*td["R"];
+
+    /*
+     * Exchange part, -sum_R Q(am,R) (R|em)
+     */
+    SymmetryBlockedTensor<T> QA("QA", arena, group, 3, LAI.getLengths(), shapeNNN, false);
+    SymmetryBlockedTensor<T> Qa("Qa", arena, group, 3, Lai.getLengths(), shapeNNN, false);
+    calcQ(T1, QA, Qa);
+
+    F(vec(1,0),vec(1,0))["AE"] -= alpha*QA["AMR"]*LAI["EMR"];
+    F(vec(0,0),vec(0,0))["ae"] -= alpha*Qa["amR"]*Lai["emR"];
+}
+
+/*
+ * sum_ef <am||ef> Tau(ef,ij) = 2 sum_ef (ae|mf) Tau(ef,ij), where (ae|mf) is only formed in batches of a
+ */
+template <typename T>
+void CholeskyFactors<T>::contractAIBCToAIJK(T alpha, const SpinorbitalTensor<T>& Tau, SpinorbitalTensor<T>& W) const
+{
+    const vector<int>& nA = LAB.getLengths()[0];
+    const vector<int>& na = Lab.getLengths()[0];
+    const vector<int>& nI = LAI.getLengths()[1];
+    const vector<int>& ni = Lai.getLengths()[1];
+    vector<int> shapeNNNN = vec(NS,NS,NS,NS);
+
+    {
+        SymmetryBlockedTensor<T> Y("Y", arena, group, 4, vec(nA,nI,nI,nI), shapeNNNN, false);
+        contractBatched(LAB, "AER", LAI, "FIR", "AEIF", Tau(vec(2,0),vec(0,2)), "EFJK", Y, "AIJK");
+        W(vec(1,1),vec(0,2))["AIJK"] += alpha*Y["AIJK"];
+    }
+
+    {
+        SymmetryBlockedTensor<T> Y("Y", arena, group, 4, vec(nA,ni,nI,ni), shapeNNNN, false);
+        contractBatched(LAB, "AER", Lai, "fiR", "AEif", Tau(vec(1,0),vec(0,1)), "EfJk", Y, "AiJk");
+        W(vec(1,0),vec(0,1))["AiJk"] += 2.0*alpha*Y["AiJk"];
+    }
+
+    {
+        SymmetryBlockedTensor<T> Y("Y", arena, group, 4, vec(na,nI,nI,ni), shapeNNNN, false);
+        contractBatched(Lab, "afR", LAI, "EIR", "afIE", Tau(vec(1,0),vec(0,1)), "EfJk", Y, "aIJk");
+        W(vec(0,1),vec(0,1))["aIJk"] -= 2.0*alpha*Y["aIJk"];
+    }
+
+    {
+        SymmetryBlockedTensor<T> Y("Y", arena, group, 4, vec(na,ni,ni,ni), shapeNNNN, false);
+        contractBatched(Lab, "aeR", Lai, "fiR", "aeif", Tau(vec(0,0),vec(0,0)), "efjk", Y, "aijk");
+        W(vec(0,0),vec(0,0))["aijk"] += alpha*Y["aijk"];
+    }
+}
+
+/*
+ * sum_f <am||ef> T1(f,i) = sum_R (ae|R) P(mi,R) - sum_R Q(ai,R) (R|em)
+ * with P(mi,R) = sum_f (R|fm) T1(f,i)
+ */
+template <typename T>
+void CholeskyFactors<T>::contractAIBCToAIBJ(T alpha, const SpinorbitalTensor<T>& T1, SpinorbitalTensor<T>& W) const
+{
+    const vector<int>& nI = LAI.getLengths()[1];
+    const vector<int>& ni = Lai.getLengths()[1];
+    const vector<int>& lenR = LAB.getLengths()[2];
+    vector<int> shapeNNN = vec(NS,NS,NS);
+
+    SymmetryBlockedTensor<T> PA("PA", arena, group, 3, vec(nI,nI,lenR), shapeNNN, false);
+    SymmetryBlockedTensor<T> Pa("Pa", arena, group, 3, vec(ni,ni,lenR), shapeNNN, false);
+    PA["IJR"] = LAI["FIR"]*T1(vec(1,0),vec(0,1))["FJ"];
+    Pa["ijR"] = Lai["fiR"]*T1(vec(0,0),vec(0,0))["fj"];
+
+    SymmetryBlockedTensor<T> PDA("PDA", arena, group, 3, vec(nI,nI,lenR), shapeNNN, false);
+    SymmetryBlockedTensor<T> PDa("PDa", arena, group, 3, vec(ni,ni,lenR), shapeNNN, false);
+    PDA["IJR"] = D["R"]*PA["IJR"];
+    PDa["ijR"] = D["R"]*Pa["ijR"];
+
+    SymmetryBlockedTensor<T> QA("QA", arena, group, 3, LAI.getLengths(), shapeNNN, false);
+    SymmetryBlockedTensor<T> Qa("Qa", arena, group, 3, Lai.getLengths(), shapeNNN, false);
+    calcQ(T1, QA, Qa);
+
+    W(vec(1,1),vec(1,1))["AIBJ"] += alpha*LAB["ABR"]*PDA["IJR"];
+    W(vec(1,1),vec(1,1))["AIBJ"] -= alpha*QA["AJR"]*LAI["BIR"];
+    W(vec(1,0),vec(1,0))["AiBj"] += alpha*LAB["ABR"]*PDa["ijR"];
+    W(vec(0,1),vec(0,1))["aIbJ"] += alpha*Lab["abR"]*PDA["IJR"];
+    W(vec(0,0),vec(0,0))["aibj"] += alpha*Lab["abR"]*PDa["ijR"];
+    W(vec(0,0),vec(0,0))["aibj"] -= alpha*Qa["ajR"]*Lai["biR"];
+    W(vec(1,0),vec(0,1))["AibJ"] -= alpha*QA["AJR"]*Lai["biR"];
+    W(vec(0,1),vec(1,0))["aIBj"] -= alpha*Qa["ajR"]*LAI["BIR"];
+}
+
+INSTANTIATE_SPECIALIZATIONS(CholeskyFactors);
@@ -0,0 +1,121 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+
+#ifndef _AQUARIUS_OPERATOR_CHOLESKYFACTORS_HPP_
+#define _AQUARIUS_OPERATOR_CHOLESKYFACTORS_HPP_
+
+#include "tensor/spinorbital_tensor.hpp"
+#include "util/stl_ext.hpp"
+
+#include "space.hpp"
+
+namespace aquarius
+{
+namespace op
+{
+
+/*
+ * Three-index factors of the MO integrals, (pq|rs) = sum_R L(pq,R) D(R) L(rs,R),
+ * which stand in for the blocks of a two-electron operator with three or more
+ * virtual indices (ABCI, AIBC, and ABCD). Only L and D are kept; D is applied to
+ * the smaller intermediates as they are formed.
+ *
+ * Each contract function adds the same quantity to its result as the spin-orbital
+ * expression in its comment does with the full integrals. Products of factors with
+ * four indices are only formed for batch_size values of the first virtual index
+ * at a time.
+ */
+template <typename T>
+class CholeskyFactors
+{
+    protected:
+        Arena arena;
+        const symmetry::PointGroup& group;
+        int batch_size;
+        tensor::SymmetryBlockedTensor<T> LAB, Lab;
+        tensor::SymmetryBlockedTensor<T> LAI, Lai;
+        tensor::SymmetryBlockedTensor<T> D;
+
+        /*
+         * Y[idx_Y] = V[idx_V]*B[idx_B] with V[idx_V] = D[R]*L1[idx_L1]*L2[idx_L2], where R is
+         * the last index of L1 and L2 and V is formed and contracted in batches of the first
+         * index of L1, which must also be the first index of V and Y
+         */
+        void contractBatched(const tensor::SymmetryBlockedTensor<T>& L1, const std::string& idx_L1,
+                             const tensor::SymmetryBlockedTensor<T>& L2, const std::string& idx_L2,
+                             const std::string& idx_V,
+                             const tensor::SymmetryBlockedTensor<T>& B, const std::string& idx_B,
+                             tensor::SymmetryBlockedTensor<T>& Y, const std::string& idx_Y) const;
+
+        /*
+         * Q(ai,R) = D(R) sum_e L(ae,R) T1(e,i)
+         */
+        void calcQ(const tensor::SpinorbitalTensor<T>& T1,
+                   tensor::SymmetryBlockedTensor<T>& QA, tensor::SymmetryBlockedTensor<T>& Qa) const;
+
+    public:
+        /*
+         * Take the factors of the virtual-virtual and virtual-occupied integrals along with
+         * the diagonal D(R)
+         */
+        CholeskyFactors(const tensor::SymmetryBlockedTensor<T>& LAB, const tensor::SymmetryBlockedTensor<T>& Lab,
+                        const tensor::SymmetryBlockedTensor<T>& LAI, const tensor::SymmetryBlockedTensor<T>& Lai,
+                        const tensor::SymmetryBlockedTensor<T>& D, int batch_size);
+
+        /*
+         * Z["abij"] += alpha*ABCD["abef"]*Tau["efij"]
+         */
+        void contractABCD(T alpha, const tensor::SpinorbitalTensor<T>& Tau, tensor::SpinorbitalTensor<T>& Z) const;
+
+        /*
+         * Z["abij"] += alpha*ABCI["abej"]*T1["ei"]
+         */
+        void contractABCI(T alpha, const tensor::SpinorbitalTensor<T>& T1, tensor::SpinorbitalTensor<T>& Z) const;
+
+        /*
+         * Z["ai"] += alpha*AIBC["amef"]*Tau["efim"]
+         */
+        void contractAIBCToAI(T alpha, const tensor::SpinorbitalTensor<T>& Tau, tensor::SpinorbitalTensor<T>& Z) const;
+
+        /*
+         * F["ae"] += alpha*AIBC["amef"]*T1["fm"]
+         */
+        void contractAIBCToAB(T alpha, const tensor::SpinorbitalTensor<T>& T1, tensor::SpinorbitalTensor<T>& F) const;
+
+        /*
+         * W["amij"] += alpha*AIBC["amef"]*Tau["efij"]
+         */
+        void contractAIBCToAIJK(T alpha, const tensor::SpinorbitalTensor<T>& Tau, tensor::SpinorbitalTensor<T>& W) const;
+
+        /*
+         * W["amei"] += alpha*AIBC["amef"]*T1["fi"]
+         */
+        void contractAIBCToAIBJ(T alpha, const tensor::SpinorbitalTensor<T>& T1, tensor::SpinorbitalTensor<T>& W) const;
+};
+
+}
+}
+
+#endif
@@ -36,7 +36,9 @@ using namespace aquarius::symmetry;
 
 template <typename T>
 CholeskyMOIntegrals<T>::CholeskyMOIntegrals(const string& name, const Config& config)
-: MOIntegrals<T>("choleskymoints", name, config)
+: MOIntegrals<T>("choleskymoints", name, config),
+  factorized(config.get<bool>("factorized")),
+  batch_size(config.get<int>("batch_size"))
 {
     this->getProduct("H").addRequirement(Requirement("cholesky","cholesky"));
 }
@@ -50,9 +52,6 @@ void CholeskyMOIntegrals<T>::run(TaskDAG& dag, const Arena& arena)
     const SymmetryBlockedTensor<T>& Fa = this->template get<SymmetryBlockedTensor<T> >("Fa");
     const SymmetryBlockedTensor<T>& Fb = this->template get<SymmetryBlockedTensor<T> >("Fb");
 
-    this->put("H", new TwoElectronOperator<T>("V", OneElectronOperator<T>("f", occ, vrt, Fa, Fb)));
-    TwoElectronOperator<T>& H = this->template get<TwoElectronOperator<T> >("H");
-
     const CholeskyIntegrals<T>& chol = this->template get<CholeskyIntegrals<T> >("cholesky");
 
     const SymmetryBlockedTensor<T>& cA = vrt.Calpha;
@@ -113,8 +112,6 @@ void CholeskyMOIntegrals<T>::run(TaskDAG& dag, const Arena& arena)
 
     SymmetryBlockedTensor<T> LDIJ("LDIJ", arena, group, 3, sizeIIR, shapeNNN, false);
     SymmetryBlockedTensor<T> LDij("LDij", arena, group, 3, sizeiiR, shapeNNN, false);
-    SymmetryBlockedTensor<T> LDAB("LDAB", arena, group, 3, sizeAAR, shapeNNN, false);
-    SymmetryBlockedTensor<T> LDab("LDab", arena, group, 3, sizeaaR, shapeNNN, false);
     SymmetryBlockedTensor<T> LDAI("LDAI", arena, group, 3, sizeAIR, shapeNNN, false);
     SymmetryBlockedTensor<T> LDai("LDai", arena, group, 3, sizeaiR, shapeNNN, false);
 
@@ -122,8 +119,18 @@ void CholeskyMOIntegrals<T>::run(TaskDAG& dag, const Arena& arena)
     LDij["ijR"] = D["R"]*Lij["ijR"];
     LDAI["AIR"] = D["R"]*LAI["AIR"];
     LDai["aiR"] = D["R"]*Lai["aiR"];
-    LDAB["ABR"] = D["R"]*LAB["ABR"];
-    LDab["abR"] = D["R"]*Lab["abR"];
+
+    if (factorized)
+    {
+        this->put("H", new TwoElectronOperator<T>("V", OneElectronOperator<T>("f", occ, vrt, Fa, Fb),
+                                                  new CholeskyFactors<T>(LAB, Lab, LAI, Lai, D, batch_size)));
+    }
+    else
+    {
+        this->put("H", new TwoElectronOperator<T>("V", OneElectronOperator<T>("f", occ, vrt, Fa, Fb)));
+    }
+
+    TwoElectronOperator<T>& H = this->template get<TwoElectronOperator<T> >("H");
 
     H.getIJKL()(vec(0,2),vec(0,2))["IJKL"] = 0.5*LDIJ["IKR"]*LIJ["JLR"];
     H.getIJKL()(vec(0,1),vec(0,1))["IjKl"] =     LDIJ["IKR"]*Lij["jlR"];
@@ -147,28 +154,40 @@ void CholeskyMOIntegrals<T>::run(TaskDAG& dag, const Arena& arena)
     H.getIJAB()(vec(0,1),vec(1,0))["IjAb"] = H.getABIJ()(vec(1,0),vec(0,1))["AbIj"];
     H.getIJAB()(vec(0,0),vec(0,0))["ijab"] = H.getABIJ()(vec(0,0),vec(0,0))["abij"];
 
-    H.getAIBJ()(vec(1,1),vec(1,1))["AIBJ"]  = LDAB["ABR"]*LIJ["IJR"];
+    H.getAIBJ()(vec(1,1),vec(1,1))["AIBJ"]  = LAB["ABR"]*LDIJ["IJR"];
     H.getAIBJ()(vec(1,1),vec(1,1))["AIBJ"] -= LDAI["AJR"]*LAI["BIR"];
-    H.getAIBJ()(vec(1,0),vec(1,0))["AiBj"]  = LDAB["ABR"]*Lij["ijR"];
-    H.getAIBJ()(vec(0,1),vec(0,1))["aIbJ"]  = LDab["abR"]*LIJ["IJR"];
-    H.getAIBJ()(vec(0,0),vec(0,0))["aibj"]  = LDab["abR"]*Lij["ijR"];
+    H.getAIBJ()(vec(1,0),vec(1,0))["AiBj"]  = LAB["ABR"]*LDij["ijR"];
+    H.getAIBJ()(vec(0,1),vec(0,1))["aIbJ"]  = Lab["abR"]*LDIJ["IJR"];
+    H.getAIBJ()(vec(0,0),vec(0,0))["aibj"]  = Lab["abR"]*LDij["ijR"];
     H.getAIBJ()(vec(0,0),vec(0,0))["aibj"] -= LDai["ajR"]*Lai["biR"];
     H.getAIBJ()(vec(1,0),vec(0,1))["AibJ"]  = -H.getABIJ()(vec(1,0),vec(0,1))["AbJi"];
     H.getAIBJ()(vec(0,1),vec(1,0))["aIBj"]  = -H.getABIJ()(vec(1,0),vec(0,1))["BaIj"];
 
-    H.getABCI()(vec(2,0),vec(1,1))["ABCI"] =  LDAB["ACR"]*LAI["BIR"];
-    H.getABCI()(vec(1,0),vec(1,0))["AbCi"] =  LDAB["ACR"]*Lai["biR"];
-    H.getABCI()(vec(1,0),vec(0,1))["AbcI"] = -LDab["bcR"]*LAI["AIR"];
-    H.getABCI()(vec(0,0),vec(0,0))["abci"] =  LDab["acR"]*Lai["biR"];
+    /*
+     * The three- and four-virtual blocks are only formed from the factors on demand
+     */
+    if (!factorized)
+    {
+        SymmetryBlockedTensor<T> LDAB("LDAB", arena, group, 3, sizeAAR, shapeNNN, false);
+        SymmetryBlockedTensor<T> LDab("LDab", arena, group, 3, sizeaaR, shapeNNN, false);
+
+        LDAB["ABR"] = D["R"]*LAB["ABR"];
+        LDab["abR"] = D["R"]*Lab["abR"];
+
+        H.getABCI()(vec(2,0),vec(1,1))["ABCI"] =  LDAB["ACR"]*LAI["BIR"];
+        H.getABCI()(vec(1,0),vec(1,0))["AbCi"] =  LDAB["ACR"]*Lai["biR"];
+        H.getABCI()(vec(1,0),vec(0,1))["AbcI"] = -LDab["bcR"]*LAI["AIR"];
+        H.getABCI()(vec(0,0),vec(0,0))["abci"] =  LDab["acR"]*Lai["biR"];
 
-    H.getAIBC()(vec(1,1),vec(2,0))["AIBC"] = H.getABCI()(vec(2,0),vec(1,1))["BCAI"];
-    H.getAIBC()(vec(1,0),vec(1,0))["AiBc"] = H.getABCI()(vec(1,0),vec(1,0))["BcAi"];
-    H.getAIBC()(vec(0,1),vec(1,0))["aIBc"] = H.getABCI()(vec(1,0),vec(0,1))["BcaI"];
-    H.getAIBC()(vec(0,0),vec(0,0))["aibc"] = H.getABCI()(vec(0,0),vec(0,0))["bcai"];
+        H.getAIBC()(vec(1,1),vec(2,0))["AIBC"] = H.getABCI()(vec(2,0),vec(1,1))["BCAI"];
+        H.getAIBC()(vec(1,0),vec(1,0))["AiBc"] = H.getABCI()(vec(1,0),vec(1,0))["BcAi"];
+        H.getAIBC()(vec(0,1),vec(1,0))["aIBc"] = H.getABCI()(vec(1,0),vec(0,1))["BcaI"];
+        H.getAIBC()(vec(0,0),vec(0,0))["aibc"] = H.getABCI()(vec(0,0),vec(0,0))["bcai"];
 
-    H.getABCD()(vec(2,0),vec(2,0))["ABCD"] = 0.5*LDAB["ACR"]*LAB["BDR"];
-    H.getABCD()(vec(1,0),vec(1,0))["AbCd"] =     LDAB["ACR"]*Lab["bdR"];
-    H.getABCD()(vec(0,0),vec(0,0))["abcd"] = 0.5*LDab["acR"]*Lab["bdR"];
+        H.getABCD()(vec(2,0),vec(2,0))["ABCD"] = 0.5*LDAB["ACR"]*LAB["BDR"];
+        H.getABCD()(vec(1,0),vec(1,0))["AbCd"] =     LDAB["ACR"]*Lab["bdR"];
+        H.getABCD()(vec(0,0),vec(0,0))["abcd"] = 0.5*LDab["acR"]*Lab["bdR"];
+    }
 }
 
 INSTANTIATE_SPECIALIZATIONS(CholeskyMOIntegrals);
@@ -38,6 +38,10 @@ namespace op
 template <typename T>
 class CholeskyMOIntegrals : public MOIntegrals<T>
 {
+    protected:
+        bool factorized;
+        int batch_size;
+
     public:
         CholeskyMOIntegrals(const std::string& name, const input::Config& config);
 
@@ -28,6 +28,7 @@
 #include <vector>
 
 #include "1eoperator.hpp"
+#include "r2eoperator.hpp"
 #include "mooperator.hpp"
 
 namespace aquarius
@@ -41,6 +42,29 @@ class Denominator : public op::MOOperator
     protected:
         std::vector<std::vector<T> > dA, da, dI, di;
 
+        /*
+         * d = sign*diag(F) for one irrep (collective)
+         */
+        void getDiagonal(const tensor::SymmetryBlockedTensor<T>& F, int irrep, std::vector<T>& d, T sign)
+        {
+            std::vector<int> irreps(2,irrep);
+
+            if (arena.rank == 0)
+            {
+                int nd = d.size();
+                std::vector<tkv_pair<T> > pairs(nd);
+                for (int i = 0;i < nd;i++) pairs[i].k = i+i*nd;
+                F.getRemoteData(irreps, pairs);
+                for (int i = 0;i < nd;i++) d[pairs[i].k/nd] = sign*pairs[i].d;
+            }
+            else
+            {
+                F.getRemoteData(irreps);
+            }
+
+            arena.Bcast(d, 0);
+        }
+
     public:
         template <typename Derived>
         Denominator(const OneElectronOperatorBase<T,Derived>& F)
@@ -60,56 +84,35 @@ class Denominator : public op::MOOperator
                 dI[j].resize(occ.nalpha[j]);
                 di[j].resize(occ.nbeta[j]);
 
-                std::vector<int> irreps(2,j);
-
-                if (arena.rank == 0)
-                {
-                    int nA = dA[j].size();
-                    int na = da[j].size();
-                    int nI = dI[j].size();
-                    int ni = di[j].size();
-
-                    {
-                        std::vector<tkv_pair<T> > pairs(nA);
-                        for (int i = 0;i < nA;i++) pairs[i].k = i+i*nA;
-                        F.getAB()(std::vec(1,0),std::vec(1,0)).getRemoteData(irreps, pairs);
-                        for (int i = 0;i < nA;i++) dA[j][pairs[i].k/nA] = -pairs[i].d;
-                    }
-
-                    {
-                        std::vector<tkv_pair<T> > pairs(na);
-                        for (int i = 0;i < na;i++) pairs[i].k = i+i*na;
-                        F.getAB()(std::vec(0,0),std::vec(0,0)).getRemoteData(irreps, pairs);
-                        for (int i = 0;i < na;i++) da[j][pairs[i].k/na] = -pairs[i].d;
-                    }
-
-                    {
-                        std::vector<tkv_pair<T> > pairs(nI);
-                        for (int i = 0;i < nI;i++) pairs[i].k = i+i*nI;
-                        F.getIJ()(std::vec(0,1),std::vec(0,1)).getRemoteData(irreps, pairs);
-                        for (int i = 0;i < nI;i++) dI[j][pairs[i].k/nI] = pairs[i].d;
-                    }
-
-                    {
-                        std::vector<tkv_pair<T> > pairs(ni);
-                        for (int i = 0;i < ni;i++) pairs[i].k = i+i*ni;
-                        F.getIJ()(std::vec(0,0),std::vec(0,0)).getRemoteData(irreps, pairs);
-                        for (int i = 0;i < ni;i++) di[j][pairs[i].k/ni] = pairs[i].d;
-                    }
-                }
-                else
-                {
-                    F.getAB()(std::vec(1,0),std::vec(1,0)).getRemoteData(irreps);
-                    F.getAB()(std::vec(0,0),std::vec(0,0)).getRemoteData(irreps);
-                    F.getIJ()(std::vec(0,1),std::vec(0,1)).getRemoteData(irreps);
-                    F.getIJ()(std::vec(0,0),std::vec(0,0)).getRemoteData(irreps);
-                }
-
-                arena.Bcast(dA[j], 0);
-                arena.Bcast(da[j], 0);
-                arena.Bcast(dI[j], 0);
-                arena.Bcast(di[j], 0);
+                getDiagonal(F.getAB()(std::vec(1,0),std::vec(1,0)), j, dA[j], -1);
+                getDiagonal(F.getAB()(std::vec(0,0),std::vec(0,0)), j, da[j], -1);
+                getDiagonal(F.getIJ()(std::vec(0,1),std::vec(0,1)), j, dI[j],  1);
+                getDiagonal(F.getIJ()(std::vec(0,0),std::vec(0,0)), j, di[j],  1);
+            }
+        }
+
+        /*
+         * The alpha and beta denominators of a restricted operator are the same
+         */
+        Denominator(const RestrictedTwoElectronOperator<T>& H)
+        : MOOperator(H)
+        {
+            int n = vrt.group.getNumIrreps();
+
+            dA.resize(n);
+            dI.resize(n);
+
+            for (int j = 0;j < n;j++)
+            {
+                dA[j].resize(vrt.nalpha[j]);
+                dI[j].resize(occ.nalpha[j]);
+
+                getDiagonal(H.getAB(), j, dA[j], -1);
+                getDiagonal(H.getIJ(), j, dI[j],  1);
             }
+
+            da = dA;
+            di = dI;
         }
 
         const std::vector<std::vector<T> >& getDA() const { return dA; }
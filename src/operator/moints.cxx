@@ -31,7 +31,8 @@ using namespace aquarius::task;
 using namespace aquarius::input;
 
 template <typename T>
-MOIntegrals<T>::MOIntegrals(const string& type, const string& name, const Config& config)
+MOIntegrals<T>::MOIntegrals(const string& type, const string& name, const Config& config,
+                            const string& product)
 : Task(type, name)
 {
     vector<Requirement> reqs;
@@ -39,7 +40,7 @@ MOIntegrals<T>::MOIntegrals(const string& type, const string& name, const Config
     reqs += Requirement("vrtspace", "vrt");
     reqs += Requirement("Fa", "Fa");
     reqs += Requirement("Fb", "Fb");
-    addProduct(Product("moints", "H", reqs));
+    addProduct(Product(product, "H", reqs));
 }
 
 INSTANTIATE_SPECIALIZATIONS(MOIntegrals);
@@ -38,7 +38,8 @@ template <typename T>
 class MOIntegrals : public task::Task
 {
     protected:
-        MOIntegrals(const std::string& type, const std::string& name, const input::Config& config);
+        MOIntegrals(const std::string& type, const std::string& name, const input::Config& config,
+                    const std::string& product = "moints");
 };
 
 }
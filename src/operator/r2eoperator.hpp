@@ -0,0 +1,114 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+
+#ifndef _AQUARIUS_OPERATOR_R2EOPERATOR_HPP_
+#define _AQUARIUS_OPERATOR_R2EOPERATOR_HPP_
+
+#include "tensor/symblocked_tensor.hpp"
+#include "util/stl_ext.hpp"
+
+#include "mooperator.hpp"
+
+namespace aquarius
+{
+namespace op
+{
+
+/*
+ * A closed-shell Hamiltonian over spatial orbitals. Only the alpha-beta blocks of
+ * the spin-orbital operator are kept, with the same index order and sign, e.g.
+ * abcd = <Ab|Cd>, abci = <Ab||cI> and aibc = <Ai|Bc>; every other spin block
+ * follows from these when the alpha and beta orbitals are the same. The one-
+ * electron blocks are those of the alpha Fock matrix.
+ */
+template <typename T>
+class RestrictedTwoElectronOperator : public MOOperator
+{
+    protected:
+        tensor::SymmetryBlockedTensor<T> ab;
+        tensor::SymmetryBlockedTensor<T> ij;
+        tensor::SymmetryBlockedTensor<T> ai;
+        tensor::SymmetryBlockedTensor<T> ia;
+        tensor::SymmetryBlockedTensor<T> ijkl;
+        tensor::SymmetryBlockedTensor<T> aijk;
+        tensor::SymmetryBlockedTensor<T> ijak;
+        tensor::SymmetryBlockedTensor<T> abij;
+        tensor::SymmetryBlockedTensor<T> ijab;
+        tensor::SymmetryBlockedTensor<T> aibj;
+        tensor::SymmetryBlockedTensor<T> aibc;
+        tensor::SymmetryBlockedTensor<T> abci;
+        tensor::SymmetryBlockedTensor<T> abcd;
+
+    public:
+        RestrictedTwoElectronOperator(const std::string& name, const Arena& arena,
+                                      const Space& occ, const Space& vrt)
+        : MOOperator(arena, occ, vrt),
+          ab  (name+"(ab)",   arena, occ.group, 2, std::vec(vrt.nalpha,vrt.nalpha), std::vec(NS,NS)),
+          ij  (name+"(ij)",   arena, occ.group, 2, std::vec(occ.nalpha,occ.nalpha), std::vec(NS,NS)),
+          ai  (name+"(ai)",   arena, occ.group, 2, std::vec(vrt.nalpha,occ.nalpha), std::vec(NS,NS)),
+          ia  (name+"(ia)",   arena, occ.group, 2, std::vec(occ.nalpha,vrt.nalpha), std::vec(NS,NS)),
+          ijkl(name+"(ijkl)", arena, occ.group, 4, std::vec(occ.nalpha,occ.nalpha,occ.nalpha,occ.nalpha), std::vec(NS,NS,NS,NS)),
+          aijk(name+"(aijk)", arena, occ.group, 4, std::vec(vrt.nalpha,occ.nalpha,occ.nalpha,occ.nalpha), std::vec(NS,NS,NS,NS)),
+          ijak(name+"(ijak)", arena, occ.group, 4, std::vec(occ.nalpha,occ.nalpha,vrt.nalpha,occ.nalpha), std::vec(NS,NS,NS,NS)),
+          abij(name+"(abij)", arena, occ.group, 4, std::vec(vrt.nalpha,vrt.nalpha,occ.nalpha,occ.nalpha), std::vec(NS,NS,NS,NS)),
+          ijab(name+"(ijab)", arena, occ.group, 4, std::vec(occ.nalpha,occ.nalpha,vrt.nalpha,vrt.nalpha), std::vec(NS,NS,NS,NS)),
+          aibj(name+"(aibj)", arena, occ.group, 4, std::vec(vrt.nalpha,occ.nalpha,vrt.nalpha,occ.nalpha), std::vec(NS,NS,NS,NS)),
+          aibc(name+"(aibc)", arena, occ.group, 4, std::vec(vrt.nalpha,occ.nalpha,vrt.nalpha,vrt.nalpha), std::vec(NS,NS,NS,NS)),
+          abci(name+"(abci)", arena, occ.group, 4, std::vec(vrt.nalpha,vrt.nalpha,vrt.nalpha,occ.nalpha), std::vec(NS,NS,NS,NS)),
+          abcd(name+"(abcd)", arena, occ.group, 4, std::vec(vrt.nalpha,vrt.nalpha,vrt.nalpha,vrt.nalpha), std::vec(NS,NS,NS,NS)) {}
+
+        tensor::SymmetryBlockedTensor<T>& getAB() { return ab; }
+        tensor::SymmetryBlockedTensor<T>& getIJ() { return ij; }
+        tensor::SymmetryBlockedTensor<T>& getAI() { return ai; }
+        tensor::SymmetryBlockedTensor<T>& getIA() { return ia; }
+        tensor::SymmetryBlockedTensor<T>& getIJKL() { return ijkl; }
+        tensor::SymmetryBlockedTensor<T>& getAIJK() { return aijk; }
+        tensor::SymmetryBlockedTensor<T>& getIJAK() { return ijak; }
+        tensor::SymmetryBlockedTensor<T>& getABIJ() { return abij; }
+        tensor::SymmetryBlockedTensor<T>& getIJAB() { return ijab; }
+        tensor::SymmetryBlockedTensor<T>& getAIBJ() { return aibj; }
+        tensor::SymmetryBlockedTensor<T>& getAIBC() { return aibc; }
+        tensor::SymmetryBlockedTensor<T>& getABCI() { return abci; }
+        tensor::SymmetryBlockedTensor<T>& getABCD() { return abcd; }
+
+        const tensor::SymmetryBlockedTensor<T>& getAB() const { return ab; }
+        const tensor::SymmetryBlockedTensor<T>& getIJ() const { return ij; }
+        const tensor::SymmetryBlockedTensor<T>& getAI() const { return ai; }
+        const tensor::SymmetryBlockedTensor<T>& getIA() const { return ia; }
+        const tensor::SymmetryBlockedTensor<T>& getIJKL() const { return ijkl; }
+        const tensor::SymmetryBlockedTensor<T>& getAIJK() const { return aijk; }
+        const tensor::SymmetryBlockedTensor<T>& getIJAK() const { return ijak; }
+        const tensor::SymmetryBlockedTensor<T>& getABIJ() const { return abij; }
+        const tensor::SymmetryBlockedTensor<T>& getIJAB() const { return ijab; }
+        const tensor::SymmetryBlockedTensor<T>& getAIBJ() const { return aibj; }
+        const tensor::SymmetryBlockedTensor<T>& getAIBC() const { return aibc; }
+        const tensor::SymmetryBlockedTensor<T>& getABCI() const { return abci; }
+        const tensor::SymmetryBlockedTensor<T>& getABCD() const { return abcd; }
+};
+
+}
+}
+
+#endif
@@ -116,9 +116,6 @@ void STExcitationOperator<U,2>::transform(const TwoElectronOperator<U>& X,
     SpinorbitalTensor<U>& FMI = W.getIJ();
     SpinorbitalTensor<U>& WABIJ = W.getABIJ();
     SpinorbitalTensor<U>& WMNEF = W.getIJAB();
-    SpinorbitalTensor<U>& WAMEF = W.getAIBC();
-    SpinorbitalTensor<U>& WABEJ = W.getABCI();
-    SpinorbitalTensor<U>& WABEF = W.getABCD();
     SpinorbitalTensor<U>& WMNIJ = W.getIJKL();
     SpinorbitalTensor<U>& WMNEJ = W.getIJAK();
     SpinorbitalTensor<U>& WAMIJ = W.getAIJK();
@@ -144,7 +141,10 @@ void STExcitationOperator<U,2>::transform(const TwoElectronOperator<U>& X,
 
     Z(1)["ai"]  = FAI["ai"];
     Z(1)["ai"] -= T(1)["em"]*WAMEI["amei"];
-    Z(1)["ai"] += 0.5*WAMEF["amef"]*Tau["efim"];
+    if (W.isFactorized())
+        W.getFactors().contractAIBCToAI(0.5, Tau, Z(1));
+    else
+        Z(1)["ai"] += 0.5*W.getAIBC()["amef"]*Tau["efim"];
     Z(1)["ai"] -= 0.5*WMNEJ["mnei"]*T(2)["eamn"];
     Z(1)["ai"] += T(2)["aeim"]*FME["me"];
     Z(1)["ai"] += T(1)["ei"]*FAE["ae"];
@@ -152,21 +152,36 @@ void STExcitationOperator<U,2>::transform(const TwoElectronOperator<U>& X,
 
     FAE["ae"] -= 0.5*WMNEF["mnef"]*T(2)["afmn"];
     FAE["ae"] -= FME["me"]*T(1)["am"];
-    FAE["ae"] += WAMEF["amef"]*T(1)["fm"];
-
-    WAMIJ["amij"] += 0.5*WAMEF["amef"]*Tau["efij"];
+    if (W.isFactorized())
+        W.getFactors().contractAIBCToAB(1.0, T(1), FAE);
+    else
+        FAE["ae"] += W.getAIBC()["amef"]*T(1)["fm"];
+
+    if (W.isFactorized())
+        W.getFactors().contractAIBCToAIJK(0.5, Tau, WAMIJ);
+    else
+        WAMIJ["amij"] += 0.5*W.getAIBC()["amef"]*Tau["efij"];
     WAMIJ["amij"] += WAMEI["amej"]*T(1)["ei"];
 
     WAMEI["amei"] -= 0.5*WMNEF["mnef"]*T(2)["afin"];
-    WAMEI["amei"] += WAMEF["amef"]*T(1)["fi"];
+    if (W.isFactorized())
+        W.getFactors().contractAIBCToAIBJ(1.0, T(1), WAMEI);
+    else
+        WAMEI["amei"] += W.getAIBC()["amef"]*T(1)["fi"];
     WAMEI["amei"] -= WMNEJ["nmei"]*T(1)["an"];
 
     Z(2)["abij"]  = WABIJ["abij"];
     Z(2)["abij"] += FAE["af"]*T(2)["fbij"];
     Z(2)["abij"] -= FMI["ni"]*T(2)["abnj"];
-    Z(2)["abij"] += WABEJ["abej"]*T(1)["ei"];
+    if (W.isFactorized())
+        W.getFactors().contractABCI(1.0, T(1), Z(2));
+    else
+        Z(2)["abij"] += W.getABCI()["abej"]*T(1)["ei"];
     Z(2)["abij"] -= WAMIJ["amij"]*T(1)["bm"];
-    Z(2)["abij"] += 0.5*WABEF["abef"]*Tau["efij"];
+    if (W.isFactorized())
+        W.getFactors().contractABCD(0.5, Tau, Z(2));
+    else
+        Z(2)["abij"] += 0.5*W.getABCD()["abef"]*Tau["efij"];
     Z(2)["abij"] += 0.5*WMNIJ["mnij"]*Tau["abmn"];
     Z(2)["abij"] -= WAMEI["amei"]*T(2)["ebmj"];
 }
@@ -35,12 +35,128 @@ using namespace aquarius::integrals;
 using namespace aquarius::task;
 
 template <typename T>
-AOUHF<T>::AOUHF(const string& name, const Config& config)
-: UHF<T>("aoscf", name, config)
+AOUHF<T>::AOUHF(const string& name, const Config& config, const string& type, bool restricted)
+: UHF<T>(type, name, config, restricted),
+  direct(config.get<bool>("direct")),
+  direct_rebuild(config.get<int>("direct_rebuild")),
+  direct_cutoff(config.get<double>("direct_cutoff")),
+  integral_cutoff(config.get<double>("integral_cutoff")),
+  nincremental(0),
+  ctx(Context::ISCF),
+  screen(NULL)
 {
-    for (vector<Product>::iterator i = this->products.begin();i != this->products.end();++i)
+    if (!direct)
     {
-        i->addRequirement(Requirement("eri", "I"));
+        for (vector<Product>::iterator i = this->products.begin();i != this->products.end();++i)
+        {
+            i->addRequirement(Requirement("eri", "I"));
+        }
+    }
+}
+
+template <typename T>
+AOUHF<T>::~AOUHF()
+{
+    delete screen;
+}
+
+template <typename T>
+void AOUHF<T>::contractFock(size_t neris, const double* eris, const idx4_t* idxs,
+                            const vector<int>& irrep, const vector<int>& start, const vector<int>& norb,
+                            const vector<vector<T> >& densa, const vector<vector<T> >& densb,
+                            const vector<vector<T> >& densab,
+                            vector<vector<T> >& focka, vector<vector<T> >& fockb, int64_t& flops,
+                            bool restricted)
+{
+    for (size_t n = 0;n < neris;n++)
+    {
+        int irri = irrep[idxs[n].i];
+        int irrj = irrep[idxs[n].j];
+        int irrk = irrep[idxs[n].k];
+        int irrl = irrep[idxs[n].l];
+
+        if (irri != irrj && irri != irrk && irri != irrl) continue;
+
+        int i = idxs[n].i-start[irri];
+        int j = idxs[n].j-start[irrj];
+        int k = idxs[n].k-start[irrk];
+        int l = idxs[n].l-start[irrl];
+
+        /*
+        if (i < j)
+        {
+            swap(i, j);
+        }
+        if (k < l)
+        {
+            swap(k, l);
+        }
+        if (i < k || (i == k && j < l))
+        {
+            swap(i, k);
+            swap(j, l);
+        }
+        printf("%d %d %d %d %25.15e\n", i+1, j+1, k+1, l+1, eris[n].value);
+        */
+
+        bool ieqj = i == j && irri == irrj;
+        bool keql = k == l && irrk == irrl;
+        bool ijeqkl = i == k && irri == irrk && j == l && irrj == irrl;
+
+        //cout << irri << " " << irrj << " " << irrk << " " << irrl << " "
+        //        << i << " " << j << " " << k << " " << l << endl;
+
+        /*
+         * Exchange contribution: Fa(ac) -= Da(bd)*(ab|cd)
+         */
+
+        T e = 2.0*eris[n]*(ijeqkl ? 0.5 : 1.0);
+
+        if (irri == irrk && irrj == irrl)
+        {
+            flops += 4;;
+            focka[irri][i+k*norb[irri]] -= densa[irrj][j+l*norb[irrj]]*e;
+            if (!restricted) fockb[irri][i+k*norb[irri]] -= densb[irrj][j+l*norb[irrj]]*e;
+        }
+        if (!keql && irri == irrl && irrj == irrk)
+        {
+            flops += 4;;
+            focka[irri][i+l*norb[irri]] -= densa[irrj][j+k*norb[irrj]]*e;
+            if (!restricted) fockb[irri][i+l*norb[irri]] -= densb[irrj][j+k*norb[irrj]]*e;
+        }
+        if (!ieqj)
+        {
+            if (irri == irrl && irrj == irrk)
+            {
+                flops += 4;;
+                focka[irrj][j+k*norb[irrj]] -= densa[irri][i+l*norb[irri]]*e;
+                if (!restricted) fockb[irrj][j+k*norb[irrj]] -= densb[irri][i+l*norb[irri]]*e;
+            }
+            if (!keql && irri == irrk && irrj == irrl)
+            {
+                flops += 4;;
+                focka[irrj][j+l*norb[irrj]] -= densa[irri][i+k*norb[irri]]*e;
+                if (!restricted) fockb[irrj][j+l*norb[irrj]] -= densb[irri][i+k*norb[irri]]*e;
+            }
+        }
+
+        /*
+         * Coulomb contribution: Fa(ab) += [Da(cd)+Db(cd)]*(ab|cd)
+         */
+
+        e = 2.0*e*(keql ? 0.5 : 1.0)*(ieqj ? 0.5 : 1.0);
+
+        if (irri == irrj && irrk == irrl)
+        {
+            flops += 6;;
+            focka[irri][i+j*norb[irri]] += densab[irrk][k+l*norb[irrk]]*e;
+            focka[irrk][k+l*norb[irrk]] += densab[irri][i+j*norb[irri]]*e;
+            if (!restricted)
+            {
+                fockb[irri][i+j*norb[irri]] += densab[irrk][k+l*norb[irrk]]*e;
+                fockb[irrk][k+l*norb[irrk]] += densab[irri][i+j*norb[irri]]*e;
+            }
+        }
     }
 }
 
@@ -48,7 +164,6 @@ template <typename T>
 void AOUHF<T>::buildFock()
 {
     const Molecule& molecule =this->template get<Molecule>("molecule");
-    const ERI& ints = this->template get<ERI>("I");
 
     const vector<int>& norb = molecule.getNumOrbitals();
     int nirrep = molecule.getGroup().getNumIrreps();
@@ -67,6 +182,14 @@ void AOUHF<T>::buildFock()
 
     Arena& arena = H.arena;
 
+    /*
+     * In direct mode, only the change in the density since the last build is
+     * contracted, and the previous Fock matrix is used in place of H, except
+     * every direct_rebuild iterations
+     */
+    bool incremental = direct && !last_focka.empty() &&
+                       (direct_rebuild <= 0 || nincremental < direct_rebuild-1);
+
     vector<vector<T> > focka(nirrep), fockb(nirrep);
     vector<vector<T> > densa(nirrep), densb(nirrep);
     vector<vector<T> > densab(nirrep);
@@ -80,6 +203,12 @@ void AOUHF<T>::buildFock()
             H.getAllData(irreps, focka[i], 0);
             assert(focka[i].size() == norb[i]*norb[i]);
             fockb[i] = focka[i];
+
+            if (incremental)
+            {
+                focka[i] = last_focka[i];
+                fockb[i] = last_fockb[i];
+            }
         }
         else
         {
@@ -93,6 +222,26 @@ void AOUHF<T>::buildFock()
         Db.getAllData(irreps, densb[i]);
         assert(densa[i].size() == norb[i]*norb[i]);
 
+        if (direct)
+        {
+            vector<T> tmpa(densa[i]), tmpb(densb[i]);
+
+            if (incremental)
+            {
+                PROFILE_FLOPS(2*norb[i]*norb[i]);
+                axpy(norb[i]*norb[i], -1.0, last_densa[i].data(), 1, densa[i].data(), 1);
+                axpy(norb[i]*norb[i], -1.0, last_densb[i].data(), 1, densb[i].data(), 1);
+            }
+
+            if (last_densa.size() != nirrep)
+            {
+                last_densa.resize(nirrep);
+                last_densb.resize(nirrep);
+            }
+            last_densa[i].swap(tmpa);
+            last_densb[i].swap(tmpb);
+        }
+
         densab[i] = densa[i];
         PROFILE_FLOPS(norb[i]*norb[i]);
         axpy(norb[i]*norb[i], 1.0, densb[i].data(), 1, densab[i].data(), 1);
@@ -104,125 +253,59 @@ void AOUHF<T>::buildFock()
         }
     }
 
-    const vector<T>& eris = ints.ints;
-    const vector<idx4_t>& idxs = ints.idxs;
-    size_t neris = eris.size();
+    nincremental = (incremental ? nincremental+1 : 0);
 
-    int64_t flops = 0;
-    #pragma omp parallel reduction(+:flops)
+    if (direct)
     {
-        int nt = omp_get_num_threads();
-        int tid = omp_get_thread_num();
-        size_t n0 = (neris*tid)/nt;
-        size_t n1 = (neris*(tid+1))/nt;
+        last_focka.resize(nirrep);
+        last_fockb.resize(nirrep);
+    }
 
-        vector<vector<T> > focka_local(nirrep);
-        vector<vector<T> > fockb_local(nirrep);
+    int64_t flops = 0;
 
-        for (int i = 0;i < nirrep;i++)
-        {
-            focka_local[i].resize(norb[i]*norb[i], (T)0);
-            fockb_local[i].resize(norb[i]*norb[i], (T)0);
-        }
+    if (direct)
+    {
+        buildFockDirect(irrep, start, norb, densa, densb, densab, focka, fockb, flops);
+    }
+    else
+    {
+        const ERI& ints = this->template get<ERI>("I");
 
-        for (size_t n = n0;n < n1;n++)
+        #pragma omp parallel reduction(+:flops)
         {
-            int irri = irrep[idxs[n].i];
-            int irrj = irrep[idxs[n].j];
-            int irrk = irrep[idxs[n].k];
-            int irrl = irrep[idxs[n].l];
+            vector<vector<T> > focka_local(nirrep);
+            vector<vector<T> > fockb_local(nirrep);
 
-            if (irri != irrj && irri != irrk && irri != irrl) continue;
-
-            int i = idxs[n].i-start[irri];
-            int j = idxs[n].j-start[irrj];
-            int k = idxs[n].k-start[irrk];
-            int l = idxs[n].l-start[irrl];
-
-            /*
-            if (i < j)
-            {
-                swap(i, j);
-            }
-            if (k < l)
-            {
-                swap(k, l);
-            }
-            if (i < k || (i == k && j < l))
+            for (int i = 0;i < nirrep;i++)
             {
-                swap(i, k);
-                swap(j, l);
+                focka_local[i].resize(norb[i]*norb[i], (T)0);
+                fockb_local[i].resize(norb[i]*norb[i], (T)0);
             }
-            printf("%d %d %d %d %25.15e\n", i+1, j+1, k+1, l+1, eris[n].value);
-            */
-
-            bool ieqj = i == j && irri == irrj;
-            bool keql = k == l && irrk == irrl;
-            bool ijeqkl = i == k && irri == irrk && j == l && irrj == irrl;
-
-            //cout << irri << " " << irrj << " " << irrk << " " << irrl << " "
-            //        << i << " " << j << " " << k << " " << l << endl;
 
-            /*
-             * Exchange contribution: Fa(ac) -= Da(bd)*(ab|cd)
-             */
+            vector<double> eris;
+            vector<idx4_t> idxs;
 
-            T e = 2.0*eris[n]*(ijeqkl ? 0.5 : 1.0);
-
-            if (irri == irrk && irrj == irrl)
+            #pragma omp for schedule(dynamic)
+            for (int chunk = 0;chunk < ints.getNumChunks();chunk++)
             {
-                flops += 4;;
-                focka_local[irri][i+k*norb[irri]] -= densa[irrj][j+l*norb[irrj]]*e;
-                fockb_local[irri][i+k*norb[irri]] -= densb[irrj][j+l*norb[irrj]]*e;
+                ints.readChunk(chunk, eris, idxs);
+                contractFock(eris.size(), eris.data(), idxs.data(), irrep, start, norb,
+                             densa, densb, densab, focka_local, fockb_local, flops,
+                             this->restricted);
             }
-            if (!keql && irri == irrl && irrj == irrk)
-            {
-                flops += 4;;
-                focka_local[irri][i+l*norb[irri]] -= densa[irrj][j+k*norb[irrj]]*e;
-                fockb_local[irri][i+l*norb[irri]] -= densb[irrj][j+k*norb[irrj]]*e;
-            }
-            if (!ieqj)
+
+            #pragma omp critical
             {
-                if (irri == irrl && irrj == irrk)
-                {
-                    flops += 4;;
-                    focka_local[irrj][j+k*norb[irrj]] -= densa[irri][i+l*norb[irri]]*e;
-                    fockb_local[irrj][j+k*norb[irrj]] -= densb[irri][i+l*norb[irri]]*e;
-                }
-                if (!keql && irri == irrk && irrj == irrl)
+                for (int irr = 0;irr < nirrep;irr++)
                 {
-                    flops += 4;;
-                    focka_local[irrj][j+l*norb[irrj]] -= densa[irri][i+k*norb[irri]]*e;
-                    fockb_local[irrj][j+l*norb[irrj]] -= densb[irri][i+k*norb[irri]]*e;
+                    flops += 2*norb[irr]*norb[irr];
+                    axpy(norb[irr]*norb[irr], (T)1, focka_local[irr].data(), 1, focka[irr].data(), 1);
+                    axpy(norb[irr]*norb[irr], (T)1, fockb_local[irr].data(), 1, fockb[irr].data(), 1);
                 }
             }
-
-            /*
-             * Coulomb contribution: Fa(ab) += [Da(cd)+Db(cd)]*(ab|cd)
-             */
-
-            e = 2.0*e*(keql ? 0.5 : 1.0)*(ieqj ? 0.5 : 1.0);
-
-            if (irri == irrj && irrk == irrl)
-            {
-                flops += 6;;
-                focka_local[irri][i+j*norb[irri]] += densab[irrk][k+l*norb[irrk]]*e;
-                fockb_local[irri][i+j*norb[irri]] += densab[irrk][k+l*norb[irrk]]*e;
-                focka_local[irrk][k+l*norb[irrk]] += densab[irri][i+j*norb[irri]]*e;
-                fockb_local[irrk][k+l*norb[irrk]] += densab[irri][i+j*norb[irri]]*e;
-            }
-        }
-
-        #pragma omp critical
-        {
-            for (int irr = 0;irr < nirrep;irr++)
-            {
-                flops += 2*norb[irr]*norb[irr];
-                axpy(norb[irr]*norb[irr], (T)1, focka_local[irr].data(), 1, focka[irr].data(), 1);
-                axpy(norb[irr]*norb[irr], (T)1, fockb_local[irr].data(), 1, fockb[irr].data(), 1);
-            }
         }
     }
+
     PROFILE_FLOPS(flops);
 
     for (int irr = 0;irr < nirrep;irr++)
@@ -248,7 +331,20 @@ void AOUHF<T>::buildFock()
         {
             PROFILE_FLOPS(2*norb[i]*norb[i]);
             arena.Reduce(focka[i], MPI::SUM);
-            arena.Reduce(fockb[i], MPI::SUM);
+            if (this->restricted)
+            {
+                fockb[i] = focka[i];
+            }
+            else
+            {
+                arena.Reduce(fockb[i], MPI::SUM);
+            }
+
+            if (direct)
+            {
+                last_focka[i] = focka[i];
+                last_fockb[i] = fockb[i];
+            }
 
             vector<tkv_pair<T> > pairs(norb[i]*norb[i]);
 
@@ -272,7 +368,7 @@ void AOUHF<T>::buildFock()
         {
             PROFILE_FLOPS(2*norb[i]*norb[i]);
             arena.Reduce(focka[i], MPI::SUM, 0);
-            arena.Reduce(fockb[i], MPI::SUM, 0);
+            if (!this->restricted) arena.Reduce(fockb[i], MPI::SUM, 0);
 
             Fa.writeRemoteData(irreps);
             Fb.writeRemoteData(irreps);
@@ -280,5 +376,177 @@ void AOUHF<T>::buildFock()
     }
 }
 
+template <typename T>
+void AOUHF<T>::buildFockDirect(const vector<int>& irrep, const vector<int>& start, const vector<int>& norb,
+                               const vector<vector<T> >& densa, const vector<vector<T> >& densb,
+                               const vector<vector<T> >& densab,
+                               vector<vector<T> >& focka, vector<vector<T> >& fockb, int64_t& flops)
+{
+    const Molecule& molecule = this->template get<Molecule>("molecule");
+    const Arena& arena = this->template get<SymmetryBlockedTensor<T> >("H").arena;
+
+    int nirrep = norb.size();
+
+    if (screen == NULL)
+    {
+        shells.assign(molecule.getShellsBegin(), molecule.getShellsEnd());
+        idx = Shell::setupIndices(ctx, molecule);
+
+        /*
+         * The orderings are generated lazily, so fill them in before going parallel
+         */
+        int Lmax = 0;
+        for (int a = 0;a < shells.size();++a) Lmax = max(Lmax, shells[a].getL());
+        ctx.getCartesianOrdering(Lmax);
+        ctx.getSphericalOrdering(Lmax);
+
+        funcs.resize(shells.size());
+        for (int a = 0;a < shells.size();++a)
+        {
+            for (int f = 0;f < shells[a].getNFunc();f++)
+                for (int c = 0;c < shells[a].getNContr();c++)
+                    for (int d = 0;d < shells[a].getDegeneracy();d++)
+                        funcs[a].push_back(shells[a].getIndex(ctx, idx[a], f, c, d));
+        }
+
+        screen = new SchwarzScreening(arena, shells, ERIEvaluator());
+    }
+
+    int nshell = shells.size();
+
+    /*
+     * Largest element of the (change in the) alpha or beta density in each shell block
+     */
+    vector<double> dshell(nshell*nshell, 0.0);
+    for (int a = 0;a < nshell;a++)
+    {
+        for (int b = 0;b < nshell;b++)
+        {
+            double dmax = 0;
+            for (int i = 0;i < funcs[a].size();i++)
+            {
+                int p = funcs[a][i];
+                for (int j = 0;j < funcs[b].size();j++)
+                {
+                    int q = funcs[b][j];
+                    if (irrep[p] != irrep[q]) continue;
+                    int irr = irrep[p];
+                    int pq = (p-start[irr])+(q-start[irr])*norb[irr];
+                    dmax = max(dmax, (double)max(abs(densa[irr][pq]), abs(densb[irr][pq])));
+                }
+            }
+            dshell[a*nshell+b] = dmax;
+        }
+    }
+    screen->setDensity(dshell);
+
+    ShellQuartetScheduler sched(arena, shells);
+    int nthread = sched.getNumThreads();
+
+    /*
+     * As in the ERI task, a failed thread only drains the scheduler and the
+     * error is raised after the parallel region
+     */
+    string error;
+
+    int64_t nscreened = 0;
+    #pragma omp parallel num_threads(nthread) reduction(+:flops,nscreened)
+    {
+        int tid = omp_get_thread_num();
+        bool failed = false;
+
+        vector<vector<T> > focka_local(nirrep);
+        vector<vector<T> > fockb_local(nirrep);
+
+        for (int i = 0;i < nirrep;i++)
+        {
+            focka_local[i].resize(norb[i]*norb[i], (T)0);
+            fockb_local[i].resize(norb[i]*norb[i], (T)0);
+        }
+
+        vector<double> eris(TMP_BUFSIZE);
+        vector<idx4_t> idxs(TMP_BUFSIZE);
+
+        ShellQuartetBlock block;
+        while (sched.next(tid, block))
+        {
+            if (failed) continue;
+
+            int a = block.a;
+            int b = block.b;
+
+            if (!screen->isSignificant(a, b, direct_cutoff))
+            {
+                nscreened += (int64_t)a*(a+1)/2+b+1;
+                continue;
+            }
+
+            for (int c = 0;c <= a;++c)
+            {
+                int dmax = c;
+                if (a == c) dmax = b;
+                for (int d = 0;d <= dmax;++d)
+                {
+                    if (!screen->isSignificant(a, b, c, d, direct_cutoff))
+                    {
+                        nscreened++;
+                        continue;
+                    }
+
+                    if (failed) break;
+
+                    try
+                    {
+                        TwoElectronIntegrals abcd(shells[a], shells[b], shells[c], shells[d], ERIEvaluator());
+
+                        size_t n;
+                        while ((n = abcd.process(ctx, idx[a], idx[b], idx[c], idx[d],
+                                                 TMP_BUFSIZE, eris.data(), idxs.data(), integral_cutoff)) != 0)
+                        {
+                            for (size_t m = 0;m < n;m++) idxs[m].canonicalize();
+                            contractFock(n, eris.data(), idxs.data(), irrep, start, norb,
+                                         densa, densb, densab, focka_local, fockb_local, flops,
+                                         this->restricted);
+                        }
+                    }
+                    catch (runtime_error& e)
+                    {
+                        failed = true;
+                        #pragma omp critical
+                        error = e.what();
+                    }
+                }
+            }
+        }
+
+        #pragma omp critical
+        {
+            for (int irr = 0;irr < nirrep;irr++)
+            {
+                flops += 2*norb[irr]*norb[irr];
+                axpy(norb[irr]*norb[irr], (T)1, focka_local[irr].data(), 1, focka[irr].data(), 1);
+                axpy(norb[irr]*norb[irr], (T)1, fockb_local[irr].data(), 1, fockb[irr].data(), 1);
+            }
+        }
+    }
+
+    screen->clearDensity();
+
+    if (!error.empty()) throw runtime_error(error);
+
+    arena.Allreduce(&nscreened, 1, MPI::SUM);
+
+    int64_t nquartet = (int64_t)sched.getNumBlocks()*(sched.getNumBlocks()+1)/2;
+    this->log(arena) << strprintf("%s Fock build: %ld of %ld shell quartets screened out",
+                                  (nincremental > 0 ? "Incremental" : "Full"),
+                                  (long)nscreened, (long)nquartet) << endl;
+}
+
+template <typename T>
+AORHF<T>::AORHF(const string& name, const Config& config)
+: AOUHF<T>(name, config, "aorhf", true) {}
+
 INSTANTIATE_SPECIALIZATIONS(AOUHF);
 REGISTER_TASK(AOUHF<double>, "aoscf");
+INSTANTIATE_SPECIALIZATIONS(AORHF);
+REGISTER_TASK(AORHF<double>, "aorhf");
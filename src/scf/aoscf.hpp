@@ -27,6 +27,7 @@
 
 #include "util/stl_ext.hpp"
 #include "integrals/2eints.hpp"
+#include "integrals/screening.hpp"
 
 #include "scf.hpp"
 
@@ -39,10 +40,60 @@ template <typename T>
 class AOUHF : public UHF<T>
 {
     protected:
+        bool direct;
+        int direct_rebuild;
+        double direct_cutoff;
+        double integral_cutoff;
+        int nincremental;
+        std::vector<std::vector<T> > last_focka, last_fockb;
+        std::vector<std::vector<T> > last_densa, last_densb;
+        integrals::Context ctx;
+        std::vector<integrals::Shell> shells;
+        std::vector<std::vector<int> > idx;
+        std::vector<std::vector<int> > funcs;
+        integrals::SchwarzScreening* screen;
+
         void buildFock();
 
+        /*
+         * Recompute the shell quartets which are significant for the given
+         * density (change) and add their contribution to the Fock matrices
+         */
+        void buildFockDirect(const std::vector<int>& irrep, const std::vector<int>& start,
+                             const std::vector<int>& norb,
+                             const std::vector<std::vector<T> >& densa,
+                             const std::vector<std::vector<T> >& densb,
+                             const std::vector<std::vector<T> >& densab,
+                             std::vector<std::vector<T> >& focka,
+                             std::vector<std::vector<T> >& fockb, int64_t& flops);
+
+        /*
+         * Add the Coulomb and exchange contributions of canonically-ordered
+         * integrals (ij|kl) to the Fock matrices; if restricted, only the
+         * alpha Fock matrix is formed
+         */
+        static void contractFock(size_t neris, const double* eris, const idx4_t* idxs,
+                                 const std::vector<int>& irrep, const std::vector<int>& start,
+                                 const std::vector<int>& norb,
+                                 const std::vector<std::vector<T> >& densa,
+                                 const std::vector<std::vector<T> >& densb,
+                                 const std::vector<std::vector<T> >& densab,
+                                 std::vector<std::vector<T> >& focka,
+                                 std::vector<std::vector<T> >& fockb, int64_t& flops,
+                                 bool restricted);
+
+    public:
+        AOUHF(const std::string& name, const input::Config& config,
+              const std::string& type = "aoscf", bool restricted = false);
+
+        ~AOUHF();
+};
+
+template <typename T>
+class AORHF : public AOUHF<T>
+{
     public:
-        AOUHF(const std::string& name, const input::Config& config);
+        AORHF(const std::string& name, const input::Config& config);
 };
 
 }
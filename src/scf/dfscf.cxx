@@ -0,0 +1,263 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+#include "dfscf.hpp"
+
+using namespace std;
+using namespace aquarius;
+using namespace aquarius::scf;
+using namespace aquarius::tensor;
+using namespace aquarius::input;
+using namespace aquarius::integrals;
+using namespace aquarius::task;
+using namespace aquarius::symmetry;
+
+template <typename T>
+DFUHF<T>::DFUHF(const string& name, const Config& config, const string& type, bool restricted)
+: UHF<T>(type, name, config, restricted)
+{
+    for (vector<Product>::iterator i = this->products.begin();i != this->products.end();++i)
+    {
+        i->addRequirement(Requirement("df", "B"));
+    }
+}
+
+template <typename T>
+void DFUHF<T>::buildFock()
+{
+    const Molecule& molecule = this->template get<Molecule>("molecule");
+    const PointGroup& group = molecule.getGroup();
+
+    const vector<int>& norb = molecule.getNumOrbitals();
+    vector<int> zero(norb.size(), 0);
+
+    const DensityFittedIntegrals<T>& df = this->template get<DensityFittedIntegrals<T> >("B");
+    const SymmetryBlockedTensor<T>& B = df.getB();
+    const vector<int>& nfit = df.getNumFitting();
+
+    SymmetryBlockedTensor<T>& H = this->template get<SymmetryBlockedTensor<T> >("H");
+    SymmetryBlockedTensor<T>& Da = this->template get<SymmetryBlockedTensor<T> >("Da");
+    SymmetryBlockedTensor<T>& Db = this->template get<SymmetryBlockedTensor<T> >("Db");
+    SymmetryBlockedTensor<T>& Fa = this->template get<SymmetryBlockedTensor<T> >("Fa");
+    SymmetryBlockedTensor<T>& Fb = this->template get<SymmetryBlockedTensor<T> >("Fb");
+
+    /*
+     * Coulomb contribution:
+     *
+     * F[ab] = (Da[cd]+Db[cd])*(ab|cd)
+     *
+     *       = B[abQ]*{B[cdQ]*(Da[cd]+Db[cd])}
+     */
+    SymmetryBlockedTensor<T> J("J", B.arena, group, 1, vec(nfit), vec(NS), false);
+
+    Da += Db;
+    J["Q"] = B["cdQ"]*Da["cd"];
+    Da -= Db;
+    Fa["ab"] = B["abQ"]*J["Q"];
+
+    /*
+     * Core contribution:
+     *
+     * F += H
+     *
+     * Up though this point, Fa = Fb
+     */
+    Fa += H;
+    Fb  = Fa;
+
+    /*
+     * Exchange contribution:
+     *
+     * Fa[ab] -= Da[cd]*(ac|bd)
+     *
+     *         = C[ci]*C[di]*B[acQ]*B[bdQ]
+     *
+     *         = {B[acQ]*C[ci]}*{B[bdQ]*C[di]}
+     *
+     *         = B[aiQ]*B[biQ]
+     *
+     * which scales as the number of occupied orbitals instead of basis functions.
+     * Before the first diagonalization (i.e. from a density guess) there are no
+     * orbitals, so factor the density instead.
+     */
+    if (!this->have_orbitals)
+    {
+        buildExchange(Da, Fa);
+
+        if (this->restricted)
+        {
+            Fb = Fa;
+        }
+        else
+        {
+            buildExchange(Db, Fb);
+        }
+
+        return;
+    }
+
+    SymmetryBlockedTensor<T> Ca_occ("CI", this->template gettmp<SymmetryBlockedTensor<T> >("Ca"),
+                                    vec(zero,zero), vec(norb,this->occ_alpha));
+    SymmetryBlockedTensor<T> Ba_occ("BpIQ", B.arena, group, 3, vec(norb,this->occ_alpha,nfit),
+                                    vec(NS,NS,NS), false);
+
+    Ba_occ["aiQ"] = B["acQ"]*Ca_occ["ci"];
+    Fa["ab"] -= Ba_occ["aiQ"]*Ba_occ["biQ"];
+
+    if (this->restricted)
+    {
+        Fb = Fa;
+    }
+    else
+    {
+        SymmetryBlockedTensor<T> Cb_occ("Ci", this->template gettmp<SymmetryBlockedTensor<T> >("Cb"),
+                                        vec(zero,zero), vec(norb,this->occ_beta));
+        SymmetryBlockedTensor<T> Bb_occ("BpiQ", B.arena, group, 3, vec(norb,this->occ_beta,nfit),
+                                        vec(NS,NS,NS), false);
+
+        Bb_occ["aiQ"] = B["acQ"]*Cb_occ["ci"];
+        Fb["ab"] -= Bb_occ["aiQ"]*Bb_occ["biQ"];
+    }
+}
+
+/*
+ * F[ab] -= D[cd]*(ac|bd) for a density which does not (yet) come from orbitals.
+ *
+ * D is factored as X[ci]*X[di] from its eigenvectors with non-negligible
+ * eigenvalues, so that the exchange is formed from B[aiQ] = B[acQ]*X[ci] as for
+ * the occupied orbitals. A SAD guess has only as many such eigenvalues as there
+ * are occupied atomic orbitals, which avoids a norb*norb*nfit intermediate.
+ */
+template <typename T>
+void DFUHF<T>::buildExchange(SymmetryBlockedTensor<T>& D, SymmetryBlockedTensor<T>& F)
+{
+    const Molecule& molecule = this->template get<Molecule>("molecule");
+    const PointGroup& group = molecule.getGroup();
+    int nirrep = group.getNumIrreps();
+
+    const vector<int>& norb = molecule.getNumOrbitals();
+
+    const DensityFittedIntegrals<T>& df = this->template get<DensityFittedIntegrals<T> >("B");
+    const SymmetryBlockedTensor<T>& B = df.getB();
+    const vector<int>& nfit = df.getNumFitting();
+    const Arena& arena = B.arena;
+
+    vector<int> nfactor(nirrep, 0);
+    vector<vector<T> > factor(nirrep);
+    int info = 0;
+
+    for (int i = 0;i < nirrep;i++)
+    {
+        if (norb[i] == 0) continue;
+
+        vector<int> irreps(2,i);
+
+        if (arena.rank == 0)
+        {
+            int n = norb[i];
+            vector<T> vals;
+            vector<typename real_type<T>::type> w(n);
+
+            D.getAllData(irreps, vals, 0);
+            assert(vals.size() == n*n);
+
+            /*
+             * The other ranks are still in the collectives below, so a failure
+             * is only reported once all irreps have been gone through
+             */
+            PROFILE_FLOPS(9*n*n*n);
+            int err = heev('V', 'U', n, vals.data(), n, w.data());
+            if (err != 0)
+            {
+                if (info == 0) info = err;
+                continue;
+            }
+
+            /*
+             * The density is positive semi-definite, so anything else is noise
+             */
+            int first = 0;
+            while (first < n && w[first] <= 1e-12*w[n-1]) first++;
+            nfactor[i] = n-first;
+
+            factor[i].resize(n*nfactor[i]);
+            for (int j = first;j < n;j++)
+            {
+                for (int k = 0;k < n;k++)
+                {
+                    factor[i][k+(j-first)*n] = vals[k+j*n]*sqrt(w[j]);
+                }
+            }
+        }
+        else
+        {
+            D.getAllData(irreps, 0);
+        }
+    }
+
+    arena.Bcast(&info, 1, 0);
+    if (info != 0) throw runtime_error(strprintf("DF: Info in heev: %d", info));
+
+    arena.Bcast(nfactor, 0);
+
+    SymmetryBlockedTensor<T> X("X", arena, group, 2, vec(norb,nfactor), vec(NS,NS), true);
+
+    for (int i = 0;i < nirrep;i++)
+    {
+        if (norb[i] == 0 || nfactor[i] == 0) continue;
+
+        vector<int> irreps(2,i);
+
+        if (arena.rank == 0)
+        {
+            vector< tkv_pair<T> > pairs(factor[i].size());
+
+            for (int j = 0;j < factor[i].size();j++)
+            {
+                pairs[j].k = j;
+                pairs[j].d = factor[i][j];
+            }
+
+            X.writeRemoteData(irreps, pairs);
+        }
+        else
+        {
+            X.writeRemoteData(irreps);
+        }
+    }
+
+    SymmetryBlockedTensor<T> BX("BpXQ", arena, group, 3, vec(norb,nfactor,nfit), vec(NS,NS,NS), false);
+
+    BX["aiQ"] = B["acQ"]*X["ci"];
+    F["ab"] -= BX["aiQ"]*BX["biQ"];
+}
+
+template <typename T>
+DFRHF<T>::DFRHF(const string& name, const Config& config)
+: DFUHF<T>(name, config, "dfrhf", true) {}
+
+INSTANTIATE_SPECIALIZATIONS(DFUHF);
+REGISTER_TASK(DFUHF<double>, "dfscf");
+INSTANTIATE_SPECIALIZATIONS(DFRHF);
+REGISTER_TASK(DFRHF<double>, "dfrhf");
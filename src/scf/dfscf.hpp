@@ -0,0 +1,63 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+#ifndef _AQUARIUS_SCF_DFSCF_HPP_
+#define _AQUARIUS_SCF_DFSCF_HPP_
+
+#include "integrals/df.hpp"
+
+#include "scf.hpp"
+
+namespace aquarius
+{
+namespace scf
+{
+
+/*
+ * SCF with the Coulomb and exchange matrices from density-fitted integrals (RI-JK)
+ */
+template <typename T>
+class DFUHF : public UHF<T>
+{
+    public:
+        DFUHF(const std::string& name, const input::Config& config,
+              const std::string& type = "dfscf", bool restricted = false);
+
+    protected:
+        void buildFock();
+
+        void buildExchange(tensor::SymmetryBlockedTensor<T>& D, tensor::SymmetryBlockedTensor<T>& F);
+};
+
+template <typename T>
+class DFRHF : public DFUHF<T>
+{
+    public:
+        DFRHF(const std::string& name, const input::Config& config);
+};
+
+}
+}
+
+#endif
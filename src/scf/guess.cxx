@@ -0,0 +1,369 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+
+#include "guess.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+#include "integrals/1eints.hpp"
+#include "integrals/2eints.hpp"
+#include "util/checkpoint.hpp"
+#include "util/lapack.h"
+#include "task/task.hpp"
+
+using namespace std;
+using namespace aquarius;
+using namespace aquarius::scf;
+using namespace aquarius::input;
+using namespace aquarius::integrals;
+using namespace aquarius::symmetry;
+using namespace aquarius::task;
+
+map<string,vector<vector<double> > > AtomicDensity::densities;
+
+/*
+ * Order in which the subshells (n,l) are filled
+ */
+static const int aufbau[][2] = {{1,0},{2,0},{2,1},{3,0},{3,1},{4,0},{3,2},{4,1},{5,0},{4,2},
+                                {5,1},{6,0},{4,3},{5,2},{6,1},{7,0},{5,3},{6,2},{7,1}};
+
+bool AtomicDensity::isSupported(const Atom& atom)
+{
+    for (vector<Shell>::const_iterator s = atom.getShellsBegin();s != atom.getShellsEnd();++s)
+    {
+        if (s->getL() > 1 && (!s->isSpherical() || s->getContaminants())) return false;
+    }
+
+    return true;
+}
+
+string AtomicDensity::basisKey(const Atom& atom)
+{
+    ostringstream os;
+
+    os << atom.getCenter().getElement().getSymbol();
+    for (vector<Shell>::const_iterator s = atom.getShellsBegin();s != atom.getShellsEnd();++s)
+    {
+        os << ';' << s->getL() << ',' << s->getNPrim() << ',' << s->getNContr();
+        for (int i = 0;i < s->getExponents().size();i++)
+            os << strprintf(",%.15e", s->getExponents()[i]);
+        for (int i = 0;i < s->getCoefficients().size();i++)
+            os << strprintf(",%.15e", s->getCoefficients()[i]);
+    }
+
+    return os.str();
+}
+
+const vector<vector<double> >& AtomicDensity::get(const Arena& arena, const Atom& atom, const string& cache_dir)
+{
+    string key = basisKey(atom);
+
+    map<string,vector<vector<double> > >::iterator it = densities.find(key);
+    if (it != densities.end()) return it->second;
+
+    vector<vector<double> >& P = densities[key];
+
+    if (cache_dir.empty())
+    {
+        P = calculate(atom);
+        return P;
+    }
+
+    /*
+     * File names are the element and a (FNV-1a) hash of the basis, and the full
+     * key is checked when reading in case of a collision
+     */
+    uint64_t hash = fnv1a(key);
+
+    string path = strprintf("%s/%s.%016llx.sad", cache_dir.c_str(),
+                            atom.getCenter().getElement().getSymbol().c_str(), (unsigned long long)hash);
+    Checkpoint chk(arena, path);
+
+    if (chk.beginRead())
+    {
+        vector<char> stored;
+        chk.read("basis", stored);
+        if (string(stored.begin(), stored.end()) == key) chk.read("density", P);
+        chk.endRead();
+
+        if (!P.empty()) return P;
+    }
+
+    P = calculate(atom);
+
+    try
+    {
+        chk.beginWrite();
+        chk.write("basis", vector<char>(key.begin(), key.end()));
+        chk.write("density", P);
+        chk.commit();
+    }
+    catch (runtime_error& e)
+    {
+        Logger::log(arena) << "Could not cache the atomic density: " << e.what() << endl;
+    }
+
+    return P;
+}
+
+vector<vector<double> > AtomicDensity::calculate(const Atom& atom)
+{
+    const Element& element = atom.getCenter().getElement();
+    Center center(PointGroup::C1(), vec3(), element);
+    vector<Center> centers(1, center);
+
+    vector<Shell> shells;
+    for (vector<Shell>::const_iterator s = atom.getShellsBegin();s != atom.getShellsEnd();++s)
+    {
+        shells.push_back(Shell(center, *s));
+    }
+
+    int nshell = shells.size();
+    Context ctx(Context::ISCF);
+
+    int n = 0;
+    int Lmax = 0;
+    vector<vector<int> > idx(nshell, vector<int>(1));
+    for (int s = 0;s < nshell;s++)
+    {
+        idx[s][0] = n;
+        n += shells[s].getNFunc()*shells[s].getNContr();
+        Lmax = max(Lmax, shells[s].getL());
+    }
+
+    /*
+     * Radial functions of each l as (shell, contraction)
+     */
+    vector<vector<pair<int,int> > > radial(Lmax+1);
+    for (int s = 0;s < nshell;s++)
+    {
+        for (int e = 0;e < shells[s].getNContr();e++)
+        {
+            radial[shells[s].getL()].push_back(make_pair(s, e));
+        }
+    }
+
+    /*
+     * Electrons per component m of each occupied subshell of each l
+     */
+    vector<vector<double> > occ(Lmax+1);
+    int left = element.getAtomicNumber();
+    for (int i = 0;left > 0;i++)
+    {
+        if (i == sizeof(aufbau)/sizeof(aufbau[0]))
+            throw runtime_error("Too many electrons for the SAD guess");
+
+        int l = aufbau[i][1];
+        int j = aufbau[i][0]-l-1;
+        int nelec = min(left, 2*(2*l+1));
+        left -= nelec;
+
+        if (l > Lmax || j >= radial[l].size())
+            throw runtime_error(strprintf("The basis of %s is too small for the SAD guess",
+                                          element.getSymbol().c_str()));
+
+        if (occ[l].size() <= j) occ[l].resize(j+1, 0.0);
+        occ[l][j] = (double)nelec/(2*l+1);
+    }
+
+    vector<double> S(n*n, 0.0), H(n*n, 0.0);
+    for (int a = 0;a < nshell;a++)
+    {
+        for (int b = 0;b <= a;b++)
+        {
+            OneElectronIntegrals s(shells[a], shells[b], OVIEvaluator());
+            OneElectronIntegrals h(shells[a], shells[b], OneElectronHamiltonianEvaluator(centers));
+
+            size_t nint = s.getNumInts();
+            vector<double> ints(nint);
+            vector<idx2_t> idxs(nint);
+
+            size_t nproc = s.process(ctx, idx[a], idx[b], nint, ints.data(), idxs.data());
+            for (int k = 0;k < nproc;k++)
+            {
+                S[idxs[k].i*n+idxs[k].j] = S[idxs[k].j*n+idxs[k].i] = ints[k];
+            }
+
+            nproc = h.process(ctx, idx[a], idx[b], nint, ints.data(), idxs.data());
+            for (int k = 0;k < nproc;k++)
+            {
+                H[idxs[k].i*n+idxs[k].j] = H[idxs[k].j*n+idxs[k].i] = ints[k];
+            }
+        }
+    }
+
+    /*
+     * Unique integrals (ij|kl), and the distinct index permutations of each
+     */
+    vector<double> eri;
+    vector<idx4_t> eri_idx;
+    for (int a = 0;a < nshell;a++)
+    {
+        for (int b = 0;b <= a;b++)
+        {
+            for (int c = 0;c <= a;c++)
+            {
+                int dmax = (a == c ? b : c);
+                for (int d = 0;d <= dmax;d++)
+                {
+                    TwoElectronIntegrals abcd(shells[a], shells[b], shells[c], shells[d], ERIEvaluator());
+
+                    size_t nint = abcd.getNumInts();
+                    vector<double> ints(nint);
+                    vector<idx4_t> idxs(nint);
+
+                    size_t nproc = abcd.process(ctx, idx[a], idx[b], idx[c], idx[d],
+                                                nint, ints.data(), idxs.data());
+
+                    for (int k = 0;k < nproc;k++)
+                    {
+                        idx4_t p[8];
+                        p[0] = idx4_t(idxs[k].i, idxs[k].j, idxs[k].k, idxs[k].l);
+                        p[1] = idx4_t(idxs[k].j, idxs[k].i, idxs[k].k, idxs[k].l);
+                        p[2] = idx4_t(idxs[k].i, idxs[k].j, idxs[k].l, idxs[k].k);
+                        p[3] = idx4_t(idxs[k].j, idxs[k].i, idxs[k].l, idxs[k].k);
+                        for (int q = 0;q < 4;q++) p[q+4] = idx4_t(p[q].k, p[q].l, p[q].i, p[q].j);
+
+                        for (int q = 0;q < 8;q++)
+                        {
+                            bool seen = false;
+                            for (int r = 0;r < q;r++)
+                            {
+                                seen = seen || (p[r].i == p[q].i && p[r].j == p[q].j &&
+                                                p[r].k == p[q].k && p[r].l == p[q].l);
+                            }
+                            if (seen) continue;
+
+                            eri.push_back(ints[k]);
+                            eri_idx.push_back(p[q]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /*
+     * Restricted SCF for the total density D, with each P(l) from the radial
+     * orbitals of l which diagonalize the block of the Fock matrix of a single
+     * component m
+     */
+    vector<double> D(n*n, 0.0);
+    vector<double> F(n*n);
+    vector<double> Dnew(n*n);
+
+    for (int iter = 0;iter < 100;iter++)
+    {
+        /*
+         * F[ij] = H[ij] + D[kl]*((ij|kl) - (1/2)(ik|jl))
+         */
+        F = H;
+        for (int q = 0;q < eri.size();q++)
+        {
+            const idx4_t& p = eri_idx[q];
+            F[p.i*n+p.j] += D[p.k*n+p.l]*eri[q];
+            F[p.i*n+p.k] -= 0.5*D[p.j*n+p.l]*eri[q];
+        }
+
+        fill(Dnew.begin(), Dnew.end(), 0.0);
+
+        for (int l = 0;l <= Lmax;l++)
+        {
+            int nr = radial[l].size();
+            if (nr == 0 || occ[l].empty()) continue;
+
+            vector<int> func(nr);
+            vector<double> Fl(nr*nr), Sl(nr*nr), El(nr), Pl(nr*nr, 0.0);
+
+            for (int m = 0;m < 2*l+1;m++)
+            {
+                for (int r = 0;r < nr;r++)
+                {
+                    const Shell& shell = shells[radial[l][r].first];
+                    func[r] = shell.getIndex(ctx, idx[radial[l][r].first], m, radial[l][r].second, 0);
+                }
+
+                if (m == 0)
+                {
+                    for (int r1 = 0;r1 < nr;r1++)
+                    {
+                        for (int r2 = 0;r2 < nr;r2++)
+                        {
+                            Fl[r1+r2*nr] = F[func[r1]*n+func[r2]];
+                            Sl[r1+r2*nr] = S[func[r1]*n+func[r2]];
+                        }
+                    }
+
+                    int info = hegv(AXBX, 'V', 'U', nr, Fl.data(), nr, Sl.data(), nr, El.data());
+                    if (info != 0) throw runtime_error("Diagonalization failed in the SAD guess");
+
+                    for (int j = 0;j < occ[l].size();j++)
+                    {
+                        ger(nr, nr, occ[l][j], &Fl[j*nr], 1, &Fl[j*nr], 1, Pl.data(), nr);
+                    }
+                }
+
+                for (int r1 = 0;r1 < nr;r1++)
+                {
+                    for (int r2 = 0;r2 < nr;r2++)
+                    {
+                        Dnew[func[r1]*n+func[r2]] = Pl[r1+r2*nr];
+                    }
+                }
+            }
+        }
+
+        double change = 0;
+        for (int i = 0;i < n*n;i++)
+        {
+            change = max(change, abs(Dnew[i]-D[i]));
+            D[i] = (iter == 0 ? Dnew[i] : 0.5*(D[i]+Dnew[i]));
+        }
+
+        if (change < 1e-8) break;
+    }
+
+    vector<vector<double> > P(Lmax+1);
+    for (int l = 0;l <= Lmax;l++)
+    {
+        int nr = radial[l].size();
+        P[l].resize(nr*nr);
+
+        for (int r1 = 0;r1 < nr;r1++)
+        {
+            int i = shells[radial[l][r1].first].getIndex(ctx, idx[radial[l][r1].first], 0, radial[l][r1].second, 0);
+            for (int r2 = 0;r2 < nr;r2++)
+            {
+                int j = shells[radial[l][r2].first].getIndex(ctx, idx[radial[l][r2].first], 0, radial[l][r2].second, 0);
+                P[l][r1+r2*nr] = D[i*n+j];
+            }
+        }
+    }
+
+    return P;
+}
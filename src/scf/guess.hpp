@@ -0,0 +1,87 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+
+#ifndef _AQUARIUS_SCF_GUESS_HPP_
+#define _AQUARIUS_SCF_GUESS_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "input/molecule.hpp"
+#include "integrals/shell.hpp"
+#include "util/distributed.hpp"
+#include "util/stl_ext.hpp"
+
+namespace aquarius
+{
+namespace scf
+{
+
+/*
+ * Densities of the free atoms for the superposition of atomic densities (SAD)
+ * guess.
+ *
+ * Each density is that of the neutral atom in its ground configuration,
+ * averaged over the components of each partially filled shell, from a small
+ * restricted SCF in the basis of the atom. Such a density is spherically
+ * symmetric: for each angular momentum l it is a matrix P(l) over the
+ * contracted radial functions of that l (in the order of the shells and then
+ * of the contractions), and the same for every component m. It is then
+ * unchanged by any symmetry operation which maps the atom to one of its
+ * images, so in the symmetry-adapted basis the same P(l) simply appears for
+ * every function of every irrep.
+ *
+ * Densities are kept for the rest of the run, and, if a cache directory is
+ * given, on disk for the next one, keyed by element and basis.
+ */
+class AtomicDensity
+{
+    protected:
+        static std::map<std::string,std::vector<std::vector<double> > > densities;
+
+    public:
+        /*
+         * The SAD guess requires spherical harmonic functions without contaminants
+         */
+        static bool isSupported(const input::Atom& atom);
+
+        /*
+         * P(l) for each l up to the highest angular momentum of the basis of atom,
+         * each stored as a square matrix (collective)
+         */
+        static const std::vector<std::vector<double> >& get(const Arena& arena, const input::Atom& atom,
+                                                            const std::string& cache_dir = "");
+
+    protected:
+        static std::string basisKey(const input::Atom& atom);
+
+        static std::vector<std::vector<double> > calculate(const input::Atom& atom);
+};
+
+}
+}
+
+#endif
@@ -36,16 +36,25 @@ using namespace aquarius::op;
 using namespace aquarius::symmetry;
 
 template <typename T>
-UHF<T>::UHF(const std::string& type, const std::string& name, const Config& config)
+UHF<T>::UHF(const std::string& type, const std::string& name, const Config& config,
+            bool restricted)
 : Iterative(type, name, config), frozen_core(config.get<bool>("frozen_core")),
-  diis(config.get("diis"), 2)
+  restricted(restricted), guess(config.get<string>("guess")), diis(config.get("diis"), 2),
+  ediis(config.get("ediis"), 2), use_ediis(config.get<string>("ediis.method") != "none"),
+  ediis_upper(config.get<double>("ediis.upper")), ediis_lower(config.get<double>("ediis.lower")),
+  newton(config.get<bool>("newton.enabled")), newton_start(config.get<double>("newton.start")),
+  newton_max_step(config.get<double>("newton.max_step")), newton_step(false), have_orbitals(false),
+  old_energy(numeric_limits<double>::max())
 {
+    if (config.exists("guess_cache")) guess_cache = config.get<string>("guess_cache");
+
     vector<Requirement> reqs;
     reqs += Requirement("molecule", "molecule");
     reqs += Requirement("ovi", "S");
     reqs += Requirement("1ehamiltonian", "H");
     addProduct(Product("double", "energy", reqs));
     addProduct(Product("double", "convergence", reqs));
+    addProduct(Product("double", "iterations", reqs));
     addProduct(Product("double", "S2", reqs));
     addProduct(Product("double", "multiplicity", reqs));
     addProduct(Product("occspace", "occ", reqs));
@@ -66,6 +75,12 @@ void UHF<T>::run(TaskDAG& dag, const Arena& arena)
     int nalpha = molecule.getNumAlphaElectrons();
     int nbeta = molecule.getNumBetaElectrons();
 
+    if (restricted && nalpha != nbeta)
+    {
+        throw runtime_error(strprintf("A restricted reference requires a closed-shell molecule, "
+                                      "but there are %d alpha and %d beta electrons", nalpha, nbeta));
+    }
+
     energy = molecule.getNuclearRepulsion();
 
     vector<int> shapeNN = vec(NS,NS);
@@ -97,6 +112,15 @@ void UHF<T>::run(TaskDAG& dag, const Arena& arena)
 
     calcSMinusHalf();
 
+    if (guess == "sad" && calcAtomicGuess())
+    {
+        log(arena) << "Initial guess: superposition of atomic densities" << endl;
+    }
+    else
+    {
+        log(arena) << "Initial guess: core Hamiltonian" << endl;
+    }
+
     Iterative::run(dag, arena);
 
     if (isUsed("S2") || isUsed("multiplicity"))
@@ -106,6 +130,7 @@ void UHF<T>::run(TaskDAG& dag, const Arena& arena)
 
     put("energy", new Scalar(arena, energy));
     put("convergence", new Scalar(arena, conv));
+    put("iterations", new Scalar(arena, iter-1));
 
     int nfrozen = 0;
     if (frozen_core)
@@ -188,9 +213,18 @@ template <typename T>
 void UHF<T>::iterate()
 {
     buildFock();
-    DIISExtrap();
     calcEnergy();
-    diagonalizeFock();
+    DIISExtrap();
+
+    if (newton_step)
+    {
+        rotateOrbitals();
+    }
+    else
+    {
+        diagonalizeFock();
+    }
+
     calcDensity();
 
     const Molecule& molecule = get<Molecule>("molecule");
@@ -358,6 +392,116 @@ void UHF<T>::calcSMinusHalf()
     }
 }
 
+template <typename T>
+bool UHF<T>::calcAtomicGuess()
+{
+    const Molecule& molecule = get<Molecule>("molecule");
+
+    for (vector<Atom>::const_iterator a = molecule.getAtomsBegin();a != molecule.getAtomsEnd();++a)
+    {
+        if (!AtomicDensity::isSupported(*a)) return false;
+    }
+
+    const vector<int>& norb = molecule.getNumOrbitals();
+    int nirrep = molecule.getGroup().getNumIrreps();
+    int nalpha = molecule.getNumAlphaElectrons();
+    int nbeta = molecule.getNumBetaElectrons();
+
+    SymmetryBlockedTensor<T>& Da = get<SymmetryBlockedTensor<T> >("Da");
+    SymmetryBlockedTensor<T>& Db = get<SymmetryBlockedTensor<T> >("Db");
+    const Arena& arena = Da.arena;
+
+    Context ctx(Context::ISCF);
+    vector<vector<int> > idx = Shell::setupIndices(ctx, molecule);
+
+    vector<int> irrep;
+    for (int i = 0;i < nirrep;i++) irrep += vector<int>(norb[i],i);
+
+    vector<int> start(nirrep,0);
+    for (int i = 1;i < nirrep;i++) start[i] = start[i-1]+norb[i-1];
+
+    /*
+     * Each P(l) goes on the diagonal blocks of every component and every image of
+     * the atom, which all end up in the same irrep
+     */
+    vector<vector<tkv_pair<T> > > pairs(nirrep);
+    int nelec = 0;
+    int first_shell = 0;
+    for (vector<Atom>::const_iterator a = molecule.getAtomsBegin();a != molecule.getAtomsEnd();++a)
+    {
+        const vector<vector<double> >& P = AtomicDensity::get(arena, *a, guess_cache);
+
+        vector<Shell> shells(a->getShellsBegin(), a->getShellsEnd());
+        nelec += a->getCenter().getElement().getAtomicNumber()*a->getCenter().getCenters().size();
+
+        for (int l = 0;l < P.size();l++)
+        {
+            vector<int> shell, contr;
+            for (int s = 0;s < shells.size();s++)
+            {
+                if (shells[s].getL() != l) continue;
+                for (int e = 0;e < shells[s].getNContr();e++)
+                {
+                    shell.push_back(s);
+                    contr.push_back(e);
+                }
+            }
+
+            int nr = shell.size();
+            if (nr == 0) continue;
+            assert(P[l].size() == nr*nr);
+
+            for (int r = 0;r < shells[shell[0]].getDegeneracy();r++)
+            {
+                for (int m = 0;m < 2*l+1;m++)
+                {
+                    for (int r1 = 0;r1 < nr;r1++)
+                    {
+                        int i = shells[shell[r1]].getIndex(ctx, idx[first_shell+shell[r1]], m, contr[r1], r);
+                        for (int r2 = 0;r2 < nr;r2++)
+                        {
+                            int j = shells[shell[r2]].getIndex(ctx, idx[first_shell+shell[r2]], m, contr[r2], r);
+
+                            int irr = irrep[i];
+                            assert(irr == irrep[j]);
+
+                            pairs[irr].push_back(tkv_pair<T>((i-start[irr])*norb[irr]+(j-start[irr]),
+                                                             P[l][r1+r2*nr]));
+                        }
+                    }
+                }
+            }
+        }
+
+        first_shell += shells.size();
+    }
+
+    for (int i = 0;i < nirrep;i++)
+    {
+        vector<int> irreps(2,i);
+
+        if (arena.rank == 0)
+        {
+            vector<tkv_pair<T> > alpha(pairs[i]), beta(pairs[i]);
+            for (int p = 0;p < pairs[i].size();p++)
+            {
+                alpha[p].d *= (double)nalpha/nelec;
+                beta[p].d *= (double)nbeta/nelec;
+            }
+
+            Da.writeRemoteData(irreps, alpha);
+            Db.writeRemoteData(irreps, beta);
+        }
+        else
+        {
+            Da.writeRemoteData(irreps);
+            Db.writeRemoteData(irreps);
+        }
+    }
+
+    return true;
+}
+
 template <typename T>
 void UHF<T>::diagonalizeFock()
 {
@@ -534,6 +678,13 @@ void UHF<T>::diagonalizeFock()
 
             Ca.writeRemoteData(irreps, pairs);
 
+            if (restricted)
+            {
+                Cb.writeRemoteData(irreps, pairs);
+                E_beta[i] = E_alpha[i];
+                continue;
+            }
+
             Fb.getAllData(irreps, fock, 0);
             assert(fock.size() == norb[i]*norb[i]);
             PROFILE_FLOPS(9*norb[i]*norb[i]*norb[i]);
@@ -570,6 +721,14 @@ void UHF<T>::diagonalizeFock()
             Fa.getAllData(irreps, 0);
             S.arena.Bcast(E_alpha[i], 0);
             Ca.writeRemoteData(irreps);
+
+            if (restricted)
+            {
+                Cb.writeRemoteData(irreps);
+                E_beta[i] = E_alpha[i];
+                continue;
+            }
+
             Fb.getAllData(irreps, 0);
             S.arena.Bcast(E_beta[i], 0);
             Cb.writeRemoteData(irreps);
@@ -606,6 +765,8 @@ void UHF<T>::diagonalizeFock()
         occ_beta[E_beta_sorted[i].second]++;
     }
 
+    have_orbitals = true;
+
     log(S.arena) << "Iteration " << iter << " occupation = " << occ_alpha << ", " << occ_beta << endl;
 }
 
@@ -658,11 +819,20 @@ void UHF<T>::calcDensity()
      * D[ab] = C[ai]*C[bi]
      */
     dDa["ab"]  = Da["ab"];
-    dDb["ab"]  = Db["ab"];
      Da["ab"]  = Ca_occ["ai"]*Ca_occ["bi"];
-     Db["ab"]  = Cb_occ["ai"]*Cb_occ["bi"];
     dDa["ab"] -= Da["ab"];
-    dDb["ab"] -= Db["ab"];
+
+    if (restricted)
+    {
+        dDb["ab"] = dDa["ab"];
+         Db["ab"] =  Da["ab"];
+    }
+    else
+    {
+        dDb["ab"]  = Db["ab"];
+         Db["ab"]  = Cb_occ["ai"]*Cb_occ["bi"];
+        dDb["ab"] -= Db["ab"];
+    }
 }
 
 template <typename T>
@@ -713,18 +883,281 @@ void UHF<T>::DIISExtrap()
         tmp1["ab"]  = Smhalf["ac"]*  tmp2["cb"];
           dF["ab"]  =   tmp1["ac"]*Smhalf["cb"];
 
-        tmp1["ab"]  =     Fb["ac"]*    Db["cb"];
-        tmp2["ab"]  =   tmp1["ac"]*     S["cb"];
-        tmp1["ab"]  =      S["ac"]*    Db["cb"];
-        tmp2["ab"] -=   tmp1["ac"]*    Fb["cb"];
-        tmp1["ab"]  = Smhalf["ac"]*  tmp2["cb"];
-          dF["ab"] +=   tmp1["ac"]*Smhalf["cb"];
+        /*
+         * For RHF the beta residual is identical, and Fa and Fb are
+         * extrapolated with the same coefficients so they stay equal
+         */
+        if (!restricted)
+        {
+            tmp1["ab"]  =     Fb["ac"]*    Db["cb"];
+            tmp2["ab"]  =   tmp1["ac"]*     S["cb"];
+            tmp1["ab"]  =      S["ac"]*    Db["cb"];
+            tmp2["ab"] -=   tmp1["ac"]*    Fb["cb"];
+            tmp1["ab"]  = Smhalf["ac"]*  tmp2["cb"];
+              dF["ab"] +=   tmp1["ac"]*Smhalf["cb"];
+        }
     }
 
     vector< SymmetryBlockedTensor<T>* > Fab(2);
     Fab[0] = &Fa;
     Fab[1] = &Fb;
+
+    vector< SymmetryBlockedTensor<T>* > Dab(2);
+    Dab[0] = &Da;
+    Dab[1] = &Db;
+
+    /*
+     * The energy has already been computed for the current (unextrapolated) F and D
+     */
+    if (use_ediis) ediis.push(energy, Dab, Fab);
+
+    double error = dF.norm(00);
+
     diis.extrapolate(Fab, vector< SymmetryBlockedTensor<T>* >(1, &dF));
+
+    /*
+     * Far from convergence, replace (or mix) the DIIS Fock matrix with
+     * the EDIIS/ADIIS one
+     */
+    if (use_ediis && error > ediis_lower)
+    {
+        double w = min(1.0, (error-ediis_lower)/(ediis_upper-ediis_lower));
+
+        if (w < 1)
+        {
+            SymmetryBlockedTensor<T> Fa_diis("Fa_diis", Fa);
+            SymmetryBlockedTensor<T> Fb_diis("Fb_diis", Fb);
+
+            ediis.extrapolate(Fab);
+
+            Fa["ab"] = w*Fa["ab"];
+            Fa["ab"] += (1-w)*Fa_diis["ab"];
+            Fb["ab"] = w*Fb["ab"];
+            Fb["ab"] += (1-w)*Fb_diis["ab"];
+        }
+        else
+        {
+            ediis.extrapolate(Fab);
+        }
+    }
+
+    /*
+     * Only take a quasi-Newton step when the previous one lowered the energy,
+     * otherwise fall back to diagonalization for this iteration
+     */
+    newton_step = newton && have_orbitals && error < newton_start && energy <= old_energy;
+    old_energy = energy;
+}
+
+template <typename T>
+void UHF<T>::rotateOrbitals()
+{
+    SymmetryBlockedTensor<T>& Fa = get<SymmetryBlockedTensor<T> >("Fa");
+    SymmetryBlockedTensor<T>& Fb = get<SymmetryBlockedTensor<T> >("Fb");
+    SymmetryBlockedTensor<T>& Ca = gettmp<SymmetryBlockedTensor<T> >("Ca");
+    SymmetryBlockedTensor<T>& Cb = gettmp<SymmetryBlockedTensor<T> >("Cb");
+
+    rotateOrbitals(Fa, Ca, occ_alpha, E_alpha);
+
+    if (restricted)
+    {
+        Cb["ab"] = Ca["ab"];
+        E_beta = E_alpha;
+    }
+    else
+    {
+        rotateOrbitals(Fb, Cb, occ_beta, E_beta);
+    }
+
+    log(Ca.arena) << "Iteration " << iter << " quasi-Newton step, occupation = " << occ_alpha << ", " << occ_beta << endl;
+}
+
+/*
+ * Rotate the orbitals of each irrep by U = (1 + K)(1 + K^T K)^-1/2, where
+ *
+ *   K_ai = -F_ai/(F_aa - F_ii), K_ia = -K_ai
+ *
+ * in the current MO basis. This is a quasi-Newton step using the orbital gradient F_ai and
+ * the diagonal approximation to the orbital Hessian. The occupation of each irrep is kept
+ * fixed, which avoids the flipping between occupation patterns that aufbau can cause.
+ * Afterwards, the occupied and virtual orbitals are separately made canonical.
+ */
+template <typename T>
+void UHF<T>::rotateOrbitals(const SymmetryBlockedTensor<T>& F, SymmetryBlockedTensor<T>& C,
+                            const vector<int>& occ, vector<vector<typename real_type<T>::type> >& E)
+{
+    const Molecule& molecule = get<Molecule>("molecule");
+
+    const vector<int>& norb = molecule.getNumOrbitals();
+
+    /*
+     * Lower bound on the diagonal Hessian, in case the orbital
+     * energies are out of order
+     */
+    const double min_hessian = 0.1;
+
+    for (int i = 0;i < molecule.getGroup().getNumIrreps();i++)
+    {
+        int n = norb[i];
+        int no = occ[i];
+        int nv = n-no;
+
+        if (n == 0) continue;
+
+        vector<int> irreps(2,i);
+
+        if (C.arena.rank == 0)
+        {
+            int info;
+            vector<T> c, f;
+            vector<T> fmo(n*n), K(n*n), X(n*n), U(n*n), tmp(n*n);
+            vector<typename real_type<T>::type> w(n);
+            vector< tkv_pair<T> > pairs(n*n);
+
+            C.getAllData(irreps, c, 0);
+            assert(c.size() == n*n);
+            F.getAllData(irreps, f, 0);
+            assert(f.size() == n*n);
+
+            PROFILE_FLOPS(4*n*n*n);
+            gemm('N', 'N', n, n, n, 1.0, f.data(), n,   c.data(), n, 0.0, tmp.data(), n);
+            gemm('C', 'N', n, n, n, 1.0, c.data(), n, tmp.data(), n, 0.0, fmo.data(), n);
+
+            double max_step = 0;
+            for (int a = no;a < n;a++)
+            {
+                for (int j = 0;j < no;j++)
+                {
+                    double h = max(min_hessian, (double)real(fmo[a+a*n]-fmo[j+j*n]));
+                    K[a+j*n] = -fmo[a+j*n]/h;
+                    K[j+a*n] = -conj(K[a+j*n]);
+                    max_step = max(max_step, (double)abs(K[a+j*n]));
+                }
+            }
+
+            if (max_step > newton_max_step)
+            {
+                scal(n*n, (T)(newton_max_step/max_step), K.data(), 1);
+            }
+
+            /*
+             * X = 1 + K^T K, and U = (1 + K)X^-1/2 is unitary since K is antisymmetric
+             */
+            PROFILE_FLOPS(17*n*n*n);
+            gemm('C', 'N', n, n, n, 1.0, K.data(), n, K.data(), n, 0.0, X.data(), n);
+            for (int j = 0;j < n;j++) X[j+j*n] += 1.0;
+            info = heev('V', 'U', n, X.data(), n, w.data());
+            assert(info == 0);
+
+            for (int j = 0;j < n;j++)
+            {
+                for (int k = 0;k < n;k++) tmp[k+j*n] = X[k+j*n]/sqrt(w[j]);
+            }
+
+            gemm('N', 'C', n, n, n, 1.0, tmp.data(), n, X.data(), n, 0.0, U.data(), n);
+            for (int j = 0;j < n;j++) K[j+j*n] += 1.0;
+            gemm('N', 'N', n, n, n, 1.0, K.data(), n, U.data(), n, 0.0, X.data(), n);
+            U.swap(X);
+
+            /*
+             * Diagonalize the occupied-occupied and virtual-virtual blocks of U^T F U
+             */
+            gemm('N', 'N', n, n, n, 1.0, fmo.data(), n,   U.data(), n, 0.0, tmp.data(), n);
+            gemm('C', 'N', n, n, n, 1.0,   U.data(), n, tmp.data(), n, 0.0,   X.data(), n);
+
+            for (int j = 0;j < n;j++)
+            {
+                for (int k = 0;k < n;k++)
+                {
+                    if ((j < no) != (k < no)) X[k+j*n] = 0;
+                }
+            }
+
+            if (no > 0)
+            {
+                info = heev('V', 'U', no, X.data(), n, w.data());
+                assert(info == 0);
+            }
+
+            if (nv > 0)
+            {
+                info = heev('V', 'U', nv, X.data()+no+no*n, n, w.data()+no);
+                assert(info == 0);
+            }
+
+            std::copy(w.begin(), w.end(), E[i].begin());
+            C.arena.Bcast(E[i], 0);
+
+            gemm('N', 'N', n, n, n, 1.0,   U.data(), n,   X.data(), n, 0.0, tmp.data(), n);
+            gemm('N', 'N', n, n, n, 1.0,   c.data(), n, tmp.data(), n, 0.0,   U.data(), n);
+
+            for (int j = 0;j < n*n;j++)
+            {
+                pairs[j].k = j;
+                pairs[j].d = U[j];
+            }
+
+            C.writeRemoteData(irreps, pairs);
+        }
+        else
+        {
+            C.getAllData(irreps, 0);
+            F.getAllData(irreps, 0);
+            C.arena.Bcast(E[i], 0);
+            C.writeRemoteData(irreps);
+        }
+    }
+}
+
+template <typename T>
+void UHF<T>::saveState(Checkpoint& chk)
+{
+    SymmetryBlockedTensor<T>& Fa = get<SymmetryBlockedTensor<T> >("Fa");
+    SymmetryBlockedTensor<T>& Fb = get<SymmetryBlockedTensor<T> >("Fb");
+
+    chk.writeTensor("Fa", Fa);
+    chk.writeTensor("Fb", Fb);
+    chk.writeTensor("Da", get<SymmetryBlockedTensor<T> >("Da"));
+    chk.writeTensor("Db", get<SymmetryBlockedTensor<T> >("Db"));
+    chk.writeTensor("Ca", gettmp<SymmetryBlockedTensor<T> >("Ca"));
+    chk.writeTensor("Cb", gettmp<SymmetryBlockedTensor<T> >("Cb"));
+    chk.write("occ_alpha", occ_alpha);
+    chk.write("occ_beta", occ_beta);
+    chk.write("E_alpha", E_alpha);
+    chk.write("E_beta", E_beta);
+
+    diis.save(chk);
+    ediis.save(chk);
+}
+
+template <typename T>
+void UHF<T>::loadState(Checkpoint& chk)
+{
+    SymmetryBlockedTensor<T>& Fa = get<SymmetryBlockedTensor<T> >("Fa");
+    SymmetryBlockedTensor<T>& Fb = get<SymmetryBlockedTensor<T> >("Fb");
+
+    chk.readTensor("Fa", Fa);
+    chk.readTensor("Fb", Fb);
+    chk.readTensor("Da", get<SymmetryBlockedTensor<T> >("Da"));
+    chk.readTensor("Db", get<SymmetryBlockedTensor<T> >("Db"));
+    chk.readTensor("Ca", gettmp<SymmetryBlockedTensor<T> >("Ca"));
+    chk.readTensor("Cb", gettmp<SymmetryBlockedTensor<T> >("Cb"));
+    chk.read("occ_alpha", occ_alpha);
+    chk.read("occ_beta", occ_beta);
+    chk.read("E_alpha", E_alpha);
+    chk.read("E_beta", E_beta);
+
+    vector< SymmetryBlockedTensor<T>* > Fab(2);
+    Fab[0] = &Fa;
+    Fab[1] = &Fb;
+    diis.load(chk, Fab, vector< SymmetryBlockedTensor<T>* >(1, &gettmp<SymmetryBlockedTensor<T> >("dF")));
+
+    vector< SymmetryBlockedTensor<T>* > Dab(2);
+    Dab[0] = &get<SymmetryBlockedTensor<T> >("Da");
+    Dab[1] = &get<SymmetryBlockedTensor<T> >("Db");
+    ediis.load(chk, Dab, Fab);
+
+    have_orbitals = true;
 }
 
 INSTANTIATE_SPECIALIZATIONS(UHF);
@@ -40,9 +40,12 @@
 #include "util/distributed.hpp"
 #include "util/iterative.hpp"
 #include "convergence/diis.hpp"
+#include "convergence/ediis.hpp"
 #include "task/task.hpp"
 #include "operator/space.hpp"
 
+#include "guess.hpp"
+
 namespace aquarius
 {
 namespace scf
@@ -53,13 +56,43 @@ class UHF : public Iterative
 {
     protected:
         bool frozen_core;
+        /*
+         * Closed-shell (RHF) reference: only the alpha Fock matrix is
+         * diagonalized and the beta orbitals and density are copies
+         */
+        bool restricted;
         T damping;
+        /*
+         * Initial guess: "sad" (superposition of atomic densities) or "core"
+         * (the orbitals of the core Hamiltonian), and where to cache the atomic
+         * densities (if anywhere)
+         */
+        std::string guess;
+        std::string guess_cache;
         std::vector<int> occ_alpha, occ_beta;
         std::vector<std::vector<typename std::real_type<T>::type> > E_alpha, E_beta;
         aquarius::convergence::DIIS< tensor::SymmetryBlockedTensor<T> > diis;
+        /*
+         * The Fock matrix is interpolated with EDIIS or ADIIS while the largest element
+         * of the orbital gradient [F,D] is above ediis_upper, extrapolated with DIIS
+         * below ediis_lower, and a linear mix of the two in between
+         */
+        aquarius::convergence::EDIIS< tensor::SymmetryBlockedTensor<T> > ediis;
+        bool use_ediis;
+        double ediis_upper, ediis_lower;
+        /*
+         * Once the orbital gradient is below newton_start, rotate the orbitals with
+         * a quasi-Newton step instead of diagonalizing the Fock matrix (as long as
+         * the energy keeps going down)
+         */
+        bool newton;
+        double newton_start, newton_max_step;
+        bool newton_step, have_orbitals;
+        double old_energy;
 
     public:
-        UHF(const std::string& type, const std::string& name, const input::Config& config);
+        UHF(const std::string& type, const std::string& name, const input::Config& config,
+            bool restricted = false);
 
         void iterate();
 
@@ -68,10 +101,22 @@ class UHF : public Iterative
     protected:
         void calcSMinusHalf();
 
+        /*
+         * Set Da and Db to the superposition of atomic densities, scaled to the number
+         * of alpha and beta electrons; returns false if the basis does not allow it
+         */
+        bool calcAtomicGuess();
+
         void calcS2();
 
         void diagonalizeFock();
 
+        void rotateOrbitals();
+
+        void rotateOrbitals(const tensor::SymmetryBlockedTensor<T>& F, tensor::SymmetryBlockedTensor<T>& C,
+                            const std::vector<int>& occ,
+                            std::vector<std::vector<typename std::real_type<T>::type> >& E);
+
         virtual void buildFock() = 0;
 
         void calcEnergy();
@@ -79,6 +124,10 @@ class UHF : public Iterative
         void calcDensity();
 
         void DIISExtrap();
+
+        void saveState(Checkpoint& chk);
+
+        void loadState(Checkpoint& chk);
 };
 
 }
@@ -26,17 +26,29 @@
 
 #include <set>
 #include <exception>
+#include <algorithm>
+#include <cmath>
 
 using namespace std;
 using namespace aquarius;
 using namespace aquarius::time;
 using namespace aquarius::input;
 
+/*
+ * Largest ratio of the cost hints of two tasks which are run side-by-side
+ */
+#define MAX_COST_RATIO 100.0
+
 namespace aquarius
 {
 namespace task
 {
 
+static bool isCostlier(Task* a, Task* b)
+{
+    return a->getCostHint() > b->getCostHint();
+}
+
 Logger::NullStream Logger::nullstream;
 Logger::SelfDestructStream Logger::sddstream;
 
@@ -165,11 +177,13 @@ Product& Requirement::get()
     return *product;
 }
 
+int Product::next_id = 0;
+
 Product::Product(const string& type, const string& name)
-: type(type), name(name), requirements(new vector<Requirement>()), used(new bool(false)) {}
+: type(type), name(name), requirements(new vector<Requirement>()), used(new bool(false)), id(next_id++) {}
 
 Product::Product(const string& type, const string& name, const vector<Requirement>& reqs)
-: type(type), name(name), requirements(new vector<Requirement>(reqs)), used(new bool(false)) {}
+: type(type), name(name), requirements(new vector<Requirement>(reqs)), used(new bool(false)), id(next_id++) {}
 
 void Product::addRequirement(const Requirement& req)
 {
@@ -235,6 +249,21 @@ const Schema& Task::getSchema(const string& name)
             Config schema = master.get(i->first);
             schemas[i->first] = Schema(schema);
         }
+
+        /*
+         * An entry of the form "task other" shares the schema of task other
+         */
+        for (vector<pair<string,Config> >::iterator i = configs.begin();i != configs.end();++i)
+        {
+            vector<pair<string,Config> > children = i->second.find<Config>("*");
+            if (children.size() != 1) continue;
+
+            const string& other = children[0].first;
+            if (other == i->first || schemas.find(other) == schemas.end()) continue;
+            if (!children[0].second.find<Config>("*").empty()) continue;
+
+            schemas[i->first] = schemas[other];
+        }
     }
 
     map<string,Schema>::iterator i = schemas.find(name);
@@ -256,6 +285,42 @@ const Product& Task::getProduct(const string& name) const
     return const_cast<Task&>(*this).getProduct(name);
 }
 
+bool Task::isRedistributable() const
+{
+    for (vector<Product>::const_iterator p = products.begin();p != products.end();++p)
+    {
+        if (p->getType() != "double" && p->getType() != "bool") return false;
+    }
+    return true;
+}
+
+void Task::redistribute(const Arena& world, int root, bool member)
+{
+    for (vector<Product>::iterator p = products.begin();p != products.end();++p)
+    {
+        int exists = p->exists();
+        world.Bcast(&exists, 1, root);
+        if (!exists) continue;
+
+        if (p->getType() == "double")
+        {
+            double value = (member ? p->get<Scalar>().value : 0.0);
+            world.Bcast(&value, 1, root);
+            p->put(new Scalar(world, value));
+        }
+        else if (p->getType() == "bool")
+        {
+            int value = (member ? p->get<Boolean>().value : 0);
+            world.Bcast(&value, 1, root);
+            p->put(new Boolean(world, value));
+        }
+        else
+        {
+            throw logic_error("Product " + p->getName() + " of task " + name + " cannot be redistributed");
+        }
+    }
+}
+
 Task* Task::createTask(const string& type, const string& name, const input::Config& config)
 {
     map<string,factory_func>::iterator i = tasks().find(type);
@@ -503,12 +568,246 @@ void TaskDAG::satisfyExplicitRequirements(const Arena& world)
     }
 }
 
+void TaskDAG::checkForCycles(const Arena& world)
+{
+    /*
+     * Task i depends on task j if one of its requirements is fulfilled by a product of j
+     */
+    int ntask = tasks.size();
+    vector<vector<int> > deps(ntask);
+
+    for (int i = 0;i < ntask;i++)
+    {
+        vector<Product>& products = tasks[i].first->getProducts();
+        for (vector<Product>::iterator p = products.begin();p != products.end();++p)
+        {
+            for (vector<Requirement>::iterator r = p->getRequirements().begin();r != p->getRequirements().end();++r)
+            {
+                if (!r->isFulfilled()) continue;
+
+                for (int j = 0;j < ntask;j++)
+                {
+                    vector<Product>& other = tasks[j].first->getProducts();
+                    for (vector<Product>::iterator q = other.begin();q != other.end();++q)
+                    {
+                        if (r->get().isSameAs(*q)) deps[i].push_back(j);
+                    }
+                }
+            }
+        }
+    }
+
+    /*
+     * Depth-first search, keeping the current path so that any cycle found can be reported.
+     * state is 0 for unvisited tasks, 1 for those on the current path, and 2 once finished.
+     */
+    vector<int> state(ntask, 0);
+
+    for (int start = 0;start < ntask;start++)
+    {
+        if (state[start] != 0) continue;
+
+        vector<pair<int,int> > path(1, make_pair(start, 0));
+        state[start] = 1;
+
+        while (!path.empty())
+        {
+            int i = path.back().first;
+
+            if (path.back().second == deps[i].size())
+            {
+                state[i] = 2;
+                path.pop_back();
+                continue;
+            }
+
+            int j = deps[i][path.back().second++];
+
+            if (state[j] == 1)
+            {
+                int k = path.size()-1;
+                while (path[k].first != j) k--;
+
+                string cycle;
+                for (;k < path.size();k++) cycle += tasks[path[k].first].first->getName() + " -> ";
+                cycle += tasks[j].first->getName();
+
+                throw runtime_error("Cyclic task dependency: " + cycle);
+            }
+            else if (state[j] == 0)
+            {
+                state[j] = 1;
+                path.push_back(make_pair(j, 0));
+            }
+        }
+    }
+}
+
+bool TaskDAG::isReplicated(const string& type)
+{
+    return type == "double" || type == "bool" || type == "molecule";
+}
+
+bool TaskDAG::canRunConcurrently(Task& task)
+{
+    if (!task.isRedistributable()) return false;
+
+    for (vector<Product>::iterator p = task.getProducts().begin();p != task.getProducts().end();++p)
+    {
+        for (vector<Requirement>::iterator r = p->getRequirements().begin();r != p->getRequirements().end();++r)
+        {
+            if (!isReplicated(r->getType())) return false;
+        }
+    }
+
+    return true;
+}
+
+bool TaskDAG::runTask(Task& task, const Arena& arena, string& error)
+{
+    Logger::log(arena) << "Starting task: " << task.getName() << endl;
+    Timer timer;
+
+    bool success = true;
+
+    reset_memory_high_water();
+
+    TraceScope trace("task", task.getName());
+    ProfileScope scope(task.getName());
+    timer.start();
+    try
+    {
+        task.run(*this, arena);
+    }
+    catch (runtime_error& e)
+    {
+        success = false;
+        error = e.what();
+    }
+    timer.stop();
+    scope.stop();
+
+    double dt = timer.seconds(arena);
+    double gflops = timer.gflops(arena);
+    Logger::log(arena) << "Finished task: " << task.getName() <<
+               " in " << std::fixed << std::setprecision(3) << dt << " s" << endl;
+    Logger::log(arena) << "Task: " << task.getName() <<
+               " achieved " << std::fixed << std::setprecision(3) << gflops << " Gflops/sec" << endl;
+
+    unsigned long peak = get_memory_high_water();
+    arena.Allreduce(&peak, 1, MPI::MAX);
+    Logger::log(arena) << "Task: " << task.getName() <<
+               " allocated at most " << std::fixed << std::setprecision(3) << peak/1048576.0 << " MB per process" << endl;
+
+    return success;
+}
+
+void TaskDAG::checkProducts(Task& task, const Arena& arena)
+{
+    for (vector<Product>::iterator p = task.getProducts().begin();p != task.getProducts().end();++p)
+    {
+        if (p->isUsed() && !p->exists())
+            Logger::error(arena) << "Product " << p->getName() <<
+                                    " of task " << task.getName() <<
+                                    " was not successfully produced" << endl;
+    }
+}
+
+void TaskDAG::executeConcurrently(const Arena& world, vector<Task*>& batch)
+{
+    int ntask = batch.size();
+
+    /*
+     * Every task gets at least one rank, and the rest are shared out in
+     * proportion to the cost hints (largest remainder first)
+     */
+    double total = 0;
+    vector<double> cost(ntask);
+    for (int i = 0;i < ntask;i++)
+    {
+        cost[i] = max(0.0, batch[i]->getCostHint());
+        total += cost[i];
+    }
+
+    int left = world.nproc-ntask;
+    int assigned = 0;
+    vector<int> nproc(ntask, 1);
+    vector<pair<double,int> > remainder;
+    for (int i = 0;i < ntask;i++)
+    {
+        double share = (total > 0 ? left*cost[i]/total : (double)left/ntask);
+        nproc[i] += (int)share;
+        assigned += (int)share;
+        remainder.push_back(make_pair(share-floor(share), -i));
+    }
+
+    sort(remainder.rbegin(), remainder.rend());
+    for (int i = 0;assigned < left;i++, assigned++) nproc[-remainder[i].second]++;
+
+    vector<int> root(ntask, 0);
+    for (int i = 1;i < ntask;i++) root[i] = root[i-1]+nproc[i-1];
+
+    int color = 0;
+    while (color < ntask-1 && world.rank >= root[color+1]) color++;
+
+    ostream& os = Logger::log(world) << "Running " << ntask << " tasks concurrently:";
+    for (int i = 0;i < ntask;i++) os << " " << batch[i]->getName() << " (" << nproc[i] << ")";
+    os << endl;
+
+    MPI::Intracomm comm = world.getCommunicator().Split(color, world.rank);
+
+    int failed = ntask;
+    string error;
+
+    {
+        Arena arena(comm);
+
+        if (!runTask(*batch[color], arena, error)) failed = color;
+
+        world.Allreduce(&failed, 1, MPI::MIN);
+
+        if (failed == ntask)
+        {
+            for (int i = 0;i < ntask;i++)
+            {
+                batch[i]->redistribute(world, root[i], i == color);
+                checkProducts(*batch[i], world);
+            }
+        }
+        else
+        {
+            /*
+             * Anything left on the sub-arena must go before the arena does
+             */
+            vector<Product>& products = batch[color]->getProducts();
+            for (vector<Product>::iterator p = products.begin();p != products.end();++p)
+            {
+                p->put((Resource*)NULL);
+            }
+        }
+
+        for (int i = 0;i < ntask;i++) delete batch[i];
+    }
+
+    comm.Free();
+
+    if (failed < ntask)
+    {
+        int len = error.size();
+        world.Bcast(&len, 1, root[failed]);
+        error.resize(len);
+        vector<char> buf(error.begin(), error.end());
+        world.Bcast(buf.data(), len, root[failed], MPI::CHAR);
+        throw runtime_error(string(buf.begin(), buf.end()));
+    }
+}
+
 void TaskDAG::execute(Arena& world)
 {
     satisfyExplicitRequirements(world);
     satisfyRemainingRequirements(world);
 
-    //TODO: check for cycles
+    checkForCycles(world);
 
     /*
      * Successively search for executable tasks
@@ -549,46 +848,74 @@ void TaskDAG::execute(Arena& world)
 
         if (to_execute.empty()) break;
 
+        /*
+         * Independent tasks which only need replicated inputs and whose products can be
+         * redistributed are run side-by-side on sub-arenas of world, as many at a time as
+         * there are ranks. Everything else is run on all of world, one task after another.
+         */
+        vector<Task*> concurrent, sequential;
         for (vector<Task*>::iterator t = to_execute.begin();t != to_execute.end();++t)
         {
-            Logger::log(world) << "Starting task: " << (*t)->getName() << endl;
-            Timer timer;
+            if (world.nproc > 1 && canRunConcurrently(**t))
+            {
+                concurrent.push_back(*t);
+            }
+            else
+            {
+                sequential.push_back(*t);
+            }
+        }
 
-            bool success = true;
-            string error;
+        /*
+         * Tasks are batched from the most expensive down, and a task is not run alongside
+         * one more than MAX_COST_RATIO times as expensive: it would hold on to ranks that the
+         * other task could use for nearly all of its run time. A task left alone in its
+         * batch is run on all of world.
+         */
+        stable_sort(concurrent.begin(), concurrent.end(), isCostlier);
+
+        while (concurrent.size() > 1)
+        {
+            double maxcost = concurrent[0]->getCostHint();
+
+            int ntask = 1;
+            while (ntask < min((int)concurrent.size(), world.nproc) &&
+                   concurrent[ntask]->getCostHint()*MAX_COST_RATIO >= maxcost) ntask++;
+
+            vector<Task*> batch(concurrent.begin(), concurrent.begin()+ntask);
+            concurrent.erase(concurrent.begin(), concurrent.begin()+ntask);
+
+            if (ntask == 1)
+            {
+                sequential.push_back(batch[0]);
+                continue;
+            }
 
-            timer.start();
             try
             {
-                (*t)->run(*this, world);
+                executeConcurrently(world, batch);
             }
             catch (runtime_error& e)
             {
-                success = false;
-                error = e.what();
+                for (vector<Task*>::iterator t = concurrent.begin();t != concurrent.end();++t) delete *t;
+                for (vector<Task*>::iterator t = sequential.begin();t != sequential.end();++t) delete *t;
+                throw;
             }
-            timer.stop();
+        }
+
+        sequential.insert(sequential.begin(), concurrent.begin(), concurrent.end());
 
-            double dt = timer.seconds(world);
-            double gflops = timer.gflops(world);
-            Logger::log(world) << "Finished task: " << (*t)->getName() <<
-                       " in " << std::fixed << std::setprecision(3) << dt << " s" << endl;
-            Logger::log(world) << "Task: " << (*t)->getName() <<
-                       " achieved " << std::fixed << std::setprecision(3) << gflops << " Gflops/sec" << endl;
+        for (vector<Task*>::iterator t = sequential.begin();t != sequential.end();++t)
+        {
+            string error;
 
-            if (!success)
+            if (!runTask(**t, world, error))
             {
-                while (t != to_execute.end()) delete *t++;
+                while (t != sequential.end()) delete *t++;
                 throw runtime_error(error);
             }
 
-            for (vector<Product>::iterator p = (*t)->getProducts().begin();p != (*t)->getProducts().end();++p)
-            {
-                if (p->isUsed() && !p->exists())
-                    Logger::error(world) << "Product " << p->getName() <<
-                                            " of task " << (*t)->getName() <<
-                                            " was not successfully produced" << endl;
-            }
+            checkProducts(**t, world);
 
             delete *t;
         }
@@ -604,6 +931,7 @@ CompareScalars::CompareScalars(const string& name, const Config& config)
 : Task("compare", name)
 {
     tolerance = config.get<double>("tolerance");
+    less = config.get<string>("relation") == "less";
 
     vector<Requirement> reqs;
     reqs.push_back(Requirement("double", "val1"));
@@ -616,7 +944,11 @@ void CompareScalars::run(TaskDAG& dag, const Arena& arena)
     double val1 = get<Scalar>("val1");
     double val2 = get<Scalar>("val2");
 
-    bool match = abs(val1-val2) < tolerance;
+    /*
+     * With relation less, val1 must be smaller than val2 by more than the
+     * tolerance, e.g. to check that one method converges in fewer iterations
+     */
+    bool match = less ? val2-val1 > tolerance : abs(val1-val2) < tolerance;
 
     if (match)
     {
@@ -625,7 +957,8 @@ void CompareScalars::run(TaskDAG& dag, const Arena& arena)
     else
     {
         error(arena) << "failed: " << fixed <<
-                setprecision((int)(0.5-log10(tolerance))) << val1 << " vs " << val2 << endl;
+                setprecision((int)(0.5-log10(tolerance))) << val1 <<
+                (less ? " not less than " : " vs ") << val2 << endl;
     }
 
     put("match", new Boolean(arena, match));
@@ -201,6 +201,9 @@ class Product
         std::global_ptr<Resource> data;
         std::shared_ptr<std::vector<Requirement> > requirements;
         std::shared_ptr<bool> used;
+        int id;
+
+        static int next_id;
 
     public:
         Product(const std::string& type, const std::string& name);
@@ -226,6 +229,12 @@ class Product
 
         bool exists() const { return data; }
 
+        /*
+         * Each product gets a unique id when it is created, which is kept by its
+         * copies (e.g. those held by requirements)
+         */
+        bool isSameAs(const Product& other) const { return id == other.id; }
+
         void addRequirement(const Requirement& req);
 
         void addRequirements(const std::vector<Requirement>& reqs);
@@ -329,6 +338,11 @@ class Task
             throw std::logic_error("Product " + name + " not found on task " + this->name + " or its dependencies");
         }
 
+        template <typename T> const T& get(const std::string& name) const
+        {
+            return const_cast<Task&>(*this).get<T>(name);
+        }
+
         Product& getProduct(const std::string& name);
 
         const Product& getProduct (const std::string& name) const;
@@ -339,6 +353,29 @@ class Task
 
         virtual void run(TaskDAG& dag, const Arena& arena) = 0;
 
+        /*
+         * Relative cost of running this task, used to size its share of the world
+         * arena when it is run alongside other independent tasks, and to keep tasks
+         * of very different cost from being run side-by-side at all. Tasks which can
+         * estimate their work should return a rough flop count; this is only called
+         * once all of the requirements of the task exist.
+         */
+        virtual double getCostHint() const { return 1.0; }
+
+        /*
+         * Whether all of the products of this task can be moved from a sub-arena
+         * to world by redistribute(). By default, only scalar and boolean products
+         * can be.
+         */
+        virtual bool isRedistributable() const;
+
+        /*
+         * Move the products of a task which was run on a sub-arena to world. This is
+         * called on every rank of world; root is the world rank of rank 0 of the
+         * sub-arena, and member is true on the ranks which ran the task.
+         */
+        virtual void redistribute(const Arena& world, int root, bool member);
+
         static Task* createTask(const std::string& type, const std::string& name, const input::Config& config);
 };
 
@@ -374,6 +411,22 @@ class TaskDAG
 
         void satisfyExplicitRequirements(const Arena& world);
 
+        void checkForCycles(const Arena& world);
+
+        /*
+         * Resources of these types are the same on every rank, and so can be
+         * used by tasks running on any sub-arena
+         */
+        static bool isReplicated(const std::string& type);
+
+        bool canRunConcurrently(Task& task);
+
+        bool runTask(Task& task, const Arena& arena, std::string& error);
+
+        void checkProducts(Task& task, const Arena& arena);
+
+        void executeConcurrently(const Arena& world, std::vector<Task*>& batch);
+
     public:
         TaskDAG() {}
 
@@ -390,10 +443,13 @@ class CompareScalars : public Task
 {
     protected:
         double tolerance;
+        bool less;
 
     public:
         CompareScalars(const std::string& name, const input::Config& config);
 
+        double getCostHint() const { return 0.0; }
+
         void run(TaskDAG& dag, const Arena& arena);
 };
 
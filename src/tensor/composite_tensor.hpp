@@ -186,6 +186,22 @@ class CompositeTensor : public Tensor<Derived,T>
 
         int getNumTensors() const { return tensors.size(); }
 
+        /*
+         * Copy other into each subtensor owned by this tensor, leaving references to
+         * other tensors alone. This resets an intermediate which was made as a partial
+         * copy, e.g. TwoElectronOperator(name, H, copy), without reallocating it.
+         */
+        void refresh(const Derived& other_)
+        {
+            const CompositeTensor<Derived,Base,T>& other = other_;
+            assert(tensors.size() == other.tensors.size());
+
+            for (int i = 0;i < tensors.size();i++)
+            {
+                if (tensors[i].isAlloced) *tensors[i].tensor = *other.tensors[i].tensor;
+            }
+        }
+
         bool exists(int idx) const
         {
             return tensors[idx] != NULL;
@@ -0,0 +1,230 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+
+#include <stdexcept>
+#include <map>
+#include <cmath>
+
+#include "contraction_order.hpp"
+
+using namespace std;
+using namespace aquarius::tensor;
+
+namespace
+{
+
+/*
+ * The labels of the factors in mask which also appear in idx_C or in a factor not in mask,
+ * in order of first appearance
+ */
+string keptLabels(const vector<string>& idx, const string& idx_C, unsigned mask)
+{
+    int n = idx.size();
+    string kept;
+
+    for (int i = 0;i < n;i++)
+    {
+        if (!(mask & (1u<<i))) continue;
+
+        for (int j = 0;j < idx[i].size();j++)
+        {
+            char c = idx[i][j];
+            if (kept.find(c) != string::npos) continue;
+
+            bool outside = idx_C.find(c) != string::npos;
+            for (int k = 0;k < n && !outside;k++)
+            {
+                if (!(mask & (1u<<k)) && idx[k].find(c) != string::npos) outside = true;
+            }
+
+            if (outside) kept += c;
+        }
+    }
+
+    return kept;
+}
+
+double product(const map<char,double>& length, const string& labels)
+{
+    double p = 1;
+    for (int i = 0;i < labels.size();i++) p *= length.find(labels[i])->second;
+    return p;
+}
+
+double contractionFlops(const map<char,double>& length, const string& kept_A, const string& kept_B)
+{
+    string labels = kept_A;
+    for (int i = 0;i < kept_B.size();i++)
+    {
+        if (labels.find(kept_B[i]) == string::npos) labels += kept_B[i];
+    }
+    return 2*product(length, labels);
+}
+
+map<char,double> labelLengths(const vector<string>& idx, const vector<vector<int> >& len,
+                              const string& idx_C)
+{
+    if (idx.size() != len.size()) throw logic_error("number of index strings and lengths differ");
+
+    map<char,double> length;
+
+    for (int i = 0;i < idx.size();i++)
+    {
+        if (idx[i].size() != len[i].size()) throw logic_error("index string and lengths differ in size");
+
+        for (int j = 0;j < idx[i].size();j++)
+        {
+            map<char,double>::iterator it = length.find(idx[i][j]);
+            if (it == length.end())
+            {
+                length[idx[i][j]] = len[i][j];
+            }
+            else if (it->second != len[i][j])
+            {
+                throw logic_error(string("inconsistent lengths for index ") + idx[i][j]);
+            }
+        }
+    }
+
+    for (int i = 0;i < idx_C.size();i++)
+    {
+        if (length.find(idx_C[i]) == length.end())
+            throw logic_error(string("output index ") + idx_C[i] + " does not appear in any factor");
+    }
+
+    return length;
+}
+
+}
+
+ContractionOrder::ContractionOrder(const vector<string>& idx, const vector<vector<int> >& len,
+                                   const string& idx_C)
+: flops(0), size(0)
+{
+    int n = idx.size();
+
+    if (n < 2) throw logic_error("a product must have at least two factors");
+    if (n > 16) throw logic_error("too many factors in product");
+
+    map<char,double> length = labelLengths(idx, len, idx_C);
+
+    unsigned full = (1u<<n)-1;
+    vector<string> kept(full+1);
+    vector<double> best_flops(full+1, 0);
+    vector<double> best_size(full+1, 0);
+    vector<unsigned> split(full+1, 0);
+
+    for (unsigned mask = 1;mask <= full;mask++)
+    {
+        kept[mask] = keptLabels(idx, idx_C, mask);
+
+        if ((mask & (mask-1)) == 0) continue;
+
+        /*
+         * Try every split of mask into two non-empty parts, where the part
+         * containing the lowest factor is taken as the left operand
+         */
+        unsigned low = mask & (~mask+1);
+        bool found = false;
+
+        for (unsigned sub = (mask-1) & mask;sub > 0;sub = (sub-1) & mask)
+        {
+            if (!(sub & low)) continue;
+
+            unsigned other = mask^sub;
+
+            double f = best_flops[sub]+best_flops[other]+
+                       contractionFlops(length, kept[sub], kept[other]);
+            double s = max(best_size[sub], best_size[other]);
+            if (mask != full) s = max(s, product(length, kept[mask]));
+
+            if (!found || f < best_flops[mask]*(1-1e-12) ||
+                (f <= best_flops[mask]*(1+1e-12) && s < best_size[mask]))
+            {
+                best_flops[mask] = f;
+                best_size[mask] = s;
+                split[mask] = sub;
+                found = true;
+            }
+        }
+    }
+
+    flops = best_flops[full];
+    size = best_size[full];
+
+    /*
+     * Unwind the splits into a list of steps, with each step after those
+     * for its operands
+     */
+    vector<unsigned> stack(1, full);
+    vector<unsigned> order;
+    while (!stack.empty())
+    {
+        unsigned mask = stack.back();
+        stack.pop_back();
+        if ((mask & (mask-1)) == 0) continue;
+        order.push_back(mask);
+        stack.push_back(split[mask]);
+        stack.push_back(mask^split[mask]);
+    }
+
+    map<unsigned,int> operand;
+    for (int i = 0;i < n;i++) operand[1u<<i] = i;
+
+    for (int i = (int)order.size()-1;i >= 0;i--)
+    {
+        unsigned mask = order[i];
+
+        Step step;
+        step.A = operand[split[mask]];
+        step.B = operand[mask^split[mask]];
+        step.idx = (mask == full ? idx_C : kept[mask]);
+        step.flops = contractionFlops(length, kept[split[mask]], kept[mask^split[mask]]);
+        step.size = product(length, step.idx);
+
+        operand[mask] = n+steps.size();
+        steps.push_back(step);
+    }
+}
+
+double ContractionOrder::getFlopsInOrder(const vector<string>& idx, const vector<vector<int> >& len,
+                                         const string& idx_C)
+{
+    int n = idx.size();
+
+    if (n < 2) throw logic_error("a product must have at least two factors");
+    if (n > 16) throw logic_error("too many factors in product");
+
+    map<char,double> length = labelLengths(idx, len, idx_C);
+
+    double flops = 0;
+    for (int i = 1;i < n;i++)
+    {
+        flops += contractionFlops(length, keptLabels(idx, idx_C, (1u<<i)-1),
+                                          keptLabels(idx, idx_C, 1u<<i));
+    }
+
+    return flops;
+}
@@ -0,0 +1,97 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+
+#ifndef _AQUARIUS_TENSOR_CONTRACTION_ORDER_HPP_
+#define _AQUARIUS_TENSOR_CONTRACTION_ORDER_HPP_
+
+#include <vector>
+#include <string>
+
+#include "util/stl_ext.hpp"
+
+namespace aquarius
+{
+namespace tensor
+{
+
+/*
+ * The cheapest order in which to evaluate a product of several tensors, C = A_0*A_1*...,
+ * as a sequence of binary contractions.
+ *
+ * Each index label has a single length (its total length over all irreps and spin cases),
+ * and the cost of a binary contraction is taken as twice the product of the lengths of
+ * all of the labels involved. All possible orders are searched (dynamic programming over
+ * subsets of the factors), choosing the fewest total flops and then the smallest largest
+ * intermediate.
+ */
+class ContractionOrder
+{
+    public:
+        /*
+         * Operands 0 to n-1 are the factors, and operand n+i is the result of step i.
+         * The last step produces C.
+         */
+        struct Step
+        {
+            int A, B;
+            std::string idx;
+            double flops;
+            double size;
+
+            Step() : A(-1), B(-1), flops(0), size(0) {}
+        };
+
+    protected:
+        std::vector<Step> steps;
+        double flops;
+        double size;
+
+    public:
+        ContractionOrder(const std::vector<std::string>& idx, const std::vector<std::vector<int> >& len,
+                         const std::string& idx_C);
+
+        const std::vector<Step>& getSteps() const { return steps; }
+
+        /*
+         * Total number of flops for all steps
+         */
+        double getFlops() const { return flops; }
+
+        /*
+         * Size of the largest intermediate
+         */
+        double getSize() const { return size; }
+
+        /*
+         * Flops for evaluating the product left-to-right, ((A_0*A_1)*A_2)*...
+         */
+        static double getFlopsInOrder(const std::vector<std::string>& idx, const std::vector<std::vector<int> >& len,
+                                      const std::string& idx_C);
+};
+
+}
+}
+
+#endif
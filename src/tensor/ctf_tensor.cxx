@@ -31,12 +31,28 @@ using namespace aquarius::tensor;
 template <typename T>
 map<const tCTF_World<T>*,pair<int,CTFTensor<T>*> > CTFTensor<T>::scalars;
 
+template <typename T>
+int64_t CTFTensor<T>::nextId = 0;
+
+template <typename T>
+map<string,typename CTFTensor<T>::MappedOperand> CTFTensor<T>::mappings;
+
+template <typename T>
+map<int64_t,set<string> > CTFTensor<T>::mappingsOf;
+
+template <typename T>
+map<const tCTF_World<T>*,int64_t> CTFTensor<T>::mappingSize;
+
+template <typename T>
+int64_t CTFTensor<T>::mappingCacheLimit = 0;
+
 /*
  * Create a scalar (0-dimensional tensor)
  */
 template <typename T>
 CTFTensor<T>::CTFTensor(const string& name, const Arena& arena, T scalar)
-: IndexableTensor< CTFTensor<T>,T >(name), Resource(arena), len(0), sym(0)
+: IndexableTensor< CTFTensor<T>,T >(name), Resource(arena), len(0), sym(0),
+  id(nextId++), version(0)
 {
     allocate();
     *dt = scalar;
@@ -49,7 +65,7 @@ CTFTensor<T>::CTFTensor(const string& name, const Arena& arena, T scalar)
 template <typename T>
 CTFTensor<T>::CTFTensor(const string& name, const CTFTensor<T>& A, T scalar)
 : IndexableTensor< CTFTensor<T>,T >(name), Resource(A.arena),
-  len(0), sym(0)
+  len(0), sym(0), id(nextId++), version(0)
 {
     allocate();
     *dt = scalar;
@@ -62,7 +78,7 @@ CTFTensor<T>::CTFTensor(const string& name, const CTFTensor<T>& A, T scalar)
 template <typename T>
 CTFTensor<T>::CTFTensor(const CTFTensor<T>& A, bool copy, bool zero)
 : IndexableTensor< CTFTensor<T>,T >(A.name, A.ndim), Resource(A.arena),
-  len(A.len), sym(A.sym)
+  len(A.len), sym(A.sym), id(nextId++), version(0)
 {
     allocate();
 
@@ -84,7 +100,7 @@ CTFTensor<T>::CTFTensor(const CTFTensor<T>& A, bool copy, bool zero)
 template <typename T>
 CTFTensor<T>::CTFTensor(const string& name, const CTFTensor<T>& A, bool copy, bool zero)
 : IndexableTensor< CTFTensor<T>,T >(name, A.ndim), Resource(A.arena),
-  len(A.len), sym(A.sym)
+  len(A.len), sym(A.sym), id(nextId++), version(0)
 {
     allocate();
 
@@ -103,7 +119,7 @@ CTFTensor<T>::CTFTensor(const string& name, const CTFTensor<T>& A, bool copy, bo
 template <typename T>
 CTFTensor<T>::CTFTensor(const string& name, CTFTensor<T>* A)
 : IndexableTensor< CTFTensor<T>,T >(name, A->ndim), Resource(A->arena),
-  len(A->len), sym(A->sym)
+  len(A->len), sym(A->sym), id(nextId++), version(0)
 {
     dt = A->dt;
     delete A;
@@ -113,7 +129,7 @@ CTFTensor<T>::CTFTensor(const string& name, CTFTensor<T>* A)
 template <typename T>
 CTFTensor<T>::CTFTensor(const string& name, const CTFTensor<T>& A, const vector<int>& start_A, const vector<int>& len_A)
 : IndexableTensor< CTFTensor<T>,T >(name, A.ndim), Resource(A.arena),
-  len(len_A), sym(A.sym)
+  len(len_A), sym(A.sym), id(nextId++), version(0)
 {
     allocate();
     slice((T)1, false, A, start_A, (T)0);
@@ -127,7 +143,7 @@ template <typename T>
 CTFTensor<T>::CTFTensor(const string& name, const Arena& arena, int ndim, const vector<int>& len, const vector<int>& sym,
                           bool zero)
 : IndexableTensor< CTFTensor<T>,T >(name, ndim), Resource(arena),
-  len(len), sym(sym)
+  len(len), sym(sym), id(nextId++), version(0)
 {
     assert(len.size() == ndim);
     assert(sym.size() == ndim);
@@ -145,6 +161,7 @@ CTFTensor<T>::CTFTensor(const string& name, const Arena& arena, int ndim, const
 template <typename T>
 CTFTensor<T>::~CTFTensor()
 {
+    unmap();
     unregister_scalar();
     free();
 }
@@ -161,6 +178,99 @@ void CTFTensor<T>::free()
     delete dt;
 }
 
+template <typename T>
+const CTFTensor<T>& CTFTensor<T>::mapped(const string& statement, const vector<int64_t>& ids) const
+{
+    typename map<string,MappedOperand>::iterator it = mappings.find(statement);
+
+    if (it == mappings.end())
+    {
+        MappedOperand& m = mappings[statement];
+        m.ids = ids;
+        m.version = version;
+        m.size = 0;
+        m.copy = NULL;
+        for (int i = 0;i < ids.size();i++) mappingsOf[ids[i]].insert(statement);
+        return *this;
+    }
+
+    MappedOperand& m = it->second;
+
+    if (m.version != version)
+    {
+        if (m.copy != NULL)
+        {
+            mappingSize[&arena.ctf<T>()] -= m.size;
+            delete m.copy;
+            m.copy = NULL;
+        }
+        m.version = version;
+        return *this;
+    }
+
+    if (m.copy != NULL) return *m.copy;
+
+    /*
+     * Second use of the same data by this statement: keep a copy of our own
+     * which CTF is free to leave in the distribution this statement wants
+     *
+     * The size is computed identically on every rank of the arena, so that
+     * all ranks agree on whether to make the (collective) copy
+     */
+    int64_t size = 1;
+    for (int i = 0;i < ndim;i++) size *= len[i];
+    size /= arena.nproc;
+
+    int64_t& total = mappingSize[&arena.ctf<T>()];
+    if (total+size > mappingCacheLimit) return *this;
+
+    m.copy = new CTFTensor<T>(this->name, *this);
+    m.size = size;
+    total += size;
+
+    return *m.copy;
+}
+
+template <typename T>
+void CTFTensor<T>::unmap(const string& statement)
+{
+    typename map<string,MappedOperand>::iterator it = mappings.find(statement);
+    if (it == mappings.end()) return;
+
+    MappedOperand m = it->second;
+    mappings.erase(it);
+
+    for (int i = 0;i < m.ids.size();i++)
+    {
+        map<int64_t,set<string> >::iterator of = mappingsOf.find(m.ids[i]);
+        if (of == mappingsOf.end()) continue;
+        of->second.erase(statement);
+        if (of->second.empty()) mappingsOf.erase(of);
+    }
+
+    if (m.copy != NULL)
+    {
+        mappingSize[&m.copy->arena.template ctf<T>()] -= m.size;
+        delete m.copy;
+    }
+}
+
+template <typename T>
+void CTFTensor<T>::unmap()
+{
+    map<int64_t,set<string> >::iterator of = mappingsOf.find(id);
+    if (of == mappingsOf.end()) return;
+
+    /*
+     * Copy the list, since unmap(statement) removes entries from it
+     */
+    set<string> statements(of->second);
+    for (set<string>::iterator it = statements.begin();it != statements.end();++it)
+    {
+        unmap(*it);
+    }
+}
+
 template <typename T>
 void CTFTensor<T>::register_scalar()
 {
@@ -218,6 +328,8 @@ void CTFTensor<T>::resize(int ndim, const vector<int>& len, const vector<int>& s
     this->len = len;
     this->sym = sym;
 
+    unmap();
+    modified();
     free();
     allocate();
     if (zero) *dt = (T)0;
@@ -226,6 +338,7 @@ void CTFTensor<T>::resize(int ndim, const vector<int>& len, const vector<int>& s
 template <typename T>
 T* CTFTensor<T>::getRawData(int64_t& size)
 {
+    modified();
     return const_cast<T*>(const_cast<const CTFTensor<T>&>(*this).getRawData(size));
 }
 
@@ -273,6 +386,7 @@ void CTFTensor<T>::slice(T alpha, bool conja, const CTFTensor<T>& A, const vecto
         assert(end_B[i] <= this->len[i]);
     }
 
+    modified();
     dt->slice(start_B.data(), end_B.data(), beta, *A.dt, start_A.data(), end_A.data(), alpha);
 }
 
@@ -444,9 +558,26 @@ void CTFTensor<T>::mult(T alpha, bool conja, const CTFTensor<T>& A, const string
                                   bool conjb, const CTFTensor<T>& B, const string& idx_B,
                          T  beta,                                     const string& idx_C)
 {
+    time::TraceScope trace("ctf", time::Trace::enabled ?
+        contractionName(A.name, idx_A, B.name, idx_B, beta != (T)0, this->name, idx_C) : string());
+
+    const CTFTensor<T>* A_ = &A;
+    const CTFTensor<T>* B_ = &B;
+    if (mappingCacheLimit > 0)
+    {
+        ostringstream statement;
+        statement << A.id << ':' << idx_A << ' ' << B.id << ':' << idx_B << ' ' << id << ':' << idx_C;
+        vector<int64_t> ids(1, A.id);
+        ids.push_back(B.id);
+        ids.push_back(id);
+        A_ = &A.mapped(statement.str()+" A", ids);
+        B_ = &B.mapped(statement.str()+" B", ids);
+    }
+
+    modified();
     if (beta != 1.0)
       (*this->dt)[idx_C.c_str()] = beta*(*this->dt)[idx_C.c_str()];
-    (*this->dt)[idx_C.c_str()] += alpha*(*A.dt)[idx_A.c_str()]*(*B.dt)[idx_B.c_str()];
+    (*this->dt)[idx_C.c_str()] += alpha*(*A_->dt)[idx_A.c_str()]*(*B_->dt)[idx_B.c_str()];
 /*    dt->contract(alpha, *A.dt, idx_A.c_str(),
                         *B.dt, idx_B.c_str(),
                   beta,        idx_C.c_str());
@@ -465,9 +596,23 @@ template <typename T>
 void CTFTensor<T>::sum(T alpha, bool conja, const CTFTensor<T>& A, const string& idx_A,
                         T  beta,                                     const string& idx_B)
 {
+    time::TraceScope trace("ctf", time::Trace::enabled ?
+        summationName(A.name, idx_A, beta != (T)0, this->name, idx_B) : string());
+
+    const CTFTensor<T>* A_ = &A;
+    if (mappingCacheLimit > 0)
+    {
+        ostringstream statement;
+        statement << A.id << ':' << idx_A << ' ' << id << ':' << idx_B;
+        vector<int64_t> ids(1, A.id);
+        ids.push_back(id);
+        A_ = &A.mapped(statement.str()+" A", ids);
+    }
+
+    modified();
     if (beta != 1.0)
       (*this->dt)[idx_B.c_str()] = beta*(*this->dt)[idx_B.c_str()];
-    (*this->dt)[idx_B.c_str()] += alpha*(*A.dt)[idx_A.c_str()];
+    (*this->dt)[idx_B.c_str()] += alpha*(*A_->dt)[idx_A.c_str()];
     /*dt->sum(alpha, *A.dt, idx_A.c_str(),
              beta,        idx_B.c_str());*/
 }
@@ -475,6 +620,7 @@ void CTFTensor<T>::sum(T alpha, bool conja, const CTFTensor<T>& A, const string&
 template <typename T>
 void CTFTensor<T>::scale(T alpha, const string& idx_A)
 {
+    modified();
     (*this->dt)[idx_A.c_str()] = alpha*(*this->dt)[idx_A.c_str()];
 }
 
@@ -31,8 +31,10 @@
 #include <cstdio>
 #include <stdint.h>
 #include <cstring>
+#include <sstream>
 #include <cassert>
 #include <string>
+#include <set>
 #include <algorithm>
 #include <cfloat>
 
@@ -66,6 +68,33 @@ class CTFTensor : public IndexableTensor< CTFTensor<T>,T >, public task::Resourc
         std::vector<int> len;
         std::vector<int> sym;
         static std::map<const tCTF_World<T>*,std::pair<int,CTFTensor<T>*> > scalars;
+        /*
+         * Identity and version of the data, so that cached copies of operands
+         * can be checked for staleness
+         */
+        int64_t id;
+        int64_t version;
+        static int64_t nextId;
+
+        /*
+         * Copy of an operand private to one statement, which is identified by the
+         * operands and index strings of a mult or sum. Repeated statements on unchanged data,
+         * e.g. the integrals in every CC iteration, then find their operands still
+         * in the distribution CTF chose last time and do not redistribute them.
+         *
+         * Each statement is also listed under the id of every tensor taking part
+         * in it, and is dropped when any of them is destroyed.
+         */
+        struct MappedOperand
+        {
+            std::vector<int64_t> ids;
+            int64_t version;
+            int64_t size;
+            CTFTensor<T>* copy;
+        };
+        static std::map<std::string,MappedOperand> mappings;
+        static std::map<int64_t,std::set<std::string> > mappingsOf;
+        static std::map<const tCTF_World<T>*,int64_t> mappingSize;
 
         void allocate();
 
@@ -77,7 +106,28 @@ class CTFTensor : public IndexableTensor< CTFTensor<T>,T >, public task::Resourc
 
         CTFTensor<T>& scalar() const;
 
+        void modified() { version++; }
+
+        /*
+         * Get the tensor to use as an operand in the given statement. A copy is
+         * made the second time that the statement sees the same version of
+         * the data, and is used until the data changes. ids are those of all
+         * tensors in the statement. Must not be called when mappingCacheLimit is 0.
+         */
+        const CTFTensor<T>& mapped(const std::string& statement, const std::vector<int64_t>& ids) const;
+
+        static void unmap(const std::string& statement);
+
+        void unmap();
+
     public:
+        /*
+         * Maximum number of elements per process held in statement copies of
+         * operands (see mapped()); 0 (the default) disables the copies. Set
+         * from the input with tensor { mapping_cache }.
+         */
+        static int64_t mappingCacheLimit;
+
         CTFTensor(const std::string& name, const Arena& arena, T scalar = (T)0);
 
         CTFTensor(const std::string& name, const CTFTensor<T>& A, T scalar);
@@ -129,22 +179,26 @@ class CTFTensor : public IndexableTensor< CTFTensor<T>,T >, public task::Resourc
         template <typename Container>
         void writeRemoteData(const Container& pairs)
         {
+            modified();
             dt->write(pairs.size(), pairs.data());
         }
 
         void writeRemoteData()
         {
+            modified();
             dt->write(0, NULL);
         }
 
         template <typename Container>
         void writeRemoteData(double alpha, double beta, const Container& pairs)
         {
+            modified();
             dt->write(pairs.size(), alpha, beta, pairs.data());
         }
 
         void writeRemoteData(double alpha, double beta)
         {
+            modified();
             dt->write(0, alpha, beta, NULL);
         }
 
@@ -195,6 +195,19 @@ void DenseTensor<T>::mult(const T alpha, bool conja, const DenseTensor<T>& A, co
     for (int i = 0;i <     B.ndim;i++) idx_B_[i] = idx_B[i];
     for (int i = 0;i < this->ndim;i++) idx_C_[i] = idx_C[i];
 
+    /*
+     * Plain (and batched) contractions go through gemm, and anything else
+     * (traces, diagonals, replication) through the general kernel
+     */
+    if (tensor_is_contraction(A.ndim, idx_A_.data(), B.ndim, idx_B_.data(), ndim, idx_C_.data()))
+    {
+        CHECK_RETURN_VALUE(
+        tensor_contract_dense_(alpha, A.data, A.ndim, A.len.data(), A.ld.data(), idx_A_.data(),
+                                      B.data, B.ndim, B.len.data(), B.ld.data(), idx_B_.data(),
+                               beta,    data,   ndim,   len.data(),   ld.data(), idx_C_.data()));
+        return;
+    }
+
     CHECK_RETURN_VALUE(
     tensor_mult_dense_(alpha, A.data, A.ndim, A.len.data(), A.ld.data(), idx_A_.data(),
                               B.data, B.ndim, B.len.data(), B.ld.data(), idx_B_.data(),
@@ -211,11 +224,50 @@ void DenseTensor<T>::sum(const T alpha, bool conja, const DenseTensor<T>& A, con
     for (int i = 0;i <     A.ndim;i++) idx_A_[i] = idx_A[i];
     for (int i = 0;i < this->ndim;i++) idx_B_[i] = idx_B[i];
 
+    /*
+     * Copies and reorderings go through the blocked permutation kernel, and
+     * anything else (traces, diagonals, replication) through the general kernel
+     */
+    if (tensor_is_permutation(A.ndim, idx_A_.data(), ndim, idx_B_.data()))
+    {
+        CHECK_RETURN_VALUE(
+        tensor_transpose_dense_(alpha, A.data, A.ndim, A.len.data(), A.ld.data(), idx_A_.data(),
+                                beta,    data,   ndim,   len.data(),   ld.data(), idx_B_.data()));
+        return;
+    }
+
     CHECK_RETURN_VALUE(
     tensor_sum_dense_(alpha, A.data, A.ndim, A.len.data(), A.ld.data(), idx_A_.data(),
                       beta,    data,   ndim,   len.data(),   ld.data(), idx_B_.data()));
 }
 
+template <typename T>
+DenseTensor<T>* DenseTensor<T>::newIntermediate(const string& name, const string& idx_A,
+                                                const DenseTensor<T>& B, const string& idx_B,
+                                                string& idx_C) const
+{
+    vector<int> len_C(idx_C.size());
+
+    for (int i = 0;i < idx_C.size();i++)
+    {
+        size_t j;
+        if ((j = idx_A.find(idx_C[i])) != string::npos)
+        {
+            len_C[i] = len[j];
+        }
+        else if ((j = idx_B.find(idx_C[i])) != string::npos)
+        {
+            len_C[i] = B.len[j];
+        }
+        else
+        {
+            return NULL;
+        }
+    }
+
+    return new DenseTensor<T>(name, idx_C.size(), len_C, true);
+}
+
 template <typename T>
 void DenseTensor<T>::scale(const T alpha, const string& idx_A)
 {
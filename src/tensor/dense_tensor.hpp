@@ -90,6 +90,12 @@ class DenseTensor : public LocalTensor< DenseTensor<T>,T >
 
         void scale(const T alpha, const std::string& idx_A);
 
+        std::vector<int> getIndexLengths() const { return len; }
+
+        DenseTensor<T>* newIntermediate(const std::string& name, const std::string& idx_A,
+                                        const DenseTensor<T>& B, const std::string& idx_B,
+                                        std::string& idx_C) const;
+
         //DenseTensor<T> slice(const std::vector<int>& start, const std::vector<int>& len);
 };
 
@@ -28,10 +28,12 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <stdexcept>
 
 #include "util/stl_ext.hpp"
 
 #include "tensor.hpp"
+#include "contraction_order.hpp"
 
 namespace aquarius
 {
@@ -41,6 +43,47 @@ namespace tensor
 template <class Derived, class T> class IndexableTensor;
 template <class Derived, class T> class IndexedTensor;
 template <class Derived, class T> class IndexedTensorMult;
+template <class Derived, class T> class IndexedTensorProduct;
+template <class Derived, class T> class IndexedTensorSum;
+
+/*
+ * Whether Expr is an indexed tensor expression (an indexed tensor, or a product or
+ * sum of them) over tensors of type Derived with elements of type T; only these can be
+ * terms of an IndexedTensorSum
+ */
+template <class Expr, class Derived, class T>
+struct is_indexed_expression
+{
+    static const bool value = false;
+};
+
+template <class cvDerived, class Derived, class T>
+struct is_indexed_expression<IndexedTensor<cvDerived,T>,Derived,T>
+{
+    static const bool value = std::is_same<typename std::remove_cv<cvDerived>::type,Derived>::value;
+};
+
+template <class cvDerived, class Derived, class T>
+struct is_indexed_expression<IndexedTensorMult<cvDerived,T>,Derived,T>
+{
+    static const bool value = std::is_same<typename std::remove_cv<cvDerived>::type,Derived>::value;
+};
+
+template <class Derived, class T>
+struct is_indexed_expression<IndexedTensorProduct<Derived,T>,Derived,T>
+{
+    static const bool value = true;
+};
+
+template <class Derived, class T>
+struct is_indexed_expression<IndexedTensorSum<Derived,T>,Derived,T>
+{
+    static const bool value = true;
+};
+
+#define ENABLE_IF_INDEXED_EXPRESSION(Derived,T,Expr,return_type) \
+template <class Expr> \
+typename std::enable_if<is_indexed_expression<Expr,Derived,T>::value,return_type >::type
 
 #define INHERIT_FROM_INDEXABLE_TENSOR(Derived,T) \
     protected: \
@@ -185,6 +228,32 @@ class IndexableTensorBase
 
         virtual T dot(bool conja, const Derived& A, const std::string& idx_A,
                       bool conjb,                   const std::string& idx_B) const = 0;
+
+        /**********************************************************************
+         *
+         * Support for products of more than two tensors (see IndexedTensorProduct)
+         *
+         *********************************************************************/
+        /*
+         * The length of each index, summed over irreps and spin cases where
+         * applicable, used to estimate the cost of contractions
+         */
+        virtual std::vector<int> getIndexLengths() const
+        {
+            return std::vector<int>(ndim, 1);
+        }
+
+        /*
+         * Allocate a zeroed tensor which can hold (*this)[idx_A]*B[idx_B] with the
+         * indices in idx_C, which may be reordered as the tensor type requires.
+         * Returns NULL if the product cannot be represented.
+         */
+        virtual Derived* newIntermediate(const std::string& name, const std::string& idx_A,
+                                         const Derived& B, const std::string& idx_B,
+                                         std::string& idx_C) const
+        {
+            return NULL;
+        }
 };
 
 template <class Derived, typename T>
@@ -374,12 +443,77 @@ class IndexedTensor
             return *this;
         }
 
+        ENABLE_IF_SAME(Derived,cvDerived,CONCAT(IndexedTensor<Derived,T>&))
+        operator=(const IndexedTensorProduct<cvDerived,T>& other)
+        {
+            other.evaluate((T)1, tensor_, (T)0, idx_);
+            return *this;
+        }
+
+        ENABLE_IF_SAME(Derived,cvDerived,CONCAT(IndexedTensor<Derived,T>&))
+        operator+=(const IndexedTensorProduct<cvDerived,T>& other)
+        {
+            other.evaluate((T)1, tensor_, factor_, idx_);
+            return *this;
+        }
+
+        ENABLE_IF_SAME(Derived,cvDerived,CONCAT(IndexedTensor<Derived,T>&))
+        operator-=(const IndexedTensorProduct<cvDerived,T>& other)
+        {
+            other.evaluate((T)(-1), tensor_, factor_, idx_);
+            return *this;
+        }
+
+        ENABLE_IF_SAME(Derived,cvDerived,CONCAT(IndexedTensor<Derived,T>&))
+        operator=(const IndexedTensorSum<cvDerived,T>& other)
+        {
+            other.evaluate((T)1, tensor_, (T)0, idx_);
+            return *this;
+        }
+
+        ENABLE_IF_SAME(Derived,cvDerived,CONCAT(IndexedTensor<Derived,T>&))
+        operator+=(const IndexedTensorSum<cvDerived,T>& other)
+        {
+            other.evaluate((T)1, tensor_, factor_, idx_);
+            return *this;
+        }
+
+        ENABLE_IF_SAME(Derived,cvDerived,CONCAT(IndexedTensor<Derived,T>&))
+        operator-=(const IndexedTensorSum<cvDerived,T>& other)
+        {
+            other.evaluate((T)(-1), tensor_, factor_, idx_);
+            return *this;
+        }
+
         ENABLE_IF_SAME(Derived,cvDerived,CONCAT(IndexedTensorMult<Derived,T>))
         operator*(const IndexedTensor<cvDerived,T>& other) const
         {
             return IndexedTensorMult<Derived,T>(*this, other);
         }
 
+        ENABLE_IF_SAME(Derived,cvDerived,CONCAT(IndexedTensorProduct<typename std::remove_cv<Derived>::type,T>))
+        operator*(const IndexedTensorMult<cvDerived,T>& other) const
+        {
+            return IndexedTensorProduct<typename std::remove_cv<Derived>::type,T>(*this)*other;
+        }
+
+        /**********************************************************************
+         *
+         * Sums of terms (see IndexedTensorSum)
+         *
+         *********************************************************************/
+        ENABLE_IF_INDEXED_EXPRESSION(CONCAT(typename std::remove_cv<Derived>::type),T,Expr,CONCAT(IndexedTensorSum<typename std::remove_cv<Derived>::type,T>))
+        operator+(const Expr& other) const
+        {
+            return IndexedTensorSum<typename std::remove_cv<Derived>::type,T>(*this)+other;
+        }
+
+        ENABLE_IF_INDEXED_EXPRESSION(CONCAT(typename std::remove_cv<Derived>::type),T,Expr,CONCAT(IndexedTensorSum<typename std::remove_cv<Derived>::type,T>))
+        operator-(const Expr& other) const
+        {
+            return IndexedTensorSum<typename std::remove_cv<Derived>::type,T>(*this)-other;
+        }
+
         ENABLE_IF_SAME(Derived,cvDerived,CONCAT(IndexedTensorMult<Derived,T>))
         operator*(const ScaledTensor<cvDerived,T>& other) const
         {
@@ -529,6 +663,422 @@ class IndexedTensorMult
         {
             return other*factor;
         }
+
+        /**********************************************************************
+         *
+         * Products of more than two tensors, and sums of terms
+         *
+         *********************************************************************/
+        ENABLE_IF_SAME(Derived,cvDerived,CONCAT(IndexedTensorProduct<typename std::remove_cv<Derived>::type,T>))
+        operator*(const IndexedTensor<cvDerived,T>& other) const
+        {
+            return IndexedTensorProduct<typename std::remove_cv<Derived>::type,T>(*this)*other;
+        }
+
+        ENABLE_IF_INDEXED_EXPRESSION(CONCAT(typename std::remove_cv<Derived>::type),T,Expr,CONCAT(IndexedTensorSum<typename std::remove_cv<Derived>::type,T>))
+        operator+(const Expr& other) const
+        {
+            return IndexedTensorSum<typename std::remove_cv<Derived>::type,T>(*this)+other;
+        }
+
+        ENABLE_IF_INDEXED_EXPRESSION(CONCAT(typename std::remove_cv<Derived>::type),T,Expr,CONCAT(IndexedTensorSum<typename std::remove_cv<Derived>::type,T>))
+        operator-(const Expr& other) const
+        {
+            return IndexedTensorSum<typename std::remove_cv<Derived>::type,T>(*this)-other;
+        }
+};
+
+/*
+ * A lazily-evaluated product of any number of indexed tensors, e.g. A["abef"]*B["efmn"]*C["mnij"].
+ *
+ * On assignment to an indexed tensor, the order of the binary contractions is chosen by
+ * ContractionOrder from the index lengths of the factors, and the intermediates are
+ * created with newIntermediate and freed as soon as they have been used.
+ */
+template <class Derived, typename T>
+class IndexedTensorProduct
+{
+    public:
+        struct Factor
+        {
+            const Derived* tensor;
+            std::string idx;
+            bool conj;
+
+            Factor(const Derived& tensor, const std::string& idx, bool conj)
+            : tensor(&tensor), idx(idx), conj(conj) {}
+        };
+
+        std::vector<Factor> factors_;
+        T factor_;
+
+        template <class cvDerived>
+        IndexedTensorProduct(const IndexedTensor<cvDerived,T>& A)
+        : factor_(A.factor_)
+        {
+            factors_.push_back(Factor(A.tensor_, A.idx_, A.conj_));
+        }
+
+        template <class cvDerived>
+        IndexedTensorProduct(const IndexedTensorMult<cvDerived,T>& AB)
+        : factor_(AB.factor_)
+        {
+            factors_.push_back(Factor(AB.A_.tensor_, AB.A_.idx_, AB.A_.conj_));
+            factors_.push_back(Factor(AB.B_.tensor_, AB.B_.idx_, AB.B_.conj_));
+        }
+
+        /**********************************************************************
+         *
+         * Unary negation, conjugation
+         *
+         *********************************************************************/
+        IndexedTensorProduct<Derived,T> operator-() const
+        {
+            IndexedTensorProduct<Derived,T> ret(*this);
+            ret.factor_ = -ret.factor_;
+            return ret;
+        }
+
+        friend IndexedTensorProduct<Derived,T> conj(const IndexedTensorProduct<Derived,T>& other)
+        {
+            IndexedTensorProduct<Derived,T> ret(other);
+            for (int i = 0;i < ret.factors_.size();i++) ret.factors_[i].conj = !ret.factors_[i].conj;
+            return ret;
+        }
+
+        /**********************************************************************
+         *
+         * Products with further tensors
+         *
+         *********************************************************************/
+        template <class cvDerived>
+        IndexedTensorProduct<Derived,T> operator*(const IndexedTensor<cvDerived,T>& other) const
+        {
+            IndexedTensorProduct<Derived,T> ret(*this);
+            ret.factors_.push_back(Factor(other.tensor_, other.idx_, other.conj_));
+            ret.factor_ *= other.factor_;
+            return ret;
+        }
+
+        template <class cvDerived>
+        IndexedTensorProduct<Derived,T> operator*(const IndexedTensorMult<cvDerived,T>& other) const
+        {
+            return (*this)*IndexedTensorProduct<Derived,T>(other);
+        }
+
+        IndexedTensorProduct<Derived,T> operator*(const IndexedTensorProduct<Derived,T>& other) const
+        {
+            IndexedTensorProduct<Derived,T> ret(*this);
+            ret.factors_.insert(ret.factors_.end(), other.factors_.begin(), other.factors_.end());
+            ret.factor_ *= other.factor_;
+            return ret;
+        }
+
+        /**********************************************************************
+         *
+         * Operations with scalars
+         *
+         *********************************************************************/
+        IndexedTensorProduct<Derived,T> operator*(const T factor) const
+        {
+            IndexedTensorProduct<Derived,T> ret(*this);
+            ret.factor_ *= factor;
+            return ret;
+        }
+
+        IndexedTensorProduct<Derived,T> operator/(const T factor) const
+        {
+            IndexedTensorProduct<Derived,T> ret(*this);
+            ret.factor_ /= factor;
+            return ret;
+        }
+
+        friend IndexedTensorProduct<Derived,T> operator*(const T factor, const IndexedTensorProduct<Derived,T>& other)
+        {
+            return other*factor;
+        }
+
+        /**********************************************************************
+         *
+         * Sums of terms
+         *
+         *********************************************************************/
+        ENABLE_IF_INDEXED_EXPRESSION(Derived,T,Expr,CONCAT(IndexedTensorSum<Derived,T>))
+        operator+(const Expr& other) const
+        {
+            return IndexedTensorSum<Derived,T>(*this)+other;
+        }
+
+        ENABLE_IF_INDEXED_EXPRESSION(Derived,T,Expr,CONCAT(IndexedTensorSum<Derived,T>))
+        operator-(const Expr& other) const
+        {
+            return IndexedTensorSum<Derived,T>(*this)-other;
+        }
+
+        /**********************************************************************
+         *
+         * Evaluation
+         *
+         *********************************************************************/
+        /*
+         * C[idx_C] = alpha*(this product) + beta*C[idx_C]
+         */
+        void evaluate(const T alpha, Derived& C, const T beta, const std::string& idx_C) const
+        {
+            int n = factors_.size();
+
+            if (n == 1)
+            {
+                const Factor& A = factors_[0];
+                C.sum(alpha*factor_, A.conj, *A.tensor, A.idx, beta, idx_C);
+                return;
+            }
+
+            if (n == 2)
+            {
+                const Factor& A = factors_[0];
+                const Factor& B = factors_[1];
+                C.mult(alpha*factor_, A.conj, *A.tensor, A.idx,
+                                      B.conj, *B.tensor, B.idx,
+                       beta,                             idx_C);
+                return;
+            }
+
+            std::vector<std::string> idx(n);
+            std::vector<std::vector<int> > len(n);
+            for (int i = 0;i < n;i++)
+            {
+                idx[i] = factors_[i].idx;
+                len[i] = factors_[i].tensor->getIndexLengths();
+            }
+
+            ContractionOrder order(idx, len, idx_C);
+            const std::vector<ContractionOrder::Step>& steps = order.getSteps();
+            int nstep = steps.size();
+
+            std::vector<const Derived*> operand(n+nstep, (const Derived*)NULL);
+            std::vector<Derived*> owned(n+nstep, (Derived*)NULL);
+            std::vector<bool> conj(n+nstep, false);
+            idx.resize(n+nstep);
+
+            for (int i = 0;i < n;i++)
+            {
+                operand[i] = factors_[i].tensor;
+                conj[i] = factors_[i].conj;
+            }
+
+            for (int s = 0;s < nstep-1;s++)
+            {
+                const ContractionOrder::Step& step = steps[s];
+                const Derived& A = *operand[step.A];
+                const Derived& B = *operand[step.B];
+
+                idx[n+s] = step.idx;
+                Derived* AB = A.newIntermediate(A.name+"*"+B.name, idx[step.A], B, idx[step.B], idx[n+s]);
+
+                if (AB == NULL)
+                {
+                    for (int i = 0;i < n+s;i++) delete owned[i];
+                    throw std::logic_error("cannot form intermediate " + A.name+"[\""+idx[step.A]+"\"]*"+
+                                                                         B.name+"[\""+idx[step.B]+"\"]");
+                }
+
+                AB->mult((T)1, conj[step.A], A, idx[step.A],
+                               conj[step.B], B, idx[step.B],
+                         (T)0,                  idx[n+s]);
+
+                operand[n+s] = owned[n+s] = AB;
+
+                delete owned[step.A];
+                delete owned[step.B];
+                owned[step.A] = owned[step.B] = NULL;
+            }
+
+            const ContractionOrder::Step& last = steps[nstep-1];
+            C.mult(alpha*factor_, conj[last.A], *operand[last.A], idx[last.A],
+                                  conj[last.B], *operand[last.B], idx[last.B],
+                   beta,                                          idx_C);
+
+            for (int i = 0;i < n+nstep;i++) delete owned[i];
+        }
+};
+
+/*
+ * A lazily-evaluated sum of terms, each an indexed tensor or a product of any number of
+ * them, e.g. Z["abij"] += A["ae"]*T["ebij"] - B["mi"]*T["abmj"] + C["abef"]*D["efmn"]*E["mnij"].
+ *
+ * On assignment, every term is accumulated directly into the output, or into a copy of it
+ * if a term after the first reads the output. Terms which differ only in one factor with
+ * the same indices, e.g. A["ae"]*T["ebij"] + A["ae"]*U["ebij"], are fused into one product
+ * with the sum of those factors, A["ae"]*(T+U)["ebij"].
+ */
+template <class Derived, typename T>
+class IndexedTensorSum
+{
+    public:
+        std::vector<IndexedTensorProduct<Derived,T> > terms_;
+
+        template <class cvDerived>
+        IndexedTensorSum(const IndexedTensor<cvDerived,T>& A)
+        : terms_(1, IndexedTensorProduct<Derived,T>(A)) {}
+
+        template <class cvDerived>
+        IndexedTensorSum(const IndexedTensorMult<cvDerived,T>& AB)
+        : terms_(1, IndexedTensorProduct<Derived,T>(AB)) {}
+
+        IndexedTensorSum(const IndexedTensorProduct<Derived,T>& ABC)
+        : terms_(1, ABC) {}
+
+        /**********************************************************************
+         *
+         * Unary negation
+         *
+         *********************************************************************/
+        IndexedTensorSum<Derived,T> operator-() const
+        {
+            IndexedTensorSum<Derived,T> ret(*this);
+            for (int i = 0;i < ret.terms_.size();i++) ret.terms_[i].factor_ = -ret.terms_[i].factor_;
+            return ret;
+        }
+
+        /**********************************************************************
+         *
+         * Further terms
+         *
+         *********************************************************************/
+        ENABLE_IF_INDEXED_EXPRESSION(Derived,T,Expr,CONCAT(IndexedTensorSum<Derived,T>))
+        operator+(const Expr& other) const
+        {
+            IndexedTensorSum<Derived,T> ret(*this);
+            IndexedTensorSum<Derived,T> rhs(other);
+            ret.terms_.insert(ret.terms_.end(), rhs.terms_.begin(), rhs.terms_.end());
+            return ret;
+        }
+
+        ENABLE_IF_INDEXED_EXPRESSION(Derived,T,Expr,CONCAT(IndexedTensorSum<Derived,T>))
+        operator-(const Expr& other) const
+        {
+            return (*this)+(-IndexedTensorSum<Derived,T>(other));
+        }
+
+        /**********************************************************************
+         *
+         * Operations with scalars
+         *
+         *********************************************************************/
+        IndexedTensorSum<Derived,T> operator*(const T factor) const
+        {
+            IndexedTensorSum<Derived,T> ret(*this);
+            for (int i = 0;i < ret.terms_.size();i++) ret.terms_[i].factor_ *= factor;
+            return ret;
+        }
+
+        friend IndexedTensorSum<Derived,T> operator*(const T factor, const IndexedTensorSum<Derived,T>& other)
+        {
+            return other*factor;
+        }
+
+        /**********************************************************************
+         *
+         * Evaluation
+         *
+         *********************************************************************/
+        /*
+         * C[idx_C] = alpha*(this sum) + beta*C[idx_C]
+         */
+        void evaluate(const T alpha, Derived& C, const T beta, const std::string& idx_C) const
+        {
+            typedef typename IndexedTensorProduct<Derived,T>::Factor Factor;
+
+            std::vector<IndexedTensorProduct<Derived,T> > terms(terms_);
+            std::vector<Derived*> owned;
+
+            for (int i = 0;i < terms.size();i++)
+            {
+                for (int j = i+1;j < terms.size();)
+                {
+                    int which = fusableFactor(terms[i], terms[j]);
+
+                    if (which == -1)
+                    {
+                        j++;
+                        continue;
+                    }
+
+                    Factor& X = terms[i].factors_[which];
+                    const Factor& Y = terms[j].factors_[which];
+
+                    /*
+                     * Replace the distinct factor of term i by a new tensor which
+                     * holds the (scaled) sum of those of terms i and j
+                     */
+                    if (std::find(owned.begin(), owned.end(), X.tensor) == owned.end())
+                    {
+                        Derived* sum = new Derived(X.tensor->name, *X.tensor);
+                        sum->sum(terms[i].factor_, X.conj, *X.tensor, X.idx, (T)0, X.idx);
+                        owned.push_back(sum);
+                        X = Factor(*sum, X.idx, false);
+                        terms[i].factor_ = (T)1;
+                    }
+
+                    const_cast<Derived*>(X.tensor)->sum(terms[j].factor_, Y.conj, *Y.tensor, Y.idx, (T)1, X.idx);
+                    terms.erase(terms.begin()+j);
+                }
+            }
+
+            /*
+             * Term 0 overwrites C, so if a later term reads C, accumulate into a
+             * copy instead and only write C at the end
+             */
+            bool aliased = false;
+            for (int i = 1;i < terms.size();i++)
+            {
+                for (int j = 0;j < terms[i].factors_.size();j++)
+                {
+                    if (terms[i].factors_[j].tensor == &C) aliased = true;
+                }
+            }
+
+            Derived* out = (aliased ? new Derived(C.name, C) : &C);
+
+            for (int i = 0;i < terms.size();i++)
+            {
+                terms[i].evaluate(alpha, *out, (i == 0 ? beta : (T)1), idx_C);
+            }
+
+            if (aliased)
+            {
+                C.sum((T)1, false, *out, idx_C, (T)0, idx_C);
+                delete out;
+            }
+
+            for (int i = 0;i < owned.size();i++) delete owned[i];
+        }
+
+    protected:
+        /*
+         * If A and B are products of the same tensors (in the same order) except for one
+         * factor, which has the same indices in both, return the position of that factor,
+         * otherwise -1
+         */
+        static int fusableFactor(const IndexedTensorProduct<Derived,T>& A, const IndexedTensorProduct<Derived,T>& B)
+        {
+            if (A.factors_.size() < 2 || A.factors_.size() != B.factors_.size()) return -1;
+
+            int which = -1;
+            for (int i = 0;i < A.factors_.size();i++)
+            {
+                const typename IndexedTensorProduct<Derived,T>::Factor& a = A.factors_[i];
+                const typename IndexedTensorProduct<Derived,T>::Factor& b = B.factors_[i];
+
+                if (a.idx != b.idx) return -1;
+                if (a.tensor == b.tensor && a.conj == b.conj) continue;
+                if (which != -1) return -1;
+                which = i;
+            }
+
+            return which;
+        }
 };
 
 }
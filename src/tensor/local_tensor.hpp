@@ -92,6 +92,9 @@ switch (ret) \
     case TENSOR_INVALID_START: \
         throw InvalidStartError(); \
         break; \
+    case TENSOR_OUT_OF_MEMORY: \
+        aq_throw_out_of_memory(__FILE__, __LINE__); \
+        break; \
     default: \
         break; \
 }
@@ -168,8 +171,8 @@ class LocalTensor : public IndexableTensor<Derived,T>
             if (ld.size() != ndim)
             {
                 ld.resize(ndim);
-                ld[0] = 1;
-                for (int i = 1;i < ndim;i++) ld[i] = ld[i-1]*len[i-1];
+                if (ndim > 0) ld[0] = 1;
+                for (int i = 1;i < ndim;i++) ld[i] = len[i-1];
             }
 
             #ifdef VALIDATE_INPUTS
@@ -179,7 +182,7 @@ class LocalTensor : public IndexableTensor<Derived,T>
             }
             #endif //VALIDATE_INPUTS
 
-            data = data;
+            this->data = data;
             isAlloced = false;
             if (zero) std::fill(data, data+size, (T)0);
         }
@@ -192,8 +195,8 @@ class LocalTensor : public IndexableTensor<Derived,T>
             if (ld.size() != ndim)
             {
                 ld.resize(ndim);
-                ld[0] = 1;
-                for (int i = 1;i < ndim;i++) ld[i] = ld[i-1]*len[i-1];
+                if (ndim > 0) ld[0] = 1;
+                for (int i = 1;i < ndim;i++) ld[i] = len[i-1];
             }
 
             #ifdef VALIDATE_INPUTS
@@ -149,6 +149,9 @@ static int conv_idx(const vector<int>& cidx_A, string& iidx_A,
 template<class T>
 map<const tCTF_World<T>*,map<const PointGroup*,pair<int,SpinorbitalTensor<T>*> > > SpinorbitalTensor<T>::scalars;
 
+template<class T>
+map<string,vector<vector<typename SpinorbitalTensor<T>::MultTerm> > > SpinorbitalTensor<T>::multTerms;
+
 template<class T>
 SpinorbitalTensor<T>::SpinorbitalTensor(const string& name, const SpinorbitalTensor<T>& t, const T val)
 : IndexableCompositeTensor<SpinorbitalTensor<T>,SymmetryBlockedTensor<T>,T >(name, 0, 0),
@@ -371,23 +374,26 @@ const SymmetryBlockedTensor<T>& SpinorbitalTensor<T>::operator()(const vector<in
 }
 
 template<class T>
-void SpinorbitalTensor<T>::mult(const T alpha, bool conja, const SpinorbitalTensor<T>& A, const string& idx_A,
-                                               bool conjb, const SpinorbitalTensor<T>& B, const string& idx_B,
-                                const T beta_,                                            const string& idx_C)
+const vector<vector<typename SpinorbitalTensor<T>::MultTerm> >&
+SpinorbitalTensor<T>::expandMult(const SpinorbitalTensor<T>& A, const string& idx_A,
+                                 const SpinorbitalTensor<T>& B, const string& idx_B,
+                                                                const string& idx_C) const
 {
-    assert(group == A.group);
-    assert(group == B.group);
-    assert(idx_A.size() == A.ndim);
-    assert(idx_B.size() == B.ndim);
-    assert(idx_C.size() == this->ndim);
-    assert(spaces == A.spaces || this->ndim == 0 || A.ndim == 0);
-    assert(spaces == B.spaces || this->ndim == 0 || B.ndim == 0);
+    ostringstream os;
+    os << idx_A << '|' << idx_B << '|' << idx_C << '|'
+       << A.nout << A.nin << '|' << B.nout << B.nin << '|' << nout << nin;
+    for (int sc = 0;sc < cases.size();sc++)
+        os << '|' << cases[sc].alpha_out << cases[sc].alpha_in;
+    string key = os.str();
 
-    vector<T> beta(cases.size(), beta_);
+    typename map<string,vector<vector<MultTerm> > >::iterator it = multTerms.find(key);
+    if (it != multTerms.end()) return it->second;
+
+    vector<vector<MultTerm> > terms(cases.size());
 
     for (int sc = 0;sc < cases.size();sc++)
     {
-        SpinCase& scC = cases[sc];
+        const SpinCase& scC = cases[sc];
 
         int nouttot_C = std::sum(nout);
 
@@ -680,38 +686,86 @@ void SpinorbitalTensor<T>::mult(const T alpha, bool conja, const SpinorbitalTens
                      idx_B_, idx_B__,
                      idx_C_, idx_C__);
 
-            const SymmetryBlockedTensor<T>& tensor_A = A(alpha_out_A, alpha_in_A);
-            const SymmetryBlockedTensor<T>& tensor_B = B(alpha_out_B, alpha_in_B);
+            MultTerm term;
+            term.factor = diagFactor;
+            term.alpha_out_A = alpha_out_A;
+            term.alpha_in_A = alpha_in_A;
+            term.alpha_out_B = alpha_out_B;
+            term.alpha_in_B = alpha_in_B;
+            term.idx_A = idx_A__;
+            term.idx_B = idx_B__;
+            term.idx_C = idx_C__;
 
             /*
-            cout << alpha << " " << beta[sc] << " " << *t << endl;
-            cout <<    tensor_A.getSymmetry() << " " <<   alpha_out_A << " " <<   alpha_in_A << endl;
-            cout <<    tensor_B.getSymmetry() << " " <<   alpha_out_B << " " <<   alpha_in_B << endl;
-            cout << scC.tensor->getSymmetry() << " " << scC.alpha_out << " " << scC.alpha_in << endl;
-            cout << idx_A__ << " " << idx_B__ << " " << idx_C__ << endl;
-
-            T before;
-            if (this->ndim == 0)
+             * Fuse terms which contract the same spin blocks in the same way
+             */
+            int j;
+            for (j = 0;j < terms[sc].size();j++)
             {
-                int64_t n;
-                before = (*scC.tensor)(0).getRawData(n)[0];
+                if (terms[sc][j].alpha_out_A == alpha_out_A &&
+                    terms[sc][j].alpha_in_A  == alpha_in_A  &&
+                    terms[sc][j].alpha_out_B == alpha_out_B &&
+                    terms[sc][j].alpha_in_B  == alpha_in_B  &&
+                    terms[sc][j].idx_A == idx_A__ &&
+                    terms[sc][j].idx_B == idx_B__ &&
+                    terms[sc][j].idx_C == idx_C__) break;
             }
-            */
-
-            scC.tensor->mult(alpha*diagFactor, conja, tensor_A, idx_A__,
-                                               conjb, tensor_B, idx_B__,
-                                     beta[sc],                  idx_C__);
 
-            /*
-            if (this->ndim == 0)
+            if (j == terms[sc].size())
             {
-                int64_t n;
-                cout << "? " << (*scC.tensor)(0).getRawData(n)[0]-before << endl;
+                terms[sc].push_back(term);
             }
-            */
+            else
+            {
+                terms[sc][j].factor += diagFactor;
+            }
+        }
+
+        for (int j = terms[sc].size()-1;j >= 0;j--)
+        {
+            if (terms[sc][j].factor == 0.0) terms[sc].erase(terms[sc].begin()+j);
+        }
+    }
+
+    return multTerms[key] = terms;
+}
+
+template<class T>
+void SpinorbitalTensor<T>::mult(const T alpha, bool conja, const SpinorbitalTensor<T>& A, const string& idx_A,
+                                               bool conjb, const SpinorbitalTensor<T>& B, const string& idx_B,
+                                const T beta_,                                            const string& idx_C)
+{
+    assert(group == A.group);
+    assert(group == B.group);
+    assert(idx_A.size() == A.ndim);
+    assert(idx_B.size() == B.ndim);
+    assert(idx_C.size() == this->ndim);
+    assert(spaces == A.spaces || this->ndim == 0 || A.ndim == 0);
+    assert(spaces == B.spaces || this->ndim == 0 || B.ndim == 0);
+
+    time::ProfileScope scope(contractionName(A.name, idx_A, B.name, idx_B, beta_ != (T)0, this->name, idx_C));
+
+    vector<T> beta(cases.size(), beta_);
+
+    const vector<vector<MultTerm> >& terms = expandMult(A, idx_A, B, idx_B, idx_C);
+
+    for (int sc = 0;sc < cases.size();sc++)
+    {
+        for (int t = 0;t < terms[sc].size();t++)
+        {
+            const MultTerm& term = terms[sc][t];
+
+            cases[sc].tensor->mult(alpha*term.factor, conja, A(term.alpha_out_A, term.alpha_in_A), term.idx_A,
+                                                      conjb, B(term.alpha_out_B, term.alpha_in_B), term.idx_B,
+                                               beta[sc],                                         term.idx_C);
 
             beta[sc] = 1.0;
         }
+
+        /*
+         * C = beta*C even if every term of this spin case has cancelled
+         */
+        if (beta[sc] != 1.0) cases[sc].tensor->scale(beta[sc]);
     }
 }
 
@@ -1076,6 +1130,99 @@ void SpinorbitalTensor<T>::unregister_scalar()
     }
 }
 
+template <typename T>
+void SpinorbitalTensor<T>::getIndexType(int i, int& space, bool& out) const
+{
+    out = true;
+    for (space = 0;space < spaces.size();space++)
+    {
+        if (i < nout[space]) return;
+        i -= nout[space];
+    }
+
+    out = false;
+    for (space = 0;space < spaces.size();space++)
+    {
+        if (i < nin[space]) return;
+        i -= nin[space];
+    }
+
+    throw logic_error("index out of range");
+}
+
+template <typename T>
+vector<int> SpinorbitalTensor<T>::getIndexLengths() const
+{
+    vector<int> lengths(this->ndim);
+
+    for (int i = 0;i < this->ndim;i++)
+    {
+        int s; bool out;
+        getIndexType(i, s, out);
+        lengths[i] = std::sum(spaces[s].nalpha)+std::sum(spaces[s].nbeta);
+    }
+
+    return lengths;
+}
+
+template <typename T>
+SpinorbitalTensor<T>* SpinorbitalTensor<T>::newIntermediate(const string& name, const string& idx_A,
+                                                            const SpinorbitalTensor<T>& B, const string& idx_B,
+                                                            string& idx_C) const
+{
+    if (!(group == B.group) || !(spaces == B.spaces)) return NULL;
+
+    int nspaces = spaces.size();
+    vector<int> nout_C(nspaces, 0), nin_C(nspaces, 0);
+    vector<string> out_C(nspaces), in_C(nspaces);
+
+    for (int i = 0;i < idx_C.size();i++)
+    {
+        int s; bool out;
+        size_t j;
+
+        if ((j = idx_A.find(idx_C[i])) != string::npos)
+        {
+            getIndexType(j, s, out);
+        }
+        else if ((j = idx_B.find(idx_C[i])) != string::npos)
+        {
+            B.getIndexType(j, s, out);
+        }
+        else
+        {
+            return NULL;
+        }
+
+        if (out)
+        {
+            nout_C[s]++;
+            out_C[s] += idx_C[i];
+        }
+        else
+        {
+            nin_C[s]++;
+            in_C[s] += idx_C[i];
+        }
+    }
+
+    /*
+     * Same conditions on the spin as in the constructor
+     */
+    int nouttot = std::sum(nout_C);
+    int nintot = std::sum(nin_C);
+    int spin_C = spin+B.spin;
+    if (abs(spin_C) > nouttot+nintot ||
+        abs(spin_C) < abs(nouttot-nintot) ||
+        abs(spin_C)%2 != abs(nouttot-nintot)%2) return NULL;
+
+    idx_C.clear();
+    for (int s = 0;s < nspaces;s++) idx_C += out_C[s];
+    for (int s = 0;s < nspaces;s++) idx_C += in_C[s];
+
+    return new SpinorbitalTensor<T>(name, this->arena, group, spaces, nout_C, nin_C, spin_C);
+}
+
 template <typename T>
 SpinorbitalTensor<T>& SpinorbitalTensor<T>::scalar() const
 {
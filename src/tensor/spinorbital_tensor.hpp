@@ -30,6 +30,7 @@
 #include <cstring>
 #include <cassert>
 #include <string>
+#include <sstream>
 #include <algorithm>
 
 #include "autocc/autocc.hpp"
@@ -92,6 +93,17 @@ class SpinorbitalTensor : public IndexableCompositeTensor<SpinorbitalTensor<T>,S
 
         typename std::real_type<T>::type norm(int p) const;
 
+        std::vector<int> getIndexLengths() const;
+
+        /*
+         * The indices of the intermediate are ordered as for any other spinorbital tensor:
+         * first the outgoing and then the incoming indices, each grouped by space. Each
+         * index keeps the space and direction it has in A or B.
+         */
+        SpinorbitalTensor<T>* newIntermediate(const std::string& name, const std::string& idx_A,
+                                              const SpinorbitalTensor<T>& B, const std::string& idx_B,
+                                              std::string& idx_C) const;
+
     protected:
         struct SpinCase
         {
@@ -110,11 +122,37 @@ class SpinorbitalTensor : public IndexableCompositeTensor<SpinorbitalTensor<T>,S
         std::vector<SpinCase> cases;
         static std::map<const tCTF_World<T>*,std::map<const symmetry::PointGroup*,std::pair<int,SpinorbitalTensor<T>*> > > scalars;
 
+        /*
+         * One spin-orbital contraction term C(spin case) += factor*A(spin case)*B(spin case)
+         */
+        struct MultTerm
+        {
+            double factor;
+            std::vector<int> alpha_out_A, alpha_in_A;
+            std::vector<int> alpha_out_B, alpha_in_B;
+            std::string idx_A, idx_B, idx_C;
+        };
+
+        /*
+         * Spin-case expansions of mult for each spin case of C, keyed by the index
+         * strings and the shapes of the operands
+         */
+        static std::map<std::string,std::vector<std::vector<MultTerm> > > multTerms;
+
         void register_scalar();
 
         void unregister_scalar();
 
         SpinorbitalTensor<T>& scalar() const;
+
+        const std::vector<std::vector<MultTerm> >& expandMult(const SpinorbitalTensor<T>& A, const std::string& idx_A,
+                                                              const SpinorbitalTensor<T>& B, const std::string& idx_B,
+                                                                                             const std::string& idx_C) const;
+
+        /*
+         * The space and direction (outgoing or incoming) of index i
+         */
+        void getIndexType(int i, int& space, bool& out) const;
 };
 
 }
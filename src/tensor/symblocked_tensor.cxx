@@ -25,6 +25,7 @@
 #include <fstream>
 
 #include "symblocked_tensor.hpp"
+#include "dense_tensor.hpp"
 
 using namespace std;
 using namespace aquarius::tensor;
@@ -415,6 +416,177 @@ vector<int> SymmetryBlockedTensor<T>::getStrides(const string& indices, const in
     return strides;
 }
 
+template <class T>
+bool SymmetryBlockedTensor<T>::isBatchable(const CTFTensor<T>& A)
+{
+    const vector<int>& len = A.getLengths();
+    const vector<int>& sym = A.getSymmetry();
+
+    int64_t size = 1;
+    for (int i = 0;i < A.getDimension();i++)
+    {
+        if (sym[i] != NS) return false;
+        size *= len[i];
+    }
+
+    return size <= batchThreshold;
+}
+
+/*
+ * Record the flops and bytes of one block contraction, as for dense blocks spread
+ * evenly over the ranks
+ */
+template <class T>
+void SymmetryBlockedTensor<T>::profileBlock(const BlockMult& block) const
+{
+    const CTFTensor<T>* tensors[3] = {block.A, block.B, block.C};
+    const string* idx[3] = {&block.idx_A, &block.idx_B, &block.idx_C};
+
+    map<char,int64_t> extent;
+    int64_t size = 0;
+    for (int t = 0;t < 3;t++)
+    {
+        const vector<int>& len = tensors[t]->getLengths();
+        int64_t n = 1;
+        for (int i = 0;i < len.size();i++)
+        {
+            extent[(*idx[t])[i]] = len[i];
+            n *= len[i];
+        }
+        size += n;
+    }
+
+    int64_t flops = 2;
+    for (map<char,int64_t>::iterator it = extent.begin();it != extent.end();++it) flops *= it->second;
+
+    time::profile_flops(flops/arena.nproc);
+    time::profile_bytes(size*(int64_t)sizeof(T)/arena.nproc);
+}
+
+template <class T>
+void SymmetryBlockedTensor<T>::multBlocks(const vector<BlockMult>& blocks, vector<T>& beta)
+{
+    /*
+     * A block of C is batched only if it and all of its contributions are small
+     */
+    vector<int> batched(tensors.size(), 1);
+    for (int b = 0;b < blocks.size();b++)
+    {
+        profileBlock(blocks[b]);
+
+        if (!isBatchable(*blocks[b].A) ||
+            !isBatchable(*blocks[b].B) ||
+            !isBatchable(*blocks[b].C)) batched[blocks[b].off_C] = 0;
+    }
+
+    for (int b = 0;b < blocks.size();b++)
+    {
+        const BlockMult& block = blocks[b];
+        if (batched[block.off_C]) continue;
+
+        block.C->mult(block.alpha, block.conja, *block.A, block.idx_A,
+                                   block.conjb, *block.B, block.idx_B,
+                      beta[block.off_C],                  block.idx_C);
+
+        beta[block.off_C] = 1.0;
+    }
+
+    /*
+     * Collect the distinct input blocks and the groups of the batched blocks of C
+     */
+    vector<const CTFTensor<T>*> inputs;
+    vector<int> groups;
+    for (int b = 0;b < blocks.size();b++)
+    {
+        const BlockMult& block = blocks[b];
+        if (!batched[block.off_C]) continue;
+
+        if (find(inputs.begin(), inputs.end(), block.A) == inputs.end()) inputs.push_back(block.A);
+        if (find(inputs.begin(), inputs.end(), block.B) == inputs.end()) inputs.push_back(block.B);
+        if (find(groups.begin(), groups.end(), block.off_C) == groups.end()) groups.push_back(block.off_C);
+    }
+
+    if (groups.empty()) return;
+
+    /*
+     * Replicate all of the input blocks on every rank at once, with the
+     * keys of block i offset by the total size of blocks 0..i-1
+     */
+    vector<int64_t> offset(inputs.size()+1, 0);
+    vector<tkv_pair<T> > local, pairs;
+    for (int i = 0;i < inputs.size();i++)
+    {
+        const vector<int>& len = inputs[i]->getLengths();
+        int64_t size = 1;
+        for (int j = 0;j < inputs[i]->getDimension();j++) size *= len[j];
+        offset[i+1] = offset[i]+size;
+
+        inputs[i]->getLocalData(pairs);
+        for (int j = 0;j < pairs.size();j++) pairs[j].k += offset[i];
+        local.insert(local.end(), pairs.begin(), pairs.end());
+    }
+
+    vector<int> counts(arena.nproc, 0);
+    counts[arena.rank] = local.size()*sizeof(tkv_pair<T>);
+    arena.Allgather(counts);
+
+    int64_t npair = 0;
+    for (int p = 0;p < arena.nproc;p++) npair += counts[p]/sizeof(tkv_pair<T>);
+
+    vector<tkv_pair<T> > all(npair);
+    arena.Allgatherv((const char*)local.data(), counts[arena.rank],
+                     (char*)all.data(), counts.data(), MPI::BYTE);
+
+    vector<T> data(offset[inputs.size()], (T)0);
+    for (int64_t i = 0;i < npair;i++) data[all[i].k] = all[i].d;
+
+    /*
+     * Each group is computed by one rank and written back, scaling C by beta
+     */
+    for (int g = 0;g < groups.size();g++)
+    {
+        CTFTensor<T>* C = NULL;
+        vector<tkv_pair<T> > out;
+
+        for (int b = 0;b < blocks.size();b++)
+        {
+            const BlockMult& block = blocks[b];
+            if (block.off_C == groups[g]) C = block.C;
+        }
+
+        if (g%arena.nproc == arena.rank)
+        {
+            DenseTensor<T> C_("C", C->getDimension(), C->getLengths(), true);
+
+            for (int b = 0;b < blocks.size();b++)
+            {
+                const BlockMult& block = blocks[b];
+                if (block.off_C != groups[g]) continue;
+
+                int ia = find(inputs.begin(), inputs.end(), block.A)-inputs.begin();
+                int ib = find(inputs.begin(), inputs.end(), block.B)-inputs.begin();
+
+                DenseTensor<T> A_("A", block.A->getDimension(), block.A->getLengths(), data.data()+offset[ia]);
+                DenseTensor<T> B_("B", block.B->getDimension(), block.B->getLengths(), data.data()+offset[ib]);
+
+                C_.mult(block.alpha, block.conja, A_, block.idx_A,
+                                     block.conjb, B_, block.idx_B,
+                                  1.0,                block.idx_C);
+            }
+
+            const vector<int>& len = C->getLengths();
+            int64_t size = 1;
+            for (int i = 0;i < C->getDimension();i++) size *= len[i];
+
+            out.resize(size);
+            for (int64_t k = 0;k < size;k++) out[k] = tkv_pair<T>(k, C_.getData()[k]);
+        }
+
+        C->writeRemoteData(1.0, beta[groups[g]], out);
+        beta[groups[g]] = 1.0;
+    }
+}
+
 template <class T>
 void SymmetryBlockedTensor<T>::mult(T alpha, bool conja, const SymmetryBlockedTensor<T>& A, const string& idx_A,
                                              bool conjb, const SymmetryBlockedTensor<T>& B, const string& idx_B,
@@ -423,6 +595,8 @@ void SymmetryBlockedTensor<T>::mult(T alpha, bool conja, const SymmetryBlockedTe
     assert(group == A.group);
     assert(group == B.group);
 
+    time::ProfileScope scope(contractionName(A.name, idx_A, B.name, idx_B, beta != (T)0, this->name, idx_C));
+
     int n = group.getNumIrreps();
 
     string idx_A_(idx_A);
@@ -567,6 +741,7 @@ void SymmetryBlockedTensor<T>::mult(T alpha, bool conja, const SymmetryBlockedTe
     stride_C.resize(m);
 
     vector<T> beta_(tensors.size(), beta);
+    vector<BlockMult> blocks;
 
     int off_A = 0;
     int off_B = 0;
@@ -588,11 +763,19 @@ void SymmetryBlockedTensor<T>::mult(T alpha, bool conja, const SymmetryBlockedTe
 
             int off_C_ = (tensors[off_C].isAlloced ? off_C : tensors[off_C].ref);
             assert(off_C_ >= 0 && off_C_ < tensors.size());
-            tensors[off_C].tensor->mult(alpha*f1*f3/f2, conja, *A.tensors[off_A].tensor, idx_A__,
-                                                        conjb, *B.tensors[off_B].tensor, idx_B__,
-                                         beta_[off_C_],                                  idx_C__);
 
-            beta_[off_C_] = 1.0;
+            BlockMult block;
+            block.alpha = alpha*f1*f3/f2;
+            block.conja = conja;
+            block.conjb = conjb;
+            block.A = A.tensors[off_A].tensor;
+            block.B = B.tensors[off_B].tensor;
+            block.C = tensors[off_C].tensor;
+            block.idx_A = idx_A__;
+            block.idx_B = idx_B__;
+            block.idx_C = idx_C__;
+            block.off_C = off_C_;
+            blocks.push_back(block);
         }
 
         for (int i = 0;i < m;i++)
@@ -619,6 +802,8 @@ void SymmetryBlockedTensor<T>::mult(T alpha, bool conja, const SymmetryBlockedTe
 
         if (m == 0) done = true;
     }
+
+    multBlocks(blocks, beta_);
 }
 
 template <class T>
@@ -932,6 +1117,9 @@ typename std::real_type<T>::type SymmetryBlockedTensor<T>::norm(int p) const
 template<class T>
 map<const tCTF_World<T>*,map<const PointGroup*,pair<int,SymmetryBlockedTensor<T>*> > > SymmetryBlockedTensor<T>::scalars;
 
+template<class T>
+int64_t SymmetryBlockedTensor<T>::batchThreshold = 4096;
+
 template <typename T>
 void SymmetryBlockedTensor<T>::register_scalar()
 {
@@ -974,6 +1162,44 @@ void SymmetryBlockedTensor<T>::unregister_scalar()
     }
 }
 
+template <typename T>
+vector<int> SymmetryBlockedTensor<T>::getIndexLengths() const
+{
+    vector<int> lengths(ndim);
+    for (int i = 0;i < ndim;i++) lengths[i] = std::sum(len[i]);
+    return lengths;
+}
+
+template <typename T>
+SymmetryBlockedTensor<T>* SymmetryBlockedTensor<T>::newIntermediate(const string& name, const string& idx_A,
+                                                                    const SymmetryBlockedTensor<T>& B, const string& idx_B,
+                                                                    string& idx_C) const
+{
+    if (!(group == B.group)) return NULL;
+
+    int ndim_C = idx_C.size();
+    vector<vector<int> > len_C(ndim_C);
+
+    for (int i = 0;i < ndim_C;i++)
+    {
+        size_t j;
+        if ((j = idx_A.find(idx_C[i])) != string::npos)
+        {
+            len_C[i] = len[j];
+        }
+        else if ((j = idx_B.find(idx_C[i])) != string::npos)
+        {
+            len_C[i] = B.len[j];
+        }
+        else
+        {
+            return NULL;
+        }
+    }
+
+    return new SymmetryBlockedTensor<T>(name, arena, group, ndim_C, len_C, vector<int>(ndim_C, NS), true);
+}
+
 template <typename T>
 SymmetryBlockedTensor<T>& SymmetryBlockedTensor<T>::scalar() const
 {
@@ -59,6 +59,20 @@ class SymmetryBlockedTensor : public IndexableCompositeTensor<SymmetryBlockedTen
         std::vector<std::vector<int> > reorder;
         static std::map<const tCTF_World<T>*,std::map<const symmetry::PointGroup*,std::pair<int,SymmetryBlockedTensor<T>*> > > scalars;
 
+        /*
+         * One symmetry-allowed block of a contraction, C_off_C += alpha*A*B
+         */
+        struct BlockMult
+        {
+            T alpha;
+            bool conja, conjb;
+            const CTFTensor<T>* A;
+            const CTFTensor<T>* B;
+            CTFTensor<T>* C;
+            std::string idx_A, idx_B, idx_C;
+            int off_C;
+        };
+
         static std::vector<int> getStrides(const std::string& indices, const int ndim,
                                            const int len, const std::string& idx_A);
 
@@ -74,7 +88,26 @@ class SymmetryBlockedTensor : public IndexableCompositeTensor<SymmetryBlockedTen
 
         SymmetryBlockedTensor<T>& scalar() const;
 
+        static bool isBatchable(const CTFTensor<T>& A);
+
+        void profileBlock(const BlockMult& block) const;
+
+        /*
+         * Perform the block contractions of a mult, grouped by the block of C. Groups
+         * in which every block is small enough are contracted locally after
+         * replicating all of their inputs with a single collective, and only
+         * the large groups are passed to CTF.
+         */
+        void multBlocks(const std::vector<BlockMult>& blocks, std::vector<T>& beta);
+
     public:
+        /*
+         * Largest number of elements in a block (without internal symmetry) which is
+         * contracted locally as part of a batch instead of by CTF; 0 disables
+         * batching. Set from the input with tensor { batch_threshold }.
+         */
+        static int64_t batchThreshold;
+
         SymmetryBlockedTensor(const SymmetryBlockedTensor<T>& other);
 
         SymmetryBlockedTensor(SymmetryBlockedTensor<T>* other);
@@ -195,6 +228,12 @@ class SymmetryBlockedTensor : public IndexableCompositeTensor<SymmetryBlockedTen
         void weight(const std::vector<const std::vector<std::vector<T> >*>& d);
 
         typename std::real_type<T>::type norm(int p) const;
+
+        std::vector<int> getIndexLengths() const;
+
+        SymmetryBlockedTensor<T>* newIntermediate(const std::string& name, const std::string& idx_A,
+                                                  const SymmetryBlockedTensor<T>& B, const std::string& idx_B,
+                                                  std::string& idx_C) const;
 };
 
 }
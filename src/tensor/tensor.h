@@ -66,6 +66,7 @@
 #define TENSOR_SYMMETRY_MISMATCH    -8
 #define TENSOR_INVALID_SYMMETRY     -9
 #define TENSOR_INVALID_START        -10
+#define TENSOR_OUT_OF_MEMORY        -11
 
 #ifdef __cplusplus
 extern "C"
@@ -144,6 +145,20 @@ int tensor_mult_dense_(const double alpha, const double* A, const int ndim_A, co
                                            const double* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
                        const double beta,        double* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C);
 
+/**
+ * Check if every index label appears exactly once in each of exactly two of A, B, and C, or exactly once in each of all three,
+ * i.e. that C = A*B is a (batched) contraction which tensor_contract_dense_ can perform
+ */
+int tensor_is_contraction(const int ndim_A, const int* idx_A,
+                          const int ndim_B, const int* idx_B,
+                          const int ndim_C, const int* idx_C);
+
+/**
+ * Contract two tensors into a third with matrix multiplication
+ *
+ * The general form is ab...ef...gh... * ef...cd...gh... -> ab...cd...gh... where the indices ef... will be summed over and
+ * gh... are batch indices. Indices may be transposed in any tensor and any index group may be empty.
+ */
 int tensor_contract_dense_(const double alpha, const double* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
                                                const double* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
                            const double beta,        double* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C);
@@ -237,6 +252,13 @@ typedef int (*tensor_func_unary_dense)(const double alpha, const double* A, cons
 int tensor_sum_dense_(const double alpha, const double* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
                       const double beta,        double* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B);
 
+/**
+ * Check if B = A only reorders the indices, i.e. every index label appears exactly once in each of A and B,
+ * so that tensor_transpose_dense_ can perform the sum
+ */
+int tensor_is_permutation(const int ndim_A, const int* idx_A,
+                          const int ndim_B, const int* idx_B);
+
 int tensor_transpose_dense_(const double alpha, const double* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
                             const double beta,        double* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B);
 
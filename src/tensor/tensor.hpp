@@ -57,6 +57,29 @@ class SymmetryMismatchError;
 class InvalidSymmetryError;
 class InvalidStartError;
 
+/*
+ * Name of the contraction C[idx_C] (+)= A[idx_A]*B[idx_B] in the profile
+ */
+inline std::string contractionName(const std::string& A, const std::string& idx_A,
+                                   const std::string& B, const std::string& idx_B,
+                                   bool accumulate,
+                                   const std::string& C, const std::string& idx_C)
+{
+    return C + "[" + idx_C + "] " + (accumulate ? "+=" : "=") + " " +
+           A + "[" + idx_A + "]*" + B + "[" + idx_B + "]";
+}
+
+/*
+ * Name of the summation B[idx_B] (+)= A[idx_A] in the profile
+ */
+inline std::string summationName(const std::string& A, const std::string& idx_A,
+                                 bool accumulate,
+                                 const std::string& B, const std::string& idx_B)
+{
+    return B + "[" + idx_B + "] " + (accumulate ? "+=" : "=") + " " +
+           A + "[" + idx_A + "]";
+}
+
 #define INHERIT_FROM_TENSOR(Derived,T) \
     public: \
         using aquarius::tensor::Tensor< Derived,T >::getDerived; \
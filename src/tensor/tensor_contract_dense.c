@@ -0,0 +1,556 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+/**
+ * Contract two tensors into a third.
+ *
+ * The general form for a contraction is \f$ab\ldots ef\ldots gh\ldots \times ef\ldots cd\ldots gh\ldots \rightarrow ab\ldots cd\ldots gh\ldots\f$
+ * where the indices ef... will be summed over, and gh... are batch indices. Indices may be transposed in any tensor, and any
+ * index group may be empty.
+ *
+ * The contraction is done as a matrix multiplication (one for each value of the batch indices), with ab... as the rows and
+ * cd... as the columns of C, and ef... as the inner dimension. Any tensor whose indices cannot already be addressed as such a
+ * matrix (in some order of the indices within each group) is first transposed into a temporary. The orders are chosen so that
+ * as little data as possible is transposed.
+ */
+
+#include "tensor.h"
+#include "util.h"
+#include "util/blas.h"
+#include "util/math_ext.h"
+#include "memory/memory.h"
+#include <string.h>
+
+/*
+ * An index of the contraction, with its stride in each of A, B, and C (or zero if absent)
+ */
+typedef struct
+{
+    int len;
+    size_t stride[3];
+} contract_index;
+
+/*
+ * Sort the indices of a group by increasing stride in tensor t
+ */
+static void sort_by_stride(const int t, const int n, contract_index* group)
+{
+    int i, j;
+    contract_index tmp;
+
+    for (i = 1;i < n;i++)
+    {
+        tmp = group[i];
+        for (j = i;j > 0 && group[j-1].stride[t] > tmp.stride[t];j--) group[j] = group[j-1];
+        group[j] = tmp;
+    }
+}
+
+/*
+ * Check if the indices of a group (in order) can be treated as a single index in tensor t
+ */
+static bool fuse_indices(const int t, const int n, const contract_index* group, size_t* len, size_t* stride)
+{
+    int i;
+
+    *len = 1;
+    *stride = 1;
+
+    if (n == 0) return true;
+
+    *stride = group[0].stride[t];
+    *len = group[0].len;
+
+    for (i = 1;i < n;i++)
+    {
+        if (group[i].stride[t] != group[i-1].stride[t]*group[i-1].len) return false;
+        *len *= group[i].len;
+    }
+
+    return true;
+}
+
+/*
+ * Check if tensor t can be addressed as a column-major matrix (or its transpose) with the indices of P
+ * as the rows and those of Q as the columns, and if so find the arguments to pass to gemm
+ */
+static bool matrix_view(const int t, const int np, const contract_index* P, const int nq, const contract_index* Q,
+                        char* trans, integer* ld)
+{
+    size_t len_P, len_Q, stride_P, stride_Q;
+
+    if (!fuse_indices(t, np, P, &len_P, &stride_P)) return false;
+    if (!fuse_indices(t, nq, Q, &len_Q, &stride_Q)) return false;
+
+    if (stride_P == 1 && (len_Q == 1 || stride_Q >= len_P))
+    {
+        *trans = 'N';
+        *ld = (len_Q == 1 ? len_P : stride_Q);
+        return true;
+    }
+
+    if (stride_Q == 1 && (len_P == 1 || stride_P >= len_Q))
+    {
+        *trans = 'T';
+        *ld = (len_P == 1 ? len_Q : stride_P);
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * Transpose the indices P, Q, and batch indices L of tensor t into a new array, in that order,
+ * or return NULL if it cannot be allocated
+ */
+static double* pack_matrix(const int t, const double* restrict X,
+                           const int np, const contract_index* P, const int nq, const contract_index* Q,
+                           const int nl, const contract_index* L, size_t* restrict stride_L)
+{
+    int i, n;
+    int len[np+nq+nl];
+    size_t stride_X[np+nq+nl];
+    size_t stride_Y[np+nq+nl];
+    size_t size;
+    double* Y;
+
+    n = 0;
+    for (i = 0;i < np;i++, n++)
+    {
+        len[n] = P[i].len;
+        stride_X[n] = P[i].stride[t];
+    }
+    for (i = 0;i < nq;i++, n++)
+    {
+        len[n] = Q[i].len;
+        stride_X[n] = Q[i].stride[t];
+    }
+    for (i = 0;i < nl;i++, n++)
+    {
+        len[n] = L[i].len;
+        stride_X[n] = L[i].stride[t];
+    }
+
+    size = 1;
+    for (i = 0;i < n;i++)
+    {
+        stride_Y[i] = size;
+        size *= len[i];
+    }
+
+    for (i = 0;i < nl;i++) stride_L[i] = stride_Y[np+nq+i];
+
+    Y = MALLOC(double, size);
+    if (Y == NULL) return NULL;
+
+    permute_strided(n, len, 1.0, X, stride_X, 0.0, Y, stride_Y);
+
+    return Y;
+}
+
+/*
+ * Copy the packed matrix Y (as from pack_matrix) back into tensor t
+ */
+static void unpack_matrix(const int t, const double* restrict Y, const double beta, double* restrict X,
+                          const int np, const contract_index* P, const int nq, const contract_index* Q,
+                          const int nl, const contract_index* L)
+{
+    int i, n;
+    int len[np+nq+nl];
+    size_t stride_X[np+nq+nl];
+    size_t stride_Y[np+nq+nl];
+    size_t size;
+
+    n = 0;
+    for (i = 0;i < np;i++, n++)
+    {
+        len[n] = P[i].len;
+        stride_X[n] = P[i].stride[t];
+    }
+    for (i = 0;i < nq;i++, n++)
+    {
+        len[n] = Q[i].len;
+        stride_X[n] = Q[i].stride[t];
+    }
+    for (i = 0;i < nl;i++, n++)
+    {
+        len[n] = L[i].len;
+        stride_X[n] = L[i].stride[t];
+    }
+
+    size = 1;
+    for (i = 0;i < n;i++)
+    {
+        stride_Y[i] = size;
+        size *= len[i];
+    }
+
+    permute_strided(n, len, 1.0, Y, stride_Y, beta, X, stride_X);
+}
+
+static size_t group_size(const int n, const contract_index* group)
+{
+    int i;
+    size_t size = 1;
+    for (i = 0;i < n;i++) size *= group[i].len;
+    return size;
+}
+
+int tensor_is_contraction(const int ndim_A, const int* idx_A,
+                          const int ndim_B, const int* idx_B,
+                          const int ndim_C, const int* idx_C)
+{
+    int i, j, n_A, n_B, n_C;
+    const int ndim[3] = {ndim_A, ndim_B, ndim_C};
+    const int* idx[3] = {idx_A, idx_B, idx_C};
+    int t;
+
+    for (t = 0;t < 3;t++)
+    {
+        for (i = 0;i < ndim[t];i++)
+        {
+            n_A = n_B = n_C = 0;
+            for (j = 0;j < ndim_A;j++) if (idx_A[j] == idx[t][i]) n_A++;
+            for (j = 0;j < ndim_B;j++) if (idx_B[j] == idx[t][i]) n_B++;
+            for (j = 0;j < ndim_C;j++) if (idx_C[j] == idx[t][i]) n_C++;
+
+            if (n_A > 1 || n_B > 1 || n_C > 1) return false;
+            if (n_A+n_B+n_C < 2) return false;
+        }
+    }
+
+    return true;
+}
+
+int tensor_contract_dense_(const double alpha, const double* restrict A, const int ndim_A, const int* restrict len_A, const int* restrict lda, const int* restrict idx_A,
+                                               const double* restrict B, const int ndim_B, const int* restrict len_B, const int* restrict ldb, const int* restrict idx_B,
+                           const double beta,        double* restrict C, const int ndim_C, const int* restrict len_C, const int* restrict ldc, const int* restrict idx_C)
+{
+    int i, j, k, c, best;
+    int nM, nN, nK, nL;
+    bool done;
+    size_t cost, best_cost, size;
+    size_t stride_A[ndim_A];
+    size_t stride_B[ndim_B];
+    size_t stride_C[ndim_C];
+    contract_index M[ndim_A+ndim_C];
+    contract_index N[ndim_B+ndim_C];
+    contract_index K[ndim_A+ndim_B];
+    contract_index L[ndim_A+ndim_B+ndim_C];
+    size_t stride_L[3][ndim_A+ndim_B+ndim_C];
+    int pos_L[ndim_A+ndim_B+ndim_C];
+    size_t off_A, off_B, off_C;
+    size_t len_M, len_N, len_K;
+    char trans_A, trans_B, trans_C;
+    integer ld_A, ld_B, ld_C;
+    bool view_A, view_B, view_C;
+    double *pack_A, *pack_B, *pack_C;
+    const double *mat_A, *mat_B;
+    double *mat_C;
+
+#ifdef VALIDATE_INPUTS
+    VALIDATE_TENSOR(ndim_A, len_A, lda, NULL);
+    VALIDATE_TENSOR(ndim_B, len_B, ldb, NULL);
+    VALIDATE_TENSOR(ndim_C, len_C, ldc, NULL);
+#endif //VALIDATE_INPUTS
+
+    if (!tensor_is_contraction(ndim_A, idx_A, ndim_B, idx_B, ndim_C, idx_C)) return TENSOR_INDEX_MISMATCH;
+
+    /*
+     * If any index is empty there is nothing to multiply (and no valid leading dimension
+     * for gemm): either C is empty, or only summed indices are and C is just scaled by beta
+     */
+    for (k = 0;k < ndim_C;k++)
+    {
+        if (len_C[k] == 0) return TENSOR_SUCCESS;
+    }
+
+    for (i = 0;i < ndim_A && len_A[i] != 0;i++);
+    for (j = 0;j < ndim_B && len_B[j] != 0;j++);
+
+    if (i < ndim_A || j < ndim_B)
+    {
+        if (beta == 1.0) return TENSOR_SUCCESS;
+        return tensor_scale_dense_(beta, C, ndim_C, len_C, ldc, idx_C);
+    }
+
+    if (lda == NULL)
+    {
+        if (ndim_A > 0) stride_A[0] = 1;
+        for (i = 1;i < ndim_A;i++) stride_A[i] = stride_A[i-1]*len_A[i-1];
+    }
+    else
+    {
+        if (ndim_A > 0) stride_A[0] = lda[0];
+        for (i = 1;i < ndim_A;i++) stride_A[i] = stride_A[i-1]*lda[i];
+    }
+
+    if (ldb == NULL)
+    {
+        if (ndim_B > 0) stride_B[0] = 1;
+        for (i = 1;i < ndim_B;i++) stride_B[i] = stride_B[i-1]*len_B[i-1];
+    }
+    else
+    {
+        if (ndim_B > 0) stride_B[0] = ldb[0];
+        for (i = 1;i < ndim_B;i++) stride_B[i] = stride_B[i-1]*ldb[i];
+    }
+
+    if (ldc == NULL)
+    {
+        if (ndim_C > 0) stride_C[0] = 1;
+        for (i = 1;i < ndim_C;i++) stride_C[i] = stride_C[i-1]*len_C[i-1];
+    }
+    else
+    {
+        if (ndim_C > 0) stride_C[0] = ldc[0];
+        for (i = 1;i < ndim_C;i++) stride_C[i] = stride_C[i-1]*ldc[i];
+    }
+
+    /*
+     * sort the indices into four groups: A and C (M), B and C (N), A and B (K), and A, B, and C (L).
+     * Indices of length one do not affect the addressing and are dropped.
+     */
+    nM = nN = nK = nL = 0;
+
+    for (i = 0;i < ndim_A;i++)
+    {
+        contract_index cur;
+
+        cur.len = len_A[i];
+        cur.stride[0] = stride_A[i];
+        cur.stride[1] = 0;
+        cur.stride[2] = 0;
+
+        for (j = 0;j < ndim_B && idx_B[j] != idx_A[i];j++);
+        for (k = 0;k < ndim_C && idx_C[k] != idx_A[i];k++);
+
+#ifdef VALIDATE_INPUTS
+        if (j < ndim_B && len_B[j] != len_A[i]) return TENSOR_LENGTH_MISMATCH;
+        if (k < ndim_C && len_C[k] != len_A[i]) return TENSOR_LENGTH_MISMATCH;
+#endif //VALIDATE_INPUTS
+
+        if (len_A[i] == 1) continue;
+
+        if (j < ndim_B) cur.stride[1] = stride_B[j];
+        if (k < ndim_C) cur.stride[2] = stride_C[k];
+
+        if (j < ndim_B && k < ndim_C)
+        {
+            L[nL++] = cur;
+        }
+        else if (j < ndim_B)
+        {
+            K[nK++] = cur;
+        }
+        else
+        {
+            M[nM++] = cur;
+        }
+    }
+
+    for (j = 0;j < ndim_B;j++)
+    {
+        contract_index cur;
+
+        for (i = 0;i < ndim_A && idx_A[i] != idx_B[j];i++);
+        if (i < ndim_A) continue;
+
+        for (k = 0;k < ndim_C && idx_C[k] != idx_B[j];k++);
+
+#ifdef VALIDATE_INPUTS
+        if (len_C[k] != len_B[j]) return TENSOR_LENGTH_MISMATCH;
+#endif //VALIDATE_INPUTS
+
+        if (len_B[j] == 1) continue;
+
+        cur.len = len_B[j];
+        cur.stride[0] = 0;
+        cur.stride[1] = stride_B[j];
+        cur.stride[2] = stride_C[k];
+
+        N[nN++] = cur;
+    }
+
+    /*
+     * Try each of the orders of the indices in M (as in A or C), N (as in B or C), and K (as in A or B),
+     * and pick the one for which the least data has to be transposed
+     */
+    best = 0;
+    best_cost = 0;
+    for (c = 0;c < 8;c++)
+    {
+        sort_by_stride((c&1) ? 2 : 0, nM, M);
+        sort_by_stride((c&2) ? 2 : 1, nN, N);
+        sort_by_stride((c&4) ? 1 : 0, nK, K);
+
+        cost = 0;
+        if (!matrix_view(0, nM, M, nK, K, &trans_A, &ld_A)) cost += group_size(nM, M)*group_size(nK, K)*group_size(nL, L);
+        if (!matrix_view(1, nK, K, nN, N, &trans_B, &ld_B)) cost += group_size(nK, K)*group_size(nN, N)*group_size(nL, L);
+        if (!matrix_view(2, nM, M, nN, N, &trans_C, &ld_C)) cost += group_size(nM, M)*group_size(nN, N)*group_size(nL, L);
+
+        if (c == 0 || cost < best_cost)
+        {
+            best = c;
+            best_cost = cost;
+        }
+    }
+
+    sort_by_stride((best&1) ? 2 : 0, nM, M);
+    sort_by_stride((best&2) ? 2 : 1, nN, N);
+    sort_by_stride((best&4) ? 1 : 0, nK, K);
+    sort_by_stride(2, nL, L);
+
+    len_M = group_size(nM, M);
+    len_N = group_size(nN, N);
+    len_K = group_size(nK, K);
+
+    for (i = 0;i < nL;i++)
+    {
+        stride_L[0][i] = L[i].stride[0];
+        stride_L[1][i] = L[i].stride[1];
+        stride_L[2][i] = L[i].stride[2];
+    }
+
+    /*
+     * Transpose any operands which cannot be used as they are
+     */
+    view_A = matrix_view(0, nM, M, nK, K, &trans_A, &ld_A);
+    view_B = matrix_view(1, nK, K, nN, N, &trans_B, &ld_B);
+    view_C = matrix_view(2, nM, M, nN, N, &trans_C, &ld_C);
+
+    pack_A = pack_B = pack_C = NULL;
+
+    if (view_A)
+    {
+        mat_A = A;
+    }
+    else
+    {
+        mat_A = pack_A = pack_matrix(0, A, nM, M, nK, K, nL, L, stride_L[0]);
+        trans_A = 'N';
+        ld_A = len_M;
+    }
+
+    if (view_B)
+    {
+        mat_B = B;
+    }
+    else
+    {
+        mat_B = pack_B = pack_matrix(1, B, nK, K, nN, N, nL, L, stride_L[1]);
+        trans_B = 'N';
+        ld_B = len_K;
+    }
+
+    if (view_C)
+    {
+        mat_C = C;
+    }
+    else
+    {
+        /*
+         * C is computed from scratch and then summed onto the original
+         */
+        mat_C = pack_C = MALLOC(double, len_M*len_N*group_size(nL, L));
+        trans_C = 'N';
+        ld_C = len_M;
+
+        size = len_M*len_N;
+        for (i = 0;i < nL;i++)
+        {
+            stride_L[2][i] = size;
+            size *= L[i].len;
+        }
+    }
+
+    if ((!view_A && pack_A == NULL) || (!view_B && pack_B == NULL) || (!view_C && pack_C == NULL))
+    {
+        FREE(pack_A);
+        FREE(pack_B);
+        FREE(pack_C);
+        return TENSOR_OUT_OF_MEMORY;
+    }
+
+    off_A = 0;
+    off_B = 0;
+    off_C = 0;
+    memset(pos_L, 0, nL*sizeof(int));
+
+    /*
+     * loop over the batch indices
+     */
+    for (done = false;!done;)
+    {
+        if (trans_C == 'N')
+        {
+            c_dgemm(trans_A, trans_B, len_M, len_N, len_K,
+                    alpha, mat_A+off_A, ld_A,
+                           mat_B+off_B, ld_B,
+                    (view_C ? beta : 0.0), mat_C+off_C, ld_C);
+        }
+        else
+        {
+            /*
+             * C^T = B^T A^T
+             */
+            c_dgemm((trans_B == 'N' ? 'T' : 'N'), (trans_A == 'N' ? 'T' : 'N'), len_N, len_M, len_K,
+                    alpha, mat_B+off_B, ld_B,
+                           mat_A+off_A, ld_A,
+                    beta, mat_C+off_C, ld_C);
+        }
+
+        done = true;
+        for (i = 0;i < nL;i++)
+        {
+            if (pos_L[i] == L[i].len-1)
+            {
+                pos_L[i] = 0;
+                off_A -= stride_L[0][i]*(L[i].len-1);
+                off_B -= stride_L[1][i]*(L[i].len-1);
+                off_C -= stride_L[2][i]*(L[i].len-1);
+            }
+            else
+            {
+                pos_L[i]++;
+                off_A += stride_L[0][i];
+                off_B += stride_L[1][i];
+                off_C += stride_L[2][i];
+                done = false;
+                break;
+            }
+        }
+    }
+    /*
+     * end loop over batch indices
+     */
+
+    if (!view_C) unpack_matrix(2, pack_C, beta, C, nM, M, nN, N, nL, L);
+
+    FREE(pack_A);
+    FREE(pack_B);
+    FREE(pack_C);
+
+    return TENSOR_SUCCESS;
+}
@@ -0,0 +1,115 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+/**
+ * Transpose a tensor and sum onto a second.
+ *
+ * The general form for a transposition operation is \f$ab\ldots \rightarrow P(ab\ldots)\f$
+ * where P is some permutation. The work is done by permute_strided (util/math_ext.h).
+ *
+ * \author Devin Matthews
+ * \date Sep. 28 2011
+ */
+
+#include "tensor.h"
+#include "util.h"
+#include "util/math_ext.h"
+
+int tensor_is_permutation(const int ndim_A, const int* idx_A,
+                          const int ndim_B, const int* idx_B)
+{
+    int i, j, n_A, n_B;
+
+    if (ndim_A != ndim_B) return false;
+
+    for (i = 0;i < ndim_A;i++)
+    {
+        n_A = n_B = 0;
+        for (j = 0;j < ndim_A;j++) if (idx_A[j] == idx_A[i]) n_A++;
+        for (j = 0;j < ndim_B;j++) if (idx_B[j] == idx_A[i]) n_B++;
+
+        if (n_A != 1 || n_B != 1) return false;
+    }
+
+    return true;
+}
+
+int tensor_transpose_dense_(const double alpha, const double* restrict A, const int ndim_A, const int* restrict len_A, const int* restrict lda, const int* restrict idx_A,
+                            const double beta,        double* restrict B, const int ndim_B, const int* restrict len_B, const int* restrict ldb, const int* restrict idx_B)
+{
+    int i, j;
+    size_t stride_A[ndim_A];
+    size_t stride_B[ndim_B];
+    size_t stride_A_B[ndim_B];
+
+#ifdef VALIDATE_INPUTS
+    if (ndim_A != ndim_B) return TENSOR_INDEX_MISMATCH;
+    VALIDATE_TENSOR(ndim_A, len_A, lda, NULL);
+    VALIDATE_TENSOR(ndim_B, len_B, ldb, NULL);
+#endif //VALIDATE_INPUTS
+
+    if (lda == NULL)
+    {
+        if (ndim_A > 0) stride_A[0] = 1;
+        for (i = 1;i < ndim_A;i++) stride_A[i] = stride_A[i-1]*len_A[i-1];
+    }
+    else
+    {
+        if (ndim_A > 0) stride_A[0] = lda[0];
+        for (i = 1;i < ndim_A;i++) stride_A[i] = stride_A[i-1]*lda[i];
+    }
+
+    if (ldb == NULL)
+    {
+        if (ndim_B > 0) stride_B[0] = 1;
+        for (i = 1;i < ndim_B;i++) stride_B[i] = stride_B[i-1]*len_B[i-1];
+    }
+    else
+    {
+        if (ndim_B > 0) stride_B[0] = ldb[0];
+        for (i = 1;i < ndim_B;i++) stride_B[i] = stride_B[i-1]*ldb[i];
+    }
+
+    /*
+     * stride_A_B[i] is the stride in A of index i of B
+     */
+    for (i = 0;i < ndim_B;i++)
+    {
+        for (j = 0;j < ndim_A;j++)
+        {
+            if (idx_A[j] == idx_B[i]) break;
+        }
+
+#ifdef VALIDATE_INPUTS
+        if (j == ndim_A) return TENSOR_INDEX_MISMATCH;
+        if (len_A[j] != len_B[i]) return TENSOR_LENGTH_MISMATCH;
+#endif //VALIDATE_INPUTS
+
+        stride_A_B[i] = stride_A[j];
+    }
+
+    permute_strided(ndim_B, len_B, alpha, A, stride_A_B, beta, B, stride_B);
+
+    return TENSOR_SUCCESS;
+}
@@ -26,6 +26,11 @@
 #include <cstdio>
 #include <cassert>
 #include <algorithm>
+#include <cfloat>
+#include <fstream>
+#include <map>
+#include <set>
+#include <stdexcept>
 
 #ifdef __MACH__
 #include <mach/mach_time.h>
@@ -57,7 +62,23 @@ namespace aquarius
 namespace time
 {
 
-static std::vector<Interval> *tics[128];
+/*
+ * Timer stacks of the first MAX_TIC_THREADS OpenMP threads. A tic outside of a
+ * parallel region also starts an empty interval on the stack of every other thread,
+ * so that the flops those threads count are included in the matching toc. Threads
+ * with higher numbers keep a stack of their own, whose flops are not passed up.
+ */
+#define MAX_TIC_THREADS 128
+
+static std::vector<Interval> *tics[MAX_TIC_THREADS];
+static __thread std::vector<Interval> *private_tics = NULL;
+
+static std::vector<Interval>& tic_stack(int td)
+{
+    std::vector<Interval>*& stack = (td < MAX_TIC_THREADS ? tics[td] : private_tics);
+    if (stack == NULL) stack = new std::vector<Interval>();
+    return *stack;
+}
 
 Interval Interval::time()
 {
@@ -180,47 +201,358 @@ double Interval::gflops(const Arena& arena) const
     return (double)fl/1e9/seconds(arena);
 }
 
-std::vector<Timer> Timer::timers;
+/*
+ * Per-thread stacks of running sections, with the flops and bytes recorded with
+ * profile_flops/profile_bytes while they run. The stack is found through a
+ * thread-local pointer, so any number of threads may profile
+ */
+struct Frame
+{
+    Section* section;
+    int64_t flops;
+    int64_t bytes;
+
+    Frame(Section* section) : section(section), flops(0), bytes(0) {}
+};
+
+static __thread std::vector<Frame>* frames = NULL;
+
+/*
+ * Current section of the master thread outside of parallel regions
+ */
+static Section* master_section = NULL;
+
+static bool in_parallel()
+{
+    #ifdef _OPENMP
+    return omp_in_parallel();
+    #else
+    return false;
+    #endif
+}
+
+Section::~Section()
+{
+    for (vector<Section*>::iterator it = children.begin();it != children.end();++it) delete *it;
+}
+
+Section& Section::root()
+{
+    static Section root("");
+    return root;
+}
+
+Section& Section::current()
+{
+
+    if (frames != NULL && !frames->empty()) return *frames->back().section;
+    if (master_section != NULL) return *master_section;
+    return root();
+}
 
-Timer& Timer::timer(const std::string& name)
+Section& Section::child(const string& name)
 {
-    for (vector<Timer>::iterator it = timers.begin();it != timers.end();++it)
+    for (vector<Section*>::iterator it = children.begin();it != children.end();++it)
     {
-        if (it->name == name) return *it;
+        if ((*it)->name == name) return **it;
     }
 
-    timers.push_back(Timer(name));
-    return timers.back();
+    children.push_back(new Section(name));
+    return *children.back();
 }
 
-void Timer::printTimers(const Arena& arena)
+void Section::clear()
+{
+    dt = 0;
+    flops = 0;
+    bytes = 0;
+    count = 0;
+    for (vector<Section*>::iterator it = children.begin();it != children.end();++it) (*it)->clear();
+}
+
+ProfileScope::ProfileScope(const string& name)
 {
-    int max_len = 0;
-    for (vector<Timer>::iterator it = timers.begin();it != timers.end();++it)
+    Section& parent = Section::current();
+
+    #pragma omp critical(aquarius_profile)
+    section = &parent.child(name);
+
+    if (frames == NULL) frames = new vector<Frame>();
+    frames->push_back(Frame(section));
+    if (!in_parallel()) master_section = section;
+
+    running = true;
+    tic();
+}
+
+void ProfileScope::stop()
+{
+    if (!running) return;
+    running = false;
+
+    Interval dt = toc();
+
+    Frame frame = frames->back();
+    frames->pop_back();
+    assert(frame.section == section);
+
+    if (!frames->empty())
     {
-        max_len = max(max_len, (int)it->name.size());
+        frames->back().flops += frame.flops;
+        frames->back().bytes += frame.bytes;
     }
 
-    sort(timers.begin(), timers.end());
+    if (!in_parallel())
+        master_section = (frames->empty() ? NULL : frames->back().section);
 
-    for (vector<Timer>::iterator it = timers.begin();it != timers.end();++it)
+    #pragma omp critical(aquarius_profile)
     {
-        double tot = it->seconds(arena);
-        int64_t count = it->count;
-        arena.Allreduce(&count, 1, MPI::SUM);
-        double gflops = it->gflops(arena);
-        Logger::log(arena) << strprintf("%s:%*s %13.6f s %10ld x %11.6f gflops/sec\n", it->name.c_str(), (int)(max_len-it->name.size()), "", tot, count, gflops) << endl;
+        section->dt += dt.seconds();
+        section->flops += dt.flops+frame.flops;
+        section->bytes += frame.bytes;
+        section->count++;
     }
 }
 
-void Timer::clearTimers(const Arena& arena)
+void profile_flops(int64_t flops)
+{
+    if (frames != NULL && !frames->empty()) frames->back().flops += flops;
+}
+
+void profile_bytes(int64_t bytes)
+{
+    if (frames != NULL && !frames->empty()) frames->back().bytes += bytes;
+}
+
+/*
+ * Statistics of one section over the ranks of an arena which have it
+ */
+struct SectionReport
+{
+    string name;
+    int nrank;
+    int64_t count;
+    double min[3], avg[3], max[3];
+    vector<int> children;
+};
+
+/*
+ * Path components are separated by \001, so that sorted paths have each section
+ * right after its parent
+ */
+static void collect(const Section& section, const string& path,
+                    vector<string>& paths, vector<const Section*>& sections)
+{
+    const vector<Section*>& children = section.getChildren();
+    for (vector<Section*>::const_iterator it = children.begin();it != children.end();++it)
+    {
+        string child = (path.empty() ? (*it)->getName() : path+'\001'+(*it)->getName());
+        paths.push_back(child);
+        sections.push_back(*it);
+        collect(**it, child, paths, sections);
+    }
+}
+
+static bool slower(const vector<SectionReport>& report, int a, int b)
+{
+    return report[a].max[0] > report[b].max[0];
+}
+
+struct Slower
+{
+    const vector<SectionReport>& report;
+
+    Slower(const vector<SectionReport>& report) : report(report) {}
+
+    bool operator()(int a, int b) const { return slower(report, a, b); }
+};
+
+/*
+ * Gather the statistics of the union of the sections of all ranks as a tree rooted
+ * at element 0, with the children of each section sorted by decreasing maximum time
+ */
+static vector<SectionReport> gatherReport(const Arena& arena)
+{
+    vector<string> local_paths;
+    vector<const Section*> local_sections;
+    #pragma omp critical(aquarius_profile)
+    collect(Section::root(), "", local_paths, local_sections);
+
+    string local;
+    for (int i = 0;i < local_paths.size();i++)
+    {
+        local += local_paths[i];
+        local += '\0';
+    }
+
+    vector<int> lens(arena.nproc);
+    lens[arena.rank] = local.size();
+    arena.Allgather(lens);
+
+    int total = 0;
+    for (int i = 0;i < arena.nproc;i++) total += lens[i];
+
+    vector<char> all(total+1);
+    arena.Allgatherv(local.data(), local.size(), all.data(), lens.data(), MPI::CHAR);
+
+    set<string> unique;
+    for (int pos = 0;pos < total;)
+    {
+        string path(&all[pos]);
+        unique.insert(path);
+        pos += path.size()+1;
+    }
+
+    vector<string> paths(unique.begin(), unique.end());
+    int n = paths.size();
+
+    map<string,const Section*> mine;
+    for (int i = 0;i < local_paths.size();i++) mine[local_paths[i]] = local_sections[i];
+
+    vector<double> mins(3*n, DBL_MAX);
+    vector<double> maxs(3*n, -DBL_MAX);
+    vector<double> sums(5*n, 0.0);
+    for (int i = 0;i < n;i++)
+    {
+        map<string,const Section*>::iterator it = mine.find(paths[i]);
+        if (it == mine.end()) continue;
+
+        const Section& s = *it->second;
+        double vals[3] = {s.getTime(), (double)s.getFlops(), (double)s.getBytes()};
+        for (int j = 0;j < 3;j++)
+        {
+            mins[3*i+j] = vals[j];
+            maxs[3*i+j] = vals[j];
+            sums[5*i+j] = vals[j];
+        }
+        sums[5*i+3] = s.getCount();
+        sums[5*i+4] = 1;
+    }
+
+    arena.Allreduce(mins.data(), mins.size(), MPI::MIN);
+    arena.Allreduce(maxs.data(), maxs.size(), MPI::MAX);
+    arena.Allreduce(sums.data(), sums.size(), MPI::SUM);
+
+    vector<SectionReport> report(n+1);
+    report[0].nrank = arena.nproc;
+    report[0].count = 0;
+    for (int j = 0;j < 3;j++) report[0].min[j] = report[0].avg[j] = report[0].max[j] = 0;
+
+    map<string,int> index;
+    for (int i = 0;i < n;i++)
+    {
+        SectionReport& r = report[i+1];
+
+        size_t sep = paths[i].rfind('\001');
+        int parent = 0;
+        if (sep == string::npos)
+        {
+            r.name = paths[i];
+        }
+        else
+        {
+            r.name = paths[i].substr(sep+1);
+            parent = index[paths[i].substr(0, sep)];
+        }
+
+        r.nrank = (int)sums[5*i+4];
+        r.count = (int64_t)sums[5*i+3];
+        for (int j = 0;j < 3;j++)
+        {
+            r.min[j] = mins[3*i+j];
+            r.avg[j] = sums[5*i+j]/r.nrank;
+            r.max[j] = maxs[3*i+j];
+        }
+
+        index[paths[i]] = i+1;
+        report[parent].children.push_back(i+1);
+    }
+
+    for (int i = 0;i <= n;i++)
+    {
+        sort(report[i].children.begin(), report[i].children.end(), Slower(report));
+    }
+
+    return report;
+}
+
+static void printSection(const Arena& arena, const vector<SectionReport>& report, int i,
+                         int depth, int width)
+{
+    const SectionReport& r = report[i];
+
+    int len = 2*depth+r.name.size();
+    Logger::log(arena) << strprintf("%*s%s:%*s %11.6f %11.6f %11.6f s %10ld x %11.6f %11.6f %11.6f gflop %11.3f %11.3f %11.3f MB\n",
+                                    2*depth, "", r.name.c_str(), max(0, width-len), "",
+                                    r.min[0], r.avg[0], r.max[0], r.count,
+                                    r.min[1]/1e9, r.avg[1]/1e9, r.max[1]/1e9,
+                                    r.min[2]/1e6, r.avg[2]/1e6, r.max[2]/1e6) << endl;
+
+    for (int j = 0;j < r.children.size();j++)
+        printSection(arena, report, r.children[j], depth+1, width);
+}
+
+static int nameWidth(const vector<SectionReport>& report, int i, int depth)
+{
+    int width = (i == 0 ? 0 : 2*depth+report[i].name.size());
+    for (int j = 0;j < report[i].children.size();j++)
+        width = max(width, nameWidth(report, report[i].children[j], i == 0 ? 0 : depth+1));
+    return width;
+}
+
+void Timer::printTimers(const Arena& arena)
 {
-    for (vector<Timer>::iterator it = timers.begin();it != timers.end();++it)
+    vector<SectionReport> report = gatherReport(arena);
+
+    int width = nameWidth(report, 0, 0);
+
+    for (int j = 0;j < report[0].children.size();j++)
+        printSection(arena, report, report[0].children[j], 0, width);
+}
+
+static void writeSection(ostream& os, const vector<SectionReport>& report, int i, int depth)
+{
+    const SectionReport& r = report[i];
+    const char* stats[3] = {"time", "flops", "bytes"};
+    string indent(2*depth, ' ');
+
+    os << indent << "{\"name\": " << jsonstring(r.name)
+       << ", \"ranks\": " << r.nrank << ", \"count\": " << r.count;
+    for (int j = 0;j < 3;j++)
     {
-        it->dt = 0;
-        it->flops = 0;
-        it->count = 0;
+        os << strprintf(", \"%s\": {\"min\": %.9g, \"avg\": %.9g, \"max\": %.9g}",
+                        stats[j], r.min[j], r.avg[j], r.max[j]);
     }
+    os << ", \"children\": [";
+
+    for (int j = 0;j < r.children.size();j++)
+    {
+        os << (j == 0 ? "\n" : ",\n");
+        writeSection(os, report, r.children[j], depth+1);
+    }
+
+    if (!r.children.empty()) os << "\n" << indent;
+    os << "]}";
+}
+
+void Timer::writeTimers(const Arena& arena, const string& filename)
+{
+    vector<SectionReport> report = gatherReport(arena);
+
+    if (arena.rank != 0) return;
+
+    ofstream ofs(filename.c_str());
+    if (!ofs) throw runtime_error("could not open " + filename + " for writing");
+
+    report[0].name = "root";
+    writeSection(ofs, report, 0, 0);
+    ofs << endl;
+}
+
+void Timer::clearTimers(const Arena& arena)
+{
+    #pragma omp critical(aquarius_profile)
+    Section::root().clear();
 }
 
 void tic()
@@ -232,10 +564,10 @@ void tic()
     int tid = 0;
     int ntd = 1;
     #endif
-    for (int td = tid;td < tid+ntd;td++)
+    tic_stack(tid).push_back(Interval::time());
+    for (int td = tid+1;td < min(tid+ntd, MAX_TIC_THREADS);td++)
     {
-        if (tics[td] == NULL) tics[td] = new vector<Interval>();
-        tics[td]->push_back(td == tid ? Interval::time() : Interval());
+        tic_stack(td).push_back(Interval());
     }
 }
 
@@ -249,14 +581,15 @@ Interval toc()
     int ntd = 1;
     #endif
     Interval dt = Interval::time();
-    dt -= tics[tid]->back();
-    tics[tid]->pop_back();
-    for (int td = tid+1;td < tid+ntd;td++)
+    vector<Interval>& stack = tic_stack(tid);
+    dt -= stack.back();
+    stack.pop_back();
+    for (int td = tid+1;td < min(tid+ntd, MAX_TIC_THREADS);td++)
     {
         dt -= tics[td]->back();
         tics[td]->pop_back();
     }
-    if (!tics[tid]->empty()) tics[tid]->back().flops -= dt.flops;
+    if (!stack.empty()) stack.back().flops -= dt.flops;
     return dt;
 }
 
@@ -269,10 +602,10 @@ void cputic()
     int tid = 0;
     int ntd = 1;
     #endif
-    for (int td = tid;td < tid+ntd;td++)
+    tic_stack(tid).push_back(Interval::cputime());
+    for (int td = tid+1;td < min(tid+ntd, MAX_TIC_THREADS);td++)
     {
-        if (tics[td] == NULL) tics[td] = new vector<Interval>();
-        tics[td]->push_back(td == tid ? Interval::cputime() : Interval());
+        tic_stack(td).push_back(Interval());
     }
 }
 
@@ -286,14 +619,15 @@ Interval cputoc()
     int ntd = 1;
     #endif
     Interval dt = Interval::cputime();
-    dt -= tics[tid]->back();
-    tics[tid]->pop_back();
-    for (int td = tid+1;td < tid+ntd;td++)
+    vector<Interval>& stack = tic_stack(tid);
+    dt -= stack.back();
+    stack.pop_back();
+    for (int td = tid+1;td < min(tid+ntd, MAX_TIC_THREADS);td++)
     {
         dt -= tics[td]->back();
         tics[td]->pop_back();
     }
-    if (!tics[tid]->empty()) tics[tid]->back().flops -= dt.flops;
+    if (!stack.empty()) stack.back().flops -= dt.flops;
     return dt;
 }
 
@@ -304,7 +638,8 @@ void do_flops(int64_t flops)
     #else
     int tid = 0;
     #endif
-    tics[tid]->back().flops -= flops;
+    vector<Interval>& stack = tic_stack(tid);
+    if (!stack.empty()) stack.back().flops -= flops;
 }
 
 
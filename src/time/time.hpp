@@ -37,17 +37,16 @@
 
 #define PROFILE_SECTION(name) \
 { \
-static time::Timer __timer = time::Timer::(name); \
-__timer.start();
+time::ProfileScope __timer(#name);
 
-#define PROFILE_FUNCTION PROFILE_SECTION(__func__)
+#define PROFILE_FUNCTION \
+{ \
+time::ProfileScope __timer(__func__);
 
 #define PROFILE_STOP \
-__timer.stop(); \
 }
 
 #define PROFILE_RETURN \
-__timer.stop(); \
 return;
 
 #define PROFILE_FLOPS(n) time::do_flops(n)
@@ -76,6 +75,7 @@ class Timer;
 class Interval
 {
     friend class Timer;
+    friend class ProfileScope;
     friend void do_flops(int64_t flops);
     friend Interval toc();
     friend Interval cputoc();
@@ -130,21 +130,23 @@ Interval cputoc();
 
 void do_flops(int64_t flops);
 
+/*
+ * Record flops or bytes moved in the innermost profiling section of the calling thread
+ * (and so in its ancestors), without counting them in any Timer. This is for work
+ * such as distributed contractions whose flops CTF already counts for the Timers.
+ */
+void profile_flops(int64_t flops);
+
+void profile_bytes(int64_t bytes);
+
 class Timer : public Interval
 {
     protected:
-        static std::vector<Timer> timers;
-
-        std::string name;
         int64_t count;
         CTF_Flop_Counter ctfflops;
 
-        Timer(const std::string& name) : name(name), count(0) {}
-
     public:
-        Timer() : name(), count(0) {}
-
-        static Timer& timer(const std::string& name);
+        Timer() : count(0) {}
 
         void start()
         {
@@ -171,11 +173,90 @@ class Timer : public Interval
             }
         }
 
+        /*
+         * Print the profiling tree (see ProfileScope) with the minimum, average, and
+         * maximum over the ranks of arena of the time, flops, and bytes moved of each
+         * section. Sections which exist on only some ranks (e.g. tasks run
+         * concurrently) are reported over the ranks which have them.
+         */
         static void printTimers(const Arena& arena);
 
+        /*
+         * Write the same report as printTimers to the named file (on rank 0) as JSON
+         */
+        static void writeTimers(const Arena& arena, const std::string& filename);
+
         static void clearTimers(const Arena& arena);
 };
 
+/*
+ * A node of the profiling tree. Each thread has a current section, and a section
+ * started while another is current becomes (or accumulates into) its child of the
+ * same name. Threads in a parallel region which have no section of their own
+ * attach to the current section of the master thread.
+ */
+class Section
+{
+    friend class ProfileScope;
+    friend class Timer;
+
+    protected:
+        std::string name;
+        std::vector<Section*> children;
+        double dt;
+        int64_t flops;
+        int64_t bytes;
+        int64_t count;
+
+        Section(const std::string& name) : name(name), dt(0), flops(0), bytes(0), count(0) {}
+
+        ~Section();
+
+        Section& child(const std::string& name);
+
+        void clear();
+
+    public:
+        static Section& root();
+
+        static Section& current();
+
+        const std::string& getName() const { return name; }
+
+        const std::vector<Section*>& getChildren() const { return children; }
+
+        double getTime() const { return dt; }
+
+        int64_t getFlops() const { return flops; }
+
+        int64_t getBytes() const { return bytes; }
+
+        int64_t getCount() const { return count; }
+};
+
+/*
+ * Time a section of code for as long as the scope lives (or until stop()): a task, an
+ * iteration, a contraction, or anything marked with PROFILE_SECTION
+ */
+class ProfileScope
+{
+    protected:
+        Section* section;
+        bool running;
+
+    private:
+        ProfileScope(const ProfileScope& other);
+
+        ProfileScope& operator=(const ProfileScope& other);
+
+    public:
+        ProfileScope(const std::string& name);
+
+        ~ProfileScope() { stop(); }
+
+        void stop();
+};
+
 }
 }
 
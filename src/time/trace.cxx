@@ -0,0 +1,165 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+
+#include <algorithm>
+#include <vector>
+#include <stdexcept>
+
+#include "util/distributed.hpp"
+#include "util/util.h"
+
+#include "time.hpp"
+#include "trace.hpp"
+
+using namespace std;
+using namespace aquarius;
+
+namespace aquarius
+{
+namespace time
+{
+
+struct Event
+{
+    double ts;
+    char phase;
+    const char* category;
+    string name;
+
+    Event(double ts, char phase, const char* category, const string& name)
+    : ts(ts), phase(phase), category(category), name(name) {}
+};
+
+/*
+ * Each thread records into a buffer of its own, found through a thread-local
+ * pointer. The buffers are also linked into a list so that write() can find them;
+ * they are numbered in the order in which the threads first record an event.
+ */
+struct ThreadEvents
+{
+    int tid;
+    vector<Event> events;
+    ThreadEvents* next;
+};
+
+static __thread ThreadEvents* thread_events = NULL;
+static ThreadEvents* all_thread_events = NULL;
+static int num_thread_events = 0;
+
+#define MAX_IO_BYTES (1<<30)
+
+/*
+ * Time at which recording started on this rank, right after a barrier
+ */
+static double t0 = 0;
+
+bool Trace::enabled = false;
+
+void Trace::start(const Arena& world)
+{
+    world.Barrier();
+    t0 = Interval::time().seconds();
+    enabled = true;
+}
+
+void Trace::begin(const char* category, const string& name)
+{
+    if (thread_events == NULL)
+    {
+        thread_events = new ThreadEvents();
+
+        #pragma omp critical(aquarius_trace)
+        {
+            thread_events->tid = num_thread_events++;
+            thread_events->next = all_thread_events;
+            all_thread_events = thread_events;
+        }
+    }
+
+    thread_events->events.push_back(Event(Interval::time().seconds()-t0, 'B', category, name));
+}
+
+void Trace::end()
+{
+    if (thread_events == NULL) return;
+    thread_events->events.push_back(Event(Interval::time().seconds()-t0, 'E', "", ""));
+}
+
+void Trace::write(const Arena& world, const string& filename)
+{
+    enabled = false;
+
+    string local = strprintf("{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, "
+                             "\"args\": {\"name\": \"rank %d\"}}", world.rank, world.rank);
+
+    for (ThreadEvents* t = all_thread_events;t != NULL;t = t->next)
+    {
+        for (vector<Event>::iterator e = t->events.begin();e != t->events.end();++e)
+        {
+            local += ",\n{";
+            if (e->phase == 'B')
+            {
+                local += "\"name\": " + jsonstring(e->name) + ", \"cat\": " + jsonstring(e->category) + ", ";
+            }
+            local += strprintf("\"ph\": \"%c\", \"ts\": %.3f, \"pid\": %d, \"tid\": %d}",
+                               e->phase, e->ts*1e6, world.rank, t->tid);
+        }
+
+        vector<Event>().swap(t->events);
+    }
+
+    if (world.rank == 0) local = "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n" + local;
+    else local = ",\n" + local;
+    if (world.rank == world.nproc-1) local += "\n]}\n";
+
+    /*
+     * Every rank writes its own part of the file, after those of the lower ranks
+     */
+    int64_t len = local.size();
+    int64_t offset = 0;
+    world.Exscan(&len, &offset, 1, MPI::SUM);
+    if (world.rank == 0) offset = 0;
+
+    int64_t maxlen = len;
+    world.Allreduce(&maxlen, 1, MPI::MAX);
+
+    MPI::File file = MPI::File::Open(world.getCommunicator(), filename.c_str(),
+                                     MPI::MODE_CREATE|MPI::MODE_WRONLY, MPI::INFO_NULL);
+    file.Set_size(0);
+
+    /*
+     * Every rank must take part in the same number of collective writes
+     */
+    for (int64_t done = 0;done < maxlen;done += MAX_IO_BYTES)
+    {
+        int n = max((int64_t)0, min(len-done, (int64_t)MAX_IO_BYTES));
+        file.Write_at_all(offset+done, local.data()+min(done, len), n, MPI::CHAR);
+    }
+
+    file.Close();
+}
+
+}
+}
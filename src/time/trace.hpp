@@ -0,0 +1,102 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+
+#ifndef _AQUARIUS_TIME_TRACE_HPP_
+#define _AQUARIUS_TIME_TRACE_HPP_
+
+#include <string>
+
+namespace aquarius
+{
+
+class Arena;
+
+namespace time
+{
+
+/*
+ * Timeline of begin/end events on every rank and thread, written in the Chrome
+ * trace event format (chrome://tracing, Perfetto, etc.) with one process per rank.
+ * Nothing is recorded until start() is called, and until then a TraceScope costs
+ * only the test of a flag.
+ */
+class Trace
+{
+    public:
+        static bool enabled;
+
+        /*
+         * Start recording, with timestamps relative to a barrier on world (collective)
+         */
+        static void start(const Arena& world);
+
+        /*
+         * Stop recording and write the events of every rank to the named file, each
+         * rank writing its own part with MPI-IO (collective)
+         */
+        static void write(const Arena& world, const std::string& filename);
+
+        static void begin(const char* category, const std::string& name);
+
+        static void end();
+};
+
+/*
+ * Record an event for as long as the scope lives. Callers with names which are
+ * expensive to build should test Trace::enabled first.
+ */
+class TraceScope
+{
+    protected:
+        bool active;
+
+    private:
+        TraceScope(const TraceScope& other);
+
+        TraceScope& operator=(const TraceScope& other);
+
+    public:
+        TraceScope(const char* category, const char* name)
+        : active(Trace::enabled)
+        {
+            if (active) Trace::begin(category, name);
+        }
+
+        TraceScope(const char* category, const std::string& name)
+        : active(Trace::enabled)
+        {
+            if (active) Trace::begin(category, name);
+        }
+
+        ~TraceScope()
+        {
+            if (active) Trace::end();
+        }
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,291 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+#include "checkpoint.hpp"
+
+#include <cstdio>
+
+#include <sys/stat.h>
+
+#include "input/molecule.hpp"
+
+using namespace std;
+using namespace aquarius;
+using namespace aquarius::input;
+using namespace aquarius::integrals;
+
+/*
+ * Distributed records are read and written in pieces of at most this many
+ * bytes per rank, to stay within the int counts of MPI-IO
+ */
+#define MAX_IO_BYTES (1<<30)
+
+static const char CHECKPOINT_MAGIC[8] = {'A','Q','C','H','K','P','T','1'};
+
+static uint64_t systemHash(const Molecule& molecule)
+{
+    ostringstream os;
+
+    os << molecule.getGroup().getName() << ';' << molecule.getNumElectrons() << ',' << molecule.getMultiplicity();
+    for (vector<Atom>::const_iterator a = molecule.getAtomsBegin();a != molecule.getAtomsEnd();++a)
+    {
+        const Center& center = a->getCenter();
+
+        os << ';' << center.getElement().getSymbol();
+        for (int i = 0;i < center.getCenters().size();i++)
+        {
+            const vec3& pos = center.getCenter(i);
+            os << strprintf(",%.15e,%.15e,%.15e", pos[0], pos[1], pos[2]);
+        }
+
+        for (vector<Shell>::const_iterator s = a->getShellsBegin();s != a->getShellsEnd();++s)
+        {
+            os << ':' << s->getL() << ',' << s->getNFunc() << ',' << s->getNPrim() << ',' << s->getNContr();
+            for (int i = 0;i < s->getExponents().size();i++)
+                os << strprintf(",%.15e", s->getExponents()[i]);
+            for (int i = 0;i < s->getCoefficients().size();i++)
+                os << strprintf(",%.15e", s->getCoefficients()[i]);
+        }
+    }
+
+    return fnv1a(os.str());
+}
+
+Checkpoint::Checkpoint(const Arena& arena, const string& path)
+: Distributed(arena), path(path), pos(0), isopen(false) {}
+
+Checkpoint::~Checkpoint()
+{
+    if (isopen) file.Close();
+}
+
+void Checkpoint::beginWrite()
+{
+    assert(!isopen);
+
+    string tmp = path + ".tmp";
+
+    /*
+     * MODE_CREATE does not truncate, so remove any partial file left by an earlier job.
+     * The directory is created if needed (but not its parents).
+     */
+    if (rank == 0)
+    {
+        size_t slash = path.find_last_of('/');
+        if (slash != string::npos && slash > 0) mkdir(path.substr(0, slash).c_str(), 0777);
+        remove(tmp.c_str());
+    }
+    arena.Barrier();
+
+    file = MPI::File::Open(arena.getCommunicator(), tmp.c_str(), MPI::MODE_CREATE|MPI::MODE_WRONLY, MPI::INFO_NULL);
+    isopen = true;
+    pos = 0;
+
+    if (rank == 0) file.Write_at(pos, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC), MPI::BYTE);
+    pos += sizeof(CHECKPOINT_MAGIC);
+}
+
+void Checkpoint::commit()
+{
+    assert(isopen);
+
+    file.Sync();
+    file.Close();
+    isopen = false;
+
+    int ok = 1;
+    if (rank == 0) ok = (rename((path + ".tmp").c_str(), path.c_str()) == 0);
+    arena.Bcast(&ok, 1, 0);
+
+    if (!ok) throw runtime_error("Could not write checkpoint " + path);
+}
+
+bool Checkpoint::beginRead()
+{
+    assert(!isopen);
+
+    int found = 0;
+    if (rank == 0)
+    {
+        FILE* fp = fopen(path.c_str(), "rb");
+        if (fp != NULL)
+        {
+            char magic[sizeof(CHECKPOINT_MAGIC)];
+            found = (fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+                     equal(magic, magic+sizeof(magic), CHECKPOINT_MAGIC)) ? 1 : -1;
+            fclose(fp);
+        }
+    }
+    arena.Bcast(&found, 1, 0);
+
+    /*
+     * Every rank has to see the error, otherwise the others wait forever in the
+     * collective open below
+     */
+    if (found < 0) throw runtime_error(path + " is not a valid checkpoint file");
+    if (!found) return false;
+
+    file = MPI::File::Open(arena.getCommunicator(), path.c_str(), MPI::MODE_RDONLY, MPI::INFO_NULL);
+    isopen = true;
+    pos = sizeof(CHECKPOINT_MAGIC);
+
+    return true;
+}
+
+void Checkpoint::endRead()
+{
+    assert(isopen);
+
+    file.Close();
+    isopen = false;
+}
+
+void Checkpoint::writeSystem(const Molecule& molecule)
+{
+    write("system", systemHash(molecule));
+}
+
+void Checkpoint::checkSystem(const Molecule& molecule)
+{
+    uint64_t hash;
+    read("system", hash);
+
+    if (hash != systemHash(molecule))
+        throw runtime_error("Checkpoint " + path + " was written for a different molecule or basis set");
+}
+
+void Checkpoint::writeRecord(const string& key, const void* data, int64_t nbytes)
+{
+    assert(isopen);
+
+    if (rank == 0)
+    {
+        int32_t keylen = key.size();
+        file.Write_at(pos, &keylen, sizeof(keylen), MPI::BYTE);
+        file.Write_at(pos+sizeof(keylen), key.data(), keylen, MPI::BYTE);
+        file.Write_at(pos+sizeof(keylen)+keylen, &nbytes, sizeof(nbytes), MPI::BYTE);
+    }
+    pos += sizeof(int32_t)+key.size()+sizeof(int64_t);
+
+    if (rank == 0)
+    {
+        for (int64_t done = 0;done < nbytes;done += MAX_IO_BYTES)
+        {
+            int n = min(nbytes-done, (int64_t)MAX_IO_BYTES);
+            file.Write_at(pos+done, (const char*)data+done, n, MPI::BYTE);
+        }
+    }
+    pos += nbytes;
+}
+
+int64_t Checkpoint::readHeader(const string& key)
+{
+    assert(isopen);
+
+    int32_t keylen;
+    file.Read_at_all(pos, &keylen, sizeof(keylen), MPI::BYTE);
+
+    string stored(keylen, ' ');
+    file.Read_at_all(pos+sizeof(keylen), &stored[0], keylen, MPI::BYTE);
+
+    int64_t nbytes;
+    file.Read_at_all(pos+sizeof(keylen)+keylen, &nbytes, sizeof(nbytes), MPI::BYTE);
+
+    if (stored != key)
+        throw runtime_error("Expected record " + key + " in checkpoint " + path + ", found " + stored);
+
+    pos += sizeof(keylen)+keylen+sizeof(nbytes);
+
+    return nbytes;
+}
+
+void Checkpoint::readRecord(const string& key, vector<char>& data)
+{
+    int64_t nbytes = readHeader(key);
+
+    data.resize(nbytes);
+    for (int64_t done = 0;done < nbytes;done += MAX_IO_BYTES)
+    {
+        int n = min(nbytes-done, (int64_t)MAX_IO_BYTES);
+        file.Read_at_all(pos+done, &data[done], n, MPI::BYTE);
+    }
+    pos += nbytes;
+}
+
+void Checkpoint::writeDistributed(const string& key, const void* data, int64_t nlocal, int elemsize)
+{
+    vector<int64_t> counts(nproc);
+    counts[rank] = nlocal;
+    arena.Allgather(counts);
+
+    int64_t offset = 0, total = 0;
+    for (int i = 0;i < nproc;i++)
+    {
+        if (i < rank) offset += counts[i];
+        total += counts[i];
+    }
+
+    writeRecord(key, NULL, 0);
+    write(key, total);
+
+    /*
+     * Every rank must take part in the same number of collective writes
+     */
+    int64_t maxlocal = nlocal*elemsize;
+    arena.Allreduce(&maxlocal, 1, MPI::MAX);
+
+    for (int64_t done = 0;done < maxlocal;done += MAX_IO_BYTES)
+    {
+        int n = max((int64_t)0, min(nlocal*elemsize-done, (int64_t)MAX_IO_BYTES));
+        file.Write_at_all(pos+offset*elemsize+done, (const char*)data+min(done, nlocal*elemsize),
+                          n, MPI::BYTE);
+    }
+
+    pos += total*elemsize;
+}
+
+void Checkpoint::readDistributed(const string& key, vector<char>& data, int elemsize)
+{
+    readHeader(key);
+
+    int64_t total;
+    read(key, total);
+
+    int64_t begin = (total*rank)/nproc;
+    int64_t end = (total*(rank+1))/nproc;
+    int64_t nlocal = (end-begin)*elemsize;
+
+    data.resize(nlocal);
+
+    int64_t maxlocal = nlocal;
+    arena.Allreduce(&maxlocal, 1, MPI::MAX);
+
+    for (int64_t done = 0;done < maxlocal;done += MAX_IO_BYTES)
+    {
+        int n = max((int64_t)0, min(nlocal-done, (int64_t)MAX_IO_BYTES));
+        file.Read_at_all(pos+begin*elemsize+done, data.data()+min(done, nlocal), n, MPI::BYTE);
+    }
+
+    pos += total*elemsize;
+}
@@ -0,0 +1,234 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+#ifndef _AQUARIUS_UTIL_CHECKPOINT_HPP_
+#define _AQUARIUS_UTIL_CHECKPOINT_HPP_
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <climits>
+#include <stdint.h>
+
+#include "mpi.h"
+
+#include "tensor/ctf_tensor.hpp"
+#include "tensor/composite_tensor.hpp"
+
+#include "distributed.hpp"
+#include "stl_ext.hpp"
+
+namespace aquarius
+{
+
+namespace input
+{
+class Molecule;
+}
+
+/*
+ * A single-file, restartable snapshot of the state of a calculation.
+ *
+ * A checkpoint is a sequence of records, each a key, the payload size, and
+ * the payload. Replicated data (scalars and vectors) is written by rank 0
+ * only. Distributed tensors are written with collective MPI-IO as the
+ * (key,value) pairs stored on each rank, concatenated in rank order, so a
+ * checkpoint can be read back on any number of ranks. Records must be read
+ * in the order in which they were written; the keys are only used to catch
+ * mismatches.
+ *
+ * A new checkpoint is written to <path>.tmp and renamed over <path> only
+ * once it is complete, so a job killed while writing keeps its previous
+ * checkpoint.
+ */
+class Checkpoint : public Distributed
+{
+    protected:
+        std::string path;
+        MPI::File file;
+        MPI::Offset pos;
+        bool isopen;
+
+        void writeRecord(const std::string& key, const void* data, int64_t nbytes);
+
+        void readRecord(const std::string& key, std::vector<char>& data);
+
+        int64_t readHeader(const std::string& key);
+
+        /*
+         * Write nlocal bytes per rank at consecutive offsets starting from pos (collective)
+         */
+        void writeDistributed(const std::string& key, const void* data, int64_t nlocal, int elemsize);
+
+        /*
+         * Read an equal share of a distributed record on each rank (collective)
+         */
+        void readDistributed(const std::string& key, std::vector<char>& data, int elemsize);
+
+    public:
+        Checkpoint(const Arena& arena, const std::string& path);
+
+        ~Checkpoint();
+
+        const std::string& getPath() const { return path; }
+
+        /*
+         * Start a new checkpoint (collective)
+         */
+        void beginWrite();
+
+        /*
+         * Close the new checkpoint and replace the previous one (collective)
+         */
+        void commit();
+
+        /*
+         * Open an existing checkpoint; returns false if there is none (collective)
+         */
+        bool beginRead();
+
+        void endRead();
+
+        /*
+         * Write a hash of the geometry, charge, multiplicity, symmetry, and basis
+         * set of molecule, or check that the checkpoint was written for the same
+         * system (the latter is collective)
+         */
+        void writeSystem(const input::Molecule& molecule);
+
+        void checkSystem(const input::Molecule& molecule);
+
+        template <typename T>
+        void write(const std::string& key, const T& val)
+        {
+            writeRecord(key, &val, sizeof(T));
+        }
+
+        template <typename T>
+        void write(const std::string& key, const std::vector<T>& val)
+        {
+            writeRecord(key, val.data(), val.size()*sizeof(T));
+        }
+
+        template <typename T>
+        void write(const std::string& key, const std::vector<std::vector<T> >& val)
+        {
+            write(key, (int64_t)val.size());
+            for (int i = 0;i < val.size();i++) write(key, val[i]);
+        }
+
+        template <typename T>
+        void read(const std::string& key, T& val)
+        {
+            std::vector<char> data;
+            readRecord(key, data);
+            if (data.size() != sizeof(T))
+                throw std::runtime_error("Checkpoint record " + key + " has the wrong size");
+            std::copy(data.begin(), data.end(), (char*)&val);
+        }
+
+        template <typename T>
+        void read(const std::string& key, std::vector<T>& val)
+        {
+            std::vector<char> data;
+            readRecord(key, data);
+            if (data.size()%sizeof(T) != 0)
+                throw std::runtime_error("Checkpoint record " + key + " has the wrong size");
+            val.resize(data.size()/sizeof(T));
+            std::copy(data.begin(), data.end(), (char*)val.data());
+        }
+
+        template <typename T>
+        void read(const std::string& key, std::vector<std::vector<T> >& val)
+        {
+            int64_t n;
+            read(key, n);
+            val.resize(n);
+            for (int i = 0;i < n;i++) read(key, val[i]);
+        }
+
+        template <typename T>
+        void writeTensor(const std::string& key, const tensor::CTFTensor<T>& t)
+        {
+            std::vector<int> shape(t.getLengths());
+            shape += t.getSymmetry();
+            write(key, shape);
+
+            std::vector<tkv_pair<T> > pairs;
+            t.getLocalData(pairs);
+            writeDistributed(key, pairs.data(), pairs.size(), sizeof(tkv_pair<T>));
+        }
+
+        template <typename T>
+        void readTensor(const std::string& key, tensor::CTFTensor<T>& t)
+        {
+            std::vector<int> shape;
+            read(key, shape);
+            if (shape != t.getLengths()+t.getSymmetry())
+                throw std::runtime_error("Checkpointed tensor " + key + " has a different shape");
+
+            std::vector<char> data;
+            readDistributed(key, data, sizeof(tkv_pair<T>));
+            const tkv_pair<T>* begin = (const tkv_pair<T>*)data.data();
+            std::vector<tkv_pair<T> > pairs(begin, begin+data.size()/sizeof(tkv_pair<T>));
+            t.writeRemoteData(pairs);
+        }
+
+        /*
+         * Symmetry-blocked and spin-orbital tensors and operators are written
+         * component by component
+         */
+        template <typename Derived, typename Base, typename T>
+        void writeTensor(const std::string& key, const tensor::CompositeTensor<Derived,Base,T>& t)
+        {
+            std::vector<int> exists(t.getNumTensors());
+            for (int i = 0;i < t.getNumTensors();i++) exists[i] = t.exists(i);
+            write(key, exists);
+
+            for (int i = 0;i < t.getNumTensors();i++)
+            {
+                if (exists[i]) writeTensor(key, t(i));
+            }
+        }
+
+        template <typename Derived, typename Base, typename T>
+        void readTensor(const std::string& key, tensor::CompositeTensor<Derived,Base,T>& t)
+        {
+            std::vector<int> exists;
+            read(key, exists);
+            if (exists.size() != t.getNumTensors())
+                throw std::runtime_error("Checkpointed tensor " + key + " has a different structure");
+
+            for (int i = 0;i < t.getNumTensors();i++)
+            {
+                if (exists[i] != t.exists(i))
+                    throw std::runtime_error("Checkpointed tensor " + key + " has a different structure");
+                if (exists[i]) readTensor(key, t(i));
+            }
+        }
+};
+
+}
+
+#endif
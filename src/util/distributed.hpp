@@ -38,6 +38,7 @@
 
 #include "ctf.hpp"
 #include "util/stl_ext.hpp"
+#include "time/trace.hpp"
 
 namespace aquarius
 {
@@ -157,6 +158,7 @@ class Arena
         void Allgather(const T* sendbuf, T* recvbuf, int count) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Allgather");
             comm.Allgather(sendbuf, count, type, recvbuf, count, type);
         }
 
@@ -164,18 +166,21 @@ class Arena
         void Allgather(const std::vector<T>& sendbuf, std::vector<T>& recvbuf) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Allgather");
             comm.Allgather(sendbuf.data(), sendbuf.size(), type, recvbuf.data(), sendbuf.size(), type);
         }
 
         template <typename T>
         void Allgather(const T* sendbuf, T* recvbuf, int count, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Allgather");
             comm.Allgather(sendbuf, count, type, recvbuf, count, type);
         }
 
         template <typename T>
         void Allgather(const std::vector<T>& sendbuf, std::vector<T>& recvbuf, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Allgather");
             comm.Allgather(sendbuf.data(), sendbuf.size(), type, recvbuf.data(), sendbuf.size(), type);
         }
 
@@ -183,6 +188,7 @@ class Arena
         void Allgather(T* recvbuf, int count) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Allgather");
             comm.Allgather(MPI::IN_PLACE, 0, type, recvbuf, count, type);
         }
 
@@ -190,18 +196,21 @@ class Arena
         void Allgather(std::vector<T>& recvbuf) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Allgather");
             comm.Allgather(MPI::IN_PLACE, 0, type, recvbuf.data(), recvbuf.size()/nproc, type);
         }
 
         template <typename T>
         void Allgather(T* recvbuf, int count, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Allgather");
             comm.Allgather(MPI::IN_PLACE, 0, type, recvbuf, count, type);
         }
 
         template <typename T>
         void Allgather(std::vector<T>& recvbuf, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Allgather");
             comm.Allgather(MPI::IN_PLACE, 0, type, recvbuf.data(), recvbuf.size()/nproc, type);
         }
 
@@ -212,6 +221,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Allgatherv");
             comm.Allgatherv(sendbuf, sendcount, type, recvbuf, recvcounts, displs.data(), type);
         }
 
@@ -223,6 +233,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Allgatherv");
             comm.Allgatherv(sendbuf.data(), sendbuf.size(), type, recvbuf.data(), recvcounts.data(), displs.data(), type);
         }
 
@@ -233,6 +244,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Allgatherv");
             comm.Allgatherv(sendbuf, sendcount, type, recvbuf, recvcounts, displs.data(), type);
         }
 
@@ -243,6 +255,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Allgatherv");
             comm.Allgatherv(sendbuf.data(), sendbuf.size(), type, recvbuf.data(), recvcounts.data(), displs.data(), type);
         }
 
@@ -253,6 +266,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Allgatherv");
             comm.Allgatherv(MPI::IN_PLACE, 0, type, recvbuf, recvcounts, displs.data(), type);
         }
 
@@ -263,6 +277,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Allgatherv");
             comm.Allgatherv(MPI::IN_PLACE, 0, type, recvbuf.data(), recvcounts.data(), displs.data(), type);
         }
 
@@ -272,6 +287,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Allgatherv");
             comm.Allgatherv(MPI::IN_PLACE, 0, type, recvbuf, recvcounts, displs.data(), type);
         }
 
@@ -281,6 +297,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Allgatherv");
             comm.Allgatherv(MPI::IN_PLACE, 0, type, recvbuf.data(), recvcounts.data(), displs.data(), type);
         }
 
@@ -288,6 +305,7 @@ class Arena
         void Allreduce(const T* sendbuf, T* recvbuf, int count, const MPI::Op& op) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Allreduce");
             comm.Allreduce(sendbuf, recvbuf, count, type, op);
         }
 
@@ -295,12 +313,14 @@ class Arena
         void Allreduce(const std::vector<T>& sendbuf, std::vector<T>& recvbuf, const MPI::Op& op) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Allreduce");
             comm.Allreduce(sendbuf.data(), recvbuf.data(), sendbuf.size(), type, op);
         }
 
         template <typename T>
         void Allreduce(const T* sendbuf, T* recvbuf, int count, const MPI::Op& op, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Allreduce");
             comm.Allreduce(sendbuf, recvbuf, count, type, op);
         }
 
@@ -308,6 +328,7 @@ class Arena
         void Allreduce(const std::vector<T>& sendbuf, std::vector<T>& recvbuf, const MPI::Op& op,
                        const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Allreduce");
             comm.Allreduce(sendbuf.data(), recvbuf.data(), sendbuf.size(), type, op);
         }
 
@@ -315,6 +336,7 @@ class Arena
         void Allreduce(T* buf, int count, const MPI::Op& op) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Allreduce");
             comm.Allreduce(MPI::IN_PLACE, buf, count, type, op);
         }
 
@@ -322,18 +344,21 @@ class Arena
         void Allreduce(std::vector<T>& buf, const MPI::Op& op) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Allreduce");
             comm.Allreduce(MPI::IN_PLACE, buf.data(), buf.size(), type, op);
         }
 
         template <typename T>
         void Allreduce(T* buf, int count, const MPI::Op& op, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Allreduce");
             comm.Allreduce(MPI::IN_PLACE, buf, count, type, op);
         }
 
         template <typename T>
         void Allreduce(std::vector<T>& buf, const MPI::Op& op, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Allreduce");
             comm.Allreduce(MPI::IN_PLACE, buf.data(), buf.size(), type, op);
         }
 
@@ -341,6 +366,7 @@ class Arena
         void Alltoall(const T* sendbuf, T* recvbuf, int count) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Alltoall");
             comm.Alltoall(sendbuf, count, type, recvbuf, count, type);
         }
 
@@ -348,18 +374,21 @@ class Arena
         void Alltoall(const std::vector<T>& sendbuf, std::vector<T>& recvbuf) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Alltoall");
             comm.Alltoall(sendbuf.data(), sendbuf.size()/nproc, type, recvbuf.data(), recvbuf.size()/nproc, type);
         }
 
         template <typename T>
         void Alltoall(const T* sendbuf, T* recvbuf, int count, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Alltoall");
             comm.Alltoall(sendbuf, count, type, recvbuf, count, type);
         }
 
         template <typename T>
         void Alltoall(const std::vector<T>& sendbuf, std::vector<T>& recvbuf, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Alltoall");
             comm.Alltoall(sendbuf.data(), sendbuf.size()/nproc, type, recvbuf.data(), recvbuf.size()/nproc, type);
         }
 
@@ -373,6 +402,7 @@ class Arena
             std::vector<int> rdispls(nproc);
             rdispls[0] = 0;
             for (int i = 1;i < nproc;i++) rdispls[i] = rdispls[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Alltoallv");
             comm.Alltoallv(sendbuf, sendcounts, sdispls.data(), type,
                            recvbuf, recvcounts, rdispls.data(), type);
         }
@@ -388,6 +418,7 @@ class Arena
             std::vector<int> rdispls(nproc);
             rdispls[0] = 0;
             for (int i = 1;i < nproc;i++) rdispls[i] = rdispls[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Alltoallv");
             comm.Alltoallv(sendbuf.data(), sendcounts.data(), sdispls.data(), type,
                            recvbuf.data(), recvcounts.data(), rdispls.data(), type);
         }
@@ -402,6 +433,7 @@ class Arena
             std::vector<int> rdispls(nproc);
             rdispls[0] = 0;
             for (int i = 1;i < nproc;i++) rdispls[i] = rdispls[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Alltoallv");
             comm.Alltoallv(sendbuf, sendcounts, sdispls.data(), type,
                            recvbuf, recvcounts, rdispls.data(), type);
         }
@@ -417,12 +449,14 @@ class Arena
             std::vector<int> rdispls(nproc);
             rdispls[0] = 0;
             for (int i = 1;i < nproc;i++) rdispls[i] = rdispls[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Alltoallv");
             comm.Alltoallv(sendbuf.data(), sendcounts.data(), sdispls.data(), type,
                            recvbuf.data(), recvcounts.data(), rdispls.data(), type);
         }
 
         void Barrier() const
         {
+            time::TraceScope trace("mpi", "Barrier");
             comm.Barrier();
         }
 
@@ -430,6 +464,7 @@ class Arena
         void Bcast(T* buffer, int count, int root) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Bcast");
             comm.Bcast(buffer, count, type, root);
         }
 
@@ -437,18 +472,21 @@ class Arena
         void Bcast(std::vector<T>& buffer, int root) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Bcast");
             comm.Bcast(buffer.data(), buffer.size(), type, root);
         }
 
         template <typename T>
         void Bcast(T* buffer, int count, int root, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Bcast");
             comm.Bcast(buffer, count, type, root);
         }
 
         template <typename T>
         void Bcast(std::vector<T>& buffer, int root, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Bcast");
             comm.Bcast(buffer.data(), buffer.size(), type, root);
         }
 
@@ -456,6 +494,7 @@ class Arena
         void Exscan(const T* sendbuf, T* recvbuf, int count, const MPI::Op& op) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Exscan");
             comm.Exscan(sendbuf, recvbuf, count, type, op);
         }
 
@@ -463,6 +502,7 @@ class Arena
         void Exscan(const std::vector<T>& sendbuf, std::vector<T>& recvbuf, const MPI::Op& op) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Exscan");
             comm.Exscan(sendbuf.data(), recvbuf.data(), sendbuf.size(), type, op);
         }
 
@@ -470,6 +510,7 @@ class Arena
         void Gather(const T* sendbuf, int count, int root) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Gather");
             comm.Gather(sendbuf, count, type, NULL, 0, type, root);
         }
 
@@ -477,6 +518,7 @@ class Arena
         void Gather(const T* sendbuf, T* recvbuf, int count) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Gather");
             comm.Gather(sendbuf, count, type, recvbuf, count, type, rank);
         }
 
@@ -484,6 +526,7 @@ class Arena
         void Gather(T* recvbuf, int count) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Gather");
             comm.Gather(MPI::IN_PLACE, 0, type, recvbuf, count, type, rank);
         }
 
@@ -491,6 +534,7 @@ class Arena
         void Gather(const std::vector<T>& sendbuf, int root) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Gather");
             comm.Gather(sendbuf.data(), sendbuf.size(), type, NULL, 0, type, root);
         }
 
@@ -498,6 +542,7 @@ class Arena
         void Gather(const std::vector<T>& sendbuf, std::vector<T>& recvbuf) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Gather");
             comm.Gather(sendbuf.data(), sendbuf.size(), type, recvbuf.data(), sendbuf.size(), type, rank);
         }
 
@@ -505,42 +550,49 @@ class Arena
         void Gather(std::vector<T>& recvbuf) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Gather");
             comm.Gather(MPI::IN_PLACE, 0, type, recvbuf.data(), recvbuf.size()/nproc, type, rank);
         }
 
         template <typename T>
         void Gather(const T* sendbuf, int count, int root, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Gather");
             comm.Gather(sendbuf, count, type, NULL, 0, type, root);
         }
 
         template <typename T>
         void Gather(const T* sendbuf, T* recvbuf, int count, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Gather");
             comm.Gather(sendbuf, count, type, recvbuf, count, type, rank);
         }
 
         template <typename T>
         void Gather(T* recvbuf, int count, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Gather");
             comm.Gather(MPI::IN_PLACE, 0, type, recvbuf, count, type, rank);
         }
 
         template <typename T>
         void Gather(const std::vector<T>& sendbuf, int root, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Gather");
             comm.Gather(sendbuf.data(), sendbuf.size(), type, NULL, 0, type, root);
         }
 
         template <typename T>
         void Gather(const std::vector<T>& sendbuf, std::vector<T>& recvbuf, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Gather");
             comm.Gather(sendbuf.data(), sendbuf.size(), type, recvbuf.data(), sendbuf.size(), type, rank);
         }
 
         template <typename T>
         void Gather(std::vector<T>& recvbuf, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Gather");
             comm.Gather(MPI::IN_PLACE, 0, type, recvbuf.data(), recvbuf.size()/nproc, type, rank);
         }
 
@@ -548,6 +600,7 @@ class Arena
         void Gatherv(const T* sendbuf, int sendcount, int root) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Gatherv");
             comm.Gatherv(sendbuf, sendcount, type, NULL, NULL, NULL, type, root);
         }
 
@@ -558,6 +611,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Gatherv");
             comm.Gatherv(sendbuf, sendcount, type, recvbuf, recvcounts, displs.data(), type, rank);
         }
 
@@ -568,6 +622,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Gatherv");
             comm.Gatherv(MPI::IN_PLACE, 0, type, recvbuf, recvcounts, displs.data(), type, rank);
         }
 
@@ -575,6 +630,7 @@ class Arena
         void Gatherv(const std::vector<T>& sendbuf, int root) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Gatherv");
             comm.Gatherv(sendbuf.data(), sendbuf.size(), type, NULL, NULL, NULL, type, root);
         }
 
@@ -586,6 +642,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Gatherv");
             comm.Gatherv(sendbuf.data(), sendbuf.size(), type, recvbuf.data(), recvcounts.data(), displs.data(), type, rank);
         }
 
@@ -596,12 +653,14 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Gatherv");
             comm.Gatherv(MPI::IN_PLACE, 0, type, recvbuf.data(), recvcounts.data(), displs.data(), type, rank);
         }
 
         template <typename T>
         void Gatherv(const T* sendbuf, int sendcount, int root, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Gatherv");
             comm.Gatherv(sendbuf, sendcount, type, NULL, NULL, NULL, type, root);
         }
 
@@ -612,6 +671,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Gatherv");
             comm.Gatherv(sendbuf, sendcount, type, recvbuf, recvcounts, displs.data(), type, rank);
         }
 
@@ -621,12 +681,14 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Gatherv");
             comm.Gatherv(MPI::IN_PLACE, 0, type, recvbuf, recvcounts, displs.data(), type, rank);
         }
 
         template <typename T>
         void Gatherv(const std::vector<T>& sendbuf, int root, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Gatherv");
             comm.Gatherv(sendbuf.data(), sendbuf.size(), type, NULL, NULL, NULL, type, root);
         }
 
@@ -637,6 +699,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Gatherv");
             comm.Gatherv(sendbuf.data(), sendbuf.size(), type, recvbuf.data(), recvcounts.data(), displs.data(), type, rank);
         }
 
@@ -646,9 +709,28 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+recvcounts[i-1];
+            time::TraceScope trace("mpi", "Gatherv");
             comm.Gatherv(MPI::IN_PLACE, 0, type, recvbuf.data(), recvcounts.data(), displs.data(), type, rank);
         }
 
+        /*
+         * Non-blocking broadcast (MPI-3), which has no C++ binding
+         */
+        template <typename T>
+        MPI::Request Ibcast(T* buffer, int count, int root) const
+        {
+            const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            return Ibcast(buffer, count, root, type);
+        }
+
+        template <typename T>
+        MPI::Request Ibcast(T* buffer, int count, int root, const MPI::Datatype& type) const
+        {
+            MPI_Request request;
+            MPI_Ibcast(buffer, count, (MPI_Datatype)type, root, (MPI_Comm)comm, &request);
+            return MPI::Request(request);
+        }
+
         bool Iprobe(int source, int tag, MPI::Status& status) const
         {
             return comm.Iprobe(source, tag, status);
@@ -855,6 +937,7 @@ class Arena
         void Reduce(const T* sendbuf, int count, const MPI::Op& op, int root) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Reduce");
             comm.Reduce(sendbuf, NULL, count, type, op, root);
         }
 
@@ -862,6 +945,7 @@ class Arena
         void Reduce(const T* sendbuf, T* recvbuf, int count, const MPI::Op& op) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Reduce");
             comm.Reduce(sendbuf, recvbuf, count, type, op, rank);
         }
 
@@ -869,6 +953,7 @@ class Arena
         void Reduce(T* recvbuf, int count, const MPI::Op& op) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Reduce");
             comm.Reduce(MPI::IN_PLACE, recvbuf, count, type, op, rank);
         }
 
@@ -876,6 +961,7 @@ class Arena
         void Reduce(const std::vector<T>& sendbuf, const MPI::Op& op, int root) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Reduce");
             comm.Reduce(sendbuf.data(), NULL, sendbuf.size(), type, op, root);
         }
 
@@ -883,6 +969,7 @@ class Arena
         void Reduce(const std::vector<T>& sendbuf, std::vector<T>& recvbuf, const MPI::Op& op) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Reduce");
             comm.Reduce(sendbuf.data(), recvbuf.data(), sendbuf.size(), type, op, rank);
         }
 
@@ -890,6 +977,7 @@ class Arena
         void Reduce(std::vector<T>& recvbuf, const MPI::Op& op) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Reduce");
             comm.Reduce(MPI::IN_PLACE, recvbuf.data(), recvbuf.size(), type, op, rank);
         }
 
@@ -897,6 +985,7 @@ class Arena
         void Reduce_scatter(const T* sendbuf, T* recvbuf, int* recvcounts, const MPI::Op& op) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Reduce_scatter");
             comm.Reduce_scatter(sendbuf, recvbuf, recvcounts, type, op);
         }
 
@@ -905,6 +994,7 @@ class Arena
                             std::vector<int>& recvcounts, const MPI::Op& op) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Reduce_scatter");
             comm.Reduce_scatter(sendbuf.data(), recvbuf.data(), recvcounts.data(), type, op);
         }
 
@@ -912,6 +1002,7 @@ class Arena
         void Reduce_scatter(T* recvbuf, int* recvcounts, const MPI::Op& op) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Reduce_scatter");
             comm.Reduce_scatter(MPI::IN_PLACE, recvbuf, recvcounts, type, op);
         }
 
@@ -919,6 +1010,7 @@ class Arena
         void Reduce_scatter(std::vector<T>& recvbuf, std::vector<int>& recvcounts, const MPI::Op& op) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Reduce_scatter");
             comm.Reduce_scatter(MPI::IN_PLACE, recvbuf.data(), recvcounts.data(), type, op);
         }
 
@@ -978,6 +1070,7 @@ class Arena
         void Scan(const T* sendbuf, T* recvbuf, int count, const MPI::Op& op) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Scan");
             comm.Scan(sendbuf, recvbuf, count, type, op);
         }
 
@@ -985,6 +1078,7 @@ class Arena
         void Scan(const std::vector<T>& sendbuf, std::vector<T>& recvbuf, const MPI::Op& op) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Scan");
             comm.Scan(sendbuf.data(), recvbuf.data(), sendbuf.size(), type, op);
         }
 
@@ -992,6 +1086,7 @@ class Arena
         void Scatter(T* recvbuf, int recvcount, int root) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Scatter");
             comm.Scatter(NULL, 0, type, recvbuf, recvcount, type, root);
         }
 
@@ -999,6 +1094,7 @@ class Arena
         void Scatter(const T* sendbuf, int sendcount, T* recvbuf, int recvcount) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Scatter");
             comm.Scatter(sendbuf, sendcount, type, recvbuf, recvcount, type, rank);
         }
 
@@ -1006,6 +1102,7 @@ class Arena
         void Scatter(const T* sendbuf, int sendcount) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Scatter");
             comm.Scatter(sendbuf, sendcount, type, MPI::IN_PLACE, 0, type, rank);
         }
 
@@ -1013,6 +1110,7 @@ class Arena
         void Scatter(std::vector<T>& recvbuf, int root) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Scatter");
             comm.Scatter(NULL, 0, type, recvbuf.data(), recvbuf.size(), type, root);
         }
 
@@ -1020,6 +1118,7 @@ class Arena
         void Scatter(const std::vector<T>& sendbuf, std::vector<T>& recvbuf) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Scatter");
             comm.Scatter(sendbuf.data(), recvbuf.size(), type, recvbuf.data(), recvbuf.size(), type, rank);
         }
 
@@ -1027,42 +1126,49 @@ class Arena
         void Scatter(const std::vector<T>& sendbuf) const
         {
             const MPI::Datatype& type = MPI_TYPE_<T>::value();
+            time::TraceScope trace("mpi", "Scatter");
             comm.Scatter(sendbuf.data(), sendbuf.size()/nproc, type, MPI::IN_PLACE, 0, type, rank);
         }
 
         template <typename T>
         void Scatter(T* recvbuf, int recvcount, int root, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Scatter");
             comm.Scatter(NULL, 0, type, recvbuf, recvcount, type, root);
         }
 
         template <typename T>
         void Scatter(const T* sendbuf, int sendcount, T* recvbuf, int recvcount, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Scatter");
             comm.Scatter(sendbuf, sendcount, type, recvbuf, recvcount, type, rank);
         }
 
         template <typename T>
         void Scatter(const T* sendbuf, int sendcount, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Scatter");
             comm.Scatter(sendbuf, sendcount, type, MPI::IN_PLACE, 0, type, rank);
         }
 
         template <typename T>
         void Scatter(std::vector<T>& recvbuf, int root, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Scatter");
             comm.Scatter(NULL, 0, type, recvbuf.data(), recvbuf.size(), type, root);
         }
 
         template <typename T>
         void Scatter(const std::vector<T>& sendbuf, std::vector<T>& recvbuf, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Scatter");
             comm.Scatter(sendbuf.data(), recvbuf.size(), type, recvbuf.data(), recvbuf.size(), type, rank);
         }
 
         template <typename T>
         void Scatter(const std::vector<T>& sendbuf, const MPI::Datatype& type) const
         {
+            time::TraceScope trace("mpi", "Scatter");
             comm.Scatter(sendbuf.data(), sendbuf.size()/nproc, type, MPI::IN_PLACE, 0, type, rank);
         }
 
@@ -1073,6 +1179,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+sendcounts[i-1];
+            time::TraceScope trace("mpi", "Scatterv");
             comm.Scatterv(NULL, sendcounts, displs.data(), type, recvbuf, recvcount, type, root);
         }
 
@@ -1083,6 +1190,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+sendcounts[i-1];
+            time::TraceScope trace("mpi", "Scatterv");
             comm.Scatterv(sendbuf, sendcounts, displs.data(), type, recvbuf, recvcount, type, rank);
         }
 
@@ -1093,6 +1201,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+sendcounts[i-1];
+            time::TraceScope trace("mpi", "Scatterv");
             comm.Scatterv(sendbuf, sendcounts, displs.data(), type, MPI::IN_PLACE, 0, type, rank);
         }
 
@@ -1104,6 +1213,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+sendcounts[i-1];
+            time::TraceScope trace("mpi", "Scatterv");
             comm.Scatterv(NULL, sendcounts.data(), displs.data(), type,
                           recvbuf.data(), recvbuf.size(), type, root);
         }
@@ -1116,6 +1226,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+sendcounts[i-1];
+            time::TraceScope trace("mpi", "Scatterv");
             comm.Scatterv(sendbuf.data(), sendcounts.data(), displs.data(), type,
                           recvbuf.data(), recvbuf.size(), type, rank);
         }
@@ -1127,6 +1238,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+sendcounts[i-1];
+            time::TraceScope trace("mpi", "Scatterv");
             comm.Scatterv(sendbuf.data(), sendcounts.data(), displs.data(), type,
                           MPI::IN_PLACE, 0, type, rank);
         }
@@ -1138,6 +1250,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+sendcounts[i-1];
+            time::TraceScope trace("mpi", "Scatterv");
             comm.Scatterv(NULL, sendcounts, displs.data(), type, recvbuf, recvcount, type, root);
         }
 
@@ -1148,6 +1261,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+sendcounts[i-1];
+            time::TraceScope trace("mpi", "Scatterv");
             comm.Scatterv(sendbuf, sendcounts, displs.data(), type, recvbuf, recvcount, type, rank);
         }
 
@@ -1157,6 +1271,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+sendcounts[i-1];
+            time::TraceScope trace("mpi", "Scatterv");
             comm.Scatterv(sendbuf, sendcounts, displs.data(), type, MPI::IN_PLACE, 0, type, rank);
         }
 
@@ -1167,6 +1282,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+sendcounts[i-1];
+            time::TraceScope trace("mpi", "Scatterv");
             comm.Scatterv(NULL, sendcounts.data(), displs.data(), type,
                           recvbuf.data(), recvbuf.size(), type, root);
         }
@@ -1178,6 +1294,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+sendcounts[i-1];
+            time::TraceScope trace("mpi", "Scatterv");
             comm.Scatterv(sendbuf.data(), sendcounts.data(), displs.data(), type,
                           recvbuf.data(), recvbuf.size(), type, rank);
         }
@@ -1189,6 +1306,7 @@ class Arena
             std::vector<int> displs(nproc);
             displs[0] = 0;
             for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+sendcounts[i-1];
+            time::TraceScope trace("mpi", "Scatterv");
             comm.Scatterv(sendbuf.data(), sendcounts.data(), displs.data(), type,
                           MPI::IN_PLACE, 0, type, rank);
         }
@@ -25,17 +25,48 @@
 #ifndef _AQUARIUS_UTIL_ITERATIVE_HPP_
 #define _AQUARIUS_UTIL_ITERATIVE_HPP_
 
+#include <cstdio>
 #include <limits>
+#include <set>
 #include <string>
 
+#include <unistd.h>
+
 #include "time/time.hpp"
 #include "task/task.hpp"
+#include "input/molecule.hpp"
 
 #include "distributed.hpp"
+#include "checkpoint.hpp"
 
 namespace aquarius
 {
 
+/*
+ * The checkpoint product of an iterative task (the last iteration written).
+ * With checkpoint { remove true }, the file is deleted once no task needs it
+ * any more, along with its directory if that is then empty.
+ */
+struct CheckpointFile : public task::Scalar
+{
+    std::string dir;
+    std::string path;
+    bool remove;
+
+    CheckpointFile(const Arena& arena, double iteration, const std::string& dir,
+                   const std::string& path, bool remove)
+    : task::Scalar(arena, iteration), dir(dir), path(path), remove(remove) {}
+
+    ~CheckpointFile()
+    {
+        if (remove && arena.rank == 0)
+        {
+            std::remove(path.c_str());
+            rmdir(dir.c_str());
+        }
+    }
+};
+
 class Iterative : public task::Task
 {
     public:
@@ -48,9 +79,62 @@ class Iterative : public task::Task
         ConvergenceType convtype;
         int iter;
         int maxiter;
+        int checkpoint_interval;
+        double checkpoint_overhead;
+        bool checkpoint_remove;
+        std::string checkpoint_dir;
+        std::string checkpoint_file;
+        std::string restart_file;
 
         virtual void iterate() = 0;
 
+        /*
+         * Write or read everything needed to continue after the current
+         * iteration, other than the energy and convergence. Only solvers
+         * which accept the checkpoint options need to implement these.
+         */
+        virtual void saveState(Checkpoint& chk)
+        {
+            throw std::logic_error("Checkpointing is not implemented for " + name);
+        }
+
+        virtual void loadState(Checkpoint& chk)
+        {
+            throw std::logic_error("Checkpointing is not implemented for " + name);
+        }
+
+        /*
+         * The molecule which the requirements of this task depend on, directly or
+         * through the requirements of their own products (e.g. CC amplitudes ->
+         * MO integrals -> SCF -> molecule), or NULL if there is none
+         */
+        static const input::Molecule* findMolecule(std::vector<task::Requirement>& reqs)
+        {
+            for (std::vector<task::Requirement>::iterator r = reqs.begin();r != reqs.end();++r)
+            {
+                if (!r->isFulfilled()) continue;
+
+                task::Product& p = r->get();
+                if (p.getType() == "molecule" && p.exists()) return &p.get<input::Molecule>();
+
+                const input::Molecule* molecule = findMolecule(p.getRequirements());
+                if (molecule != NULL) return molecule;
+            }
+
+            return NULL;
+        }
+
+        const input::Molecule* findMolecule()
+        {
+            for (std::vector<task::Product>::iterator p = products.begin();p != products.end();++p)
+            {
+                const input::Molecule* molecule = findMolecule(p->getRequirements());
+                if (molecule != NULL) return molecule;
+            }
+
+            return NULL;
+        }
+
     public:
         Iterative(const std::string& type, const std::string& name, const input::Config& config)
         : Task(type, name),
@@ -58,8 +142,55 @@ class Iterative : public task::Task
           conv(std::numeric_limits<double>::infinity()),
           convtol(config.get<double>("convergence")),
           iter(0),
-          maxiter(config.get<int>("max_iterations"))
+          maxiter(config.get<int>("max_iterations")),
+          checkpoint_interval(0),
+          checkpoint_overhead(0),
+          checkpoint_remove(false),
+          checkpoint_dir(".")
         {
+            if (config.exists("checkpoint.interval"))
+            {
+                checkpoint_interval = config.get<int>("checkpoint.interval");
+                checkpoint_overhead = config.get<double>("checkpoint.max_overhead");
+                checkpoint_remove = config.get<bool>("checkpoint.remove");
+            }
+
+            if (checkpoint_interval > 0)
+            {
+                if (config.exists("checkpoint.directory"))
+                {
+                    checkpoint_dir = config.get<std::string>("checkpoint.directory");
+                }
+                checkpoint_file = checkpoint_dir + "/" + name + ".chk";
+
+                /*
+                 * Task names are unique within an input, but catch anything else that
+                 * would end up writing to the same file
+                 */
+                if (!checkpointFiles().insert(checkpoint_file).second)
+                    throw std::logic_error("Checkpoint file " + checkpoint_file +
+                                           " of task " + name + " is already in use");
+
+                /*
+                 * A task may also start from the checkpoint of another one, named as in
+                 * "using ... from"; the product type carries the task name so that the
+                 * requirement is matched to exactly that task
+                 */
+                std::vector<task::Requirement> reqs;
+                if (config.exists("checkpoint.restart"))
+                {
+                    std::string from = config.get<std::string>("checkpoint.restart");
+                    if (from.find('.') == std::string::npos)
+                        from = name.substr(0, name.find_last_of('.')+1) + from;
+                    if (from[0] == '.') from = from.substr(1);
+
+                    restart_file = checkpoint_dir + "/" + from + ".chk";
+                    reqs.push_back(task::Requirement("checkpoint:" + from, "restart"));
+                }
+
+                addProduct(task::Product("checkpoint:" + name, "checkpoint", reqs));
+            }
+
             std::string sconv = config.get<std::string>("conv_type");
 
             if (sconv == "MAXE")
@@ -80,12 +211,38 @@ class Iterative : public task::Task
 
         void run(task::TaskDAG& dag, const Arena& arena)
         {
-            for (iter = 1;iter <= maxiter && !isConverged();iter++)
+            int first = 1;
+
+            if (checkpoint_interval > 0)
+            {
+                /*
+                 * A checkpoint of this task wins over the one it was told to start from,
+                 * since it can only have been written later
+                 */
+                if (!readCheckpoint(arena, checkpoint_file, first) && !restart_file.empty())
+                {
+                    if (!readCheckpoint(arena, restart_file, first))
+                        throw std::runtime_error("Checkpoint file " + restart_file + " not found");
+                }
+            }
+
+            /*
+             * A checkpoint is skipped if writing the previous one took longer than
+             * checkpoint_overhead times the iteration time since then, which bounds
+             * the fraction of the run time spent on I/O
+             */
+            double dt_checkpoint = 0;
+            double dt_since_checkpoint = 0;
+
+            for (iter = first;iter <= maxiter && !isConverged();iter++)
             {
+                time::TraceScope trace("iteration", "iteration");
+                time::ProfileScope scope("iteration");
                 time::Timer timer;
                 timer.start();
                 iterate();
                 timer.stop();
+                scope.stop();
                 double dt = timer.seconds(arena);
 
                 int ndigit = (int)(ceil(-log10(convtol))+0.5);
@@ -95,12 +252,71 @@ class Iterative : public task::Task
                 log(arena) << "Iteration " << iter <<
                               " energy = " << std::fixed << std::setprecision(ndigit) << energy <<
                               ", convergence = " << std::scientific << std::setprecision(3) << conv << std::endl;
+
+                dt_since_checkpoint += dt;
+
+                if (checkpoint_interval > 0 &&
+                    (iter%checkpoint_interval == 0 || isConverged()) &&
+                    dt_checkpoint <= checkpoint_overhead*dt_since_checkpoint)
+                {
+                    time::Timer timer;
+                    timer.start();
+                    writeCheckpoint(arena);
+                    timer.stop();
+                    dt_checkpoint = timer.seconds(arena);
+                    dt_since_checkpoint = 0;
+
+                    log(arena) << "Checkpoint took " << std::fixed <<
+                                  std::setprecision(3) << dt_checkpoint << " s" << std::endl;
+                }
             }
 
             if (!isConverged())
             {
                 throw std::runtime_error(std::strprintf("Did not converge in %d iterations", maxiter));
             }
+
+            if (checkpoint_interval > 0)
+                put("checkpoint", new CheckpointFile(arena, iter-1, checkpoint_dir,
+                                                     checkpoint_file, checkpoint_remove));
+        }
+
+        bool readCheckpoint(const Arena& arena, const std::string& file, int& first)
+        {
+            Checkpoint chk(arena, file);
+
+            if (!chk.beginRead()) return false;
+
+            const input::Molecule* molecule = findMolecule();
+            if (molecule != NULL) chk.checkSystem(*molecule);
+
+            chk.read("iteration", first);
+            chk.read("energy", energy);
+            chk.read("convergence", conv);
+            loadState(chk);
+            chk.endRead();
+
+            log(arena) << "Restarting from iteration " << first <<
+                          " of " << file << std::endl;
+            first++;
+
+            return true;
+        }
+
+        void writeCheckpoint(const Arena& arena)
+        {
+            Checkpoint chk(arena, checkpoint_file);
+
+            chk.beginWrite();
+
+            const input::Molecule* molecule = findMolecule();
+            if (molecule != NULL) chk.writeSystem(*molecule);
+
+            chk.write("iteration", iter);
+            chk.write("energy", energy);
+            chk.write("convergence", conv);
+            saveState(chk);
+            chk.commit();
         }
 
         double getEnergy() const { return energy; }
@@ -108,6 +324,13 @@ class Iterative : public task::Task
         double getConvergence() const { return conv; }
 
         bool isConverged() const { return conv < convtol; }
+
+    private:
+        static std::set<std::string>& checkpointFiles()
+        {
+            static std::set<std::string> files;
+            return files;
+        }
 };
 
 }
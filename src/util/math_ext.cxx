@@ -103,83 +103,17 @@ using namespace std;
 namespace aquarius
 {
 
-template <typename T>
-void transpose(const size_t m, const size_t n, const T alpha, const T* A, const size_t lda,
-                                               const T  beta,       T* B, const size_t ldb)
+template <>
+void transpose(const size_t m, const size_t n, const double alpha, const double* A, const size_t lda,
+                                               const double  beta,       double* B, const size_t ldb)
 {
-    size_t i, j;
+    int len[2] = {(int)m, (int)n};
+    size_t stride_A[2] = {1, lda};
+    size_t stride_B[2] = {ldb, 1};
 
-    if (alpha == 1.0)
-    {
-        if (beta == 0.0)
-        {
-            for (i = 0;i < m;i++)
-            {
-                for (j = 0;j < n;j++)
-                {
-                    B[i*ldb + j] = A[j*lda + i];
-                }
-            }
-        }
-        else if (beta == 1.0)
-        {
-            for (i = 0;i < m;i++)
-            {
-                for (j = 0;j < n;j++)
-                {
-                    B[i*ldb + j] += A[j*lda + i];
-                }
-            }
-        }
-        else
-        {
-            for (i = 0;i < m;i++)
-            {
-                for (j = 0;j < n;j++)
-                {
-                    B[i*ldb + j] = beta*B[i*ldb + j] + A[j*lda + i];
-                }
-            }
-        }
-    }
-    else
-    {
-        if (beta == 0.0)
-        {
-            for (i = 0;i < m;i++)
-            {
-                for (j = 0;j < n;j++)
-                {
-                    B[i*ldb + j] = alpha*A[j*lda + i];
-                }
-            }
-        }
-        else if (beta == 1.0)
-        {
-            for (i = 0;i < m;i++)
-            {
-                for (j = 0;j < n;j++)
-                {
-                    B[i*ldb + j] += alpha*A[j*lda + i];
-                }
-            }
-        }
-        else
-        {
-            for (i = 0;i < m;i++)
-            {
-                for (j = 0;j < n;j++)
-                {
-                    B[i*ldb + j] = beta*B[i*ldb + j] + alpha*A[j*lda + i];
-                }
-            }
-        }
-    }
+    permute_strided(2, len, alpha, A, stride_A, beta, B, stride_B);
 }
 
-template void transpose(const size_t m, const size_t n, const double alpha, const double* A, const size_t lda,
-                                                        const double  beta,       double* B, const size_t ldb);
-
 vec3::vec3()
 {
     v[0] = 0;
@@ -29,8 +29,10 @@
 
 #ifdef __cplusplus
 #include <cmath>
+#include <cstddef>
 #else
 #include <math.h>
+#include <stddef.h>
 #endif
 
 #include "util.h"
@@ -52,6 +54,16 @@ int64_t fact(int n);
 
 int64_t dfact(int n);
 
+/*
+ * B[i_0*stride_B[0]+...] = alpha*A[i_0*stride_A[0]+...] + beta*B[i_0*stride_B[0]+...]
+ * for all 0 <= i_k < len[k], i.e. a general N-dimensional permutation of A onto B.
+ * The fastest-varying indices of A and B are transposed in cache-sized tiles
+ * (in registers if both are unit-stride), and the tiles are spread over OpenMP threads.
+ */
+void permute_strided(const int ndim, const int* restrict len,
+                     const double alpha, const double* restrict A, const size_t* restrict stride_A,
+                     const double beta,        double* restrict B, const size_t* restrict stride_B);
+
 #ifdef __cplusplus
 }
 
@@ -60,10 +72,17 @@ int64_t dfact(int n);
 namespace aquarius
 {
 
+/*
+ * B[i*ldb+j] = alpha*A[j*lda+i] + beta*B[i*ldb+j] for 0 <= i < m, 0 <= j < n
+ */
 template <typename T>
 void transpose(const size_t m, const size_t n, const T alpha, const T* A, const size_t lda,
                                                const T  beta,       T* B, const size_t ldb);
 
+template <>
+void transpose(const size_t m, const size_t n, const double alpha, const double* A, const size_t lda,
+                                               const double  beta,       double* B, const size_t ldb);
+
 class vec3;
 class mat3x3;
 
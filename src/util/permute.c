@@ -0,0 +1,391 @@
+/* Copyright (c) 2013, Devin Matthews
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following
+ * conditions are met:
+ *      * Redistributions of source code must retain the above copyright
+ *        notice, this list of conditions and the following disclaimer.
+ *      * Redistributions in binary form must reproduce the above copyright
+ *        notice, this list of conditions and the following disclaimer in the
+ *        documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL DEVIN MATTHEWS BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE. */
+
+
+#include "math_ext.h"
+
+#include <stdbool.h>
+#include <omp.h>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+/*
+ * The 2-d transpose of the fastest index of A and the fastest index of B is
+ * blocked so that a PERMUTE_L2_BLOCK^2 block of each of A and B fits in L2, and
+ * each of those into PERMUTE_L1_BLOCK^2 tiles which fit in L1. Permutations with
+ * fewer than PERMUTE_OMP_MIN elements are not worth starting threads for.
+ */
+#define PERMUTE_L1_BLOCK 32
+#define PERMUTE_L2_BLOCK 128
+#define PERMUTE_OMP_MIN 32768
+
+#define PERMUTE_MIN(a,b) ((a) < (b) ? (a) : (b))
+
+#ifdef __AVX__
+
+#define PERMUTE_SIMD 4
+
+/*
+ * B[i*ldb+j] = alpha*A[i+j*lda] + beta*B[i*ldb+j] for a 4x4 tile, transposed in registers
+ */
+static inline void transpose_simd(const double alpha, const double* restrict A, const size_t lda,
+                                  const double beta,        double* restrict B, const size_t ldb)
+{
+    __m256d a0 = _mm256_loadu_pd(A      );
+    __m256d a1 = _mm256_loadu_pd(A+  lda);
+    __m256d a2 = _mm256_loadu_pd(A+2*lda);
+    __m256d a3 = _mm256_loadu_pd(A+3*lda);
+
+    __m256d t0 = _mm256_unpacklo_pd(a0, a1);
+    __m256d t1 = _mm256_unpackhi_pd(a0, a1);
+    __m256d t2 = _mm256_unpacklo_pd(a2, a3);
+    __m256d t3 = _mm256_unpackhi_pd(a2, a3);
+
+    __m256d b[4];
+    b[0] = _mm256_permute2f128_pd(t0, t2, 0x20);
+    b[1] = _mm256_permute2f128_pd(t1, t3, 0x20);
+    b[2] = _mm256_permute2f128_pd(t0, t2, 0x31);
+    b[3] = _mm256_permute2f128_pd(t1, t3, 0x31);
+
+    __m256d va = _mm256_set1_pd(alpha);
+
+    if (beta == 0.0)
+    {
+        for (int i = 0;i < 4;i++)
+            _mm256_storeu_pd(B+i*ldb, _mm256_mul_pd(va, b[i]));
+    }
+    else
+    {
+        __m256d vb = _mm256_set1_pd(beta);
+        for (int i = 0;i < 4;i++)
+            _mm256_storeu_pd(B+i*ldb, _mm256_add_pd(_mm256_mul_pd(va, b[i]),
+                                                    _mm256_mul_pd(vb, _mm256_loadu_pd(B+i*ldb))));
+    }
+}
+
+#elif defined(__SSE2__)
+
+#define PERMUTE_SIMD 2
+
+/*
+ * B[i*ldb+j] = alpha*A[i+j*lda] + beta*B[i*ldb+j] for a 2x2 tile, transposed in registers
+ */
+static inline void transpose_simd(const double alpha, const double* restrict A, const size_t lda,
+                                  const double beta,        double* restrict B, const size_t ldb)
+{
+    __m128d a0 = _mm_loadu_pd(A    );
+    __m128d a1 = _mm_loadu_pd(A+lda);
+
+    __m128d b0 = _mm_unpacklo_pd(a0, a1);
+    __m128d b1 = _mm_unpackhi_pd(a0, a1);
+
+    __m128d va = _mm_set1_pd(alpha);
+
+    if (beta == 0.0)
+    {
+        _mm_storeu_pd(B    , _mm_mul_pd(va, b0));
+        _mm_storeu_pd(B+ldb, _mm_mul_pd(va, b1));
+    }
+    else
+    {
+        __m128d vb = _mm_set1_pd(beta);
+        _mm_storeu_pd(B    , _mm_add_pd(_mm_mul_pd(va, b0), _mm_mul_pd(vb, _mm_loadu_pd(B    ))));
+        _mm_storeu_pd(B+ldb, _mm_add_pd(_mm_mul_pd(va, b1), _mm_mul_pd(vb, _mm_loadu_pd(B+ldb))));
+    }
+}
+
+#endif
+
+/*
+ * B[i*sb_i+j*sb_j] = alpha*A[i*sa_i+j*sa_j] + beta*B[i*sb_i+j*sb_j] for one L1 tile
+ */
+static void transpose_tile(const int m, const int n,
+                           const double alpha, const double* restrict A, const size_t sa_i, const size_t sa_j,
+                           const double beta,        double* restrict B, const size_t sb_i, const size_t sb_j)
+{
+    int i, j, m0, n0;
+
+    m0 = 0;
+    n0 = 0;
+
+#ifdef PERMUTE_SIMD
+    /*
+     * Both A and B are unit-stride in their fastest index, so full
+     * PERMUTE_SIMD^2 sub-tiles may be transposed in registers
+     */
+    if (sa_i == 1 && sb_j == 1)
+    {
+        m0 = m-m%PERMUTE_SIMD;
+        n0 = n-n%PERMUTE_SIMD;
+
+        for (i = 0;i < m0;i += PERMUTE_SIMD)
+        {
+            for (j = 0;j < n0;j += PERMUTE_SIMD)
+            {
+                transpose_simd(alpha, A+i+j*sa_j, sa_j, beta, B+i*sb_i+j, sb_i);
+            }
+        }
+    }
+#endif
+
+    /*
+     * Whatever is left over: the right edge (j >= n0) for all i and
+     * the bottom edge (i >= m0) for j < n0
+     */
+    if (beta == 0.0)
+    {
+        for (i = 0;i < m;i++)
+        {
+            for (j = (i < m0 ? n0 : 0);j < n;j++)
+            {
+                B[i*sb_i+j*sb_j] = alpha*A[i*sa_i+j*sa_j];
+            }
+        }
+    }
+    else
+    {
+        for (i = 0;i < m;i++)
+        {
+            for (j = (i < m0 ? n0 : 0);j < n;j++)
+            {
+                B[i*sb_i+j*sb_j] = alpha*A[i*sa_i+j*sa_j] + beta*B[i*sb_i+j*sb_j];
+            }
+        }
+    }
+}
+
+/*
+ * Scale and copy along an index which is the fastest-varying in both A and B
+ */
+static void permute_line(const int m,
+                         const double alpha, const double* restrict A, const size_t sa,
+                         const double beta,        double* restrict B, const size_t sb)
+{
+    int i;
+
+    if (sa == 1 && sb == 1)
+    {
+        if (beta == 0.0)
+        {
+            for (i = 0;i < m;i++) B[i] = alpha*A[i];
+        }
+        else
+        {
+            for (i = 0;i < m;i++) B[i] = alpha*A[i] + beta*B[i];
+        }
+    }
+    else
+    {
+        if (beta == 0.0)
+        {
+            for (i = 0;i < m;i++) B[i*sb] = alpha*A[i*sa];
+        }
+        else
+        {
+            for (i = 0;i < m;i++) B[i*sb] = alpha*A[i*sa] + beta*B[i*sb];
+        }
+    }
+}
+
+void permute_strided(const int ndim, const int* restrict len,
+                     const double alpha, const double* restrict A, const size_t* restrict stride_A,
+                     const double beta,        double* restrict B, const size_t* restrict stride_B)
+{
+    int i, j, n, fast_A, fast_B, m_A, m_B, nblock_A, nblock_B;
+    size_t sa_A, sb_A, sa_B, sb_B, nitem, nelem;
+    int len_[ndim > 0 ? ndim : 1];
+    size_t stride_A_[ndim > 0 ? ndim : 1];
+    size_t stride_B_[ndim > 0 ? ndim : 1];
+    bool fused;
+
+    /*
+     * Drop indices of length one, and fuse pairs of indices which are
+     * contiguous in both A and B (e.g. a dense copy becomes one long line)
+     */
+    n = 0;
+    nelem = 1;
+    for (i = 0;i < ndim;i++)
+    {
+        if (len[i] == 0) return;
+        if (len[i] == 1) continue;
+        len_[n] = len[i];
+        stride_A_[n] = stride_A[i];
+        stride_B_[n] = stride_B[i];
+        nelem *= len[i];
+        n++;
+    }
+
+    do
+    {
+        fused = false;
+        for (i = 0;i < n && !fused;i++)
+        {
+            for (j = 0;j < n && !fused;j++)
+            {
+                if (i == j ||
+                    stride_A_[j] != stride_A_[i]*len_[i] ||
+                    stride_B_[j] != stride_B_[i]*len_[i]) continue;
+
+                len_[i] *= len_[j];
+                len_[j] = len_[n-1];
+                stride_A_[j] = stride_A_[n-1];
+                stride_B_[j] = stride_B_[n-1];
+                n--;
+                fused = true;
+            }
+        }
+    }
+    while (fused);
+
+    /*
+     * Find the fastest-varying index of A and of B
+     */
+    fast_A = -1;
+    fast_B = -1;
+    for (i = 0;i < n;i++)
+    {
+        if (fast_A == -1 || stride_A_[i] < stride_A_[fast_A]) fast_A = i;
+        if (fast_B == -1 || stride_B_[i] < stride_B_[fast_B]) fast_B = i;
+    }
+
+    m_A = (fast_A == -1 ? 1 : len_[fast_A]);
+    sa_A = (fast_A == -1 ? 0 : stride_A_[fast_A]);
+    sb_A = (fast_A == -1 ? 0 : stride_B_[fast_A]);
+
+    if (fast_B == fast_A)
+    {
+        m_B = 1;
+        sa_B = 0;
+        sb_B = 0;
+    }
+    else
+    {
+        m_B = len_[fast_B];
+        sa_B = stride_A_[fast_B];
+        sb_B = stride_B_[fast_B];
+    }
+
+    /*
+     * A work item is one L2 block of the fast indices for one value of the
+     * remaining indices, with the blocks of fast_A varying fastest
+     */
+    nblock_A = (m_A+PERMUTE_L2_BLOCK-1)/PERMUTE_L2_BLOCK;
+    nblock_B = (m_B+PERMUTE_L2_BLOCK-1)/PERMUTE_L2_BLOCK;
+    nitem = nelem/((size_t)m_A*m_B)*nblock_A*nblock_B;
+
+    #pragma omp parallel if(nelem >= PERMUTE_OMP_MIN)
+    {
+        int k, block_A, block_B, i0, j0, i1, j1;
+        size_t item, item0, item1, off_A, off_B, rem;
+        int pos[n > 0 ? n : 1];
+        int nthread = omp_get_num_threads();
+        int tid = omp_get_thread_num();
+        bool done;
+
+        item0 = (nitem*tid)/nthread;
+        item1 = (nitem*(tid+1))/nthread;
+
+        /*
+         * Position of the first item of this thread
+         */
+        block_A = item0%nblock_A;
+        block_B = (item0/nblock_A)%nblock_B;
+        rem = item0/nblock_A/nblock_B;
+        off_A = 0;
+        off_B = 0;
+        for (k = 0;k < n;k++)
+        {
+            pos[k] = 0;
+            if (k == fast_A || k == fast_B) continue;
+            pos[k] = rem%len_[k];
+            rem /= len_[k];
+            off_A += pos[k]*stride_A_[k];
+            off_B += pos[k]*stride_B_[k];
+        }
+
+        for (item = item0;item < item1;item++)
+        {
+            if (m_B == 1)
+            {
+                i0 = block_A*PERMUTE_L2_BLOCK;
+                i1 = PERMUTE_MIN(m_A, i0+PERMUTE_L2_BLOCK);
+                permute_line(i1-i0, alpha, A+off_A+i0*sa_A, sa_A,
+                                     beta, B+off_B+i0*sb_A, sb_A);
+            }
+            else
+            {
+                int bi0 = block_A*PERMUTE_L2_BLOCK;
+                int bj0 = block_B*PERMUTE_L2_BLOCK;
+                int bi1 = PERMUTE_MIN(m_A, bi0+PERMUTE_L2_BLOCK);
+                int bj1 = PERMUTE_MIN(m_B, bj0+PERMUTE_L2_BLOCK);
+
+                for (j0 = bj0;j0 < bj1;j0 += PERMUTE_L1_BLOCK)
+                {
+                    j1 = PERMUTE_MIN(bj1, j0+PERMUTE_L1_BLOCK);
+
+                    for (i0 = bi0;i0 < bi1;i0 += PERMUTE_L1_BLOCK)
+                    {
+                        i1 = PERMUTE_MIN(bi1, i0+PERMUTE_L1_BLOCK);
+
+                        transpose_tile(i1-i0, j1-j0,
+                                       alpha, A+off_A+i0*sa_A+j0*sa_B, sa_A, sa_B,
+                                        beta, B+off_B+i0*sb_A+j0*sb_B, sb_A, sb_B);
+                    }
+                }
+            }
+
+            /*
+             * Advance to the next item
+             */
+            if (++block_A < nblock_A) continue;
+            block_A = 0;
+            if (++block_B < nblock_B) continue;
+            block_B = 0;
+
+            done = true;
+            for (k = 0;k < n;k++)
+            {
+                if (k == fast_A || k == fast_B) continue;
+
+                if (pos[k] == len_[k]-1)
+                {
+                    pos[k] = 0;
+                    off_A -= stride_A_[k]*(len_[k]-1);
+                    off_B -= stride_B_[k]*(len_[k]-1);
+                }
+                else
+                {
+                    pos[k]++;
+                    off_A += stride_A_[k];
+                    off_B += stride_B_[k];
+                    done = false;
+                    break;
+                }
+            }
+            if (done) break;
+        }
+    }
+}
@@ -38,6 +38,7 @@
 #include <complex>
 #include <cstdarg>
 #include <cstdio>
+#include <stdint.h>
 
 #include "memory/memory.h"
 
@@ -1974,7 +1975,47 @@ inline std::string strprintf(const char* fmt, ...)
     vsnprintf(s.data(), n+1, fmt, list);
     va_end(list);
 
-    return std::string(s.begin(), s.end());
+    return std::string(s.data(), n);
+}
+
+/*
+ * s as a quoted JSON string, with quotes, backslashes, and control characters escaped
+ */
+inline std::string jsonstring(const std::string& s)
+{
+    std::string out = "\"";
+    for (int i = 0;i < s.size();i++)
+    {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (c < 0x20)
+        {
+            out += strprintf("\\u%04x", (int)c);
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    return out+"\"";
+}
+
+/*
+ * 64-bit FNV-1a hash of s
+ */
+inline uint64_t fnv1a(const std::string& s)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (int i = 0;i < s.size();i++)
+    {
+        hash ^= (unsigned char)s[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
 }
 
 template<typename T> std::ostream& operator<<(std::ostream& os, const std::vector<T>& v)